@@ -0,0 +1,731 @@
+#include "Particle.h"
+#include "LocalTimeRK.h"
+
+#include <time.h>
+#include <chrono>
+
+// Performance benchmarks, not run as part of the unit tests. Build and run with:
+//
+// make bench
+
+// Prevents the compiler from optimizing away results that are not otherwise used
+volatile int64_t benchmarkSink;
+
+class BenchmarkTimer {
+public:
+	BenchmarkTimer(const char *name, size_t count) : name(name), count(count) {
+		start = std::chrono::steady_clock::now();
+	}
+	~BenchmarkTimer() {
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("%-48s %10zu ops %9.3f ms %9.2f ns/op\n", name, count, elapsed * 1000.0, elapsed * 1e9 / (double)count);
+	}
+
+	const char *name;
+	size_t count;
+	std::chrono::steady_clock::time_point start;
+};
+
+const char *tzNewYork = "EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00";
+
+void benchBatchConvert() {
+	const size_t count = 1000000;
+	LocalTimePosixTimezone tzConfig(tzNewYork);
+
+	std::vector<time_t> times(count);
+	std::vector<time_t> localTime(count);
+	std::vector<uint8_t> dst(count);
+	std::vector<int16_t> year(count);
+	std::vector<int8_t> month(count), day(count), hour(count), minute(count), second(count);
+
+	for(int pass = 0; pass < 2; pass++) {
+		// Pass 0: one sample per second for about 11 days (one DST segment)
+		// Pass 1: spread over about 2 years (many segments)
+		time_t t = LocalTime::stringToTime("2021-06-01 00:00:00");
+		for(size_t ii = 0; ii < count; ii++) {
+			times[ii] = t;
+			t += (pass == 0) ? 1 : 61;
+		}
+		printf("batch conversion, %s\n", (pass == 0) ? "one DST segment" : "spanning DST segments");
+
+		{
+			BenchmarkTimer timer("  LocalTimeConvert::convert() loop", count);
+			LocalTimeConvert conv;
+			conv.withConfig(tzConfig);
+			int64_t sum = 0;
+			for(size_t ii = 0; ii < count; ii++) {
+				conv.withTime(times[ii]).convert();
+				sum += conv.localTimeValue.tm_hour + conv.isDST();
+			}
+			benchmarkSink = sum;
+		}
+		{
+			LocalTimeTransitionTable table;
+			table.build(tzConfig);
+
+			BenchmarkTimer timer("  LocalTimeConvert::convert() transition table", count);
+			LocalTimeConvert conv;
+			conv.withTransitionTable(&table);
+			int64_t sum = 0;
+			for(size_t ii = 0; ii < count; ii++) {
+				conv.withTime(times[ii]).convert();
+				sum += conv.localTimeValue.tm_hour + conv.isDST();
+			}
+			benchmarkSink = sum;
+		}
+		{
+			BenchmarkTimer timer("  LocalTimeBatchConvert local time and DST", count);
+			LocalTimeBatchConvert batch;
+			batch.withConfig(tzConfig).withLocalTime(localTime.data()).withDST(dst.data()).convert(times.data(), count);
+			benchmarkSink = localTime[count - 1] + dst[count - 1];
+		}
+		{
+			BenchmarkTimer timer("  LocalTimeBatchConvert with date and time", count);
+			LocalTimeBatchConvert batch;
+			batch.withConfig(tzConfig)
+				.withLocalTime(localTime.data())
+				.withDST(dst.data())
+				.withDateTime(year.data(), month.data(), day.data(), hour.data(), minute.data(), second.data())
+				.convert(times.data(), count);
+			benchmarkSink = hour[count - 1];
+		}
+	}
+}
+
+void benchFixedOffsetConvert() {
+	const size_t count = 1000000;
+	time_t start = LocalTime::stringToTime("2021-06-01 00:00:00");
+
+	printf("fixed offset conversion\n");
+	{
+		BenchmarkTimer timer("  LocalTimeConvert::convert() IST-5:30", count);
+		LocalTimeConvert conv;
+		conv.withConfig(LocalTimePosixTimezone("IST-5:30"));
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			conv.withTime(start + (time_t)ii * 61).convert();
+			sum += conv.localTimeValue.tm_hour;
+		}
+		benchmarkSink = sum;
+	}
+	{
+		BenchmarkTimer timer("  LocalTimeFixedOffsetConvert<19800>", count);
+		LocalTimeFixedOffsetConvert<19800> conv;
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			conv.withTime(start + (time_t)ii * 61).convert();
+			sum += conv.localTimeValue.tm_hour;
+		}
+		benchmarkSink = sum;
+	}
+}
+
+void benchIncrementalConvert() {
+	const size_t count = 1000000;
+	LocalTimePosixTimezone tzConfig(tzNewYork);
+
+	printf("stepping forward\n");
+	{
+		BenchmarkTimer timer("  LocalTimeConvert::addSeconds(1)", count);
+		LocalTimeConvert conv;
+		conv.withConfig(tzConfig).withTime(LocalTime::stringToTime("2021-06-01 00:00:00")).convert();
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			conv.addSeconds(1);
+			sum += conv.localTimeValue.tm_sec;
+		}
+		benchmarkSink = sum;
+	}
+	{
+		BenchmarkTimer timer("  LocalTimeConvert::nextMinute()", count);
+		LocalTimeConvert conv;
+		conv.withConfig(tzConfig).withTime(LocalTime::stringToTime("2021-06-01 00:00:00")).convert();
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			conv.nextMinute();
+			sum += conv.localTimeValue.tm_min;
+		}
+		benchmarkSink = sum;
+	}
+	{
+		BenchmarkTimer timer("  LocalTimeConversion::convert() sorted stream", count);
+		LocalTimeConversion conversion;
+		conversion.withConfig(&tzConfig);
+		time_t t = LocalTime::stringToTime("2021-06-01 00:00:00");
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			conversion.withTime(t + (time_t)ii * 5).convert();
+			sum += conversion.hour;
+		}
+		benchmarkSink = sum;
+	}
+	{
+		BenchmarkTimer timer("  LocalTimeCursor::advance() sorted stream", count);
+		LocalTimeCursor cursor;
+		cursor.withConfig(&tzConfig);
+		time_t t = LocalTime::stringToTime("2021-06-01 00:00:00");
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			cursor.advance(t + (time_t)ii * 5);
+			sum += cursor.hour;
+		}
+		benchmarkSink = sum;
+	}
+}
+
+void benchMultiZoneConvert() {
+	const size_t numZones = 300;
+	const size_t numTimes = 10000;
+	time_t start = LocalTime::stringToTime("2021-06-01 00:00:00");
+
+	// Distinct zones with DST, offset from New York by whole and half hours
+	std::vector<LocalTimePosixTimezone> configs(numZones);
+	std::vector<LocalTimeZoneHandle> zones(numZones);
+	LocalTimeZoneRegistry registry;
+	for(size_t ii = 0; ii < numZones; ii++) {
+		String tzStr = String::format("XST%d:%02dXDT,M3.2.0/2:00:00,M11.1.0/2:00:00", (int)(ii % 24) - 11, (ii % 2) ? 30 : 0);
+		configs[ii].parse(tzStr.c_str());
+		zones[ii] = registry.intern(tzStr.c_str());
+	}
+	std::vector<int8_t> hour(numZones);
+
+	printf("one time in %zu timezones\n", numZones);
+	{
+		BenchmarkTimer timer("  LocalTimeConvert per timezone", numZones * numTimes);
+		int64_t sum = 0;
+		for(size_t tt = 0; tt < numTimes; tt++) {
+			for(size_t ii = 0; ii < numZones; ii++) {
+				LocalTimeConvert conv;
+				conv.withConfig(configs[ii]).withTime(start + (time_t)tt * 3607).convert();
+				sum += conv.localTimeValue.tm_hour;
+			}
+		}
+		benchmarkSink = sum;
+	}
+	{
+		BenchmarkTimer timer("  LocalTimeMultiZoneConvert configs", numZones * numTimes);
+		LocalTimeMultiZoneConvert multi;
+		multi.withConfigs(configs.data(), numZones).withDateTime(NULL, NULL, NULL, hour.data(), NULL, NULL);
+		int64_t sum = 0;
+		for(size_t tt = 0; tt < numTimes; tt++) {
+			multi.convert(start + (time_t)tt * 3607);
+			sum += hour[tt % numZones];
+		}
+		benchmarkSink = sum;
+	}
+	{
+		BenchmarkTimer timer("  LocalTimeMultiZoneConvert handles", numZones * numTimes);
+		LocalTimeMultiZoneConvert multi;
+		multi.withZones(zones.data(), numZones, registry).withDateTime(NULL, NULL, NULL, hour.data(), NULL, NULL);
+		int64_t sum = 0;
+		for(size_t tt = 0; tt < numTimes; tt++) {
+			multi.convert(start + (time_t)tt * 3607);
+			sum += hour[tt % numZones];
+		}
+		benchmarkSink = sum;
+	}
+}
+
+void benchFormat() {
+	const size_t count = 1000000;
+	LocalTimeConvert conv;
+	conv.withConfig(LocalTimePosixTimezone(tzNewYork)).withTime(LocalTime::stringToTime("2021-06-01 00:00:00")).convert();
+
+	printf("formatting %s\n", TIME_FORMAT_ISO8601_FULL);
+	{
+		BenchmarkTimer timer("  LocalTimeConvert::format() String", count);
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			sum += conv.format(TIME_FORMAT_ISO8601_FULL).length();
+		}
+		benchmarkSink = sum;
+	}
+	{
+		BenchmarkTimer timer("  LocalTimeConvert::format() buffer", count);
+		char buf[64];
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			sum += conv.format(TIME_FORMAT_ISO8601_FULL, buf, sizeof(buf));
+		}
+		benchmarkSink = sum;
+	}
+	{
+		BenchmarkTimer timer("  LocalTimeFormatter::format() buffer", count);
+		LocalTimeFormatter formatter(TIME_FORMAT_ISO8601_FULL);
+		char buf[64];
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			sum += formatter.format(conv, buf, sizeof(buf));
+		}
+		benchmarkSink = sum;
+	}
+}
+
+// Previous implementation of LocalTime::stringToTime()
+static time_t legacyStringToTime(const char *str) {
+	struct tm timeInfo;
+	int parts[6];
+	if (sscanf(str, "%d-%d-%d%*c%d:%d:%d", &parts[0], &parts[1], &parts[2], &parts[3], &parts[4], &parts[5]) == 6) {
+		timeInfo.tm_year = parts[0] - 1900;
+		timeInfo.tm_mon = parts[1] - 1;
+		timeInfo.tm_mday = parts[2];
+		timeInfo.tm_hour = parts[3];
+		timeInfo.tm_min = parts[4];
+		timeInfo.tm_sec = parts[5];
+		return LocalTime::tmToTime(&timeInfo);
+	}
+	else {
+		return 0;
+	}
+}
+
+void benchISO8601() {
+	const size_t count = 1000000;
+	const char *str = "2021-04-01T12:34:56.250-04:00";
+
+	printf("ISO 8601 parsing and formatting\n");
+	{
+		BenchmarkTimer timer("  legacy sscanf stringToTime", count);
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			sum += legacyStringToTime(str);
+		}
+		benchmarkSink = sum;
+	}
+	{
+		BenchmarkTimer timer("  LocalTime::stringToTime()", count);
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			sum += LocalTime::stringToTime(str);
+		}
+		benchmarkSink = sum;
+	}
+	{
+		BenchmarkTimer timer("  LocalTimeISO8601::parse() with offset", count);
+		LocalTimeISO8601 iso;
+		size_t len = strlen(str);
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			iso.parse(str, len);
+			sum += iso.toTime();
+		}
+		benchmarkSink = sum;
+	}
+	{
+		BenchmarkTimer timer("  LocalTime::timeToString() buffer", count);
+		char buf[32];
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			sum += LocalTime::timeToString(1617280496 + (time_t)ii, buf, sizeof(buf));
+		}
+		benchmarkSink = sum;
+	}
+}
+
+void benchScheduleIndex() {
+	const size_t count = 100000;
+	LocalTimePosixTimezone tzConfig(tzNewYork);
+	time_t start = LocalTime::stringToTime("2022-03-01 00:00:00");
+
+	// Every 15 minutes on weekdays during business hours except a holiday, every 4 hours, 
+	// and on the first Monday of the month
+	LocalTimeSchedule schedule;
+	schedule.withMinuteOfHour(15, LocalTimeRange(LocalTimeHMS("09:00:00"), LocalTimeHMS("16:59:59"), LocalTimeRestrictedDate(LocalTimeDayOfWeek::MASK_WEEKDAY).withExceptDates({"2022-03-07"})));
+	schedule.withHourOfDay(4);
+	schedule.withDayOfWeekOfMonth(1, 1, LocalTimeRange(LocalTimeHMS("09:00:00")));
+
+	printf("next scheduled time (3 items, %zu times 7 minutes apart)\n", count);
+	{
+		BenchmarkTimer timer("  LocalTimeSchedule::getNextScheduledTime()", count);
+		LocalTimeConvert conv;
+		conv.withConfig(tzConfig);
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			conv.withTime(start + (time_t)ii * 420).convert();
+			schedule.getNextScheduledTime(conv);
+			sum += conv.time;
+		}
+		benchmarkSink = sum;
+	}
+	{
+		BenchmarkTimer timer("  LocalTimeScheduleIndex::getNextScheduledTime()", count);
+		LocalTimeScheduleIndex index(schedule);
+		LocalTimeConvert conv;
+		conv.withConfig(tzConfig);
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			conv.withTime(start + (time_t)ii * 420).convert();
+			index.getNextScheduledTime(conv);
+			sum += conv.time;
+		}
+		benchmarkSink = sum;
+	}
+}
+
+void benchScheduler() {
+	const size_t numSchedules = 10000;
+	LocalTimePosixTimezone tzConfig(tzNewYork);
+	time_t start = LocalTime::stringToTime("2022-03-01 00:00:00");
+
+	// Schedules that fire every 15 to 74 minutes at different minute offsets
+	LocalTimeScheduleManager manager;
+	for(size_t ii = 0; ii < numSchedules; ii++) {
+		LocalTimeSchedule schedule;
+		schedule.withMinuteOfHour(15 + (int)(ii % 60), LocalTimeRange(LocalTimeHMS(String::format("00:%02d:00", (int)(ii % 15)))));
+		schedule.withFlags(LocalTimeSchedule::FLAG_QUICK_WAKE);
+		manager.schedules.push_back(schedule);
+	}
+
+	printf("next wake (%zu schedules)\n", numSchedules);
+	{
+		const size_t count = 10;
+		BenchmarkTimer timer("  LocalTimeScheduleManager::getNextWake()", count);
+		LocalTimeConvert conv;
+		conv.withConfig(tzConfig);
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			conv.withTime(start + (time_t)ii * 60).convert();
+			sum += manager.getNextWake(conv);
+		}
+		benchmarkSink = sum;
+	}
+
+	LocalTimeScheduler scheduler;
+	scheduler.withConfig(tzConfig);
+	{
+		BenchmarkTimer timer("  LocalTimeScheduler::add()", numSchedules);
+		for(auto it = manager.schedules.begin(); it != manager.schedules.end(); ++it) {
+			scheduler.add(*it, start);
+		}
+	}
+	{
+		// One day, checking every minute. The count is the number of schedules that fired.
+		BenchmarkTimer timer("  LocalTimeScheduler::popDue() per schedule fired", 0);
+		int64_t sum = 0;
+		for(time_t timeNow = start; timeNow < start + 86400; timeNow += 60) {
+			timer.count += scheduler.popDue(timeNow, [&sum](LocalTimeScheduler::ScheduleId id, time_t time) {
+				sum += time;
+			});
+			sum += scheduler.peekNext();
+		}
+		benchmarkSink = sum;
+	}
+}
+
+void benchTimingWheel() {
+	LocalTimePosixTimezone tzConfig(tzNewYork);
+	time_t start = LocalTime::stringToTime("2022-03-01 00:00:00");
+
+	const size_t numSchedulesArray[] = { 10000, 100000, 1000000 };
+	for(size_t numSchedules : numSchedulesArray) {
+		// Schedules that fire every 15 to 74 minutes at different minute offsets
+		LocalTimeScheduleManager manager;
+		manager.schedules.resize(numSchedules);
+		for(size_t ii = 0; ii < numSchedules; ii++) {
+			manager.schedules[ii].withMinuteOfHour(15 + (int)(ii % 60), LocalTimeRange(LocalTimeHMS(String::format("00:%02d:00", (int)(ii % 15)))));
+			manager.schedules[ii].withFlags(LocalTimeSchedule::FLAG_QUICK_WAKE);
+		}
+
+		printf("timing wheel (%zu schedules)\n", numSchedules);
+		{
+			const size_t count = 3;
+			BenchmarkTimer timer("  LocalTimeScheduleManager::getNextWake()", count);
+			LocalTimeConvert conv;
+			conv.withConfig(tzConfig);
+			int64_t sum = 0;
+			for(size_t ii = 0; ii < count; ii++) {
+				conv.withTime(start + (time_t)ii * 60).convert();
+				sum += manager.getNextWake(conv);
+			}
+			benchmarkSink = sum;
+		}
+
+		LocalTimeTimingWheel wheel;
+		wheel.withConfig(tzConfig);
+		{
+			BenchmarkTimer timer("  LocalTimeTimingWheel::add()", numSchedules);
+			for(auto it = manager.schedules.begin(); it != manager.schedules.end(); ++it) {
+				wheel.add(*it, start);
+			}
+		}
+		{
+			// Ten minutes, advancing every second. The count is the number of schedules that fired.
+			BenchmarkTimer timer("  LocalTimeTimingWheel::advance() each second", 0);
+			int64_t sum = 0;
+			for(time_t timeNow = start; timeNow < start + 600; timeNow++) {
+				timer.count += wheel.advance(timeNow, [&sum](LocalTimeTimingWheel::ScheduleId id, time_t time) {
+					sum += time;
+				});
+			}
+			benchmarkSink = sum;
+		}
+		{
+			// Clock jumps forward a day, then advance every second for a minute
+			BenchmarkTimer timer("  LocalTimeTimingWheel::advance() 1 day jump", 0);
+			int64_t sum = 0;
+			for(time_t timeNow = start + 86400; timeNow < start + 86460; timeNow++) {
+				timer.count += wheel.advance(timeNow, [&sum](LocalTimeTimingWheel::ScheduleId id, time_t time) {
+					sum += time;
+				});
+			}
+			benchmarkSink = sum;
+		}
+	}
+}
+
+void benchScheduleOccurrences() {
+	LocalTimePosixTimezone tzConfig(tzNewYork);
+
+	// Same schedule as benchScheduleIndex()
+	LocalTimeSchedule schedule;
+	schedule.withMinuteOfHour(15, LocalTimeRange(LocalTimeHMS("09:00:00"), LocalTimeHMS("16:59:59"), LocalTimeRestrictedDate(LocalTimeDayOfWeek::MASK_WEEKDAY).withExceptDates({"2022-03-07"})));
+	schedule.withHourOfDay(4);
+	schedule.withDayOfWeekOfMonth(1, 1, LocalTimeRange(LocalTimeHMS("09:00:00")));
+
+	LocalTimeConvert conv;
+	conv.withConfig(tzConfig).withTime(LocalTime::stringToTime("2022-03-01 00:00:00")).convert();
+	time_t until = conv.time + 7 * 86400;
+
+	const size_t numWeeks = 100;
+	size_t count = 0;
+	int64_t weekSum = 0;
+	for(const LocalTimeConvert &occurrence : schedule.occurrences(conv, until)) {
+		weekSum += occurrence.time;
+		count++;
+	}
+	benchmarkSink = weekSum;
+
+	printf("schedule occurrences (%zu times in a week)\n", count);
+	{
+		BenchmarkTimer timer("  getNextScheduledTime() loop", count * numWeeks);
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < numWeeks; ii++) {
+			LocalTimeConvert loopConv(conv);
+			while(schedule.getNextScheduledTime(loopConv) && loopConv.time < until) {
+				sum += loopConv.time;
+			}
+		}
+		benchmarkSink = sum;
+	}
+	{
+		BenchmarkTimer timer("  LocalTimeSchedule::occurrences()", count * numWeeks);
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < numWeeks; ii++) {
+			for(const LocalTimeConvert &occurrence : schedule.occurrences(conv, until)) {
+				sum += occurrence.time;
+			}
+		}
+		benchmarkSink = sum;
+	}
+}
+
+// Previous implementation of LocalTimePosixTimezone::parse() and LocalTimeChange::parse(), using strdup,
+// strtok_r, and sscanf. Only the parts needed to compare speed are included.
+static void legacyChangeParse(LocalTimeChange &change, const char *str) {
+	int values[3];
+	if (str[0] == 'M' && sscanf(str, "M%d.%d.%d", &values[0], &values[1], &values[2]) == 3) {
+		change.month = (int8_t) values[0];
+		change.week = (int8_t) values[1];
+		change.dayOfWeek = (int8_t) values[2];
+		const char *cp = strchr(str, '/');
+		if (cp) {
+			change.hms.parse(cp + 1);
+		}
+		change.valid = true;
+	}
+	else {
+		change.clear();
+	}
+}
+
+static bool legacyPosixTimezoneParse(LocalTimePosixTimezone &tz, const char *str) {
+	char *mutableCopy = strdup(str);
+	char *token, *save = mutableCopy;
+	size_t ii = 0;
+	bool valid = false;
+	while((token = strtok_r(save, ",", &save)) != 0) {
+		switch(ii++) {
+			case 0: {
+				char *cp = token, *start = token, save2;
+				while(*cp >= 'A') {
+					cp++;
+				}
+				save2 = *cp;
+				*cp = 0;
+				tz.standardName = start;
+				*cp = save2;
+				valid = true;
+				if (*cp) {
+					start = cp;
+					while(*cp && *cp < 'A') {
+						cp++;
+					}
+					save2 = *cp;
+					*cp = 0;
+					tz.standardHMS.parse(start);
+					*cp = save2;
+					if (*cp) {
+						start = cp;
+						while(*cp && *cp >= 'A') {
+							cp++;
+						}
+						save2 = *cp;
+						*cp = 0;
+						tz.dstName = start;
+						*cp = save2;
+						if (*cp) {
+							tz.dstHMS.parse(cp);
+						}
+					}
+				}
+				break;
+			}
+			case 1:
+				legacyChangeParse(tz.dstStart, token);
+				break;
+			case 2:
+				legacyChangeParse(tz.standardStart, token);
+				break;
+		}
+	}
+	free(mutableCopy);
+	return valid;
+}
+
+void benchPosixTimezoneParse() {
+	const char *tzStrings[] = {
+		"EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00",
+		"CET-1CEST,M3.5.0,M10.5.0/3",
+		"AEST-10AEDT,M10.1.0/02:00:00,M4.1.0/03:00:00",
+		"NST3:30NDT,M3.2.0/0:01,M11.1.0/0:01",
+		"IST-5:30",
+		"MST7",
+		"CHAST-12:45CHADT,M9.5.0/2:45,M4.1.0/3:45",
+		"IST-2IDT,M3.4.4/26,M10.5.0",
+	};
+	const size_t numStrings = sizeof(tzStrings) / sizeof(tzStrings[0]);
+	const size_t count = 1000000;
+
+	printf("POSIX timezone parsing (%zu typical strings)\n", numStrings);
+	{
+		BenchmarkTimer timer("  legacy strdup/strtok_r/sscanf parse", count);
+		LocalTimePosixTimezone tz;
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			sum += legacyPosixTimezoneParse(tz, tzStrings[ii % numStrings]);
+		}
+		benchmarkSink = sum;
+	}
+	{
+		BenchmarkTimer timer("  LocalTimePosixTimezone::parse()", count);
+		LocalTimePosixTimezone tz;
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			sum += tz.parse(tzStrings[ii % numStrings]);
+		}
+		benchmarkSink = sum;
+	}
+	{
+		BenchmarkTimer timer("  LocalTimePosixTimezoneLiteral::parse() validate", count);
+		int64_t sum = 0;
+		for(size_t ii = 0; ii < count; ii++) {
+			sum += LocalTimePosixTimezoneLiteral::parse(tzStrings[ii % numStrings]).valid;
+		}
+		benchmarkSink = sum;
+	}
+}
+
+// Previous implementation of LocalTime::tmToTime(). The original called mktime() on
+// device and timegm() in UNITTEST builds; the closed-form version is much cheaper, so
+// the legacy path below must not use it or the baseline understates the original cost.
+static size_t legacyTmToTimeCalls = 0;
+
+static time_t legacyTmToTime(struct tm *pTimeInfo) {
+	legacyTmToTimeCalls++;
+	return timegm(pTimeInfo);
+}
+
+// Previous implementation of LocalTime::dayOfWeekOfMonth(), stepping one day at a time
+
+static int legacyDayOfWeekOfMonth(int year, int month, int dayOfWeek, int ordinal) {
+	struct tm timeInfo = {0};
+	int lastDay = LocalTime::lastDayOfMonth(year, month);
+
+	timeInfo.tm_year = year - 1900;
+	timeInfo.tm_mon = month - 1;
+	if (ordinal > 0) {
+		timeInfo.tm_mday = 1;
+		legacyTmToTime(&timeInfo);
+		while(timeInfo.tm_wday != dayOfWeek) {
+			timeInfo.tm_mday++;
+			legacyTmToTime(&timeInfo);
+		}
+		int day = timeInfo.tm_mday + (ordinal - 1) * 7;
+		return (day <= lastDay) ? day : 0;
+	}
+	else {
+		timeInfo.tm_mday = lastDay;
+		legacyTmToTime(&timeInfo);
+		while(timeInfo.tm_wday != dayOfWeek) {
+			timeInfo.tm_mday--;
+			legacyTmToTime(&timeInfo);
+		}
+		int day = timeInfo.tm_mday + (ordinal + 1) * 7;
+		return (day >= 1) ? day : 0;
+	}
+}
+
+void benchDayOfWeekOfMonth() {
+	const int ordinals[] = { 1, 2, 5, -1 };
+	size_t count = 0;
+
+	printf("nth day of week of month (%d years x 12 months x 7 days x 4 ordinals)\n", 2100 - 2000);
+	{
+		BenchmarkTimer timer("  legacy day-by-day loop (timegm)", 100 * 12 * 7 * 4);
+		int64_t sum = 0;
+		for(int year = 2000; year < 2100; year++) {
+			for(int month = 1; month <= 12; month++) {
+				for(int dayOfWeek = 0; dayOfWeek < 7; dayOfWeek++) {
+					for(int ordinal : ordinals) {
+						sum += legacyDayOfWeekOfMonth(year, month, dayOfWeek, ordinal);
+						count++;
+					}
+				}
+			}
+		}
+		benchmarkSink = sum;
+	}
+	printf("    %.2f timegm calls per op\n", (double)legacyTmToTimeCalls / (double)count);
+	{
+		BenchmarkTimer timer("  LocalTime::dayOfWeekOfMonth()", 100 * 12 * 7 * 4);
+		int64_t sum = 0;
+		for(int year = 2000; year < 2100; year++) {
+			for(int month = 1; month <= 12; month++) {
+				for(int dayOfWeek = 0; dayOfWeek < 7; dayOfWeek++) {
+					for(int ordinal : ordinals) {
+						sum += LocalTime::dayOfWeekOfMonth(year, month, dayOfWeek, ordinal);
+					}
+				}
+			}
+		}
+		benchmarkSink = sum;
+	}
+	printf("    closed form (daysFromCivil), no tmToTime or timegm calls\n");
+}
+
+int main(int argc, char *argv[]) {
+	benchBatchConvert();
+	benchFixedOffsetConvert();
+	benchIncrementalConvert();
+	benchMultiZoneConvert();
+	benchFormat();
+	benchISO8601();
+	benchScheduleIndex();
+	benchScheduler();
+	benchTimingWheel();
+	benchScheduleOccurrences();
+	benchPosixTimezoneParse();
+	benchDayOfWeekOfMonth();
+
+	return 0;
+}
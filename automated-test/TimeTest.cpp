@@ -2,6 +2,8 @@
 #include "LocalTimeRK.h"
 
 #include <time.h>
+#include <iterator>
+#include <string>
 
 // This test program assumes it's run with TZ set to "UTC" so strftime prints the same format
 // as a Particle device when using the native strftime. The Makefile calls it this way:
@@ -50,6 +52,17 @@ void _assertInt(const char *msg, int got, int expected, int line) {
 	}
 }
 
+// Use this for time_t values so times after 2038 are not truncated
+#define assertInt64(msg, got, expected) _assertInt64(msg, got, expected, __LINE__)
+void _assertInt64(const char *msg, int64_t got, int64_t expected, int line) {
+	if (expected != got) {
+		printf("assertion failed %s line %d\n", msg, line);
+		printf("expected: %lld\n", (long long)expected);
+		printf("     got: %lld\n", (long long)got);
+		assert(false);
+	}
+}
+
 #define assertStr(msg, got, expected) _assertStr(msg, got, expected, __LINE__)
 void _assertStr(const char *msg, const char *got, const char *expected, int line) {
 	if (strcmp(expected, got) != 0) {
@@ -94,6 +107,81 @@ void _assertTime2(const char *msg, time_t got, const char *expected, int line) {
 }
 
 
+// Timezones for the tests that compare one of the faster conversion classes to LocalTimeConvert
+const char *testZones[] = {
+	"EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00",       // Northern hemisphere DST
+	"AEST-10AEDT,M10.1.0/02:00:00,M4.1.0/03:00:00", // Southern hemisphere DST
+	"ACST-9:30ACDT,M10.1.0/2,M4.1.0/3",             // Half hour offset with DST
+	"ACST-9:30",                                    // Half hour offset without DST
+	"IST-2IDT,M3.4.4/26,M10.5.0",                   // Transition time past 24:00
+	"NST3:30NDT,M3.2.0,M11.1.0",                    // Negative half hour offset with DST
+	"NZST-12NZDT,M9.5.0,M4.1.0/3",                  // Large positive offset with DST
+	"IST-5:30",
+	"HST10",
+	"UTC0",
+	0
+};
+const size_t numTestZones = sizeof(testZones) / sizeof(testZones[0]) - 1;
+
+// Local time fields from any of the conversion classes, for assertSameLocalTime(). Fields 
+// that a class does not calculate are -1 and are not compared.
+struct TestLocalTime {
+	TestLocalTime(const LocalTimeConvert &conv) : 
+		isDST(conv.isDST()), position((int)conv.position),
+		year(conv.localTimeValue.year()), month(conv.localTimeValue.month()), day(conv.localTimeValue.day()),
+		hour(conv.localTimeValue.hour()), minute(conv.localTimeValue.minute()), second(conv.localTimeValue.second()),
+		dayOfWeek(conv.localTimeValue.tm_wday), dayOfYear(conv.localTimeValue.tm_yday) {};
+
+	TestLocalTime(const LocalTimeConversion &conversion) : 
+		isDST(conversion.isDST()), position((int)conversion.position),
+		year(conversion.year), month(conversion.month), day(conversion.day),
+		hour(conversion.hour), minute(conversion.minute), second(conversion.second),
+		dayOfWeek(conversion.dayOfWeek), dayOfYear(conversion.dayOfYear) {};
+
+	template<int OFFSET>
+	TestLocalTime(const LocalTimeFixedOffsetConvert<OFFSET> &conv) : 
+		isDST(conv.isDST()), position(-1),
+		year(conv.localTimeValue.year()), month(conv.localTimeValue.month()), day(conv.localTimeValue.day()),
+		hour(conv.localTimeValue.hour()), minute(conv.localTimeValue.minute()), second(conv.localTimeValue.second()),
+		dayOfWeek(conv.localTimeValue.tm_wday), dayOfYear(conv.localTimeValue.tm_yday) {};
+
+	TestLocalTime(int isDST, int year, int month, int day, int hour, int minute, int second) :
+		isDST(isDST), position(-1), year(year), month(month), day(day), hour(hour), minute(minute), second(second), 
+		dayOfWeek(-1), dayOfYear(-1) {};
+
+	int isDST;
+	int position;
+	int year;
+	int month;
+	int day;
+	int hour;
+	int minute;
+	int second;
+	int dayOfWeek;
+	int dayOfYear;
+};
+
+#define assertSameLocalTime(msg, expected, actual) _assertSameLocalTime(msg, TestLocalTime(expected), TestLocalTime(actual), __LINE__)
+void _assertSameLocalTime(const char *msg, const TestLocalTime &expected, const TestLocalTime &actual, int line) {
+	_assertInt(msg, actual.isDST, expected.isDST, line);
+	if (actual.position >= 0 && expected.position >= 0) {
+		_assertInt(msg, actual.position, expected.position, line);
+	}
+	_assertInt(msg, actual.year, expected.year, line);
+	_assertInt(msg, actual.month, expected.month, line);
+	_assertInt(msg, actual.day, expected.day, line);
+	_assertInt(msg, actual.hour, expected.hour, line);
+	_assertInt(msg, actual.minute, expected.minute, line);
+	_assertInt(msg, actual.second, expected.second, line);
+	if (actual.dayOfWeek >= 0 && expected.dayOfWeek >= 0) {
+		_assertInt(msg, actual.dayOfWeek, expected.dayOfWeek, line);
+	}
+	if (actual.dayOfYear >= 0 && expected.dayOfYear >= 0) {
+		_assertInt(msg, actual.dayOfYear, expected.dayOfYear, line);
+	}
+}
+
+
 const char *timeChanges[4] = {
 	"M3.2.0/2:00:00",
 	"M11.1.0/2:00:00",
@@ -142,9 +230,10 @@ void testLocalTimeChange() {
 	assert(tc.hms.minute == 0);
 	assert(tc.hms.second == 0);
 
+	// POSIX default time is 2:00:00
 	tc.parse("M3.2.0");
 	assert(tc.valid);
-	assert(tc.hms.hour == 0);
+	assert(tc.hms.hour == 2);
 	assert(tc.hms.minute == 0);
 	assert(tc.hms.second == 0);
 
@@ -163,7 +252,7 @@ void testLocalTimePosixTimezone() {
 	LocalTimePosixTimezone tz;
 
 	// Iceland, no DST
-	tz.parse("GMT");
+	tz.parse("GMT0");
 	assert(strcmp(tz.standardName.c_str(), "GMT") == 0);
 	assert(tz.standardHMS.hour == 0);
 	assert(tz.standardHMS.minute == 0);
@@ -375,7 +464,7 @@ void testLocalTimePosixTimezone() {
 	assert(tz.standardStart.month == 10);
 	assert(tz.standardStart.week == 5);
 	assert(tz.standardStart.dayOfWeek == 0);
-	assert(tz.standardStart.hms.hour == 0);
+	assert(tz.standardStart.hms.hour == 2);
 	assert(tz.standardStart.hms.minute == 0);
 	assert(tz.standardStart.hms.second == 0);
 	assert(tz.standardStart.valid == 1);
@@ -445,6 +534,548 @@ void testLocalTimePosixTimezone() {
 	assert(tz.dstStart.valid == 1);
 }
 
+// Parsed at compile time; a malformed string here would not compile
+constexpr LocalTimePosixTimezoneLiteral tzLiteralNewYork = LocalTimePosixTimezoneLiteral::parse("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00");
+static_assert(tzLiteralNewYork.valid, "tzLiteralNewYork");
+static_assert(tzLiteralNewYork.standardHMS.hour == 5, "tzLiteralNewYork");
+static_assert(tzLiteralNewYork.dstHMS.hour == 4, "tzLiteralNewYork");
+static_assert(tzLiteralNewYork.dstStart.month == 3 && tzLiteralNewYork.dstStart.week == 2, "tzLiteralNewYork");
+static_assert(tzLiteralNewYork.standardStart.month == 11 && tzLiteralNewYork.standardStart.hms.hour == 2, "tzLiteralNewYork");
+static_assert(tzLiteralNewYork.standardName[0] == 'E' && tzLiteralNewYork.dstName[2] == 'T' && tzLiteralNewYork.dstName[3] == 0, "tzLiteralNewYork");
+
+void testPosixTimezoneLiteral() {
+	const char *tzStrings[] = {
+		"GMT0",
+		"MST7",
+		"EST+5EDT,M3.2.0/2,M11.1.0/2",
+		"IST-5:30",
+		"ACWST-8:45",
+		"CET-1CEST,M3.5.0,M10.5.0/3",
+		"IST-2IDT,M3.4.4/26,M10.5.0",
+		"NST3:30NDT,M3.2.0/0:01,M11.1.0/0:01",
+		"AEST-10AEDT,M10.1.0/02:00:00,M4.1.0/03:00:00",
+		"CHAST-12:45CHADT,M9.5.0/2:45,M4.1.0/3:45",
+		"BST0GMT,M3.5.0/1:00:00,M10.5.0/2:00:00",
+		"<+03>-3",
+		"<-03>3<-02>,M3.5.0/-2,M10.5.0/-1",
+		"EST5EDT,J60/2,J300/2",
+		0
+	};
+	for(size_t ii = 0; tzStrings[ii]; ii++) {
+		LocalTimePosixTimezoneLiteral literal = LocalTimePosixTimezoneLiteral::parse(tzStrings[ii]);
+
+		LocalTimePosixTimezone tz1(tzStrings[ii]), tz2(literal);
+		assertInt(tzStrings[ii], tz2.isValid(), tz1.isValid());
+		if (!tz1.isValid()) {
+			continue;
+		}
+		assertStr(tzStrings[ii], tz2.standardName.c_str(), tz1.standardName.c_str());
+		assertStr(tzStrings[ii], tz2.dstName.c_str(), tz1.dstName.c_str());
+		assertStr(tzStrings[ii], tz2.standardHMS.toString(), tz1.standardHMS.toString());
+		assertStr(tzStrings[ii], tz2.dstHMS.toString(), tz1.dstHMS.toString());
+		assertStr(tzStrings[ii], tz2.dstStart.toString(), tz1.dstStart.toString());
+		assertStr(tzStrings[ii], tz2.standardStart.toString(), tz1.standardStart.toString());
+		assertInt(tzStrings[ii], tz2.hasDST(), tz1.hasDST());
+	}
+
+	LocalTimePosixTimezone tz(tzLiteralNewYork);
+	LocalTimeConvert conv;
+	conv.withConfig(tz).withTime(LocalTime::stringToTime("2021-07-01 16:00:00")).convert();
+	assertInt("", conv.isDST(), 1);
+	assertInt("", conv.localTimeValue.hour(), 12);
+
+	// Malformed strings, evaluated at runtime, report the error position
+	struct {
+		const char *str;
+		size_t errorPosition;
+	} badStrings[] = {
+		{ "", 0 },
+		{ "5EST", 0 },
+		{ "EST5EDT,M3.2.0/2:00:00", 22 },
+		{ "EST5EDT,M13.2.0,M11.1.0", 9 },
+		{ "EST5EDT,M3.6.0,M11.1.0", 11 },
+		{ "EST5EDT,M3.2.7,M11.1.0", 13 },
+		{ "EST5EDT,3.2.0,M11.1.0", 9 },
+		{ "EST5EDT,X3.2.0,M11.1.0", 8 },
+		{ "EST5,M3.2.0,M11.1.0", 4 },
+		{ "EST25", 3 },
+		{ "EST5:60", 5 },
+		{ "EST5EDT,M3.2.0,M11.1.0x", 22 },
+		{ "VERYLONGNAME5", 0 },
+		{ "EST", 3 },
+		{ "EST,M3.2.0,M11.1.0", 3 },
+		{ 0, 0 }
+	};
+	for(size_t ii = 0; badStrings[ii].str; ii++) {
+		LocalTimePosixTimezoneLiteral literal = LocalTimePosixTimezoneLiteral::parse(badStrings[ii].str);
+		assertInt(badStrings[ii].str, literal.valid, 0);
+		assertInt(badStrings[ii].str, (int)literal.errorPosition, (int)badStrings[ii].errorPosition);
+		assertInt(badStrings[ii].str, literal.errorReason != nullptr, 1);
+
+		LocalTimePosixTimezone tz2(literal);
+		assertInt(badStrings[ii].str, tz2.isValid(), 0);
+	}
+}
+
+void testPosixTimezoneParse() {
+	LocalTimePosixTimezone tz;
+	size_t errorPosition;
+	const char *errorReason;
+
+	// Quoted names
+	assertInt("", tz.parse("<+03>-3"), 1);
+	assertStr("", tz.standardName.c_str(), "+03");
+	assertInt("", tz.getOffset(false), 3 * 3600);
+	assertInt("", tz.hasDST(), 0);
+
+	assertInt("", tz.parse("<-03>3<-02>,M3.5.0/-2,M10.5.0/-1"), 1);
+	assertStr("", tz.standardName.c_str(), "-03");
+	assertStr("", tz.dstName.c_str(), "-02");
+	assertInt("", tz.getOffset(true), -2 * 3600);
+
+	// Jn does not count February 29, so J60 is always March 1
+	time_t dstStart, standardStart;
+	assertInt("", tz.parse("EST5EDT,J60/2,J300/2"), 1);
+	assertStr("", tz.dstStart.toString(), "J60/2:00:00");
+	tz.calculateTransitions(2023 - 1900, &dstStart, &standardStart);
+	assertTime2("", dstStart, "2023-03-01 07:00:00");
+	assertTime2("", standardStart, "2023-10-27 06:00:00");
+	tz.calculateTransitions(2024 - 1900, &dstStart, &standardStart);
+	assertTime2("", dstStart, "2024-03-01 07:00:00");
+	assertTime2("", standardStart, "2024-10-27 06:00:00");
+
+	// n is zero-based and counts February 29
+	assertInt("", tz.parse("EST5EDT,59/2,0"), 1);
+	assertStr("", tz.dstStart.toString(), "59/2:00:00");
+	assertInt("", (int)tz.standardStart.rule, (int)LocalTimeChange::Rule::DAY_OF_YEAR);
+	tz.calculateTransitions(2023 - 1900, &dstStart, &standardStart);
+	assertTime2("", dstStart, "2023-03-01 07:00:00");
+	assertTime2("", standardStart, "2023-01-01 06:00:00");
+	tz.calculateTransitions(2024 - 1900, &dstStart, &standardStart);
+	assertTime2("", dstStart, "2024-02-29 07:00:00");
+
+	// The standard time offset is required
+	assertInt("", tz.parse("UTC", 3, &errorPosition, &errorReason), 0);
+	assertInt("", (int)errorPosition, 3);
+	assertStr("", errorReason, "expected offset");
+	assertInt("", tz.parse("UTC0"), 1);
+	assertInt("", tz.getOffset(false), 0);
+
+	// A rule without a time changes at the POSIX default of 2:00:00 local time
+	assertInt("", tz.parse("EST5EDT,M3.2.0,M11.1.0"), 1);
+	tz.calculateTransitions(2024 - 1900, &dstStart, &standardStart);
+	assertTime2("", dstStart, "2024-03-10 07:00:00");
+	assertTime2("", standardStart, "2024-11-03 06:00:00");
+
+	assertInt("", tz.parse("CET-1CEST,M3.5.0,M10.5.0/3"), 1);
+	tz.calculateTransitions(2024 - 1900, &dstStart, &standardStart);
+	assertTime2("", dstStart, "2024-03-31 01:00:00");
+	assertTime2("", standardStart, "2024-10-27 01:00:00");
+
+	assertInt("", tz.parse("NZST-12NZDT,M9.5.0,M4.1.0/3"), 1);
+	tz.calculateTransitions(2024 - 1900, &dstStart, &standardStart);
+	assertTime2("", dstStart, "2024-09-28 14:00:00");
+	assertTime2("", standardStart, "2024-04-06 14:00:00");
+
+	// Length-bounded, stops at len
+	assertInt("", tz.parse("EST5EDT,M3.2.0,M11.1.0", 4, &errorPosition, &errorReason), 1);
+	assertStr("", tz.standardName.c_str(), "EST");
+	assertInt("", tz.hasDST(), 0);
+	assertInt("", errorReason == nullptr, 1);
+
+	assertInt("", tz.parse("EST5EDT,M3.2.0,M11.1.0", 14, &errorPosition, &errorReason), 0);
+	assertInt("", (int)errorPosition, 14);
+	assertStr("", errorReason, "expected standard time rule");
+	assertInt("", tz.isValid(), 0);
+
+	// Partial garbage is rejected
+	struct {
+		const char *str;
+		size_t errorPosition;
+	} badStrings[] = {
+		{ "not a timezone", 3 },
+		{ "EST5EDT,M3", 10 },
+		{ "EST5EDT,M3.2.0,M11.1.0 ", 22 },
+		{ "ES5", 0 },
+		{ "<+03-3", 6 },
+		{ "<+03>-3<", 7 },
+		{ "EST5EDT,J0,J300", 9 },
+		{ "EST5EDT,J366,J300", 9 },
+		{ "EST5EDT,366,J300", 8 },
+		{ "EST5EDT,M3.2.0/,M11.1.0", 15 },
+		{ 0, 0 }
+	};
+	for(size_t ii = 0; badStrings[ii].str; ii++) {
+		assertInt(badStrings[ii].str, tz.parse(badStrings[ii].str, strlen(badStrings[ii].str), &errorPosition, &errorReason), 0);
+		assertInt(badStrings[ii].str, (int)errorPosition, (int)badStrings[ii].errorPosition);
+		assertInt(badStrings[ii].str, errorReason != nullptr, 1);
+		assertInt(badStrings[ii].str, LocalTimePosixTimezone(badStrings[ii].str).isValid(), 0);
+	}
+
+	LocalTimeChange tc;
+	tc.parse("J60/2:30");
+	assertStr("", tc.toString(), "J60/2:30:00");
+	tc.parse("M3.2.0/2:00:00x");
+	assertInt("", tc.valid, 0);
+	tc.parse("M3.2.0/2:00:00x", 14);
+	assertStr("", tc.toString(), "M3.2.0/2:00:00");
+}
+
+void testCivilCalendar() {
+	// Compare the closed-form calculations to the C library
+	for(time_t t = -4000000000LL; t < 8000000000LL; t += 86400 * 13 + 3607) {
+		struct tm expected, got;
+		gmtime_r(&t, &expected);
+		LocalTime::timeToTm(t, &got);
+
+		assertInt("", got.tm_year, expected.tm_year);
+		assertInt("", got.tm_mon, expected.tm_mon);
+		assertInt("", got.tm_mday, expected.tm_mday);
+		assertInt("", got.tm_hour, expected.tm_hour);
+		assertInt("", got.tm_min, expected.tm_min);
+		assertInt("", got.tm_sec, expected.tm_sec);
+		assertInt("", got.tm_wday, expected.tm_wday);
+		assertInt("", got.tm_yday, expected.tm_yday);
+
+		assertInt("", (int)(LocalTime::tmToTime(&got) - t), 0);
+	}
+
+	// Normalization of out-of-range values
+	struct tm timeInfo = {0};
+	timeInfo.tm_year = 121;
+	timeInfo.tm_mon = 0;
+	timeInfo.tm_mday = 32;
+	timeInfo.tm_hour = -1;
+	LocalTime::tmToTime(&timeInfo);
+	assertStr("", LocalTime::getTmString(&timeInfo), "tm_year=121 tm_mon=0 tm_mday=31 tm_hour=23 tm_min=0 tm_sec=0 tm_wday=0");
+
+	timeInfo = {0};
+	timeInfo.tm_year = 121;
+	timeInfo.tm_mon = 13;
+	timeInfo.tm_mday = 0;
+	timeInfo.tm_sec = 3661;
+	LocalTime::tmToTime(&timeInfo);
+	assertStr("", LocalTime::getTmString(&timeInfo), "tm_year=122 tm_mon=0 tm_mday=31 tm_hour=1 tm_min=1 tm_sec=1 tm_wday=1");
+	assertInt("", timeInfo.tm_yday, 30);
+
+	timeInfo = {0};
+	timeInfo.tm_year = 100;
+	timeInfo.tm_mon = -11;
+	timeInfo.tm_mday = 29;
+	LocalTime::tmToTime(&timeInfo);
+	// 1999 is not a leap year so this is March 1
+	assertStr("", LocalTime::getTmString(&timeInfo), "tm_year=99 tm_mon=2 tm_mday=1 tm_hour=0 tm_min=0 tm_sec=0 tm_wday=1");
+	assertInt("", timeInfo.tm_yday, 59);
+
+	assertInt("", LocalTime::daysFromCivil(1970, 1, 1), 0);
+	assertInt("", LocalTime::daysFromCivil(2000, 3, 1), 11017);
+	assertInt("", LocalTime::daysFromCivil(1969, 12, 31), -1);
+
+	int year, month, day;
+	LocalTime::civilFromDays(11016, &year, &month, &day);
+	assertInt("", year, 2000);
+	assertInt("", month, 2);
+	assertInt("", day, 29);
+
+	assertInt("", LocalTime::dayOfWeekFromDays(0), 4);
+	assertInt("", LocalTime::dayOfWeekFromDays(-1), 3);
+	assertInt("", LocalTime::dayOfWeekFromDays(-5), 6);
+}
+
+void testZoneName() {
+	LocalTimeZoneName name;
+	assertStr("", name.c_str(), "");
+	assertInt("", (int)name.length(), 0);
+
+	name = "EST";
+	assertStr("", name, "EST");
+	assertInt("", name == "EST", 1);
+	assertInt("", name != "EDT", 1);
+
+	// Truncated to fit in the buffer
+	name = "ABCDEFGHIJ";
+	assertStr("", name.c_str(), "ABCDEFG");
+
+	name = NULL;
+	assertStr("", name.c_str(), "");
+
+	// The config can be copied as raw bytes
+	LocalTimePosixTimezone tz1("AEST-10AEDT,M10.1.0/02:00:00,M4.1.0/03:00:00"), tz2;
+	memcpy(&tz2, &tz1, sizeof(LocalTimePosixTimezone));
+	assertStr("", tz2.standardName.c_str(), "AEST");
+	assertStr("", tz2.dstName.c_str(), "AEDT");
+	assertInt("", tz2.getOffset(true), 11 * 3600);
+
+	LocalTimeConvert conv;
+	conv.withConfig(tz2).withTime(LocalTime::stringToTime("2021-12-01 00:00:00")).convert();
+	assertStr("", conv.zoneName().c_str(), "AEDT");
+}
+
+void testDayOfWeekOfMonth() {
+	// Compare to checking every day of the month
+	for(int year = 1990; year <= 2060; year++) {
+		for(int month = 1; month <= 12; month++) {
+			int lastDay = LocalTime::lastDayOfMonth(year, month);
+			for(int dayOfWeek = 0; dayOfWeek < 7; dayOfWeek++) {
+				int days[6];
+				int count = 0;
+				for(int day = 1; day <= lastDay; day++) {
+					if (LocalTime::dayOfWeekFromDays(LocalTime::daysFromCivil(year, month, day)) == dayOfWeek) {
+						days[count++] = day;
+					}
+				}
+				for(int ordinal = 1; ordinal <= 6; ordinal++) {
+					assertInt("", LocalTime::dayOfWeekOfMonth(year, month, dayOfWeek, ordinal), (ordinal <= count) ? days[ordinal - 1] : 0);
+					assertInt("", LocalTime::dayOfWeekOfMonth(year, month, dayOfWeek, -ordinal), (ordinal <= count) ? days[count - ordinal] : 0);
+				}
+			}
+		}
+	}
+	assertInt("", LocalTime::dayOfWeekOfMonth(2022, 3, 7, 1), 0);
+	assertInt("", LocalTime::dayOfWeekOfMonth(2022, 3, 0, 0), 0);
+
+	// Week 5 is the last week, even if there are only 4
+	LocalTimeChange change("M2.5.0/2:00:00");
+	struct tm timeInfo = {0};
+	timeInfo.tm_year = 2021 - 1900;
+	change.calculate(&timeInfo, LocalTimeHMS("0"));
+	assertInt("", timeInfo.tm_mday, 28);
+	timeInfo.tm_year = 2032 - 1900;
+	change.calculate(&timeInfo, LocalTimeHMS("0"));
+	assertInt("", timeInfo.tm_mday, 29);
+}
+
+void testYMDDays() {
+	assertInt("", LocalTime::lastDayOfMonth(2000, 2), 29);
+	assertInt("", LocalTime::lastDayOfMonth(1900, 2), 28);
+	assertInt("", LocalTime::lastDayOfMonth(2100, 2), 28);
+	assertInt("", LocalTime::lastDayOfMonth(2024, 2), 29);
+	assertInt("", LocalTime::lastDayOfMonth(2400, 2), 29);
+
+	LocalTimeYMD ymd("1970-01-01");
+	assertInt("", ymd.toDays(), 0);
+	ymd.fromDays(-1);
+	assertStr("", ymd.toString(), "1969-12-31");
+
+	// Compare to the C library and to lastDayOfMonth
+	LocalTimeYMD prev;
+	for(int days = -25000; days < 60000; days += 3) {
+		time_t t = (time_t)days * 86400;
+		struct tm expected;
+		gmtime_r(&t, &expected);
+
+		ymd.fromDays(days);
+		assertInt("", ymd.getYear(), expected.tm_year + 1900);
+		assertInt("", ymd.getMonth(), expected.tm_mon + 1);
+		assertInt("", ymd.getDay(), expected.tm_mday);
+		assertInt("", ymd.getDayOfWeek(), expected.tm_wday);
+		assertInt("", ymd.toDays(), days);
+
+		if (ymd.getDay() <= 3) {
+			LocalTimeYMD lastDay(ymd);
+			lastDay.addDay(-ymd.getDay());
+			assertInt("", lastDay.getDay(), LocalTime::lastDayOfMonth(lastDay.getYear(), lastDay.getMonth()));
+		}
+
+		if (!prev.isEmpty()) {
+			assertInt("", ymd.diffDays(prev), 3);
+			assertInt("", prev.diffDays(ymd), -3);
+			assertInt("", ymd.compareTo(prev), 1);
+			assertInt("", prev.compareTo(ymd), -1);
+			assertInt("", ymd > prev, 1);
+
+			LocalTimeYMD temp(prev);
+			temp.addDay(3);
+			assertInt("", temp == ymd, 1);
+			assertInt("", temp.compareTo(ymd), 0);
+		}
+		prev = ymd;
+	}
+
+	ymd.parse("2000-02-28");
+	ymd.addDay(1);
+	assertStr("", ymd.toString(), "2000-02-29");
+	ymd.addDay(366);
+	assertStr("", ymd.toString(), "2001-03-01");
+	ymd.addDay(-367);
+	assertStr("", ymd.toString(), "2000-02-28");
+	assertInt("", LocalTimeYMD("2100-03-01").diffDays(LocalTimeYMD("2100-02-28")), 1);
+
+	// Out of range days roll into the next month
+	ymd.parse("2021-02-31");
+	ymd.addDay(0);
+	assertStr("", ymd.toString(), "2021-03-03");
+}
+
+void testTransitionCache() {
+	LocalTimePosixTimezone tz("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00");
+	time_t dstStart, standardStart;
+
+	tz.getTransitions(121, &dstStart, &standardStart);
+	assertTime2("", dstStart, "2021-03-14 07:00:00");
+	assertTime2("", standardStart, "2021-11-07 06:00:00");
+
+	// Same year again comes from the cache
+	tz.getTransitions(121, &dstStart, &standardStart);
+	assertTime2("", dstStart, "2021-03-14 07:00:00");
+	assertTime2("", standardStart, "2021-11-07 06:00:00");
+
+	// Adjacent years, including more than the cache size
+	for(int year = 100; year < 140; year++) {
+		for(int pass = 0; pass < 2; pass++) {
+			struct tm timeInfo = {0};
+			timeInfo.tm_year = year;
+			time_t expected = tz.dstStart.calculate(&timeInfo, tz.standardHMS);
+
+			tz.getTransitions(year, &dstStart, NULL);
+			assertInt64("", dstStart, expected);
+		}
+	}
+
+	// Copies keep a valid cache, and parsing a new configuration invalidates it
+	LocalTimePosixTimezone tz2 = tz;
+	tz2.getTransitions(121, &dstStart, &standardStart);
+	assertTime2("", dstStart, "2021-03-14 07:00:00");
+
+	tz2.parse("CST6CDT,M3.2.0/2:00:00,M11.1.0/2:00:00");
+	tz2.getTransitions(121, &dstStart, &standardStart);
+	assertTime2("", dstStart, "2021-03-14 08:00:00");
+	assertTime2("", standardStart, "2021-11-07 07:00:00");
+
+	tz.getTransitions(121, &dstStart, &standardStart);
+	assertTime2("", dstStart, "2021-03-14 07:00:00");
+
+	// Modifying the rules directly does not require clearCache()
+	tz.dstStart.parse("M4.1.0/2:00:00");
+	tz.getTransitions(121, &dstStart, &standardStart);
+	assertTime2("", dstStart, "2021-04-04 07:00:00");
+	assertTime2("", standardStart, "2021-11-07 06:00:00");
+
+	tz.standardHMS.parse("6");
+	tz.getTransitions(121, &dstStart, &standardStart);
+	assertTime2("", dstStart, "2021-04-04 08:00:00");
+
+	tz.dstHMS.parse("5");
+	tz.getTransitions(121, &dstStart, &standardStart);
+	assertTime2("", standardStart, "2021-11-07 07:00:00");
+
+	// A cache entry owned by the caller
+	LocalTimePosixTimezone::TransitionCacheEntry entry;
+	tz2.getTransitions(121, &dstStart, &standardStart, entry);
+	assertTime2("", dstStart, "2021-03-14 08:00:00");
+	tz.getTransitions(121, &dstStart, &standardStart, entry);
+	assertTime2("", dstStart, "2021-04-04 08:00:00");
+	tz.getTransitions(122, &dstStart, &standardStart, entry);
+	assertTime2("", dstStart, "2022-04-03 08:00:00");
+}
+
+void testBatchConvert() {
+	const size_t count = 2000;
+	time_t times[count];
+	time_t localTime[count];
+	int32_t offset[count];
+	uint8_t dst[count];
+	int16_t year[count];
+	int8_t month[count], day[count], hour[count], minute[count], second[count];
+
+	for(size_t ii = 0; testZones[ii]; ii++) {
+		LocalTimePosixTimezone tzConfig(testZones[ii]);
+
+		for(int pass = 0; pass < 2; pass++) {
+			// Pass 0 is a few hours (one segment), pass 1 is spread over 2 years
+			time_t t = LocalTime::stringToTime("2021-03-14 00:00:00");
+			for(size_t jj = 0; jj < count; jj++) {
+				times[jj] = t;
+				t += (pass == 0) ? 7 : 36061;
+			}
+
+			LocalTimeBatchConvert batch;
+			batch.withConfig(tzConfig)
+				.withLocalTime(localTime)
+				.withOffset(offset)
+				.withDST(dst)
+				.withDateTime(year, month, day, hour, minute, second)
+				.convert(times, count);
+
+			LocalTimeConvert conv;
+			conv.withConfig(tzConfig);
+			for(size_t jj = 0; jj < count; jj++) {
+				conv.withTime(times[jj]).convert();
+				assertInt(testZones[ii], (int)(localTime[jj] - times[jj]), offset[jj]);
+				assertSameLocalTime(testZones[ii], conv, TestLocalTime(dst[jj], year[jj], month[jj], day[jj], hour[jj], minute[jj], second[jj]));
+			}
+		}
+	}
+
+	// Only some outputs
+	{
+		time_t t1[2] = { LocalTime::stringToTime("2021-03-14 06:59:59"), LocalTime::stringToTime("2021-03-14 07:00:00") };
+		LocalTimeBatchConvert batch;
+		batch.withConfig(LocalTimePosixTimezone("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00")).withDST(dst).convert(t1, 2);
+		assertInt("", dst[0], 0);
+		assertInt("", dst[1], 1);
+	}
+}
+
+template<int OFFSET>
+void testFixedOffsetConvert(const char *tzStr) {
+	LocalTimePosixTimezone tzConfig(tzStr);
+	assertInt("", LocalTimeFixedOffsetConvert<OFFSET>::isEquivalent(tzConfig), 1);
+
+	LocalTimeFixedOffsetConvert<OFFSET> fixedConv;
+	LocalTimeConvert conv;
+	conv.withConfig(tzConfig);
+
+	time_t t = LocalTime::stringToTime("1999-12-31 00:00:00");
+	for(int ii = 0; ii < 5000; ii++) {
+		fixedConv.withTime(t).convert();
+		conv.withTime(t).convert();
+		assertInt("", (int)conv.position, (int)LocalTimeConvert::Position::NO_DST);
+		assertInt("", fixedConv.isDST(), conv.isDST());
+		assertInt("", fixedConv.localTimeValue.year(), conv.localTimeValue.year());
+		assertInt("", fixedConv.localTimeValue.month(), conv.localTimeValue.month());
+		assertInt("", fixedConv.localTimeValue.day(), conv.localTimeValue.day());
+		assertInt("", fixedConv.localTimeValue.hour(), conv.localTimeValue.hour());
+		assertInt("", fixedConv.localTimeValue.minute(), conv.localTimeValue.minute());
+		assertInt("", fixedConv.localTimeValue.tm_wday, conv.localTimeValue.tm_wday);
+		assertInt64("", LocalTimeFixedOffsetConvert<OFFSET>::toUTC(fixedConv.localTimeValue), t);
+		t += 7919;
+	}
+
+	// Small steps forward and back across local midnight reuse the local day when they can
+	t = LocalTime::stringToTime("2024-02-28 23:59:00") - OFFSET;
+	int steps[] = { 1, 59, -61, 3601, -3599, 86399 };
+	for(int ii = 0; ii < 600; ii++) {
+		fixedConv.withTime(t).convert();
+		conv.withTime(t).convert();
+		assertSameLocalTime(tzStr, fixedConv, conv);
+		t += steps[ii % 6];
+	}
+
+	// Modifying localTimeValue directly and then converting must update all of the fields
+	fixedConv.localTimeValue.tm_mday = 0;
+	fixedConv.convert();
+	conv.convert();
+	assertSameLocalTime(tzStr, fixedConv, conv);
+}
+
+void testFixedOffset() {
+	testFixedOffsetConvert<0>("UTC0");
+	testFixedOffsetConvert<-18000>("EST5");
+	testFixedOffsetConvert<19800>("IST-5:30");
+	testFixedOffsetConvert<-34200>("MART9:30");
+	testFixedOffsetConvert<20700>("NPT-5:45");
+
+	assertInt("", LocalTimeFixedOffsetConvert<3600>::isEquivalent(LocalTimePosixTimezone("CET-1CEST,M3.5.0,M10.5.0/3")), 0);
+	assertInt("", LocalTimeFixedOffsetConvert<3600>::isEquivalent(LocalTimePosixTimezone("CET-1")), 1);
+	assertInt("", LocalTimeFixedOffsetConvert<-3600>::isEquivalent(LocalTimePosixTimezone("CET-1")), 0);
+
+	LocalTimeUTCConvert utcConv;
+	utcConv.withTime(LocalTime::stringToTime("2021-06-01 12:34:56")).convert();
+	assertInt("", utcConv.localTimeValue.hour(), 12);
+	assertInt("", utcConv.localTimeValue.minute(), 34);
+	assertInt("", utcConv.localTimeValue.second(), 56);
+}
 
 void test1() {
 	LocalTimePosixTimezone tzConfig("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00");
@@ -1892,7 +2523,7 @@ void test1() {
 		// Every 4 hours otherwise (00:00, 04:00, ...)
 		schedule.fromJson(readTestDataJson("testfiles/test16.json"));
 
-		conv.withConfig("UTC").withTime(LocalTime::stringToTime("2021-12-03 08:15:00")).convert();
+		conv.withConfig("UTC0").withTime(LocalTime::stringToTime("2021-12-03 08:15:00")).convert();
 
 		conv.nextSchedule(schedule);
 		assertTime2("", conv.time, "2021-12-03 09:00:00"); 
@@ -3269,6 +3900,9 @@ void printConv(LocalTimeConvert conv) {
 void testFile(const char *configStr, const char *path) {
 	LocalTimePosixTimezone tzConfig(configStr);
 
+	LocalTimeTransitionTable table;
+	assertInt(path, table.build(tzConfig), 1);
+
 	char *testData = readTestData(path);
 	
 	int line = 1;
@@ -3380,6 +4014,15 @@ void testFile(const char *configStr, const char *path) {
 		}
 
 
+		// The transition table must give identical results
+		LocalTimeConvert tableConv;
+		tableConv.withTransitionTable(&table).withTime(conv.time).convert();
+		assertInt(entry, (int)tableConv.position, (int)conv.position);
+		assertInt64(entry, tableConv.dstStart, conv.dstStart);
+		assertInt64(entry, tableConv.standardStart, conv.standardStart);
+		assertInt64(entry, LocalTime::tmToTime(&tableConv.localTimeValue), LocalTime::tmToTime(&conv.localTimeValue));
+		assertInt(entry, tableConv.localTimeValue.tm_wday, conv.localTimeValue.tm_wday);
+
 		//printConv(conv);
 		line++;
 	}
@@ -3388,6 +4031,1248 @@ void testFile(const char *configStr, const char *path) {
 	free(testData);
 }
 
+void testTransitionTable() {
+	for(size_t ii = 0; testZones[ii]; ii++) {
+		LocalTimeTransitionTable table;
+		table.build(LocalTimePosixTimezone(testZones[ii]), 2000, 2100);
+		assertInt(testZones[ii], table.isValid(), 1);
+
+		LocalTimeConvert conv, tableConv;
+		conv.withConfig(table.config);
+		tableConv.withTransitionTable(&table);
+
+		// Crosses both ends of the table
+		for(time_t t = LocalTime::stringToTime("1999-06-01 00:00:00"); t < LocalTime::stringToTime("2102-01-01 00:00:00"); t += 86400 * 3 + 3607) {
+			conv.withTime(t).convert();
+			tableConv.withTime(t).convert();
+			assertSameLocalTime(testZones[ii], conv, tableConv);
+			assertInt64(testZones[ii], LocalTime::tmToTime(&tableConv.localTimeValue), LocalTime::tmToTime(&conv.localTimeValue));
+
+			int32_t offset;
+			bool isDST;
+			if (table.lookup(t, &offset, &isDST)) {
+				assertInt(testZones[ii], isDST, conv.isDST());
+				assertInt(testZones[ii], offset, conv.config.getOffset(conv.isDST()));
+			}
+			else {
+				assertInt(testZones[ii], table.isInRange(t), 0);
+			}
+		}
+	}
+
+	LocalTimeTransitionTable table;
+	assertInt("", table.build(LocalTimePosixTimezone("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00"), 2021, 2021), 1);
+	assertInt("", (int)table.size(), 3);
+	assertInt("", table.find(LocalTime::stringToTime("2020-12-31 23:59:59")), -1);
+	assertInt("", table.find(LocalTime::stringToTime("2021-01-01 00:00:00")), 0);
+	assertInt("", table.find(LocalTime::stringToTime("2021-03-14 06:59:59")), 0);
+	assertInt("", table.find(LocalTime::stringToTime("2021-03-14 07:00:00")), 1);
+	assertInt("", table.find(LocalTime::stringToTime("2021-11-07 05:59:59")), 1);
+	assertInt("", table.find(LocalTime::stringToTime("2021-11-07 06:00:00")), 2);
+	assertInt("", table.find(LocalTime::stringToTime("2021-12-31 23:59:59")), 2);
+	assertInt("", table.find(LocalTime::stringToTime("2022-01-01 00:00:00")), -1);
+
+	assertInt("", table.build(LocalTimePosixTimezone("MST7"), 2000, 2100), 1);
+	assertInt("", (int)table.size(), 1);
+
+	assertInt("", table.build(LocalTimePosixTimezone(), 2000, 2100), 0);
+	assertInt("", table.isValid(), 0);
+}
+
+void testLocalToUTC() {
+	for(size_t ii = 0; testZones[ii]; ii++) {
+		LocalTimePosixTimezone tzConfig(testZones[ii]);
+
+		for(time_t t = LocalTime::stringToTime("2020-12-25 00:00:00"); t < LocalTime::stringToTime("2023-01-05 00:00:00"); t += 1799) {
+			// Previous algorithm, using a forward conversion
+			struct tm timeInfo;
+			LocalTime::timeToTm(t, &timeInfo);
+			time_t expected = t + tzConfig.standardHMS.toSeconds();
+			if (tzConfig.hasDST()) {
+				LocalTimeConvert conv;
+				conv.withConfig(tzConfig).withTime(expected).convert();
+				if (conv.isDST()) {
+					expected = t + tzConfig.dstHMS.toSeconds();
+				}
+			}
+			assertInt64(testZones[ii], tzConfig.localToUTC(&timeInfo), expected);
+		}
+	}
+
+	LocalTimePosixTimezone tzConfig("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00");
+	LocalTimePosixTimezone::LocalTimeKind kind;
+	LocalTimeValue value;
+
+	value.fromString("2021-07-01 12:00:00");
+	assertTime("", value.toUTC(tzConfig, &kind), "tm_year=121 tm_mon=6 tm_mday=1 tm_hour=16 tm_min=0 tm_sec=0 tm_wday=4");
+	assertInt("", (int)kind, (int)LocalTimePosixTimezone::LocalTimeKind::UNIQUE);
+
+	value.fromString("2021-03-14 01:59:59");
+	assertTime("", value.toUTC(tzConfig, &kind), "tm_year=121 tm_mon=2 tm_mday=14 tm_hour=6 tm_min=59 tm_sec=59 tm_wday=0");
+	assertInt("", (int)kind, (int)LocalTimePosixTimezone::LocalTimeKind::UNIQUE);
+
+	// Spring forward, 2:00 to 2:59:59 does not exist
+	value.fromString("2021-03-14 02:30:00");
+	assertTime("", value.toUTC(tzConfig, &kind), "tm_year=121 tm_mon=2 tm_mday=14 tm_hour=6 tm_min=30 tm_sec=0 tm_wday=0");
+	assertInt("", (int)kind, (int)LocalTimePosixTimezone::LocalTimeKind::SKIPPED);
+
+	value.fromString("2021-03-14 03:00:00");
+	assertTime("", value.toUTC(tzConfig, &kind), "tm_year=121 tm_mon=2 tm_mday=14 tm_hour=7 tm_min=0 tm_sec=0 tm_wday=0");
+	assertInt("", (int)kind, (int)LocalTimePosixTimezone::LocalTimeKind::UNIQUE);
+
+	// Fall back, 1:00 to 1:59:59 happens twice, the second (standard time) is returned
+	value.fromString("2021-11-07 00:59:59");
+	assertTime("", value.toUTC(tzConfig, &kind), "tm_year=121 tm_mon=10 tm_mday=7 tm_hour=4 tm_min=59 tm_sec=59 tm_wday=0");
+	assertInt("", (int)kind, (int)LocalTimePosixTimezone::LocalTimeKind::UNIQUE);
+
+	value.fromString("2021-11-07 01:30:00");
+	assertTime("", value.toUTC(tzConfig, &kind), "tm_year=121 tm_mon=10 tm_mday=7 tm_hour=6 tm_min=30 tm_sec=0 tm_wday=0");
+	assertInt("", (int)kind, (int)LocalTimePosixTimezone::LocalTimeKind::REPEATED);
+
+	value.fromString("2021-11-07 02:00:00");
+	assertTime("", value.toUTC(tzConfig, &kind), "tm_year=121 tm_mon=10 tm_mday=7 tm_hour=7 tm_min=0 tm_sec=0 tm_wday=0");
+	assertInt("", (int)kind, (int)LocalTimePosixTimezone::LocalTimeKind::UNIQUE);
+
+	// Southern hemisphere: DST ends April 4, 2021 at 3:00 AEDT, starts October 3, 2021 at 2:00 AEST
+	LocalTimePosixTimezone tzSydney("AEST-10AEDT,M10.1.0/02:00:00,M4.1.0/03:00:00");
+	value.fromString("2021-04-04 02:30:00");
+	value.toUTC(tzSydney, &kind);
+	assertInt("", (int)kind, (int)LocalTimePosixTimezone::LocalTimeKind::REPEATED);
+	value.fromString("2021-10-03 02:30:00");
+	value.toUTC(tzSydney, &kind);
+	assertInt("", (int)kind, (int)LocalTimePosixTimezone::LocalTimeKind::SKIPPED);
+	value.fromString("2021-10-03 03:00:00");
+	value.toUTC(tzSydney, &kind);
+	assertInt("", (int)kind, (int)LocalTimePosixTimezone::LocalTimeKind::UNIQUE);
+}
+
+void testIncrementalConvert() {
+	for(size_t ii = 0; testZones[ii]; ii++) {
+		LocalTimePosixTimezone tzConfig(testZones[ii]);
+
+		LocalTimeConvert conv;
+		conv.withConfig(tzConfig).withTime(LocalTime::stringToTime("2021-03-13 00:00:00")).convert();
+
+		// Steps of varying size, crossing DST changes and the end of the year
+		int steps[] = { 1, 59, 61, 3599, 3601, 86399, 86401 };
+		for(int jj = 0; jj < 4000; jj++) {
+			conv.addSeconds(steps[jj % 7]);
+
+			LocalTimeConvert fresh;
+			fresh.withConfig(tzConfig).withTime(conv.time).convert();
+
+			assertSameLocalTime(testZones[ii], fresh, conv);
+			assertInt64(testZones[ii], conv.dstStart, fresh.dstStart);
+			assertInt64(testZones[ii], conv.standardStart, fresh.standardStart);
+		}
+	}
+
+	// Changing the config must not reuse the previous segment
+	LocalTimeConvert conv;
+	conv.withConfig(LocalTimePosixTimezone("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00")).withTime(LocalTime::stringToTime("2021-07-01 16:00:00")).convert();
+	assertInt("", conv.localTimeValue.hour(), 12);
+	conv.withConfig(LocalTimePosixTimezone("CST6CDT,M3.2.0/2:00:00,M11.1.0/2:00:00")).convert();
+	assertInt("", conv.localTimeValue.hour(), 11);
+
+	// Modifying localTimeValue directly and then converting must update all of the fields
+	conv.localTimeValue.tm_mday = 0;
+	conv.convert();
+	assertInt("", conv.localTimeValue.day(), 1);
+
+	// Converting before the global config is set must not keep using UTC once it's set
+	LocalTime::instance().withConfig(LocalTimePosixTimezone());
+	LocalTimeConvert globalConv;
+	globalConv.withTime(LocalTime::stringToTime("2021-12-01 22:00:00")).convert();
+	assertInt("", globalConv.localTimeValue.hour(), 22);
+	LocalTime::instance().withConfig(LocalTimePosixTimezone("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00"));
+	globalConv.convert();
+	assertInt("", globalConv.localTimeValue.hour(), 17);
+	globalConv.addSeconds(3600);
+	assertInt("", globalConv.localTimeValue.hour(), 18);
+}
+
+void testLocalTimeConversion() {
+	assertInt("", sizeof(LocalTimeConversion) <= 64, 1);
+
+	for(size_t ii = 0; testZones[ii]; ii++) {
+		LocalTimePosixTimezone tzConfig(testZones[ii]);
+
+		LocalTimeConversion conversion;
+		conversion.withConfig(&tzConfig);
+
+		for(time_t t = LocalTime::stringToTime("2020-12-25 00:00:00"); t < LocalTime::stringToTime("2023-01-05 00:00:00"); t += 3 * 3600 + 17) {
+			LocalTimeConvert conv;
+			conv.withConfig(tzConfig).withTime(t).convert();
+
+			conversion.withTime(t).convert();
+			assertSameLocalTime(testZones[ii], conv, conversion);
+			assertInt64(testZones[ii], conversion.segmentStart, conv.segmentStart);
+			assertInt64(testZones[ii], conversion.segmentEnd, conv.segmentEnd);
+
+			LocalTimeValue value = conversion.getLocalTimeValue();
+			assertInt(testZones[ii], value.hour(), conv.localTimeValue.hour());
+		}
+	}
+
+	// No config uses the global config
+	LocalTime::instance().withConfig(LocalTimePosixTimezone("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00"));
+	LocalTimeConversion conversion;
+	conversion.withTime(LocalTime::stringToTime("2021-07-01 16:00:00")).convert();
+	assertInt("", conversion.hour, 12);
+	assertInt("", conversion.isDST(), 1);
+	assertInt("", conversion.offset, -4 * 3600);
+
+	// Changing the global config is picked up, even within the same segment
+	LocalTime::instance().withConfig(LocalTimePosixTimezone("CST6CDT,M3.2.0/2:00:00,M11.1.0/2:00:00"));
+	conversion.withTime(LocalTime::stringToTime("2021-07-01 16:00:01")).convert();
+	assertInt("", conversion.hour, 11);
+	assertInt("", conversion.offset, -5 * 3600);
+
+	// A replaced snapshot is never reused, so any number of updates is picked up
+	LocalTime::instance().withConfig(LocalTimePosixTimezone("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00"));
+	conversion.withTime(LocalTime::stringToTime("2021-07-01 16:00:01")).convert();
+	assertInt("", conversion.offset, -4 * 3600);
+	for(size_t ii = 0; ii < 8; ii++) {
+		LocalTime::instance().withConfig(LocalTimePosixTimezone((ii % 2) ? "CET-1" : "EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00"));
+		conversion.convert();
+		assertInt("", conversion.offset, (ii % 2) ? 3600 : -4 * 3600);
+	}
+
+	LocalTimePosixTimezone tzConfig("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00");
+	conversion.withConfig(&tzConfig).convert();
+	LocalTime::instance().withConfig(LocalTimePosixTimezone("UTC0"));
+	conversion.withTime(LocalTime::stringToTime("2021-07-01 16:00:02")).convert();
+	assertInt("", conversion.hour, 12);
+}
+
+void testGlobalConfig() {
+	uint32_t version1 = LocalTime::instance().getConfigVersion();
+	{
+		LocalTime::ConfigReader reader1;
+		assertInt("", reader1.getVersion(), version1);
+
+		LocalTime::instance().withConfig(LocalTimePosixTimezone("CST6CDT,M3.2.0/2:00:00,M11.1.0/2:00:00"));
+		LocalTime::ConfigReader reader2;
+		assertInt("", reader2.getVersion(), version1 + 1);
+		assertInt("", &reader2.getConfig() != &reader1.getConfig(), 1);
+		assertStr("", LocalTime::instance().getConfig().standardName.c_str(), "CST");
+
+		// Snapshots held by a reader are never modified or reused, no matter how many updates are made
+		for(size_t ii = 0; ii < 10; ii++) {
+			LocalTime::instance().withConfig(LocalTimePosixTimezone((ii % 2) ? "MST7" : "PST8PDT,M3.2.0/2:00:00,M11.1.0/2:00:00"));
+		}
+		assertInt("", LocalTime::instance().getConfigVersion(), version1 + 11);
+		assertStr("", LocalTime::instance().getConfig().standardName.c_str(), "MST");
+		assertStr("", reader2.getConfig().standardName.c_str(), "CST");
+		assertInt("", reader2.getVersion(), version1 + 1);
+		assertInt("", reader1.getVersion(), version1);
+
+		LocalTime::ConfigReader reader3;
+		assertInt("", &reader3.getConfig() != &reader2.getConfig(), 1);
+		assertInt("", reader3.getConfig().transitionCache[0].valid, 0);
+	}
+	assertInt("", &LocalTime::instance() == &LocalTime::instance(), 1);
+
+	// With no readers, this deletes the snapshots that were retired above
+	LocalTime::instance().withConfig(LocalTimePosixTimezone("MST7"));
+	assertInt("", LocalTime::instance().getConfigVersion(), version1 + 12);
+
+	LocalTimeConvert conv;
+	conv.withTime(LocalTime::stringToTime("2021-07-01 16:00:00")).convert();
+	assertInt("", conv.localTimeValue.hour(), 9);
+}
+
+void testZoneRegistry() {
+	LocalTimeZoneRegistry registry;
+	const char *tzNewYork = "EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00";
+	const char *tzLosAngeles = "PST8PDT,M3.2.0/2:00:00,M11.1.0/2:00:00";
+
+	assertInt("", (int)registry.size(), 0);
+	assertInt("", registry.find(tzNewYork), LocalTimeZoneRegistry::INVALID_HANDLE);
+
+	LocalTimeZoneHandle ny = registry.intern(tzNewYork);
+	LocalTimeZoneHandle la = registry.intern(tzLosAngeles);
+	assertInt("", ny, 0);
+	assertInt("", la, 1);
+	assertInt("", registry.intern(tzNewYork), ny);
+	assertInt("", registry.find(tzLosAngeles), la);
+	assertInt("", registry.intern(""), LocalTimeZoneRegistry::INVALID_HANDLE);
+	assertInt("", registry.intern(NULL), LocalTimeZoneRegistry::INVALID_HANDLE);
+	assertInt("", (int)registry.size(), 2);
+
+	assertStr("", registry.getString(la), tzLosAngeles);
+	assertStr("", registry.getConfig(ny)->standardName.c_str(), "EST");
+	assertInt("", registry.getTransitionTable(ny)->isValid(), 1);
+	assertInt("", registry.getConfig(ny) == &registry.getTransitionTable(ny)->config, 1);
+	assertInt("", registry.getConfig(2) == NULL, 1);
+	assertInt("", registry.getString(LocalTimeZoneRegistry::INVALID_HANDLE) == NULL, 1);
+
+	// Enough zones to need more than one chunk, pointers to earlier entries do not move
+	const LocalTimePosixTimezone *nyConfig = registry.getConfig(ny);
+	for(int ii = 0; ii < (int)LocalTimeZoneRegistry::CHUNK_SIZE * 2; ii++) {
+		String tzStr = String::format("UTC%d:%02d", ii / 60 - 12, ii % 60);
+		assertInt(tzStr.c_str(), registry.intern(tzStr.c_str()), ii + 2);
+	}
+	assertInt("", registry.getConfig(ny) == nyConfig, 1);
+	assertInt("", registry.getConfig(LocalTimeZoneRegistry::CHUNK_SIZE * 2 + 1)->standardHMS.toSeconds(), -(11 * 3600 + 3 * 60));
+
+	// More zones than hash buckets, so buckets have more than one entry
+	LocalTimeZoneRegistry bigRegistry;
+	bigRegistry.withTransitionYears(2021, 2021);
+	const int numBig = (int)LocalTimeZoneRegistry::NUM_BUCKETS * 3;
+	for(int ii = 0; ii < numBig; ii++) {
+		String tzStr = String::format("UTC%d:%02d:%02d", ii / 3600, (ii / 60) % 60, ii % 60);
+		assertInt(tzStr.c_str(), bigRegistry.intern(tzStr.c_str()), ii);
+	}
+	for(int ii = 0; ii < numBig; ii++) {
+		String tzStr = String::format("UTC%d:%02d:%02d", ii / 3600, (ii / 60) % 60, ii % 60);
+		assertInt(tzStr.c_str(), bigRegistry.find(tzStr.c_str()), ii);
+		assertInt(tzStr.c_str(), bigRegistry.intern(tzStr.c_str()), ii);
+	}
+	assertInt("", (int)bigRegistry.size(), numBig);
+	assertInt("", bigRegistry.find("UTC9:00:00"), LocalTimeZoneRegistry::INVALID_HANDLE);
+
+	LocalTimeConvert conv;
+	conv.withZone(ny, registry).withTime(LocalTime::stringToTime("2021-07-01 16:00:00")).convert();
+	assertInt("", conv.localTimeValue.hour(), 12);
+	assertInt("", conv.isDST(), 1);
+	conv.withZone(la, registry).withTime(LocalTime::stringToTime("2021-07-01 16:00:00")).convert();
+	assertInt("", conv.localTimeValue.hour(), 9);
+
+	// One schedule evaluated in two timezones
+	LocalTimeSchedule schedule;
+	schedule.withTime(LocalTimeHMS("06:00"));
+	time_t start = LocalTime::stringToTime("2021-07-01 00:00:00");
+	assertTime2("", schedule.getNextScheduledTime(ny, start, registry), "2021-07-01 10:00:00");
+	assertTime2("", schedule.getNextScheduledTime(la, start, registry), "2021-07-01 13:00:00");
+
+	// Singleton registry
+	LocalTimeZoneHandle chicago = LocalTimeZoneRegistry::instance().intern("CST6CDT,M3.2.0/2:00:00,M11.1.0/2:00:00");
+	assertInt("", &LocalTimeZoneRegistry::instance() == &LocalTimeZoneRegistry::instance(), 1);
+	assertInt("", chicago != LocalTimeZoneRegistry::INVALID_HANDLE, 1);
+	assertTime2("", schedule.getNextScheduledTime(chicago, start), "2021-07-01 11:00:00");
+	conv.withZone(chicago).withTime(start).convert();
+	assertInt("", conv.localTimeValue.hour(), 19);
+}
+
+void testMultiZoneConvert() {
+	const size_t numZones = numTestZones;
+
+	LocalTimeZoneRegistry registry;
+	registry.withTransitionYears(2000, 2040);
+
+	// The last config and handle are not valid, and use the global config (UTC)
+	LocalTimePosixTimezone configs[numZones + 1];
+	LocalTimeZoneHandle zones[numZones + 1];
+	for(size_t ii = 0; ii < numZones; ii++) {
+		configs[ii].parse(testZones[ii]);
+		zones[ii] = registry.intern(testZones[ii]);
+	}
+	zones[numZones] = LocalTimeZoneRegistry::INVALID_HANDLE;
+
+	time_t localTime[numZones + 1];
+	int32_t offset[numZones + 1];
+	uint8_t dst[numZones + 1];
+	int16_t year[numZones + 1];
+	int8_t month[numZones + 1], day[numZones + 1], hour[numZones + 1], minute[numZones + 1], second[numZones + 1];
+
+	for(int pass = 0; pass < 2; pass++) {
+		LocalTimeMultiZoneConvert multi;
+		if (pass == 0) {
+			multi.withConfigs(configs, numZones + 1);
+		}
+		else {
+			multi.withZones(zones, numZones + 1, registry);
+		}
+		multi.withLocalTime(localTime).withOffset(offset).withDST(dst).withDateTime(year, month, day, hour, minute, second);
+
+		// Starts and ends outside of the years in the transition tables
+		for(time_t t = LocalTime::stringToTime("1998-06-01 00:00:00"); t < LocalTime::stringToTime("2043-01-01 00:00:00"); t += 86400 * 5 + 3607) {
+			multi.convert(t);
+
+			for(size_t ii = 0; ii <= numZones; ii++) {
+				LocalTimeConvert conv;
+				if (ii < numZones) {
+					conv.withConfig(configs[ii]);
+				}
+				conv.withTime(t).convert();
+
+				const char *msg = (ii < numZones) ? testZones[ii] : "global";
+				assertInt64(msg, localTime[ii], LocalTime::tmToTime(&conv.localTimeValue));
+				assertInt(msg, offset[ii], (int)(LocalTime::tmToTime(&conv.localTimeValue) - t));
+				assertSameLocalTime(msg, conv, TestLocalTime(dst[ii], year[ii], month[ii], day[ii], hour[ii], minute[ii], second[ii]));
+			}
+		}
+	}
+
+	// Only some outputs
+	LocalTimeMultiZoneConvert multi;
+	hour[0] = hour[1] = -1;
+	multi.withZones(zones, 2, registry).withDST(dst).convert(LocalTime::stringToTime("2021-07-01 16:00:00"));
+	assertInt("", dst[0], 1);
+	assertInt("", dst[1], 0);
+	assertInt("", hour[0], -1);
+
+	// The configs are not written, and changing one in place is picked up by the next convert
+	multi.withConfigs(configs, 1).withOffset(offset).convert(LocalTime::stringToTime("2021-03-20 12:00:00"));
+	assertInt("", offset[0], -4 * 3600);
+	assertInt("", configs[0].transitionCache[121 % LocalTimePosixTimezone::TRANSITION_CACHE_SIZE].valid, 0);
+	configs[0].dstStart.parse("M4.1.0/2:00:00");
+	multi.convert(LocalTime::stringToTime("2021-03-20 12:00:00"));
+	assertInt("", offset[0], -5 * 3600);
+}
+
+void testCursor() {
+	for(size_t ii = 0; testZones[ii]; ii++) {
+		LocalTimePosixTimezone config(testZones[ii]);
+		LocalTimeCursor cursor;
+		cursor.withConfig(&config);
+		LocalTimeConvert conv;
+		conv.withConfig(config);
+
+		// Mostly increasing, crossing days, DST transitions, and years, with occasional jumps backwards
+		time_t t = LocalTime::stringToTime("2020-12-30 00:00:00");
+		for(int step = 0; step < 20000; step++) {
+			if ((step % 997) == 0) {
+				t -= 86400 * 40 + 17;
+			}
+			else {
+				t += 1789;
+			}
+			cursor.advance(t);
+			conv.withTime(t).convert();
+
+			assertInt64(testZones[ii], cursor.localTime(), LocalTime::tmToTime(&conv.localTimeValue));
+			assertSameLocalTime(testZones[ii], conv, cursor);
+		}
+	}
+
+	// Before 1970, and withTime().convert()
+	LocalTimePosixTimezone config("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00");
+	LocalTimeCursor cursor;
+	cursor.withConfig(&config).withTime(LocalTime::stringToTime("1969-12-31 12:00:00"));
+	cursor.convert();
+	assertInt("", cursor.year, 1969);
+	assertInt("", cursor.day, 31);
+	assertInt("", cursor.hour, 7);
+	assertInt("", cursor.dayOfWeek, 3);
+	cursor.advance(LocalTime::stringToTime("1970-01-01 05:00:00"));
+	assertInt("", cursor.year, 1970);
+	assertInt("", cursor.hour, 0);
+	assertInt("", cursor.localDays, 0);
+
+	// Mixing withTime().convert() and advance()
+	cursor.advance(LocalTime::stringToTime("2022-03-01 12:00:00"));
+	assertInt("", cursor.month, 3);
+	assertInt("", cursor.day, 1);
+	cursor.withTime(LocalTime::stringToTime("2022-06-15 12:00:00")).convert();
+	assertInt("", cursor.month, 6);
+	assertInt("", cursor.day, 15);
+	cursor.advance(LocalTime::stringToTime("2022-03-01 12:01:00"));
+	assertInt("", cursor.month, 3);
+	assertInt("", cursor.day, 1);
+	assertInt("", cursor.hour, 7);
+	assertInt("", cursor.minute, 1);
+
+	// The base class convert() writes the date fields without updating localDays
+	static_cast<LocalTimeConversion &>(cursor).withTime(LocalTime::stringToTime("2022-06-15 12:00:00")).convert();
+	assertInt("", cursor.month, 6);
+	cursor.advance(LocalTime::stringToTime("2022-03-01 12:02:00"));
+	assertInt("", cursor.year, 2022);
+	assertInt("", cursor.month, 3);
+	assertInt("", cursor.day, 1);
+	assertInt("", cursor.dayOfYear, 59);
+	assertInt("", cursor.dayOfWeek, 2);
+	assertInt("", cursor.minute, 2);
+}
+
+void testFormatBuffer() {
+	LocalTimeConvert conv;
+	conv.withConfig(LocalTimePosixTimezone("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00")).withTime(LocalTime::stringToTime("2021-04-01 16:00:00")).convert();
+
+	const char *specs[] = {
+		"%Y-%m-%d %H:%M:%S",
+		"%Y-%m-%d %H:%M:%S %z",
+		"%Y-%m-%d %H:%M:%S %Z",
+		"%I:%M %p",
+		"100%% %a %b %m%%",
+		"no conversions",
+		"",
+		TIME_FORMAT_DEFAULT,
+		TIME_FORMAT_ISO8601_FULL,
+		0
+	};
+	for(size_t ii = 0; specs[ii]; ii++) {
+		String expected = conv.format(specs[ii]);
+
+		char buf[64];
+		assertInt(specs[ii], (int)conv.format(specs[ii], buf, sizeof(buf)), (int)expected.length());
+		assertStr(specs[ii], buf, expected.c_str());
+
+		std::string str;
+		conv.formatTo(std::back_inserter(str), specs[ii]);
+		assertStr(specs[ii], str.c_str(), expected.c_str());
+	}
+	assertStr("", conv.format("%Z %z").c_str(), "EDT -04:00");
+
+	// Truncation returns the full length and is always null terminated
+	char buf[64];
+	memset(buf, 'x', sizeof(buf));
+	assertInt("", (int)conv.format("%Y-%m-%d %H:%M:%S", buf, 8), 19);
+	assertStr("", buf, "2021-04");
+	assertInt("", buf[8], 'x');
+	assertInt("", (int)conv.format("%Z", buf, 3), 3);
+	assertStr("", buf, "ED");
+	assertInt("", (int)conv.format("%Y", buf, 0), 4);
+	assertInt("", buf[0], 'E');
+
+	// Output iterator that is a pointer
+	char *end = conv.formatTo(buf, "%H:%M");
+	*end = 0;
+	assertInt("", (int)(end - buf), 5);
+	assertStr("", buf, "12:00");
+
+	// Formats and results longer than the previous fixed-size buffers
+	String longSpec;
+	for(int ii = 0; ii < 12; ii++) {
+		longSpec += "%Y-%m-%d ";
+	}
+	String longResult = conv.format(longSpec.c_str());
+	assertInt("", (int)longResult.length(), 12 * 11);
+	assertStr("", longResult.c_str() + 11 * 11, "2021-04-01 ");
+
+	assertInt("", (int)conv.timeStr(buf, sizeof(buf)), 24);
+	assertStr("", buf, "Thu Apr  1 12:00:00 2021");
+	assertInt("", (int)conv.timeStr(buf, 4), 24);
+	assertStr("", buf, "Thu");
+
+	assertInt("", (int)LocalTime::timeToString(LocalTime::stringToTime("2021-04-01 16:00:00"), buf, sizeof(buf), 'T'), 19);
+	assertStr("", buf, "2021-04-01T16:00:00");
+	assertStr("", LocalTime::timeToString(LocalTime::stringToTime("2021-04-01 16:00:00")).c_str(), "2021-04-01 16:00:00");
+
+	assertStr("", conv.getZoneName(), "EDT");
+	conv.withConfig(LocalTimePosixTimezone("UTC0")).convert();
+	assertStr("", conv.getZoneName(), "Z");
+	assertStr("", conv.format("%H:%M%z").c_str(), "16:00Z");
+}
+
+void testFormatter() {
+	const char *specs[] = {
+		TIME_FORMAT_DEFAULT,
+		TIME_FORMAT_ISO8601_FULL,
+		"%Y-%m-%d %H:%M:%S",
+		"%Y-%m-%d %H:%M:%S %z %Z",
+		"%a %A %b %B %h %C %y %e %j %I %p %u %w",
+		"%D %F %T %R %r",
+		"100%% literal text%n%t",
+		"%U %W %V %G %g %c %x %X %Ey %Od %-d %5Y %",
+		"",
+		0
+	};
+
+	for(size_t ii = 0; specs[ii]; ii++) {
+		LocalTimeFormatter formatter(specs[ii]);
+
+		for(size_t jj = 0; testZones[jj]; jj++) {
+			LocalTimePosixTimezone config(testZones[jj]);
+			LocalTimeConvert conv;
+			conv.withConfig(config);
+			LocalTimeConversion conversion;
+			conversion.withConfig(&config);
+
+			for(time_t t = LocalTime::stringToTime("2020-12-25 00:00:00"); t < LocalTime::stringToTime("2022-01-10 00:00:00"); t += 86400 * 3 + 3607) {
+				conv.withTime(t).convert();
+				String expected = conv.format(specs[ii]);
+
+				char buf[128];
+				assertInt(specs[ii], (int)formatter.format(conv, buf, sizeof(buf)), (int)expected.length());
+				assertStr(specs[ii], buf, expected.c_str());
+				assertStr(specs[ii], formatter.format(conv).c_str(), expected.c_str());
+
+				conversion.withTime(t).convert();
+				formatter.format(conversion, buf, sizeof(buf));
+				assertStr(specs[ii], buf, expected.c_str());
+
+				time_t localTime;
+				uint8_t dst;
+				LocalTimeBatchConvert batch;
+				batch.withConfig(config).withLocalTime(&localTime).withDST(&dst).convert(&t, 1);
+				formatter.format(batch, 0, buf, sizeof(buf));
+				assertStr(specs[ii], buf, expected.c_str());
+			}
+		}
+	}
+
+	// Years that are not 4 digits
+	LocalTimeFormatter formatter("%Y %y %C");
+	LocalTimeConvert conv;
+	conv.withConfig(LocalTimePosixTimezone("UTC0")).withTime(LocalTime::stringToTime("0999-06-01 00:00:00")).convert();
+	assertStr("", formatter.format(conv).c_str(), conv.format("%Y %y %C").c_str());
+
+	// Truncation
+	char buf[8];
+	formatter.compile("%Y-%m-%d");
+	conv.withTime(LocalTime::stringToTime("2021-04-01 16:00:00")).convert();
+	assertInt("", (int)formatter.format(conv, buf, sizeof(buf)), 10);
+	assertStr("", buf, "2021-04");
+
+	// Literals and conversions are compiled into a small number of ops
+	formatter.compile("Date: %Y-%m-%d");
+	assertInt("", (int)formatter.ops.size(), 6);
+	assertInt("", (int)formatter.ops[0].type, (int)LocalTimeFormatter::OpType::LITERAL);
+	formatter.compile("%T");
+	assertInt("", (int)formatter.ops.size(), 5);
+	formatter.compile("%%%%");
+	assertInt("", (int)formatter.ops.size(), 1);
+}
+
+void testISO8601() {
+	LocalTimeISO8601 iso;
+	char buf[64];
+
+	const char *str = "2021-04-01T12:34:56.250-04:00\", \"next\"";
+	assertInt("", (int)iso.parse(str), 29);
+	assertInt("", iso.year, 2021);
+	assertInt("", iso.month, 4);
+	assertInt("", iso.day, 1);
+	assertInt("", iso.hour, 12);
+	assertInt("", iso.minute, 34);
+	assertInt("", iso.second, 56);
+	assertInt("", (int)iso.nanosecond, 250000000);
+	assertInt("", iso.fractionDigits, 3);
+	assertInt("", iso.hasOffset, 1);
+	assertInt("", iso.offset, -4 * 3600);
+	assertTime2("", iso.toTime(), "2021-04-01 16:34:56");
+	assertInt("", (int)iso.format(buf, sizeof(buf)), 29);
+	assertStr("", buf, "2021-04-01T12:34:56.250-04:00");
+
+	// Not null terminated, only the length given is used
+	assertInt("", (int)iso.parse(str, 19), 19);
+	assertInt("", iso.hasOffset, 0);
+	assertInt("", iso.fractionDigits, 0);
+	assertInt("", (int)iso.parse(str, 18), 18);
+	assertInt("", iso.second, 5);
+	assertInt("", (int)iso.parse(str, 13), 0);
+	assertInt("", (int)iso.parse(str, 16), 16);
+	assertInt("", iso.timeParts, 2);
+	assertInt("", (int)iso.parse(str, 22), 22);
+	assertInt("", iso.fractionDigits, 2);
+	assertInt("", (int)iso.parse(str, 25), 23);
+	assertInt("", iso.hasOffset, 0);
+
+	assertInt("", (int)iso.parse("2021-04-01 12:34:56Z"), 20);
+	assertInt("", iso.hasOffset, 1);
+	assertInt("", iso.offset, 0);
+	assertInt("", iso.separator, ' ');
+	iso.format(buf, sizeof(buf));
+	assertStr("", buf, "2021-04-01 12:34:56Z");
+
+	assertInt("", (int)iso.parse("2021-04-01T12:34:56,5+0530"), 26);
+	assertInt("", (int)iso.nanosecond, 500000000);
+	assertInt("", iso.offset, 5 * 3600 + 30 * 60);
+	assertInt("", (int)iso.parse("2021-04-01T12:34:56.123456789012+09"), 35);
+	assertInt("", (int)iso.nanosecond, 123456789);
+	assertInt("", iso.offset, 9 * 3600);
+	assertInt("", (int)iso.parse("2021-04-01T12:34:56+x"), 19);
+	assertInt("", iso.hasOffset, 0);
+	assertInt("", (int)iso.parse("2021-04-01T12:34:56."), 19);
+
+	assertInt("", (int)iso.parse("2021-04-01"), 0);
+	assertInt("", (int)iso.parse("2021-04-01T"), 0);
+	assertInt("", (int)iso.parse("x2021-04-01T12:00:00"), 0);
+	assertInt("", (int)iso.parse(""), 0);
+	assertInt("", (int)iso.parse(NULL), 0);
+
+	assertInt("", (int)iso.parseDate("2021-04-01", 10), 10);
+	assertInt("", (int)iso.parseDate("2021-04", 7), 0);
+	assertInt("", (int)iso.parseTime("-5:30xyz", 8), 5);
+	assertInt("", iso.hour, -5);
+	assertInt("", iso.minute, 30);
+	assertInt("", iso.timeParts, 2);
+
+	iso.fromTime(LocalTime::stringToTime("2021-04-01 16:00:00"), -4 * 3600);
+	iso.format(buf, sizeof(buf));
+	assertStr("", buf, "2021-04-01T12:00:00-04:00");
+	assertInt("", (int)iso.format(buf, 5), 25);
+	assertStr("", buf, "2021");
+
+	assertInt("", (int)LocalTimeISO8601::formatNumber(-5, 3, buf, sizeof(buf)), 3);
+	buf[3] = 0;
+	assertStr("", buf, "-05");
+	assertInt("", (int)LocalTimeISO8601::formatNumber(-2147483647 - 1, 2, buf, sizeof(buf)), 11);
+	buf[11] = 0;
+	assertStr("", buf, "-2147483648");
+
+	// Compatibility with the previous sscanf implementation
+	assertTime2("", LocalTime::stringToTime("2021-04-01T12:00:00-04:00"), "2021-04-01 12:00:00");
+	assertTime2("", LocalTime::stringToTime(" 2021- 4- 1 12: 0: 0"), "2021-04-01 12:00:00");
+	assertInt64("", LocalTime::stringToTime("2021-04-01 12:00"), 0);
+	assertInt64("", LocalTime::stringToTime("garbage"), 0);
+
+	struct tm timeInfo;
+	memset(&timeInfo, 0xff, sizeof(timeInfo));
+	LocalTime::stringToTime("2021-04-01 12:00:00", &timeInfo);
+	assertInt("", timeInfo.tm_isdst, 0);
+	assertInt("", timeInfo.tm_wday, 4);
+	assertInt("", timeInfo.tm_yday, 90);
+
+	LocalTimeValue value;
+	value.fromString("2021-04-01 12:00:00");
+	assertInt("", value.tm_wday, 4);
+
+	LocalTimeHMS hms("-5:30");
+	assertInt("", hms.hour, -5);
+	assertInt("", hms.minute, 30);
+	assertStr("", hms.toString().c_str(), "-5:30:00");
+	hms.parse("7");
+	assertStr("", hms.toString().c_str(), "07:00:00");
+	hms.parse("7:xx");
+	assertStr("", hms.toString().c_str(), "07:00:00");
+
+	LocalTimeYMD ymd;
+	assertInt("", ymd.parse("2021-4-1"), 1);
+	assertStr("", ymd.toString().c_str(), "2021-04-01");
+	assertInt("", (int)ymd.parse("2022-05-06T00:00:00", 10), 10);
+	assertStr("", ymd.toString().c_str(), "2022-05-06");
+	assertInt("", ymd.parse("05/06/2022"), 0);
+
+	assertStr("", LocalTime::timeToString(LocalTime::stringToTime("1969-12-31 23:59:59")).c_str(), "1969-12-31 23:59:59");
+}
+
+void testScheduleIndex() {
+	std::vector<LocalTimeSchedule> schedules;
+
+	// Schedules from the test files
+	const char *scheduleFiles[] = {
+		"testfiles/test12.json",
+		"testfiles/test13.json",
+		"testfiles/test14.json",
+		"testfiles/test15.json",
+		"testfiles/test16.json",
+		"testfiles/test17.json",
+		"testfiles/test18.json",
+		"testfiles/test19.json",
+		0
+	};
+	for(size_t ii = 0; scheduleFiles[ii]; ii++) {
+		LocalTimeSchedule schedule;
+		schedule.fromJson(readTestDataJson(scheduleFiles[ii]));
+		schedules.push_back(schedule);
+	}
+
+	// Schedules from the time ranges in test08 and date restrictions in test09 - test11
+	std::vector<LocalTimeRange> ranges;
+	{
+		JSONObjectIterator iter(readTestDataJson("testfiles/test08.json"));
+		while(iter.next()) {
+			LocalTimeRange range;
+			range.fromJson(iter.value());
+			ranges.push_back(range);
+		}
+	}
+	const char *restrictionFiles[] = {
+		"testfiles/test09.json",
+		"testfiles/test10.json",
+		"testfiles/test11.json",
+		0
+	};
+	for(size_t ii = 0; restrictionFiles[ii]; ii++) {
+		LocalTimeRestrictedDate restriction;
+		restriction.fromJson(readTestDataJson(restrictionFiles[ii]));
+		for(auto it = ranges.begin(); it != ranges.end(); ++it) {
+			LocalTimeRange range(it->hmsStart, it->hmsEnd, restriction);
+
+			LocalTimeSchedule schedule;
+			schedule.withMinuteOfHour(20, range).withHourOfDay(3, range).withDayOfMonth(7, range).withDayOfWeekOfMonth(1, -1, range);
+			schedules.push_back(schedule);
+		}
+	}
+	{
+		LocalTimeSchedule schedule;
+		schedule.withTimes({LocalTimeHMSRestricted(LocalTimeHMS("06:00"), LocalTimeRestrictedDate(LocalTimeDayOfWeek::MASK_WEEKDAY).withExceptDates({"2022-03-09"})), LocalTimeHMS("18:30")});
+		schedule.withMinuteOfHour(10, LocalTimeRange(LocalTimeHMS("08:03:00"), LocalTimeHMS("10:00:00")));
+		schedules.push_back(schedule);
+	}
+	{
+		LocalTimeSchedule schedule;
+		schedule.withMinuteOfHour(7, LocalTimeRange(LocalTimeHMS("00:03:20"), LocalTimeHMS("20:00:00")));
+		schedule.withHourOfDay(5, LocalTimeRange(LocalTimeHMS("01:30:15"), LocalTimeHMS("23:00:00")));
+		schedules.push_back(schedule);
+	}
+	{
+		LocalTimeSchedule schedule;
+		schedule.withMinuteOfHour(45, LocalTimeRange(LocalTimeHMS("00:10:00"), LocalTimeHMS("23:59:59"), LocalTimeRestrictedDate(LocalTimeDayOfWeek::MASK_WEEKEND)));
+		schedules.push_back(schedule);
+	}
+
+	// The index must agree with the day-by-day calculation in LocalTimeSchedule
+	const char *tzStrs[] = {
+		"EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00",
+		"ACST-9:30ACDT,M10.1.0/2,M4.1.0/3",
+		"NPT-5:45",
+		0
+	};
+	for(size_t ii = 0; tzStrs[ii]; ii++) {
+		LocalTimePosixTimezone tzConfig(tzStrs[ii]);
+		for(size_t jj = 0; jj < schedules.size(); jj++) {
+			LocalTimeScheduleIndex index(schedules[jj]);
+			assertInt("", index.isEmpty(), 0);
+
+			// Covers the test file dates, and the start and end of DST in both hemispheres
+			for(time_t t = LocalTime::stringToTime("2021-10-01 00:00:00"); t < LocalTime::stringToTime("2022-04-20 00:00:00"); t += 3600 + 7 * 60 + 13) {
+				if (t > LocalTime::stringToTime("2021-10-05 00:00:00") && t < LocalTime::stringToTime("2021-11-05 00:00:00")) {
+					t = LocalTime::stringToTime("2021-11-05 00:00:00");
+				}
+				if (t > LocalTime::stringToTime("2021-11-09 00:00:00") && t < LocalTime::stringToTime("2022-02-20 00:00:00")) {
+					t = LocalTime::stringToTime("2022-02-20 00:00:00");
+				}
+				LocalTimeConvert conv1, conv2;
+				conv1.withConfig(tzConfig).withTime(t).convert();
+				conv2 = conv1;
+
+				bool bResult1 = schedules[jj].getNextScheduledTime(conv1);
+				bool bResult2 = index.getNextScheduledTime(conv2);
+				assertInt(tzStrs[ii], bResult2, bResult1);
+				if (bResult1 && conv1.time != conv2.time) {
+					printf("schedule %d at %s\n", (int)jj, LocalTime::timeToString(t).c_str());
+					assertStr(tzStrs[ii], LocalTime::timeToString(conv2.time), LocalTime::timeToString(conv1.time));
+				}
+				assertInt64(tzStrs[ii], index.getNextScheduledTime(tzConfig, t), bResult1 ? conv1.time : 0);
+			}
+		}
+	}
+
+	// Only on dates stop the search after the last date
+	LocalTimeSchedule schedule;
+	schedule.withTime(LocalTimeHMSRestricted(LocalTimeHMS("12:00"), LocalTimeRestrictedDate(0).withOnlyOnDates({"2022-03-07"})));
+	LocalTimeScheduleIndex index(schedule);
+	LocalTimePosixTimezone tzConfig("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00");
+	assertTime2("", index.getNextScheduledTime(tzConfig, LocalTime::stringToTime("2022-01-01 00:00:00")), "2022-03-07 17:00:00");
+	assertInt64("", index.getNextScheduledTime(tzConfig, LocalTime::stringToTime("2022-03-07 17:00:00")), 0);
+
+	index.clear();
+	assertInt("", index.isEmpty(), 1);
+	assertInt64("", index.getNextScheduledTime(tzConfig, LocalTime::stringToTime("2022-01-01 00:00:00")), 0);
+}
+
+void testScheduler() {
+	LocalTimePosixTimezone tzConfig("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00");
+	LocalTimeZoneHandle adelaide = LocalTimeZoneRegistry::instance().intern("ACST-9:30ACDT,M10.1.0/2,M4.1.0/3");
+
+	std::vector<LocalTimeSchedule> schedules;
+	schedules.push_back(LocalTimeSchedule().withMinuteOfHour(15, LocalTimeRange(LocalTimeHMS("09:00:00"), LocalTimeHMS("17:00:00"))));
+	schedules.push_back(LocalTimeSchedule().withTimes({LocalTimeHMS("06:00"), LocalTimeHMS("18:30")}));
+	schedules.push_back(LocalTimeSchedule().withHourOfDay(4, LocalTimeRange(LocalTimeHMS("00:05:00"), LocalTimeHMS("23:59:59"))).withZone(adelaide));
+	schedules.push_back(LocalTimeSchedule().withDayOfWeekOfMonth(LocalTimeDayOfWeek::DAY_MONDAY, -1, LocalTimeRange(LocalTimeHMS("01:30:00"))));
+	schedules.push_back(LocalTimeSchedule().withMinuteOfHour(20, LocalTimeRange(LocalTimeHMS("00:00:00"), LocalTimeHMS("23:59:59"), LocalTimeRestrictedDate(LocalTimeDayOfWeek::MASK_WEEKEND))));
+
+	LocalTimeScheduler scheduler;
+	scheduler.withConfig(tzConfig);
+
+	time_t timeNow = LocalTime::stringToTime("2022-02-20 00:00:00");
+	for(size_t ii = 0; ii < schedules.size(); ii++) {
+		assertInt("", (int)scheduler.add(schedules[ii], timeNow), (int)ii);
+		schedules[ii].nextTime = 0;
+	}
+	assertInt("", (int)scheduler.size(), (int)schedules.size());
+
+	// The scheduler must return the same times as isScheduledTime() on each schedule
+	auto checkSchedules = [&](time_t timeNow) {
+		std::vector<std::pair<time_t, LocalTimeScheduler::ScheduleId>> expected, actual;
+		for(size_t ii = 0; ii < schedules.size(); ii++) {
+			if (!scheduler.isValid((LocalTimeScheduler::ScheduleId)ii)) {
+				continue;
+			}
+			LocalTimeConvert conv;
+			if (schedules[ii].zone != LocalTimeZoneRegistry::INVALID_HANDLE) {
+				conv.withZone(schedules[ii].zone);
+			}
+			else {
+				conv.withConfig(tzConfig);
+			}
+			conv.withTime(timeNow).convert();
+
+			time_t nextTime = schedules[ii].nextTime;
+			if (schedules[ii].isScheduledTime(conv, timeNow)) {
+				expected.push_back(std::make_pair(nextTime, (LocalTimeScheduler::ScheduleId)ii));
+			}
+		}
+		std::sort(expected.begin(), expected.end());
+
+		scheduler.popDue(timeNow, [&](LocalTimeScheduler::ScheduleId id, time_t time) {
+			actual.push_back(std::make_pair(time, id));
+		});
+
+		assertInt("", (int)actual.size(), (int)expected.size());
+		for(size_t ii = 0; ii < actual.size() && ii < expected.size(); ii++) {
+			assertTime2("", actual[ii].first, LocalTime::timeToString(expected[ii].first).c_str());
+			assertInt64("", actual[ii].second, expected[ii].second);
+		}
+	};
+
+	// Prime nextTime in the schedules
+	checkSchedules(timeNow);
+
+	// Covers the start of DST in both zones
+	for(; timeNow < LocalTime::stringToTime("2022-04-10 00:00:00"); timeNow += 7 * 60 + 13) {
+		checkSchedules(timeNow);
+
+		time_t nextTime = 0;
+		for(size_t ii = 0; ii < schedules.size(); ii++) {
+			if (schedules[ii].nextTime != 0 && (nextTime == 0 || schedules[ii].nextTime < nextTime)) {
+				nextTime = schedules[ii].nextTime;
+			}
+		}
+		assertInt64("", scheduler.peekNext(), nextTime);
+	}
+
+	// Long gaps between calls only return each schedule once
+	timeNow = LocalTime::stringToTime("2022-04-20 00:00:00");
+	checkSchedules(timeNow);
+
+	// Update and remove only change that schedule
+	schedules[1] = LocalTimeSchedule().withTime(LocalTimeHMS("20:01"));
+	scheduler.update(1, schedules[1], timeNow);
+	LocalTimeScheduler::ScheduleId id;
+	assertTime2("", scheduler.peekNext(&id), "2022-04-20 00:01:00");
+	assertInt("", (int)id, 1);
+	assertInt("", scheduler.remove(1), 1);
+	assertInt("", scheduler.remove(1), 0);
+	assertInt("", scheduler.update(1, schedules[1], timeNow), 0);
+	assertInt("", (int)scheduler.size(), (int)schedules.size() - 1);
+	for(; timeNow < LocalTime::stringToTime("2022-04-22 00:00:00"); timeNow += 7 * 60 + 13) {
+		checkSchedules(timeNow);
+	}
+
+	// Removed ids are reused
+	assertInt("", (int)scheduler.add(schedules[1], timeNow), 1);
+	scheduler.clear();
+	assertInt("", (int)scheduler.size(), 0);
+	assertInt64("", scheduler.peekNext(), 0);
+
+	// A time after the lookahead period is found by checking again at the end of the period
+	int lookaheadDays = LocalTime::instance().getScheduleLookaheadDays();
+	LocalTime::instance().withScheduleLookaheadDays(10);
+
+	LocalTimeSchedule schedule;
+	schedule.withDayOfMonth(20, LocalTimeRange(LocalTimeHMS("12:00:00")));
+	timeNow = LocalTime::stringToTime("2022-03-01 00:00:00");
+	id = scheduler.add(schedule, timeNow);
+	assertTime2("", scheduler.peekNext(), "2022-03-11 00:00:00");
+	time_t time;
+	assertInt("", scheduler.popDue(LocalTime::stringToTime("2022-03-11 00:00:00"), id, time), 0);
+	assertTime2("", scheduler.peekNext(), "2022-03-20 16:00:00");
+	assertInt("", scheduler.popDue(LocalTime::stringToTime("2022-03-20 16:00:00"), id, time), 1);
+	assertTime2("", time, "2022-03-20 16:00:00");
+	assertInt("", scheduler.popDue(LocalTime::stringToTime("2022-03-20 16:00:00"), id, time), 0);
+
+	LocalTime::instance().withScheduleLookaheadDays(lookaheadDays);
+}
+
+void testTimingWheel() {
+	LocalTimePosixTimezone tzConfig("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00");
+	LocalTimeZoneHandle adelaide = LocalTimeZoneRegistry::instance().intern("ACST-9:30ACDT,M10.1.0/2,M4.1.0/3");
+
+	std::vector<LocalTimeSchedule> schedules;
+	schedules.push_back(LocalTimeSchedule().withMinuteOfHour(15, LocalTimeRange(LocalTimeHMS("09:00:00"), LocalTimeHMS("17:00:00"))));
+	schedules.push_back(LocalTimeSchedule().withTimes({LocalTimeHMS("06:00"), LocalTimeHMS("18:30:17")}));
+	schedules.push_back(LocalTimeSchedule().withHourOfDay(4, LocalTimeRange(LocalTimeHMS("00:05:00"), LocalTimeHMS("23:59:59"))).withZone(adelaide));
+	schedules.push_back(LocalTimeSchedule().withDayOfWeekOfMonth(LocalTimeDayOfWeek::DAY_MONDAY, -1, LocalTimeRange(LocalTimeHMS("01:30:00"))));
+	schedules.push_back(LocalTimeSchedule().withMinuteOfHour(1, LocalTimeRange(LocalTimeHMS("00:00:00"), LocalTimeHMS("23:59:59"), LocalTimeRestrictedDate(LocalTimeDayOfWeek::MASK_WEEKEND))));
+	schedules.push_back(LocalTimeSchedule().withTime(LocalTimeHMSRestricted(LocalTimeHMS("12:00"), LocalTimeRestrictedDate(0).withOnlyOnDates({"2022-03-05", "2022-09-01", "2023-02-01"}))));
+	// Range start with seconds, so every time is at :30
+	schedules.push_back(LocalTimeSchedule().withMinuteOfHour(1, LocalTimeRange(LocalTimeHMS("00:00:30"), LocalTimeHMS("23:59:59"), LocalTimeRestrictedDate(LocalTimeDayOfWeek::MASK_WEEKEND))));
+
+	// The wheel must return the same times as the heap in LocalTimeScheduler
+	LocalTimeTimingWheel wheel;
+	wheel.withConfig(tzConfig);
+	LocalTimeScheduler scheduler;
+	scheduler.withConfig(tzConfig);
+
+	time_t timeNow = LocalTime::stringToTime("2022-02-26 23:58:00");
+	for(size_t ii = 0; ii < schedules.size(); ii++) {
+		assertInt("", (int)wheel.add(schedules[ii], timeNow), (int)ii);
+		scheduler.add(schedules[ii], timeNow);
+	}
+	assertInt("", (int)wheel.size(), (int)schedules.size());
+	assertTime2("", wheel.getTime(), "2022-02-26 23:58:00");
+
+	auto checkAdvance = [&](time_t timeNow) {
+		std::vector<std::pair<time_t, LocalTimeScheduler::ScheduleId>> expected, actual;
+		scheduler.popDue(timeNow, [&](LocalTimeScheduler::ScheduleId id, time_t time) {
+			expected.push_back(std::make_pair(time, id));
+		});
+		std::sort(expected.begin(), expected.end());
+
+		size_t count = wheel.advance(timeNow, [&](LocalTimeTimingWheel::ScheduleId id, time_t time) {
+			actual.push_back(std::make_pair(time, id));
+		});
+		assertInt("", (int)count, (int)actual.size());
+		assertTime2("", wheel.getTime(), LocalTime::timeToString(timeNow).c_str());
+
+		assertInt("", (int)actual.size(), (int)expected.size());
+		for(size_t ii = 0; ii < actual.size() && ii < expected.size(); ii++) {
+			assertTime2("", actual[ii].first, LocalTime::timeToString(expected[ii].first).c_str());
+			assertInt64("", actual[ii].second, expected[ii].second);
+		}
+	};
+
+	// Every second across midnight and the start of DST
+	for(; timeNow < LocalTime::stringToTime("2022-02-27 00:05:00"); timeNow++) {
+		checkAdvance(timeNow);
+	}
+	for(timeNow = LocalTime::stringToTime("2022-03-13 06:00:00"); timeNow < LocalTime::stringToTime("2022-03-13 08:00:00"); timeNow++) {
+		checkAdvance(timeNow);
+	}
+
+	// Irregular steps and clock jumps of minutes, hours, and days
+	const int steps[] = { 1, 59, 61, 7 * 60 + 13, 3599, 3601, 5 * 3600 + 17, 86399, 86401, 3 * 86400 + 11 };
+	for(size_t ii = 0; timeNow < LocalTime::stringToTime("2022-06-01 00:00:00"); ii++) {
+		timeNow += steps[ii % (sizeof(steps) / sizeof(steps[0]))];
+		checkAdvance(timeNow);
+	}
+
+	// Update and remove only change that schedule
+	LocalTimeSchedule schedule;
+	schedule.withTime(LocalTimeHMS("20:01"));
+	wheel.update(1, schedule, timeNow);
+	scheduler.update(1, schedule, timeNow);
+	assertInt("", wheel.remove(3), 1);
+	assertInt("", wheel.remove(3), 0);
+	assertInt("", wheel.update(3, timeNow), 0);
+	scheduler.remove(3);
+	assertInt("", (int)wheel.size(), (int)schedules.size() - 1);
+	for(int ii = 0; ii < 300; ii++) {
+		timeNow += 7 * 60 + 13;
+		checkAdvance(timeNow);
+	}
+
+	// A jump longer than the day wheel uses the overflow list
+	timeNow = LocalTime::stringToTime("2023-01-31 00:00:00");
+	checkAdvance(timeNow);
+	timeNow = LocalTime::stringToTime("2023-02-02 00:00:00");
+	checkAdvance(timeNow);
+
+	// Removed ids are reused
+	assertInt("", (int)wheel.add(schedules[3], timeNow), 3);
+	wheel.clear();
+	assertInt("", (int)wheel.size(), 0);
+	assertInt64("", wheel.getTime(), 0);
+}
+
+void testScheduleOccurrences() {
+	std::vector<LocalTimeSchedule> schedules;
+
+	const char *scheduleFiles[] = {
+		"testfiles/test12.json",
+		"testfiles/test13.json",
+		"testfiles/test14.json",
+		"testfiles/test15.json",
+		"testfiles/test16.json",
+		"testfiles/test17.json",
+		"testfiles/test18.json",
+		"testfiles/test19.json",
+		0
+	};
+	for(size_t ii = 0; scheduleFiles[ii]; ii++) {
+		LocalTimeSchedule schedule;
+		schedule.fromJson(readTestDataJson(scheduleFiles[ii]));
+		schedules.push_back(schedule);
+	}
+	{
+		LocalTimeSchedule schedule;
+		schedule.withTimes({LocalTimeHMSRestricted(LocalTimeHMS("06:00"), LocalTimeRestrictedDate(LocalTimeDayOfWeek::MASK_WEEKDAY).withExceptDates({"2022-03-09"})), LocalTimeHMS("18:30")});
+		schedule.withMinuteOfHour(10, LocalTimeRange(LocalTimeHMS("08:00:00"), LocalTimeHMS("10:00:00")));
+		schedule.withHourOfDay(2);
+		schedule.withDayOfMonth(-1, LocalTimeRange(LocalTimeHMS("18:30:00")));
+		schedules.push_back(schedule);
+	}
+
+	// The occurrences must be the same as calling getNextScheduledTime() in a loop
+	const char *tzStrs[] = {
+		"EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00",
+		"ACST-9:30ACDT,M10.1.0/2,M4.1.0/3",
+		0
+	};
+	const char *startTimes[] = {
+		"2021-10-01 00:00:00",
+		"2021-11-05 13:17:00",
+		"2022-02-24 00:00:00",
+		"2022-03-08 23:59:59",
+		"2022-03-28 12:00:00",
+		0
+	};
+	for(size_t ii = 0; tzStrs[ii]; ii++) {
+		LocalTimePosixTimezone tzConfig(tzStrs[ii]);
+		for(size_t jj = 0; jj < schedules.size(); jj++) {
+			for(size_t kk = 0; startTimes[kk]; kk++) {
+				LocalTimeConvert conv;
+				conv.withConfig(tzConfig).withTime(LocalTime::stringToTime(startTimes[kk])).convert();
+				time_t until = conv.time + 7 * 86400;
+
+				std::vector<time_t> expected, actual;
+				LocalTimeConvert loopConv(conv);
+				while(schedules[jj].getNextScheduledTime(loopConv) && loopConv.time < until) {
+					expected.push_back(loopConv.time);
+				}
+
+				for(const LocalTimeConvert &occurrence : schedules[jj].occurrences(conv, until)) {
+					assertInt("", occurrence.localTimeValue.hour(), occurrence.getLocalTimeHMS().hour);
+					actual.push_back(occurrence.time);
+				}
+
+				assertInt(tzStrs[ii], (int)actual.size(), (int)expected.size());
+				for(size_t ll = 0; ll < actual.size() && ll < expected.size(); ll++) {
+					assertTime2(tzStrs[ii], actual[ll], LocalTime::timeToString(expected[ll]).c_str());
+				}
+			}
+		}
+	}
+
+	LocalTimePosixTimezone tzConfig("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00");
+	LocalTimeConvert conv;
+	conv.withConfig(tzConfig).withTime(LocalTime::stringToTime("2022-03-01 00:00:00")).convert();
+
+	// until is exclusive, and next() and isValid() can be used instead of the iterator
+	{
+		LocalTimeSchedule schedule;
+		schedule.withTime(LocalTimeHMS("12:00"));
+		LocalTimeScheduleOccurrences occurrences = schedule.occurrences(conv, LocalTime::stringToTime("2022-03-03 17:00:00"));
+		assertInt("", occurrences.isValid(), 1);
+		assertTime2("", occurrences.getCurrent().time, "2022-03-01 17:00:00");
+		assertInt("", occurrences.next(), 1);
+		assertTime2("", occurrences.getCurrent().time, "2022-03-02 17:00:00");
+		assertInt("", occurrences.next(), 0);
+		assertInt("", occurrences.isValid(), 0);
+		assertInt("", occurrences.begin() == occurrences.end(), 1);
+
+		LocalTimeSchedule emptySchedule;
+		assertInt("", emptySchedule.occurrences(conv, conv.time + 86400).isValid(), 0);
+	}
+
+	// An item with nothing in the lookahead period is found when another item moves the current time later
+	{
+		int lookaheadDays = LocalTime::instance().getScheduleLookaheadDays();
+		LocalTime::instance().withScheduleLookaheadDays(10);
+
+		LocalTimeSchedule schedule;
+		schedule.withTime(LocalTimeHMS("12:00"));
+		schedule.withDayOfMonth(20, LocalTimeRange(LocalTimeHMS("06:00:00")));
+
+		std::vector<time_t> expected, actual;
+		LocalTimeConvert loopConv(conv);
+		while(schedule.getNextScheduledTime(loopConv) && loopConv.time < conv.time + 60 * 86400) {
+			expected.push_back(loopConv.time);
+		}
+		for(const LocalTimeConvert &occurrence : schedule.occurrences(conv, conv.time + 60 * 86400)) {
+			actual.push_back(occurrence.time);
+		}
+		assertInt("", (int)actual.size(), 62);
+		assertInt("", (int)actual.size(), (int)expected.size());
+		for(size_t ii = 0; ii < actual.size() && ii < expected.size(); ii++) {
+			assertTime2("", actual[ii], LocalTime::timeToString(expected[ii]).c_str());
+		}
+		assertTime2("", actual[19], "2022-03-20 10:00:00");
+
+		LocalTime::instance().withScheduleLookaheadDays(lookaheadDays);
+	}
+}
+
+void testScheduleMinuteOffsets() {
+	auto checkTimes = [](const char *tzStr, const LocalTimeSchedule &schedule, const char *startTime, std::initializer_list<const char *> expected) {
+		LocalTimePosixTimezone tzConfig(tzStr);
+		LocalTimeConvert conv;
+		conv.withConfig(tzConfig).withTime(LocalTime::stringToTime(startTime)).convert();
+		for(const char *expectedTime : expected) {
+			assertInt(tzStr, schedule.getNextScheduledTime(conv), 1);
+			assertTime2(tzStr, conv.time, expectedTime);
+		}
+	};
+
+	// Nepal is UTC+5:45. Every 15 minutes from 9:00 AM to 5:00 PM local time.
+	checkTimes("NPT-5:45", LocalTimeSchedule().withMinuteOfHour(15, LocalTimeRange(LocalTimeHMS("09:00:00"), LocalTimeHMS("17:00:00"))), 
+		"2022-03-01 03:10:00", {"2022-03-01 03:15:00", "2022-03-01 03:30:00", "2022-03-01 03:45:00"});
+
+	// The end of the time range is not included
+	checkTimes("NPT-5:45", LocalTimeSchedule().withMinuteOfHour(15, LocalTimeRange(LocalTimeHMS("09:00:00"), LocalTimeHMS("17:00:00"))), 
+		"2022-03-01 11:00:00", {"2022-03-02 03:15:00", "2022-03-02 03:30:00"});
+
+	// Every 3 hours starting at 00:30 local time
+	checkTimes("NPT-5:45", LocalTimeSchedule().withHourOfDay(3, LocalTimeRange(LocalTimeHMS("00:30:00"), LocalTimeHMS("23:59:59"))), 
+		"2022-03-01 00:00:00", {"2022-03-01 00:45:00", "2022-03-01 03:45:00", "2022-03-01 06:45:00"});
+
+	// 25 does not divide 60, so it's at :00, :25, and :50 every hour
+	checkTimes("NPT-5:45", LocalTimeSchedule().withMinuteOfHour(25), 
+		"2022-03-01 00:06:00", {"2022-03-01 00:15:00", "2022-03-01 00:40:00", "2022-03-01 01:05:00", "2022-03-01 01:15:00"});
+
+	// The start second is used for every time
+	checkTimes("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00", LocalTimeSchedule().withMinuteOfHour(1, LocalTimeRange(LocalTimeHMS("00:00:30"), LocalTimeHMS("23:59:59"))), 
+		"2022-02-26 23:58:00", {"2022-02-26 23:58:30", "2022-02-26 23:59:30", "2022-02-27 00:00:30"});
+
+	// Adelaide is UTC+9:30 standard and UTC+10:30 daylight. DST ends 2022-04-03 at 3:00 AM local 
+	// time, which is 2:00 AM standard time, so the times from 2:00 to 3:00 occur twice.
+	checkTimes("ACST-9:30ACDT,M10.1.0/2,M4.1.0/3", LocalTimeSchedule().withMinuteOfHour(30), 
+		"2022-04-02 14:50:00", {"2022-04-02 15:00:00", "2022-04-02 15:30:00", "2022-04-02 16:00:00", "2022-04-02 16:30:00", "2022-04-02 17:00:00", "2022-04-02 17:30:00"});
+
+	// Times of day are only scheduled once, at the standard time
+	checkTimes("ACST-9:30ACDT,M10.1.0/2,M4.1.0/3", LocalTimeSchedule().withHourOfDay(1, LocalTimeRange(LocalTimeHMS("00:30:00"), LocalTimeHMS("23:59:59"))), 
+		"2022-04-02 14:50:00", {"2022-04-02 15:00:00", "2022-04-02 17:00:00", "2022-04-02 18:00:00"});
+
+	// DST starts 2021-10-03 at 2:00 AM local time, so the times from 2:00 to 3:00 are skipped
+	checkTimes("ACST-9:30ACDT,M10.1.0/2,M4.1.0/3", LocalTimeSchedule().withMinuteOfHour(30), 
+		"2021-10-02 15:10:00", {"2021-10-02 15:30:00", "2021-10-02 16:00:00", "2021-10-02 16:30:00", "2021-10-02 17:00:00"});
+}
+
+void testScheduleNextTimeRegressions() {
+	auto checkTimes = [](const char *tzStr, const LocalTimeSchedule &schedule, const char *startTime, std::initializer_list<const char *> expected) {
+		LocalTimePosixTimezone tzConfig(tzStr);
+		LocalTimeConvert conv;
+		conv.withConfig(tzConfig).withTime(LocalTime::stringToTime(startTime)).convert();
+		for(const char *expectedTime : expected) {
+			assertInt(tzStr, schedule.getNextScheduledTime(conv), 1);
+			assertTime2(tzStr, conv.time, expectedTime);
+		}
+	};
+	const char *tzNewYork = "EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00";
+
+	// Minute of hour rolls over midnight to the first time of the next day (23:50 local time)
+	checkTimes(tzNewYork, LocalTimeSchedule().withMinuteOfHour(15), 
+		"2022-03-02 04:50:00", {"2022-03-02 05:00:00", "2022-03-02 05:15:00"});
+	checkTimes(tzNewYork, LocalTimeSchedule().withMinuteOfHour(20, LocalTimeRange(LocalTimeHMS("00:00:00"), LocalTimeHMS("23:59:59"))), 
+		"2022-03-02 04:41:00", {"2022-03-02 05:00:00", "2022-03-02 05:20:00"});
+
+	// A range starting at midnight, only on weekends. 2022-02-25 is a Friday.
+	LocalTimeSchedule weekend;
+	weekend.withMinuteOfHour(30, LocalTimeRange(LocalTimeHMS("00:00:00"), LocalTimeHMS("23:59:59"), LocalTimeRestrictedDate(LocalTimeDayOfWeek::MASK_WEEKEND)));
+	checkTimes(tzNewYork, weekend, "2022-02-26 04:45:00", {"2022-02-26 05:00:00", "2022-02-26 05:30:00"});
+	checkTimes(tzNewYork, weekend, "2022-02-26 05:00:00", {"2022-02-26 05:30:00"});
+	checkTimes(tzNewYork, weekend, "2022-02-28 04:15:00", {"2022-02-28 04:30:00", "2022-03-05 05:00:00"});
+
+	// Start minute past the increment (50 % 15 = 5), so the minute in the hour is less than the 
+	// start minute modulo the increment after stepping. ACST is UTC+9:30, so 02:21 UTC is 11:51 local.
+	// After 23:50 the next time is the start of the range, 00:50, not 00:05.
+	checkTimes("ACST-9:30", LocalTimeSchedule().withMinuteOfHour(15, LocalTimeRange(LocalTimeHMS("00:50:00"), LocalTimeHMS("23:59:59"))), 
+		"2022-03-01 02:21:00", {"2022-03-01 02:35:00", "2022-03-01 02:50:00", "2022-03-01 03:05:00"});
+	// 11:48 local steps to 12:03, which must round down to 11:50, not up to 12:05
+	checkTimes("ACST-9:30", LocalTimeSchedule().withMinuteOfHour(15, LocalTimeRange(LocalTimeHMS("00:50:00"), LocalTimeHMS("23:59:59"))), 
+		"2022-03-01 02:18:00", {"2022-03-01 02:20:00", "2022-03-01 02:35:00"});
+	checkTimes("ACST-9:30", LocalTimeSchedule().withMinuteOfHour(15, LocalTimeRange(LocalTimeHMS("00:50:00"), LocalTimeHMS("23:59:59"))), 
+		"2022-02-28 14:00:00", {"2022-02-28 14:05:00", "2022-02-28 14:20:00", "2022-02-28 15:20:00", "2022-02-28 15:35:00"});
+	// NPT is UTC+5:45, so 03:10 UTC is 08:55 local. Times are at :10, :30, and :50.
+	checkTimes("NPT-5:45", LocalTimeSchedule().withMinuteOfHour(20, LocalTimeRange(LocalTimeHMS("00:50:00"), LocalTimeHMS("23:59:59"))), 
+		"2022-03-01 03:10:00", {"2022-03-01 03:25:00", "2022-03-01 03:45:00", "2022-03-01 04:05:00"});
+
+	// Two items where the first never has a time: only on a date in the past
+	LocalTimeSchedule twoItems;
+	twoItems.withTimes({LocalTimeHMSRestricted(LocalTimeHMS("06:00"), LocalTimeRestrictedDate(0).withOnlyOnDates({"2021-01-01"})), LocalTimeHMS("18:30")});
+	checkTimes(tzNewYork, twoItems, "2022-03-01 12:00:00", {"2022-03-01 23:30:00", "2022-03-02 23:30:00"});
+
+	// Same items in the other order, so the item without a time comes after one with a time
+	LocalTimeSchedule twoItemsReversed;
+	twoItemsReversed.withTimes({LocalTimeHMS("18:30"), LocalTimeHMSRestricted(LocalTimeHMS("06:00"), LocalTimeRestrictedDate(0).withOnlyOnDates({"2021-01-01"}))});
+	checkTimes(tzNewYork, twoItemsReversed, "2022-03-01 12:00:00", {"2022-03-01 23:30:00", "2022-03-02 23:30:00"});
+}
+
 void testFiles() {
 	
 	// EST=UTC-5 EDT=UTC-4 
@@ -3437,9 +5322,35 @@ void test3() {
 int main(int argc, char *argv[]) {
 	testLocalTimeChange();
 	testLocalTimePosixTimezone();
+	testPosixTimezoneLiteral();
+	testPosixTimezoneParse();
+	testCivilCalendar();
+	testZoneName();
+	testDayOfWeekOfMonth();
+	testYMDDays();
+	testTransitionCache();
+	testBatchConvert();
+	testFixedOffset();
 	test1();
 	test3();
 	testFiles();
+	testTransitionTable();
+	testLocalToUTC();
+	testIncrementalConvert();
+	testLocalTimeConversion();
+	testGlobalConfig();
+	testZoneRegistry();
+	testMultiZoneConvert();
+	testCursor();
+	testFormatBuffer();
+	testFormatter();
+	testISO8601();
+	testScheduleIndex();
+	testScheduler();
+	testTimingWheel();
+	testScheduleOccurrences();
+	testScheduleMinuteOffsets();
+	testScheduleNextTimeRegressions();
 
 	// test2 sets the global timezone configuration
 	test2();
@@ -1,110 +1,353 @@
 #include "LocalTimeRK.h"
 
-LocalTime *LocalTime::_instance;
+std::atomic<LocalTime *> LocalTime::_instance(nullptr);
+std::atomic<LocalTimeZoneRegistry *> LocalTimeZoneRegistry::_instance(nullptr);
 
 //
-// LocalTimeYMD
+// LocalTimeISO8601
 //
-void LocalTimeYMD::fromTimeInfo(const struct tm *pTimeInfo) {
-    ymd.year = pTimeInfo->tm_year;
-    ymd.month = pTimeInfo->tm_mon + 1;
-    ymd.day = pTimeInfo->tm_mday;
-}
+size_t LocalTimeISO8601::parse(const char *str, size_t len) {
+    size_t dateLen = parseDate(str, len);
+    if (dateLen == 0 || dateLen >= len) {
+        return 0;
+    }
+    const char *cp = str + dateLen;
+    const char *end = str + len;
 
-void LocalTimeYMD::fromLocalTimeValue(const LocalTimeValue &value) {
-    *this = value.ymd();
-}
+    // Any single character separates the date and time
+    separator = *cp++;
 
-int LocalTimeYMD::getDayOfWeek() const {
-    struct tm timeInfo = {0};
+    size_t timeLen = parseTime(cp, end - cp);
+    if (timeLen == 0 || timeParts < 2) {
+        return 0;
+    }
+    cp += timeLen;
+
+    nanosecond = 0;
+    fractionDigits = 0;
+    if (timeParts == 3 && (end - cp) >= 2 && (*cp == '.' || *cp == ',') && cp[1] >= '0' && cp[1] <= '9') {
+        cp++;
+        uint32_t scale = 100000000;
+        while(cp < end && *cp >= '0' && *cp <= '9') {
+            // Digits past nanoseconds are ignored
+            nanosecond += (*cp - '0') * scale;
+            scale /= 10;
+            if (fractionDigits < 255) {
+                fractionDigits++;
+            }
+            cp++;
+        }
+    }
 
-    timeInfo.tm_year = ymd.year;
-    timeInfo.tm_mon = ymd.month - 1;
-    timeInfo.tm_mday = ymd.day;
-    
-    time_t time = LocalTime::tmToTime(&timeInfo);
-    LocalTime::timeToTm(time, &timeInfo);
+    hasOffset = false;
+    offset = 0;
+    if (cp < end) {
+        if (*cp == 'Z' || *cp == 'z') {
+            hasOffset = true;
+            cp++;
+        }
+        else
+        if (*cp == '+' || *cp == '-') {
+            const char *offsetStart = cp++;
+            int offsetHour, offsetMinute = 0;
+            if (scanDigits(cp, end, 2, &offsetHour)) {
+                const char *minuteStart = cp;
+                if (cp < end && *cp == ':') {
+                    cp++;
+                }
+                if (!scanDigits(cp, end, 2, &offsetMinute)) {
+                    // Hour only
+                    offsetMinute = 0;
+                    cp = minuteStart;
+                }
+                hasOffset = true;
+                offset = (offsetHour * 3600 + offsetMinute * 60) * ((*offsetStart == '-') ? -1 : 1);
+            }
+            else {
+                // Not an offset, so it's not part of the time
+                cp = offsetStart;
+            }
+        }
+    }
 
-    return timeInfo.tm_wday;
+    return cp - str;
 }
 
-void LocalTimeYMD::addDay(int numberOfDays) {
-    struct tm timeInfo = {0};
+size_t LocalTimeISO8601::parseDate(const char *str, size_t len) {
+    const char *cp = str;
+    const char *end = str + len;
 
-    timeInfo.tm_year = ymd.year;
-    timeInfo.tm_mon = ymd.month - 1;
-    timeInfo.tm_mday = ymd.day;
+    if (!str || 
+        !scanNumber(cp, end, &year) || cp >= end || *cp++ != '-' ||
+        !scanNumber(cp, end, &month) || cp >= end || *cp++ != '-' ||
+        !scanNumber(cp, end, &day)) {
+        return 0;
+    }
+    return cp - str;
+}
 
-    timeInfo.tm_mday += numberOfDays;
+size_t LocalTimeISO8601::parseTime(const char *str, size_t len) {
+    const char *cp = str;
+    const char *end = str + len;
+    int *values[3] = { &hour, &minute, &second };
 
-    time_t time = LocalTime::tmToTime(&timeInfo);
-    LocalTime::timeToTm(time, &timeInfo);
+    hour = minute = second = 0;
+    timeParts = 0;
+    if (!str) {
+        return 0;
+    }
+
+    while(timeParts < 3) {
+        const char *partStart = cp;
+        if (timeParts > 0) {
+            if (cp >= end || *cp++ != ':') {
+                cp = partStart;
+                break;
+            }
+        }
+        if (!scanNumber(cp, end, values[timeParts])) {
+            cp = partStart;
+            break;
+        }
+        timeParts++;
+    }
+    return cp - str;
+}
+
+time_t LocalTimeISO8601::toTime() const {
+    // Same calculation as LocalTime::tmToTime(), without normalizing a struct tm
+    int tempYear = year + (month - 1) / 12;
+    int tempMonth = (month - 1) % 12;
+    if (tempMonth < 0) {
+        tempMonth += 12;
+        tempYear--;
+    }
+    int64_t days = (int64_t)LocalTime::daysFromCivil(tempYear, tempMonth + 1, 1) + day - 1;
 
-    fromTimeInfo(&timeInfo);
+    return (time_t)(days * 86400 + (int64_t)hour * 3600 + (int64_t)minute * 60 + second - offset);
 }
 
+void LocalTimeISO8601::toTimeInfo(struct tm *pTimeInfo) const {
+    *pTimeInfo = {};
+    pTimeInfo->tm_year = year - 1900;
+    pTimeInfo->tm_mon = month - 1;
+    pTimeInfo->tm_mday = day;
+    pTimeInfo->tm_hour = hour;
+    pTimeInfo->tm_min = minute;
+    pTimeInfo->tm_sec = second;
 
-int LocalTimeYMD::compareTo(const LocalTimeYMD other) const {
-    int cmp;
+    // Normalizes the values and fills in tm_wday and tm_yday
+    LocalTime::tmToTime(pTimeInfo);
+}
 
-    if (ymd.year < other.ymd.year) {
-        cmp = -1;
-    }
-    else
-    if (ymd.year > other.ymd.year) {
-        cmp = +1;
-    }
-    else {
-        if (ymd.month < other.ymd.month) {
-            return -1;
+size_t LocalTimeISO8601::format(char *buf, size_t bufSize) const {
+    char temp[64];
+    size_t len = 0;
+
+    len += formatNumber(year, 4, &temp[len], 12);
+    temp[len++] = '-';
+    len += formatNumber(month, 2, &temp[len], 12);
+    temp[len++] = '-';
+    len += formatNumber(day, 2, &temp[len], 12);
+    temp[len++] = separator;
+    len += formatNumber(hour, 2, &temp[len], 12);
+    temp[len++] = ':';
+    len += formatNumber(minute, 2, &temp[len], 12);
+    temp[len++] = ':';
+    len += formatNumber(second, 2, &temp[len], 12);
+
+    if (fractionDigits) {
+        temp[len++] = '.';
+        uint32_t value = nanosecond;
+        for(int ii = 0; ii < 9 && ii < fractionDigits; ii++) {
+            temp[len++] = (char)('0' + value / 100000000);
+            value = (value % 100000000) * 10;
         }
-        else
-        if (ymd.month > other.ymd.month) {
-            return +1;
+    }
+
+    if (hasOffset) {
+        if (offset == 0) {
+            temp[len++] = 'Z';
         }
         else {
-            if (ymd.day < other.ymd.day) {
-                cmp = -1;
-            }  
-            else
-            if (ymd.day > other.ymd.day) {
-                cmp = +1;
-            }
-            else {
-                cmp = 0;
-            }
+            int absOffset = abs(offset);
+            temp[len++] = (offset < 0) ? '-' : '+';
+            len += formatNumber(absOffset / 3600, 2, &temp[len], 12);
+            temp[len++] = ':';
+            len += formatNumber((absOffset / 60) % 60, 2, &temp[len], 12);
         }
     }
 
-    return cmp;
+    if (bufSize > 0) {
+        size_t copyLen = std::min(len, bufSize - 1);
+        memcpy(buf, temp, copyLen);
+        buf[copyLen] = 0;
+    }
+    return len;
 }
 
-bool LocalTimeYMD::parse(const char *s) {
-    int year, month, day;
-    if (sscanf(s, "%d-%d-%d", &year, &month, &day) == 3) {
-        setYear(year);
-        setMonth(month);
-        setDay(day);
-        return true;
+void LocalTimeISO8601::fromTime(time_t time, int32_t offset) {
+    struct tm timeInfo;
+    LocalTime::timeToTm(time + offset, &timeInfo);
+
+    year = timeInfo.tm_year + 1900;
+    month = timeInfo.tm_mon + 1;
+    day = timeInfo.tm_mday;
+    hour = timeInfo.tm_hour;
+    minute = timeInfo.tm_min;
+    second = timeInfo.tm_sec;
+    timeParts = 3;
+    nanosecond = 0;
+    fractionDigits = 0;
+    hasOffset = (offset != 0);
+    this->offset = offset;
+}
+
+// [static]
+size_t LocalTimeISO8601::formatNumber(int value, int minWidth, char *buf, size_t bufSize) {
+    char digits[12];
+    size_t numDigits = 0;
+
+    // Work with negative values so INT_MIN does not overflow
+    int negValue = (value < 0) ? value : -value;
+    do {
+        digits[numDigits++] = (char)('0' - (negValue % 10));
+        negValue /= 10;
+    } while(negValue != 0);
+
+    size_t len = 0;
+    if (value < 0 && len < bufSize) {
+        buf[len++] = '-';
+        minWidth--;
     }
-    else {
+    for(int ii = (int)numDigits; ii < minWidth && len < bufSize; ii++) {
+        buf[len++] = '0';
+    }
+    while(numDigits > 0 && len < bufSize) {
+        buf[len++] = digits[--numDigits];
+    }
+    return len;
+}
+
+// [static]
+bool LocalTimeISO8601::scanNumber(const char *&cp, const char *end, int *pValue) {
+    const char *start = cp;
+
+    while(cp < end && (*cp == ' ' || (*cp >= '\t' && *cp <= '\r'))) {
+        cp++;
+    }
+
+    bool negative = false;
+    if (cp < end && (*cp == '-' || *cp == '+')) {
+        negative = (*cp == '-');
+        cp++;
+    }
+
+    if (cp >= end || *cp < '0' || *cp > '9') {
+        cp = start;
+        return false;
+    }
+
+    int value = 0;
+    while(cp < end && *cp >= '0' && *cp <= '9') {
+        value = value * 10 + (*cp++ - '0');
+    }
+    *pValue = negative ? -value : value;
+    return true;
+}
+
+// [static]
+bool LocalTimeISO8601::scanDigits(const char *&cp, const char *end, int count, int *pValue) {
+    if (end - cp < count) {
         return false;
     }
+
+    int value = 0;
+    for(int ii = 0; ii < count; ii++) {
+        if (cp[ii] < '0' || cp[ii] > '9') {
+            return false;
+        }
+        value = value * 10 + (cp[ii] - '0');
+    }
+    cp += count;
+    *pValue = value;
+    return true;
+}
+
+//
+// LocalTimeYMD
+//
+void LocalTimeYMD::fromTimeInfo(const struct tm *pTimeInfo) {
+    ymd.year = pTimeInfo->tm_year;
+    ymd.month = pTimeInfo->tm_mon + 1;
+    ymd.day = pTimeInfo->tm_mday;
+}
+
+void LocalTimeYMD::fromLocalTimeValue(const LocalTimeValue &value) {
+    *this = value.ymd();
+}
+
+int LocalTimeYMD::getDayOfWeek() const {
+    return LocalTime::dayOfWeekFromDays(toDays());
+}
+
+void LocalTimeYMD::addDay(int numberOfDays) {
+    fromDays(toDays() + numberOfDays);
+}
+
+int LocalTimeYMD::toDays() const {
+    return LocalTime::daysFromCivil(getYear(), ymd.month, ymd.day);
+}
+
+void LocalTimeYMD::fromDays(int days) {
+    int year, month, day;
+    LocalTime::civilFromDays(days, &year, &month, &day);
+
+    ymd.year = year - 1900;
+    ymd.month = month;
+    ymd.day = day;
+}
+
+bool LocalTimeYMD::parse(const char *s) {
+    return s && parse(s, strlen(s)) != 0;
+}
+
+size_t LocalTimeYMD::parse(const char *s, size_t len) {
+    LocalTimeISO8601 iso;
+
+    size_t result = iso.parseDate(s, len);
+    if (result) {
+        setYear(iso.year);
+        setMonth(iso.month);
+        setDay(iso.day);
+    }
+    return result;
+}
+
+String LocalTimeYMD::toString() const {
+    char buf[40];
+
+    size_t len = LocalTimeISO8601::formatNumber(ymd.year + 1900, 4, buf, 12);
+    buf[len++] = '-';
+    len += LocalTimeISO8601::formatNumber(ymd.month, 2, &buf[len], 12);
+    buf[len++] = '-';
+    len += LocalTimeISO8601::formatNumber(ymd.day, 2, &buf[len], 12);
+    buf[len] = 0;
+
+    return String(buf);
 }
 
 
 //
 // LocalTimeHMS
 //
-const LocalTimeHMS LocalTimeHMS::startOfDay = LocalTimeHMS("00:00:00");
-const LocalTimeHMS LocalTimeHMS::endOfDay = LocalTimeHMS("23:59:59");
+const LocalTimeHMS LocalTimeHMS::startOfDay = LocalTimeHMS(0, 0, 0);
+const LocalTimeHMS LocalTimeHMS::endOfDay = LocalTimeHMS(23, 59, 59);
 
 
 LocalTimeHMS::LocalTimeHMS() {
 }
 
-LocalTimeHMS::~LocalTimeHMS() {
-}
 
 LocalTimeHMS::LocalTimeHMS(const char *str) {
     parse(str);
@@ -121,25 +364,28 @@ void LocalTimeHMS::clear() {
 void LocalTimeHMS::parse(const char *str) {
     clear();
 
-    int values[3];
-    if (sscanf(str, "%d:%d:%d", &values[0], &values[1], &values[2]) == 3) {
-        hour = (int8_t) values[0];    
-        minute = (int8_t) values[1];    
-        second = (int8_t) values[2];    
-    }
-    else
-    if (sscanf(str, "%d:%d", &values[0], &values[1]) == 2) {
-        hour = (int8_t) values[0];    
-        minute = (int8_t) values[1];    
-    }
-    else
-    if (sscanf(str, "%d", &values[0]) == 1) {
-        hour = (int8_t) values[0];    
+    if (str) {
+        LocalTimeISO8601 iso;
+        iso.parseTime(str, strlen(str));
+
+        // Parts that are not present are 0
+        hour = (int8_t) iso.hour;
+        minute = (int8_t) iso.minute;
+        second = (int8_t) iso.second;
     }
 }
 
 String LocalTimeHMS::toString() const {
-    return String::format("%02d:%02d:%02d", (int)hour, (int)minute, (int)second);
+    char buf[40];
+
+    size_t len = LocalTimeISO8601::formatNumber(hour, 2, buf, 12);
+    buf[len++] = ':';
+    len += LocalTimeISO8601::formatNumber(minute, 2, &buf[len], 12);
+    buf[len++] = ':';
+    len += LocalTimeISO8601::formatNumber(second, 2, &buf[len], 12);
+    buf[len] = 0;
+
+    return String(buf);
 }
 
 int LocalTimeHMS::toSeconds() const {
@@ -339,8 +585,6 @@ void LocalTimeHMSRestricted::fromJson(JSONValue jsonObj) {
 //
 LocalTimeChange::LocalTimeChange() {
 }
-LocalTimeChange::~LocalTimeChange() {
-}
 
 LocalTimeChange::LocalTimeChange(const char *str) {
     parse(str);
@@ -349,40 +593,45 @@ LocalTimeChange::LocalTimeChange(const char *str) {
 void LocalTimeChange::clear() {
     month = week = dayOfWeek = valid = 0;
     hms.clear();
+    rule = Rule::MONTH_WEEK_DAY;
+    dayOfYear = 0;
 }
 
+// Copies a rule parsed by LocalTimePosixTimezoneLiteral, used by parse() and fromLiteral()
+static void changeFromLiteral(LocalTimeChange &change, const LocalTimePosixTimezoneLiteral::Change &src) {
+    change.clear();
+    if (src.valid) {
+        change.month = src.month;
+        change.week = src.week;
+        change.dayOfWeek = src.dayOfWeek;
+        change.hms = LocalTimeHMS(src.hms.hour, src.hms.minute, src.hms.second);
+        change.rule = src.rule;
+        change.dayOfYear = src.dayOfYear;
+        change.valid = true;
+    }
+}
 
 void LocalTimeChange::parse(const char *str) {
     // M3.2.0/2:00:00
-    if (!str || str[0] != 'M') {
-        clear();
-        return;
-    }
-
-    int values[3];
-    if (sscanf(str, "M%d.%d.%d", &values[0], &values[1], &values[2]) == 3) {
-        month = (int8_t) values[0];
-        week = (int8_t) values[1];
-        dayOfWeek = (int8_t) values[2];
+    changeFromLiteral(*this, LocalTimePosixTimezoneLiteral::parseRule(str));
+}
 
-        const char *cp = strchr(str, '/');
-        if (cp) {
-            cp++;
-            hms.parse(cp);
-        }
-        else {
-            hms.clear();
-        }
-        valid = true;
-    }
-    else {
-        clear();
-    }
+void LocalTimeChange::parse(const char *str, size_t len) {
+    changeFromLiteral(*this, LocalTimePosixTimezoneLiteral::parseRule(str, len));
 }
 
 String LocalTimeChange::toString() const {
     if (valid) {
-        return String::format("M%d.%d.%d/%d:%02d:%02d", (int)month, (int)week, (int)dayOfWeek, (int)hms.hour, (int)hms.minute, (int)hms.second);
+        switch(rule) {
+            case Rule::JULIAN:
+                return String::format("J%d/%d:%02d:%02d", (int)dayOfYear, (int)hms.hour, (int)hms.minute, (int)hms.second);
+
+            case Rule::DAY_OF_YEAR:
+                return String::format("%d/%d:%02d:%02d", (int)dayOfYear, (int)hms.hour, (int)hms.minute, (int)hms.second);
+
+            default:
+                return String::format("M%d.%d.%d/%d:%02d:%02d", (int)month, (int)week, (int)dayOfWeek, (int)hms.hour, (int)hms.minute, (int)hms.second);
+        }
     }
     else {
         return "";
@@ -391,25 +640,36 @@ String LocalTimeChange::toString() const {
 
 
 time_t LocalTimeChange::calculate(struct tm *pTimeInfo, LocalTimeHMS tzAdjust) const {
-    // Start with the first of the month
-    pTimeInfo->tm_mday = 1;
-    pTimeInfo->tm_mon = month - 1; // tm_mon is zero-based!
-    pTimeInfo->tm_hour = pTimeInfo->tm_min = pTimeInfo->tm_sec = 0;
-    LocalTime::tmToTime(pTimeInfo);
-
-    while(pTimeInfo->tm_wday != dayOfWeek) {
-        pTimeInfo->tm_mday++;
-        LocalTime::tmToTime(pTimeInfo);
-    }
-    if (week != 1) {
-        pTimeInfo->tm_mday += (week - 1) * 7;
-        if (pTimeInfo->tm_mday > LocalTime::lastDayOfMonth(pTimeInfo->tm_year + 1900, month)) {
-            // 5 means the last week of the month, even if there is no 5th week
-            pTimeInfo->tm_mday -= 7;
+    switch(rule) {
+        case Rule::JULIAN: {
+            // J1 is January 1 and J365 is December 31. February 29 is never counted, so 
+            // days on or after J60 (March 1) are one day later in leap years.
+            int day = dayOfYear;
+            if (day >= 60 && LocalTime::lastDayOfMonth(pTimeInfo->tm_year + 1900, 2) == 29) {
+                day++;
+            }
+            // tmToTime() carries out-of-range days into the month
+            pTimeInfo->tm_mday = day;
+            pTimeInfo->tm_mon = 0;
+            break;
         }
 
-        LocalTime::tmToTime(pTimeInfo);        
+        case Rule::DAY_OF_YEAR:
+            // Zero-based, so 0 is January 1 and 59 is February 29 in leap years
+            pTimeInfo->tm_mday = dayOfYear + 1;
+            pTimeInfo->tm_mon = 0;
+            break;
+
+        default: {
+            // Week 5 means the last week of the month, even if there is no 5th week
+            int ordinal = (week >= 5) ? -1 : ((week < 1) ? 1 : week);
+
+            pTimeInfo->tm_mday = LocalTime::dayOfWeekOfMonth(pTimeInfo->tm_year + 1900, month, dayOfWeek, ordinal);
+            pTimeInfo->tm_mon = month - 1; // tm_mon is zero-based!
+            break;
+        }
     }
+    pTimeInfo->tm_hour = pTimeInfo->tm_min = pTimeInfo->tm_sec = 0;
 
     // We now know the date of time change in local time
 
@@ -432,13 +692,15 @@ time_t LocalTimeChange::calculate(struct tm *pTimeInfo, LocalTimeHMS tzAdjust) c
 
 LocalTimePosixTimezone::LocalTimePosixTimezone() {
 }
-LocalTimePosixTimezone::~LocalTimePosixTimezone() {
-}
 
 LocalTimePosixTimezone::LocalTimePosixTimezone(const char *str) {
     parse(str);
 }
 
+LocalTimePosixTimezone::LocalTimePosixTimezone(const LocalTimePosixTimezoneLiteral &literal) {
+    fromLiteral(literal);
+}
+
 void LocalTimePosixTimezone::clear() {
     dstStart.clear();
     dstName = "";
@@ -446,161 +708,262 @@ void LocalTimePosixTimezone::clear() {
     standardStart.clear();
     standardName = "";
     standardHMS.clear();
+    clearCache();
 }
 
 bool LocalTimePosixTimezone::parse(const char *str) {
-    char *mutableCopy = strdup(str);
-
-    char *token, *save = mutableCopy;
-    size_t ii = 0;
-    while((token = strtok_r(save, ",", &save)) != 0) {
-        switch(ii++) {
-            case 0: {
-                // Timezone specifier
-                char *cp = token, *start = token, save2;
-                while(*cp >= 'A') {
-                    cp++;
-                }
-                save2 = *cp;
-                *cp = 0;
-                standardName = start;
-                *cp = save2;
-                valid = true;
-
-                if (*cp) {
-                    start = cp;
-                    while(*cp && *cp < 'A') {
-                        cp++;
-                    }
-                    save2 = *cp;
-                    *cp = 0;
-                    standardHMS.parse(start);
-                    *cp = save2;
-
-                    if (*cp) {
-                        start = cp;
-                        while(*cp && *cp >= 'A') {
-                            cp++;
-                        }
-                        save2 = *cp;
-                        *cp = 0;
-                        dstName = start;
-                        *cp = save2;
-
-                        if (*cp) {
-                            start = cp;
-                            dstHMS.parse(start);
-                        }
-                        else {
-                            // Default dst is 1 hour later
-                            dstHMS = standardHMS;
-                            dstHMS.hour--;
-                        }
-                    }
-                }
-                break;
-            }
-            case 1: {
-                dstStart.parse(token);
-                break;
-            }
-            case 2: {
-                standardStart.parse(token);
-                break;
-            }
-        }
+    // Single pass, no allocation. Parsing at runtime is the same as a constexpr literal.
+    return fromLiteral(LocalTimePosixTimezoneLiteral::parse(str));
+}
+
+bool LocalTimePosixTimezone::parse(const char *str, size_t len, size_t *pErrorPosition, const char **pErrorReason) {
+    LocalTimePosixTimezoneLiteral literal = LocalTimePosixTimezoneLiteral::parse(str, len);
+    if (pErrorPosition) {
+        *pErrorPosition = literal.errorPosition;
+    }
+    if (pErrorReason) {
+        *pErrorReason = literal.errorReason;
     }
+    return fromLiteral(literal);
+}
+
+bool LocalTimePosixTimezone::fromLiteral(const LocalTimePosixTimezoneLiteral &literal) {
+    clear();
 
-    if (dstStart.valid && !standardStart.valid) {
-        // If DST start is specified, standard start must also be specified
-        dstStart.clear();
+    if (!literal.valid) {
         valid = false;
+        return false;
     }
 
+    standardName = literal.standardName;
+    standardHMS = LocalTimeHMS(literal.standardHMS.hour, literal.standardHMS.minute, literal.standardHMS.second);
+    dstName = literal.dstName;
+    dstHMS = LocalTimeHMS(literal.dstHMS.hour, literal.dstHMS.minute, literal.dstHMS.second);
 
-    free(mutableCopy);
+    changeFromLiteral(dstStart, literal.dstStart);
+    changeFromLiteral(standardStart, literal.standardStart);
+    valid = true;
 
     return valid;
 }
 
-//
-// LocalTimeValue
-//
+time_t LocalTimePosixTimezone::localToUTC(const struct tm *pLocalTime, LocalTimeKind *pKind) const {
+    struct tm mutableTimeInfo = *pLocalTime;
+    time_t localTime = LocalTime::tmToTime(&mutableTimeInfo);
 
-int LocalTimeValue::hourFormat12() const {
-    if (tm_hour == 0) {
-        return 12;
-    }
-    else
-    if (tm_hour < 12) {
-        return tm_hour;
-    }
-    else {
-        return tm_hour - 12;
+    // The local time interpreted with each offset. Each is only correct if the 
+    // resulting UTC time actually has that offset.
+    time_t standardTime = localTime - getOffset(false);
+    if (!hasDST()) {
+        if (pKind) {
+            *pKind = LocalTimeKind::UNIQUE;
+        }
+        return standardTime;
     }
-}
+    time_t dstTime = localTime - getOffset(true);
 
-LocalTimeHMS LocalTimeValue::hms() const {
-    LocalTimeHMS result;
-    result.fromTimeInfo(this);
-    return result;
-}
+    bool standardIsDST = getSegment(standardTime);
 
-void LocalTimeValue::setHMS(LocalTimeHMS hms) {
-    if (!hms.ignore) {
-        tm_hour = hms.hour;
-        tm_min = hms.minute;
-        tm_sec = hms.second;
+    if (pKind) {
+        bool dstIsDST = getSegment(dstTime);
+
+        if (!standardIsDST && dstIsDST) {
+            *pKind = LocalTimeKind::REPEATED;
+        }
+        else
+        if (standardIsDST && !dstIsDST) {
+            *pKind = LocalTimeKind::SKIPPED;
+        }
+        else {
+            *pKind = LocalTimeKind::UNIQUE;
+        }
     }
-}
 
-LocalTimeYMD LocalTimeValue::ymd() const {
-    LocalTimeYMD result;
-    result.fromTimeInfo(this);
-    return result;
+    // This is the same decision the previous implementation made using a full 
+    // LocalTimeConvert: DST if the standard time interpretation is in DST
+    return standardIsDST ? dstTime : standardTime;
 }
 
+void LocalTimePosixTimezone::calculateTransitions(int year, time_t *pDstStart, time_t *pStandardStart) const {
+    struct tm timeInfo = {0};
 
-time_t LocalTimeValue::toUTC(LocalTimePosixTimezone config) const {
-    struct tm mutableTimeInfo = *this;
-    time_t standardTime, dstTime;
-    
-    standardTime = dstTime = LocalTime::tmToTime(&mutableTimeInfo);
-    standardTime += config.standardHMS.toSeconds();
+    timeInfo.tm_year = year;
 
-    if (config.hasDST()) {
-        LocalTimeConvert convert;
-        convert.withConfig(config).withTime(standardTime).convert();
+    // Note that the second parameter is standardHMS because when you enter DST at 
+    // a local standard time; you have not yet entered DST.
+    time_t dstStartTime = dstStart.calculate(&timeInfo, standardHMS);
 
-        if (convert.isDST()) {
-            // The time is in DST, so return that instead
-            dstTime += config.dstHMS.toSeconds();
-            return dstTime;
-        }
+    // When entering standard time you are leaving DST. For example you leave DST at 
+    // 2 AM EDT (-0400) so that's the adjustment to UTC.
+    timeInfo.tm_year = year;
+    time_t standardStartTime = standardStart.calculate(&timeInfo, dstHMS);
+
+    if (pDstStart) {
+        *pDstStart = dstStartTime;
+    }
+    if (pStandardStart) {
+        *pStandardStart = standardStartTime;
     }
-    return standardTime;
 }
 
-void LocalTimeValue::fromString(const char *str) {
-    (void) LocalTime::stringToTime(str, this);
+void LocalTimePosixTimezone::getTransitions(int year, time_t *pDstStart, time_t *pStandardStart) const {
+    getTransitions(year, pDstStart, pStandardStart, transitionCache[(unsigned)year % TRANSITION_CACHE_SIZE]);
 }
 
-int LocalTimeValue::ordinal() const {
-    int ordinal = 1;
-    int tempDayOfMonth = tm_mday;
-    while((tempDayOfMonth - 7) >= 1) {
-        ordinal++;
-        tempDayOfMonth -= 7;
+void LocalTimePosixTimezone::getTransitions(int year, time_t *pDstStart, time_t *pStandardStart, TransitionCacheEntry &entry) const {
+    // The public rule fields can be modified directly, so the entry is only used if it was
+    // calculated from the same rules
+    if (!entry.valid || entry.year != year || entry.dstRule != dstStart || entry.standardRule != standardStart || 
+        entry.dstHMS != dstHMS || entry.standardHMS != standardHMS) {
+        calculateTransitions(year, &entry.dstStart, &entry.standardStart);
+        entry.year = year;
+        entry.dstRule = dstStart;
+        entry.standardRule = standardStart;
+        entry.dstHMS = dstHMS;
+        entry.standardHMS = standardHMS;
+        entry.valid = true;
     }
-    return ordinal;
-}
 
-//
-// LocalTimeScheduleItem
-//
-bool LocalTimeScheduleItem::getNextScheduledTime(LocalTimeConvert &conv) const {
+    if (pDstStart) {
+        *pDstStart = entry.dstStart;
+    }
+    if (pStandardStart) {
+        *pStandardStart = entry.standardStart;
+    }
+}
 
-    LocalTimeConvert tempConv(conv);
+bool LocalTimePosixTimezone::getSegment(time_t time, time_t *pSegmentStart, time_t *pSegmentEnd) const {
+    if (!hasDST()) {
+        if (pSegmentStart) {
+            *pSegmentStart = std::numeric_limits<time_t>::min();
+        }
+        if (pSegmentEnd) {
+            *pSegmentEnd = std::numeric_limits<time_t>::max();
+        }
+        return false;
+    }
+
+    struct tm timeInfo;
+    LocalTime::timeToTm(time, &timeInfo);
+
+    time_t dstStartTime, standardStartTime;
+    getTransitions(timeInfo.tm_year, &dstStartTime, &standardStartTime);
+
+    return segmentFromTransitions(time, timeInfo.tm_year, dstStartTime, standardStartTime, pSegmentStart, pSegmentEnd);
+}
+
+// [static]
+bool LocalTimePosixTimezone::segmentFromTransitions(time_t time, int year, time_t dstStartTime, time_t standardStartTime, time_t *pSegmentStart, time_t *pSegmentEnd) {
+    bool isDST;
+
+    // Transitions are calculated per UTC year, so the span can't cross a year boundary
+    time_t segmentStart = (time_t)LocalTime::daysFromCivil(year + 1900, 1, 1) * 86400;
+    time_t segmentEnd = (time_t)LocalTime::daysFromCivil(year + 1901, 1, 1) * 86400;
+
+    // This must match LocalTimeConversion::positionFromTransitions()
+    time_t first, second;
+    if (dstStartTime < standardStartTime) {
+        // Northern hemisphere: DST is between the two transitions
+        first = dstStartTime;
+        second = standardStartTime;
+        isDST = (time >= first && time < second);
+    }
+    else {
+        // Southern hemisphere: DST is before the first and after the second transition
+        first = standardStartTime;
+        second = dstStartTime;
+        isDST = (time < first || time >= second);
+    }
+
+    if (time < first) {
+        segmentEnd = std::min(segmentEnd, first);
+    }
+    else
+    if (time < second) {
+        segmentStart = std::max(segmentStart, first);
+        segmentEnd = std::min(segmentEnd, second);
+    }
+    else {
+        segmentStart = std::max(segmentStart, second);
+    }
+
+    if (pSegmentStart) {
+        *pSegmentStart = segmentStart;
+    }
+    if (pSegmentEnd) {
+        *pSegmentEnd = segmentEnd;
+    }
+    return isDST;
+}
+
+void LocalTimePosixTimezone::clearCache() const {
+    for(size_t ii = 0; ii < TRANSITION_CACHE_SIZE; ii++) {
+        transitionCache[ii].valid = false;
+    }
+}
+
+//
+// LocalTimeValue
+//
+
+int LocalTimeValue::hourFormat12() const {
+    if (tm_hour == 0) {
+        return 12;
+    }
+    else
+    if (tm_hour < 12) {
+        return tm_hour;
+    }
+    else {
+        return tm_hour - 12;
+    }
+}
+
+LocalTimeHMS LocalTimeValue::hms() const {
+    LocalTimeHMS result;
+    result.fromTimeInfo(this);
+    return result;
+}
+
+void LocalTimeValue::setHMS(LocalTimeHMS hms) {
+    if (!hms.ignore) {
+        tm_hour = hms.hour;
+        tm_min = hms.minute;
+        tm_sec = hms.second;
+    }
+}
+
+LocalTimeYMD LocalTimeValue::ymd() const {
+    LocalTimeYMD result;
+    result.fromTimeInfo(this);
+    return result;
+}
+
+
+time_t LocalTimeValue::toUTC(const LocalTimePosixTimezone &config, LocalTimePosixTimezone::LocalTimeKind *pKind) const {
+    return config.localToUTC(this, pKind);
+}
+
+void LocalTimeValue::fromString(const char *str) {
+    (void) LocalTime::stringToTime(str, this);
+}
+
+int LocalTimeValue::ordinal() const {
+    int ordinal = 1;
+    int tempDayOfMonth = tm_mday;
+    while((tempDayOfMonth - 7) >= 1) {
+        ordinal++;
+        tempDayOfMonth -= 7;
+    }
+    return ordinal;
+}
+
+//
+// LocalTimeScheduleItem
+//
+bool LocalTimeScheduleItem::getNextScheduledTime(LocalTimeConvert &conv) const {
+
+    LocalTimeConvert tempConv(conv);
     
     LocalTimeYMD endYMD;
     
@@ -633,71 +996,27 @@ bool LocalTimeScheduleItem::getNextScheduledTime(LocalTimeConvert &conv) const {
         case ScheduleItemType::HOUR_OF_DAY:
         case ScheduleItemType::MINUTE_OF_HOUR:
             {
-                bool bResult = false;
-
-                int cmp = timeRange.compareTo(tempConv.localTimeValue.hms());
-                if (cmp < 0) {
-                    // Before time range, return beginning of time range
-                    tempConv.atLocalTime(timeRange.hmsStart);
-                    conv.time = tempConv.time;
-                    conv.convert();
-                    return true;
-                }
-                else 
-                if (cmp == 0) {
-                    // In time range hmsStart <= hms <= hmsEnd
-                    // Handle multiples here
-                    struct tm timeInfo;
-                    int startingModulo;
-                     
-                    switch(scheduleItemType) {
-                    case ScheduleItemType::HOUR_OF_DAY:
-                        // Loop here instead of doing the modulo math to correctly handle timezone and daylight saving switch
-                        for(LocalTimeHMS tempHMS = timeRange.hmsStart; tempHMS <= timeRange.hmsEnd; tempHMS.hour += increment) {
-                            tempConv.atLocalTime(tempHMS);
-                            if (tempConv.time > conv.time) {
-                                // Found match
-                                bResult = true;
-                                break;
-                            }
-                        }
-                        break;
-
-                    case ScheduleItemType::MINUTE_OF_HOUR:
-                        // TODO: I think this is wrong for timezones with a minute offset
-                        startingModulo = timeRange.hmsStart.minute % increment;
-
-                        tempConv.time += increment * 60;
-                        tempConv.convert();
-
-                        LocalTime::timeToTm(tempConv.time, &timeInfo);
-                        timeInfo.tm_min -= ((tempConv.localTimeValue.minute() - startingModulo) % increment);
-                        timeInfo.tm_sec = timeRange.hmsStart.second;
-                        tempConv.time = LocalTime::tmToTime(&timeInfo);
-                        tempConv.convert();
-                        if (tempConv.getLocalTimeHMS() < timeRange.hmsEnd) {
-                            bResult = true;
-                        }
-                        break;
-
-                    default:
-                        break;
-                    }
-
-                    if (bResult) {
-                        if (!timeRange.isValidDate(tempConv.getLocalTimeYMD())) {
-                            bResult = false;
-                        }
-                    }
-
-                    if (bResult) {
-                        conv.time = tempConv.time;
-                        conv.convert();
-                        return true;
+                // On later days, tempConv is at the start of the day, which is also a valid time
+                int seconds = tempConv.localTimeValue.hms().toSeconds();
+                int fromSeconds = (tempConv.time > conv.time) ? seconds - 1 : seconds;
+
+                time_t result = 0;
+                if (tempConv.time + (86400 - seconds) <= tempConv.segmentEnd) {
+                    // The UTC offset does not change for the rest of the local day, so local time of day 
+                    // is elapsed time from tempConv and only the result needs to be converted
+                    int nextSeconds = nextTimeOfDay(fromSeconds);
+                    if (nextSeconds >= 0) {
+                        result = tempConv.time + (nextSeconds - seconds);
                     }
                 }
                 else {
-                    // cmp > 0, after time range, don't check and try next day
+                    result = nextTimeAfterTimeChange(tempConv, fromSeconds, conv.time);
+                }
+
+                if (result != 0) {
+                    conv.time = result;
+                    conv.convert();
+                    return true;
                 }
             }
             break;            
@@ -767,6 +1086,88 @@ bool LocalTimeScheduleItem::getNextScheduledTime(LocalTimeConvert &conv) const {
 }
 
 
+int LocalTimeScheduleItem::nextTimeOfDay(int seconds) const {
+    int start = timeRange.hmsStart.toSeconds();
+    int end = timeRange.hmsEnd.toSeconds();
+
+    // Before the time range, every type is scheduled at the start of the time range
+    if (seconds < start) {
+        return start;
+    }
+    if (increment < 1) {
+        return -1;
+    }
+
+    switch(scheduleItemType) {
+    case ScheduleItemType::MINUTE_OF_HOUR:
+        {
+            // Smallest minute in this hour with minute:second after seconds, rounded up to the 
+            // next minute that's the same as the start modulo increment
+            int startingModulo = timeRange.hmsStart.minute % increment;
+            int hour = seconds / 3600;
+            int secondsPast = seconds % 3600 - timeRange.hmsStart.second;
+            int minute = (secondsPast < 0) ? 0 : secondsPast / 60 + 1;
+            if (minute <= startingModulo) {
+                minute = startingModulo;
+            }
+            else {
+                minute = startingModulo + ((minute - startingModulo + increment - 1) / increment) * increment;
+            }
+            if (minute >= 60) {
+                hour++;
+                minute = startingModulo;
+            }
+            int next = hour * 3600 + minute * 60 + timeRange.hmsStart.second;
+            return (next < end) ? next : -1;
+        }
+
+    case ScheduleItemType::HOUR_OF_DAY:
+        {
+            int next = start + ((seconds - start) / (increment * 3600) + 1) * increment * 3600;
+            return (next <= end) ? next : -1;
+        }
+
+    default:
+        return -1;
+    }
+}
+
+time_t LocalTimeScheduleItem::nextTimeAfterTimeChange(const LocalTimeConvert &dayConv, int fromSeconds, time_t time) const {
+    int shift = dayConv.config.getOffset(true) - dayConv.config.getOffset(false);
+    if (shift < 0) {
+        shift = -shift;
+    }
+
+    // Local time may go backwards by up to shift when falling back, so earlier times of day can
+    // be later in UTC. Check every time that could be earlier than the best so far.
+    time_t result = 0;
+    int resultSeconds = 0;
+    LocalTimeValue value = dayConv.localTimeValue;
+    for(int seconds = nextTimeOfDay(fromSeconds - shift - 1); seconds >= 0; seconds = nextTimeOfDay(seconds)) {
+        if (result != 0 && seconds > resultSeconds + shift) {
+            break;
+        }
+
+        // Same conversion as LocalTimeConvert::atLocalTime()
+        LocalTimePosixTimezone::LocalTimeKind kind;
+        value.setHMS(LocalTimeHMS(seconds / 3600, (seconds / 60) % 60, seconds % 60));
+        time_t candidates[2];
+        size_t numCandidates = 0;
+        candidates[numCandidates++] = value.toUTC(dayConv.config, &kind);
+        if (kind == LocalTimePosixTimezone::LocalTimeKind::REPEATED && scheduleItemType == ScheduleItemType::MINUTE_OF_HOUR) {
+            // Elapsed time schedules occur during both of the repeated hours
+            candidates[numCandidates++] = candidates[0] - shift;
+        }
+        for(size_t ii = 0; ii < numCandidates; ii++) {
+            if (candidates[ii] > time && (result == 0 || candidates[ii] < result)) {
+                result = candidates[ii];
+                resultSeconds = seconds;
+            }
+        }
+    }
+    return result;
+}
+
 void LocalTimeScheduleItem::fromJson(JSONValue jsonObj) {
     JSONObjectIterator iter(jsonObj);
     while(iter.next()) {
@@ -921,7 +1322,7 @@ bool LocalTimeSchedule::getNextScheduledTime(LocalTimeConvert &conv, std::functi
         if (filter(item)) {
             LocalTimeConvert tmpConvert(conv);
             bool bResult = item.getNextScheduledTime(tmpConvert);
-            if (bResult && closestTime == 0 || tmpConvert.time < closestTime) {
+            if (bResult && (closestTime == 0 || tmpConvert.time < closestTime)) {
                 closestTime = tmpConvert.time;
             }
         }
@@ -939,12 +1340,27 @@ bool LocalTimeSchedule::getNextScheduledTime(LocalTimeConvert &conv, std::functi
 }
 
 
+time_t LocalTimeSchedule::getNextScheduledTime(LocalTimeZoneHandle zone, time_t time, const LocalTimeZoneRegistry &registry) const {
+    LocalTimeConvert conv;
+    conv.withZone(zone, registry).withTime(time).convert();
+
+    if (getNextScheduledTime(conv)) {
+        return conv.time;
+    }
+    else {
+        return 0;
+    }
+}
+
 bool LocalTimeSchedule::isScheduledTime() {
     if (!Time.isValid()) {
         return false;
     }
 
     LocalTimeConvert conv;
+    if (zone != LocalTimeZoneRegistry::INVALID_HANDLE) {
+        conv.withZone(zone);
+    }
     conv.withCurrentTime().convert();
     return isScheduledTime(conv, Time.now());
 }
@@ -963,519 +1379,2709 @@ bool LocalTimeSchedule::isScheduledTime(LocalTimeConvert &conv, time_t timeNow)
     
     return result;
 }
+
+LocalTimeScheduleOccurrences LocalTimeSchedule::occurrences(const LocalTimeConvert &conv, time_t until) const {
+    return LocalTimeScheduleOccurrences(*this, conv, until);
+}
+
 //
-// LocalTimeScheduleManager
+// LocalTimeScheduleOccurrences
 //
 
-time_t LocalTimeScheduleManager::getNextTimeByName(const char *name, const LocalTimeConvert &conv) {
-    for(auto it = schedules.begin(); it != schedules.end(); ++it) {
-        if (it->name.equals(name)) {
-            LocalTimeConvert tempConv(conv);
-            if (it->getNextScheduledTime(tempConv)) {
+LocalTimeScheduleOccurrences::LocalTimeScheduleOccurrences(const LocalTimeSchedule &schedule, const LocalTimeConvert &conv, time_t until) : schedule(schedule), until(until) {
+    LocalTimeConvert untilConv(conv);
+    untilConv.withTime(until).convert();
+    untilDays = untilConv.getLocalTimeYMD().toDays();
 
-            }
-        }
+    cursors.resize(schedule.scheduleItems.size());
+    for(size_t ii = 0; ii < cursors.size(); ii++) {
+        advanceCursor(ii, conv);
     }
-    return 0;
+    selectCurrent();
 }
 
-time_t LocalTimeScheduleManager::getNextWake(const LocalTimeConvert &conv) const {
-    time_t nextTime = 0;
+bool LocalTimeScheduleOccurrences::next() {
+    if (currentIndex == NO_CURSOR) {
+        return false;
+    }
+    const LocalTimeConvert &current = cursors[currentIndex].conv;
+    time_t time = current.time;
+
+    // getNextScheduledTime() searches the lookahead period from the current time, so an item that 
+    // had nothing within the lookahead period from its last search may have a time now
+    int days = current.getLocalTimeYMD().toDays();
+    for(size_t ii = 0; ii < cursors.size(); ii++) {
+        if (cursors[ii].canRetry && days > cursors[ii].searchDays) {
+            advanceCursor(ii, current);
+        }
+    }
 
-    for(auto it = schedules.begin(); it != schedules.end(); ++it) {
-        if ((it->flags & LocalTimeSchedule::FLAG_ANY_WAKE) != 0) {
-            LocalTimeConvert tempConv(conv);
-            if (it->getNextScheduledTime(tempConv)) {
-                if (nextTime == 0 || tempConv.time < nextTime) {
-                    nextTime = tempConv.time;
-                }
-            }
+    // Advance every item at the current time, so times in more than one item are only returned once
+    for(size_t ii = 0; ii < cursors.size(); ii++) {
+        if (cursors[ii].isValid && cursors[ii].conv.time == time) {
+            advanceCursor(ii, cursors[ii].conv);
         }
     }
-    return nextTime;
+
+    selectCurrent();
+    return isValid();
 }
 
-time_t LocalTimeScheduleManager::getNextFullWake(const LocalTimeConvert &conv) const {
-    time_t nextTime = 0;
+void LocalTimeScheduleOccurrences::advanceCursor(size_t index, const LocalTimeConvert &conv) {
+    Cursor &cursor = cursors[index];
+    const LocalTimeScheduleItem &item = schedule.scheduleItems[index];
 
-    for(auto it = schedules.begin(); it != schedules.end(); ++it) {
-        if ((it->flags & LocalTimeSchedule::FLAG_FULL_WAKE) != 0) {
-            LocalTimeConvert tempConv(conv);
-            if (it->getNextScheduledTime(tempConv)) {
-                if (nextTime == 0 || tempConv.time < nextTime) {
-                    nextTime = tempConv.time;
-                }
-            }
-        }
+    if (&conv != &cursor.conv) {
+        cursor.conv = conv;
     }
-    return nextTime;
+    cursor.searchDays = cursor.conv.getLocalTimeYMD().toDays();
+    cursor.isValid = item.getNextScheduledTime(cursor.conv);
+
+    // Only on dates and except dates are searched to the expiration date, not the lookahead period
+    cursor.canRetry = !cursor.isValid && 
+        item.scheduleItemType != LocalTimeScheduleItem::ScheduleItemType::NONE &&
+        item.getExpirationDate().isEmpty() &&
+        cursor.searchDays + LocalTime::instance().getScheduleLookaheadDays() < untilDays;
 }
 
-time_t LocalTimeScheduleManager::getNextDataCapture(const LocalTimeConvert &conv) const {
-    time_t nextTime = 0;
-
-    for(auto it = schedules.begin(); it != schedules.end(); ++it) {
-        if (it->name.equals("data")) {
-            LocalTimeConvert tempConv(conv);
-            if (it->getNextScheduledTime(tempConv)) {
-                if (nextTime == 0 || tempConv.time < nextTime) {
-                    nextTime = tempConv.time;
-                }
+void LocalTimeScheduleOccurrences::selectCurrent() {
+    currentIndex = NO_CURSOR;
+    for(size_t ii = 0; ii < cursors.size(); ii++) {
+        if (cursors[ii].isValid && cursors[ii].conv.time < until) {
+            if (currentIndex == NO_CURSOR || cursors[ii].conv.time < cursors[currentIndex].conv.time) {
+                currentIndex = ii;
             }
         }
     }
-    return nextTime;
 }
 
 
-void LocalTimeScheduleManager::forEach(std::function<void(LocalTimeSchedule &schedule)> callback) {
-    for(auto it = schedules.begin(); it != schedules.end(); ++it) {
-        callback(*it);
-    }
-}
+//
+// LocalTimeScheduleIndex
+//
 
-LocalTimeSchedule &LocalTimeScheduleManager::getScheduleByName(const char *name) {
+LocalTimeScheduleIndex &LocalTimeScheduleIndex::compile(const LocalTimeSchedule &schedule) {
+    clear();
 
-    for(auto it = schedules.begin(); it != schedules.end(); ++it) {
-        if (it->name.equals(name)) {
-            return *it;
+    for(auto it = schedule.scheduleItems.begin(); it != schedule.scheduleItems.end(); ++it) {
+        const LocalTimeScheduleItem &item = *it;
+        if (!item.isValid() || item.timeRange.hmsStart.ignore) {
+            continue;
         }
-    }
 
-    LocalTimeSchedule sch;
-    sch.name = name;
-    schedules.push_back(sch);
+        DateClass dateClass;
+        switch(item.scheduleItemType) {
+        case LocalTimeScheduleItem::ScheduleItemType::DAY_OF_MONTH:
+            dateClass.dateType = DateType::DAY_OF_MONTH;
+            dateClass.ordinal = item.increment;
+            break;
 
-    return getScheduleByName(name);
-}
+        case LocalTimeScheduleItem::ScheduleItemType::DAY_OF_WEEK_OF_MONTH:
+            dateClass.dateType = DateType::DAY_OF_WEEK_OF_MONTH;
+            dateClass.dayOfWeek = item.dayOfWeek;
+            dateClass.ordinal = item.increment;
+            break;
 
+        default:
+            break;
+        }
+        dateClass.dayOfWeekMask = item.timeRange.onlyOnDays.getMask();
+        for(auto it2 = item.timeRange.onlyOnDates.begin(); it2 != item.timeRange.onlyOnDates.end(); ++it2) {
+            dateClass.onlyOnDays.push_back(it2->toDays());
+        }
+        for(auto it2 = item.timeRange.exceptDates.begin(); it2 != item.timeRange.exceptDates.end(); ++it2) {
+            dateClass.exceptDays.push_back(it2->toDays());
+        }
+        sortUnique(dateClass.onlyOnDays);
+        sortUnique(dateClass.exceptDays);
 
-void LocalTimeScheduleManager::setFromJsonObject(const JSONValue &jsonObj) {
-    JSONObjectIterator iter(jsonObj);
-    while(iter.next()) {
-        String key = (const char *)iter.name();
+        LocalTimeYMD expirationDate = item.getExpirationDate();
+        if (!expirationDate.isEmpty()) {
+            dateClass.hasExpiration = true;
+            dateClass.expirationDays = expirationDate.toDays();
+        }
 
-        for(auto it = schedules.begin(); it != schedules.end(); ++it) {
-            if (it->name.equals(key)) {
-                it->fromJson(iter.value());
+        if (dateClass.dateType == DateType::DAYS && dateClass.onlyOnDays.empty() && dateClass.exceptDays.empty()) {
+            // Only restricted by day of week, so merge into the per-weekday tables
+            std::vector<int32_t> times;
+            addItemTimes(item, times);
+            for(int dayOfWeek = 0; dayOfWeek < 7; dayOfWeek++) {
+                if (item.timeRange.onlyOnDays.isSet(dayOfWeek)) {
+                    weekdayTimes[dayOfWeek].insert(weekdayTimes[dayOfWeek].end(), times.begin(), times.end());
+                }
             }
+            continue;
+        }
+
+        auto classIt = dateClasses.begin();
+        for(; classIt != dateClasses.end(); ++classIt) {
+            if (classIt->isSameDates(dateClass)) {
+                break;
+            }
+        }
+        if (classIt == dateClasses.end()) {
+            dateClasses.push_back(dateClass);
+            classIt = dateClasses.end() - 1;
         }
+        addItemTimes(item, classIt->times);
     }
-}
 
+    for(int dayOfWeek = 0; dayOfWeek < 7; dayOfWeek++) {
+        sortUnique(weekdayTimes[dayOfWeek]);
+    }
+    for(auto it = dateClasses.begin(); it != dateClasses.end(); ++it) {
+        sortUnique(it->times);
+    }
 
-//
-// LocalTimeRange
-// 
+    return *this;
+}
 
-time_t LocalTimeRange::getTimeSpan(const LocalTimeConvert &conv) const {
-    
-    LocalTimeConvert convStart(conv);
-    convStart.atLocalTime(hmsStart);
+void LocalTimeScheduleIndex::clear() {
+    for(int dayOfWeek = 0; dayOfWeek < 7; dayOfWeek++) {
+        weekdayTimes[dayOfWeek].clear();
+    }
+    dateClasses.clear();
+}
 
-    LocalTimeConvert convEnd(conv);
-    convEnd.atLocalTime(hmsEnd);
+bool LocalTimeScheduleIndex::isEmpty() const {
+    for(int dayOfWeek = 0; dayOfWeek < 7; dayOfWeek++) {
+        if (!weekdayTimes[dayOfWeek].empty()) {
+            return false;
+        }
+    }
+    return dateClasses.empty();
+}
 
-    if (!rangeCrossesMidnight()) {
-        return convEnd.time - convStart.time;
+bool LocalTimeScheduleIndex::getNextScheduledTime(LocalTimeConvert &conv) const {
+    const LocalTimeValue &value = conv.localTimeValue;
+    int days = LocalTime::daysFromCivil(value.tm_year + 1900, value.tm_mon + 1, value.tm_mday);
+    int seconds = value.tm_hour * 3600 + value.tm_min * 60 + value.tm_sec;
+
+    time_t result = getNextScheduledTime(conv.config, conv.time, days, seconds);
+    if (result != 0) {
+        conv.time = result;
+        conv.convert();
+        return true;
     }
-    else {        
-        convEnd.nextDay();
-        return convEnd.time - convStart.time;
+    else {
+        return false;
     }
 }
 
+time_t LocalTimeScheduleIndex::getNextScheduledTime(const LocalTimePosixTimezone &config, time_t time) const {
+    LocalTimeConvert conv;
+    conv.withConfig(config).withTime(time).convert();
 
-void LocalTimeRange::fromJson(JSONValue jsonObj) {    
-    JSONObjectIterator iter(jsonObj);
-    while(iter.next()) {
-        String key = (const char *)iter.name();
+    if (getNextScheduledTime(conv)) {
+        return conv.time;
+    }
+    else {
+        return 0;
+    }
+}
 
-        if (key == "s" || key == "e") {
-            String hmsStr = iter.value().toString().data();
+time_t LocalTimeScheduleIndex::getNextScheduledTime(const LocalTimePosixTimezone &config, time_t time, int days, int seconds) const {
+    time_t result = 0;
+    int endDays = days + LocalTime::instance().getScheduleLookaheadDays();
+
+    // Days with no times are skipped without any conversions. Any day of the week with times 
+    // occurs again within a week.
+    for(int curDays = days; curDays <= endDays && curDays < days + 8; curDays++) {
+        const std::vector<int32_t> &times = weekdayTimes[LocalTime::dayOfWeekFromDays(curDays)];
+        if (!times.empty()) {
+            result = firstTimeAfter(times, config, curDays, (curDays == days) ? seconds : 0, time);
+            if (result != 0) {
+                break;
+            }
+        }
+    }
 
-            if (key == "s") {
-                hmsStart = LocalTimeHMS(hmsStr);
+    for(auto it = dateClasses.begin(); it != dateClasses.end(); ++it) {
+        int classEndDays = it->hasExpiration ? it->expirationDays : endDays;
+
+        time_t classResult = 0;
+        for(int curDays = it->nextValidDay(days, classEndDays); curDays != INVALID_DAYS && classResult == 0; curDays = it->nextValidDay(curDays + 1, classEndDays)) {
+            classResult = firstTimeAfter(it->times, config, curDays, (curDays == days) ? seconds : 0, time);
+        }
+        if (classResult != 0 && (result == 0 || classResult < result)) {
+            result = classResult;
+        }
+    }
+
+    return result;
+}
+
+// [static]
+void LocalTimeScheduleIndex::addItemTimes(const LocalTimeScheduleItem &item, std::vector<int32_t> &times) {
+    // Times are stored as seconds * 2, plus 1 for times that occur during both repeated hours
+    // when falling back. MINUTE_OF_HOUR is elapsed time, the others are at a local time of day.
+    int repeated = (item.scheduleItemType == LocalTimeScheduleItem::ScheduleItemType::MINUTE_OF_HOUR) ? 1 : 0;
+
+    for(int seconds = item.nextTimeOfDay(-1); seconds >= 0; seconds = item.nextTimeOfDay(seconds)) {
+        times.push_back(seconds * 2 + repeated);
+    }
+}
+
+// [static]
+void LocalTimeScheduleIndex::sortUnique(std::vector<int32_t> &values) {
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+}
+
+// [static]
+time_t LocalTimeScheduleIndex::firstTimeAfter(const std::vector<int32_t> &times, const LocalTimePosixTimezone &config, int days, int fromSeconds, time_t time) {
+    time_t dayStart = localToUTC(config, days, 0);
+
+    if (config.hasDST()) {
+        time_t segmentEnd;
+        config.getSegment(dayStart, NULL, &segmentEnd);
+        if (segmentEnd - dayStart < SECONDS_PER_DAY) {
+            int shift = config.getOffset(true) - config.getOffset(false);
+            if (shift < 0) {
+                shift = -shift;
             }
-            else
-            if (key == "e") {
-                hmsEnd = LocalTimeHMS(hmsStr);
+            return firstTimeAfterTimeChange(times, config, days, fromSeconds, time, shift);
+        }
+    }
+
+    // The offset is the same for the whole day, so no conversions are needed
+    for(auto it = std::lower_bound(times.begin(), times.end(), fromSeconds * 2); it != times.end(); ++it) {
+        time_t result = dayStart + *it / 2;
+        if (result > time) {
+            return result;
+        }
+    }
+    return 0;
+}
+
+// [static]
+time_t LocalTimeScheduleIndex::firstTimeAfterTimeChange(const std::vector<int32_t> &times, const LocalTimePosixTimezone &config, int days, int fromSeconds, time_t time, int shift) {
+    // Local time may go backwards by up to shift when falling back, so earlier times of day can
+    // be later in UTC. Check every time that could be earlier than the best so far.
+    time_t result = 0;
+    int resultSeconds = 0;
+    for(auto it = std::lower_bound(times.begin(), times.end(), (fromSeconds - shift) * 2); it != times.end(); ++it) {
+        int seconds = *it / 2;
+        if (result != 0 && seconds > resultSeconds + shift) {
+            break;
+        }
+
+        LocalTimePosixTimezone::LocalTimeKind kind;
+        time_t candidates[2];
+        size_t numCandidates = 0;
+        candidates[numCandidates++] = localToUTC(config, days, seconds, &kind);
+        if (kind == LocalTimePosixTimezone::LocalTimeKind::REPEATED && (*it & 1)) {
+            // Elapsed time schedules occur during both of the repeated hours
+            candidates[numCandidates++] = candidates[0] - shift;
+        }
+        for(size_t ii = 0; ii < numCandidates; ii++) {
+            if (candidates[ii] > time && (result == 0 || candidates[ii] < result)) {
+                result = candidates[ii];
+                resultSeconds = seconds;
             }
         }
     }
-    LocalTimeRestrictedDate::fromJson(jsonObj);
+    return result;
 }
 
+// [static]
+time_t LocalTimeScheduleIndex::localToUTC(const LocalTimePosixTimezone &config, int days, int seconds, LocalTimePosixTimezone::LocalTimeKind *pKind) {
+    struct tm timeInfo = {0};
+    int year, month, day;
+    LocalTime::civilFromDays(days, &year, &month, &day);
+    timeInfo.tm_year = year - 1900;
+    timeInfo.tm_mon = month - 1;
+    timeInfo.tm_mday = day;
+    timeInfo.tm_hour = seconds / 3600;
+    timeInfo.tm_min = (seconds / 60) % 60;
+    timeInfo.tm_sec = seconds % 60;
+
+    return config.localToUTC(&timeInfo, pKind);
+}
 
+bool LocalTimeScheduleIndex::DateClass::isSameDates(const DateClass &other) const {
+    return dateType == other.dateType && dayOfWeekMask == other.dayOfWeekMask && dayOfWeek == other.dayOfWeek &&
+        ordinal == other.ordinal && onlyOnDays == other.onlyOnDays && exceptDays == other.exceptDays;
+}
 
-//
-// LocalTimeConvert
-//
-void LocalTimeConvert::convert() {
-    if (!config.isValid()) {
-        config = LocalTime::instance().getConfig();
+bool LocalTimeScheduleIndex::DateClass::isValidDay(int days) const {
+    if (std::binary_search(exceptDays.begin(), exceptDays.end(), days)) {
+        return false;
+    }
+    if (dayOfWeekMask & (1 << LocalTime::dayOfWeekFromDays(days))) {
+        return true;
     }
+    return std::binary_search(onlyOnDays.begin(), onlyOnDays.end(), days);
+}
 
-    if (config.hasDST()) {
-        // We need to worry about daylight saving time
-        LocalTime::timeToTm(time, &dstStartTimeInfo);
-        standardStartTimeInfo = dstStartTimeInfo;
-
-        // Calculate start of DST. Note that the second parameter is standardHMS because when you enter DST at 
-        // a local standard time; you have not yet entered DST.
-        dstStart = config.dstStart.calculate(&dstStartTimeInfo, config.standardHMS);
-
-        // Calculate start of standard time. Same for the second parameter here, when entering standard time
-        // you are leaving DST. For example you leave DST at 2 AM EDT (-0400) so that's the adjustment to UTC.
-        standardStart = config.standardStart.calculate(&standardStartTimeInfo, config.dstHMS);
-
-        if (dstStart < standardStart) {
-            // Northern Hemisphere, DST is in summer
-            if (time < dstStart) {
-                // Before the start of DST this year
-                position = Position::BEFORE_DST;
+int LocalTimeScheduleIndex::DateClass::nextValidDay(int days, int endDays) const {
+    if (dateType == DateType::DAYS) {
+        while(days <= endDays) {
+            // Next day of the week in the mask, or only on date, whichever is first
+            int next = INVALID_DAYS;
+            if (dayOfWeekMask) {
+                int dayOfWeek = LocalTime::dayOfWeekFromDays(days);
+                for(int ii = 0; ii < 7; ii++) {
+                    if (dayOfWeekMask & (1 << ((dayOfWeek + ii) % 7))) {
+                        next = days + ii;
+                        break;
+                    }
+                }
             }
-            else if (time < standardStart) {
-                // In DST, before the end of DST in this year
-                position = Position::IN_DST;
+            auto it = std::lower_bound(onlyOnDays.begin(), onlyOnDays.end(), days);
+            if (it != onlyOnDays.end() && *it < next) {
+                next = *it;
             }
-            else {
-                // After the end of DST in this year
-                position = Position::AFTER_DST;
+            if (next > endDays) {
+                break;
             }
+            if (!std::binary_search(exceptDays.begin(), exceptDays.end(), next)) {
+                return next;
+            }
+            days = next + 1;
         }
-        else {
-            // Southern Hemisphere: DST runs from October/November through the 
-            // turn of the year, into March/April. There's a different set of
-            // position variables for this.
-            if (time < standardStart) {
-                // Before the start of standard time this year
-                position = Position::BEFORE_STANDARD;
+        return INVALID_DAYS;
+    }
+
+    // DAY_OF_MONTH and DAY_OF_WEEK_OF_MONTH have at most one day per month
+    int year, month, day;
+    LocalTime::civilFromDays(days, &year, &month, &day);
+    while(true) {
+        int firstOfMonth = LocalTime::daysFromCivil(year, month, 1);
+        if (firstOfMonth > endDays) {
+            break;
+        }
+
+        int dayOfMonth = 0;
+        if (dateType == DateType::DAY_OF_MONTH) {
+            int lastDay = LocalTime::lastDayOfMonth(year, month);
+            if (ordinal > 0 && ordinal <= lastDay) {
+                dayOfMonth = ordinal;
             }
-            else if (time < dstStart) {
-                // 
-                position = Position::IN_STANDARD;
+            else
+            if (ordinal < 0 && lastDay + ordinal + 1 >= 1) {
+                // -1 is the last day of the month
+                dayOfMonth = lastDay + ordinal + 1;
             }
-            else {
-                position = Position::AFTER_STANDARD;
+        }
+        else {
+            dayOfMonth = LocalTime::dayOfWeekOfMonth(year, month, dayOfWeek, ordinal);
+        }
+
+        if (dayOfMonth > 0) {
+            int curDays = firstOfMonth + dayOfMonth - 1;
+            if (curDays > endDays) {
+                break;
+            }
+            if (curDays >= days && isValidDay(curDays)) {
+                return curDays;
             }
+        }
 
+        if (++month > 12) {
+            month = 1;
+            year++;
         }
+    }
+    return INVALID_DAYS;
+}
+
+
+//
+// LocalTimeScheduler
+//
+
+LocalTimeScheduler::LocalTimeScheduler() : config(LocalTime::instance().getConfig()) {
+}
 
+LocalTimeScheduler::ScheduleId LocalTimeScheduler::add(const LocalTimeSchedule &schedule, time_t timeNow) {
+    ScheduleId id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
     }
     else {
-        // Just timezones, no DST
-        position = Position::NO_DST;
+        if (entries.size() >= INVALID_ID) {
+            return INVALID_ID;
+        }
+        id = (ScheduleId) entries.size();
+        entries.emplace_back();
+    }
+    entries[id].inUse = true;
+
+    update(id, schedule, timeNow);
+    return id;
+}
+
+bool LocalTimeScheduler::update(ScheduleId id, const LocalTimeSchedule &schedule, time_t timeNow) {
+    if (!isValid(id)) {
+        return false;
     }
-    if (!isDST()) {
-        LocalTime::timeToTm(time - config.standardHMS.toSeconds(), &localTimeValue);
+    Entry &entry = entries[id];
+    entry.index.compile(schedule);
+    // The registry's config is shared, so the entry uses its own copy and transition cache
+    const LocalTimePosixTimezone *zoneConfig = (schedule.zone != LocalTimeZoneRegistry::INVALID_HANDLE) ? LocalTimeZoneRegistry::instance().getConfig(schedule.zone) : NULL;
+    if (zoneConfig) {
+        entry.zoneConfig = *zoneConfig;
     }
     else {
-        LocalTime::timeToTm(time - config.dstHMS.toSeconds(), &localTimeValue);
+        entry.zoneConfig = LocalTimePosixTimezone();
     }
 
+    scheduleEntry(id, timeNow);
+    return true;
 }
-void LocalTimeConvert::addSeconds(int seconds) {
-    time += seconds;
-    convert();
+
+bool LocalTimeScheduler::remove(ScheduleId id) {
+    if (!isValid(id)) {
+        return false;
+    }
+    removeFromHeap(id);
+
+    Entry &entry = entries[id];
+    entry.index.clear();
+    entry.zoneConfig = LocalTimePosixTimezone();
+    entry.inUse = false;
+    freeIds.push_back(id);
+    return true;
 }
 
-void LocalTimeConvert::nextMinuteMultiple(int increment, int startingModulo) {
-    time += increment * 60;
+void LocalTimeScheduler::clear() {
+    entries.clear();
+    freeIds.clear();
+    heap.clear();
+}
 
-    struct tm timeInfo;
+void LocalTimeScheduler::reschedule(time_t timeNow) {
+    // Rebuilding the heap from scratch is O(n), instead of n updates at O(log n)
+    heap.clear();
+    for(ScheduleId id = 0; id < entries.size(); id++) {
+        entries[id].heapIndex = NOT_IN_HEAP;
+        if (entries[id].inUse) {
+            scheduleEntry(id, timeNow);
+        }
+    }
+}
 
-    LocalTime::timeToTm(time, &timeInfo);
+time_t LocalTimeScheduler::peekNext(ScheduleId *pId) const {
+    if (heap.empty()) {
+        return 0;
+    }
+    if (pId) {
+        *pId = heap.front().id;
+    }
+    return heap.front().time;
+}
 
-    timeInfo.tm_min -= ((timeInfo.tm_min - startingModulo) % increment);
-    timeInfo.tm_sec = 0;
+bool LocalTimeScheduler::popDue(time_t timeNow, ScheduleId &id, time_t &time) {
+    while(!heap.empty() && heap.front().time <= timeNow) {
+        HeapItem item = heap.front();
+        bool isCheck = entries[item.id].isCheck;
 
-    time = LocalTime::tmToTime(&timeInfo);
+        scheduleEntry(item.id, timeNow);
 
-    convert();
+        if (!isCheck) {
+            id = item.id;
+            time = item.time;
+            return true;
+        }
+    }
+    return false;
 }
 
+size_t LocalTimeScheduler::popDue(time_t timeNow, std::function<void(ScheduleId id, time_t time)> callback) {
+    size_t count = 0;
 
-void LocalTimeConvert::nextTimeList(std::initializer_list<LocalTimeHMS> _hmsList) {
-    std::vector<LocalTimeHMS> hmsList = _hmsList;
+    ScheduleId id;
+    time_t time;
+    while(popDue(timeNow, id, time)) {
+        callback(id, time);
+        count++;
+    }
+    return count;
+}
 
-    time_t origTime = time;
+void LocalTimeScheduler::scheduleEntry(ScheduleId id, time_t timeNow) {
+    Entry &entry = entries[id];
+
+    HeapItem item;
+    item.id = id;
+    item.time = 0;
+    entry.isCheck = false;
+
+    if (!entry.index.isEmpty()) {
+        item.time = entry.index.getNextScheduledTime(entry.zoneConfig.isValid() ? entry.zoneConfig : config, timeNow);
+        if (item.time == 0) {
+            // Nothing within the lookahead period. Schedules with only on dates may have a time 
+            // after that, so check again at the end of the period.
+            int lookaheadDays = std::max(LocalTime::instance().getScheduleLookaheadDays(), 1);
+            item.time = timeNow + (time_t)lookaheadDays * LocalTimeScheduleIndex::SECONDS_PER_DAY;
+            entry.isCheck = true;
+        }
+    }
 
-    nextDay();
-    time_t resultTime = time;
-    time = origTime;
-    convert();
+    if (item.time == 0) {
+        removeFromHeap(id);
+    }
+    else if (entry.heapIndex == NOT_IN_HEAP) {
+        heap.push_back(item);
+        setHeapItem(heap.size() - 1, item);
+        siftUp(heap.size() - 1);
+    }
+    else {
+        // The new time can be earlier (update) or later (fired)
+        size_t index = entry.heapIndex;
+        setHeapItem(index, item);
+        siftUp(index);
+        siftDown(entries[id].heapIndex);
+    }
+}
 
-    for(auto it = hmsList.begin(); it != hmsList.end(); ++it) {
-        LocalTimeHMS hms = *it;
+void LocalTimeScheduler::removeFromHeap(ScheduleId id) {
+    size_t index = entries[id].heapIndex;
+    if (index == NOT_IN_HEAP) {
+        return;
+    }
+    entries[id].heapIndex = NOT_IN_HEAP;
+
+    HeapItem last = heap.back();
+    heap.pop_back();
+    if (index < heap.size()) {
+        setHeapItem(index, last);
+        siftUp(index);
+        siftDown(entries[last.id].heapIndex);
+    }
+}
+
+void LocalTimeScheduler::siftUp(size_t index) {
+    HeapItem item = heap[index];
+    while(index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!(item < heap[parent])) {
+            break;
+        }
+        setHeapItem(index, heap[parent]);
+        index = parent;
+    }
+    setHeapItem(index, item);
+}
+
+void LocalTimeScheduler::siftDown(size_t index) {
+    HeapItem item = heap[index];
+    size_t size = heap.size();
+    while(true) {
+        size_t child = index * 2 + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && heap[child + 1] < heap[child]) {
+            child++;
+        }
+        if (!(heap[child] < item)) {
+            break;
+        }
+        setHeapItem(index, heap[child]);
+        index = child;
+    }
+    setHeapItem(index, item);
+}
+
+
+//
+// LocalTimeTimingWheel
+//
+
+LocalTimeTimingWheel::LocalTimeTimingWheel() : config(LocalTime::instance().getConfig()), slots(NUM_SLOTS, (ScheduleId)INVALID_ID) {
+}
+
+LocalTimeTimingWheel::ScheduleId LocalTimeTimingWheel::add(const LocalTimeSchedule &schedule, time_t timeNow) {
+    ScheduleId id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    }
+    else {
+        if (entries.size() >= INVALID_ID) {
+            return INVALID_ID;
+        }
+        id = (ScheduleId) entries.size();
+        entries.emplace_back();
+    }
+    entries[id].schedule = &schedule;
+
+    if (nextTick == 0) {
+        nextTick = timeNow + 1;
+    }
+    scheduleEntry(id, timeNow);
+    return id;
+}
+
+bool LocalTimeTimingWheel::update(ScheduleId id, time_t timeNow) {
+    if (!isValid(id)) {
+        return false;
+    }
+    scheduleEntry(id, timeNow);
+    return true;
+}
+
+bool LocalTimeTimingWheel::update(ScheduleId id, const LocalTimeSchedule &schedule, time_t timeNow) {
+    if (!isValid(id)) {
+        return false;
+    }
+    entries[id].schedule = &schedule;
+    scheduleEntry(id, timeNow);
+    return true;
+}
+
+bool LocalTimeTimingWheel::remove(ScheduleId id) {
+    if (!isValid(id)) {
+        return false;
+    }
+    unlinkEntry(id);
+    entries[id].schedule = NULL;
+    freeIds.push_back(id);
+    return true;
+}
+
+void LocalTimeTimingWheel::clear() {
+    entries.clear();
+    freeIds.clear();
+    std::fill(slots.begin(), slots.end(), (ScheduleId)INVALID_ID);
+    nextTick = 0;
+}
+
+size_t LocalTimeTimingWheel::advance(time_t timeNow, std::function<void(ScheduleId id, time_t time)> callback) {
+    if (nextTick == 0) {
+        nextTick = timeNow + 1;
+        return 0;
+    }
+
+    // Expire everything with a time < target. Each wheel holds times within the current unit of the
+    // next coarser wheel, so at the start of a day, hour, or minute that ends before target, all of
+    // the finer wheels and the slot for that unit can be expired without cascading.
+    time_t target = timeNow + 1;
+    due.clear();
+    while(nextTick < target) {
+        if (nextTick % 86400 == 0) {
+            time_t day = nextTick / 86400;
+            if (day % DAY_SLOTS == 0) {
+                cascadeSlot(OVERFLOW_SLOT);
+            }
+            if (target - nextTick >= 86400) {
+                expireSlot(DAY_SLOT_OFFSET + (uint32_t)(day % DAY_SLOTS));
+                expireSlots(0, DAY_SLOT_OFFSET - 1);
+                nextTick += 86400;
+                continue;
+            }
+            cascadeSlot(DAY_SLOT_OFFSET + (uint32_t)(day % DAY_SLOTS));
+        }
+        if (nextTick % 3600 == 0) {
+            uint32_t slot = HOUR_SLOT_OFFSET + (uint32_t)((nextTick / 3600) % HOUR_SLOTS);
+            if (target - nextTick >= 3600) {
+                expireSlot(slot);
+                expireSlots(0, HOUR_SLOT_OFFSET - 1);
+                nextTick += 3600;
+                continue;
+            }
+            cascadeSlot(slot);
+        }
+        if (nextTick % 60 == 0) {
+            uint32_t slot = MINUTE_SLOT_OFFSET + (uint32_t)((nextTick / 60) % MINUTE_SLOTS);
+            if (target - nextTick >= 60) {
+                expireSlot(slot);
+                expireSlots(0, MINUTE_SLOT_OFFSET - 1);
+                nextTick += 60;
+                continue;
+            }
+            cascadeSlot(slot);
+        }
+        expireSlot((uint32_t)(nextTick % SECOND_SLOTS));
+        nextTick++;
+    }
+
+    std::sort(due.begin(), due.end());
+
+    size_t count = 0;
+    for(auto it = due.begin(); it != due.end(); ++it) {
+        if (!entries[it->second].isCheck) {
+            callback(it->second, it->first);
+            count++;
+        }
+        scheduleEntry(it->second, timeNow);
+    }
+    return count;
+}
+
+void LocalTimeTimingWheel::scheduleEntry(ScheduleId id, time_t timeNow) {
+    Entry &entry = entries[id];
+    unlinkEntry(id);
+
+    LocalTimeConvert conv;
+    if (entry.schedule->zone != LocalTimeZoneRegistry::INVALID_HANDLE) {
+        conv.withZone(entry.schedule->zone);
+    }
+    else {
+        conv.withConfig(config);
+    }
+    conv.withTime(timeNow).convert();
+
+    entry.isCheck = false;
+    if (entry.schedule->getNextScheduledTime(conv)) {
+        entry.time = conv.time;
+    }
+    else if (!entry.schedule->isEmpty()) {
+        // Nothing within the lookahead period, check again at the end of the period
+        int lookaheadDays = std::max(LocalTime::instance().getScheduleLookaheadDays(), 1);
+        entry.time = timeNow + (time_t)lookaheadDays * 86400;
+        entry.isCheck = true;
+    }
+    else {
+        return;
+    }
+    insertEntry(id);
+}
+
+void LocalTimeTimingWheel::insertEntry(ScheduleId id) {
+    Entry &entry = entries[id];
+    entry.slot = slotForTime(entry.time);
+    entry.prev = INVALID_ID;
+    entry.next = slots[entry.slot];
+    if (entry.next != INVALID_ID) {
+        entries[entry.next].prev = id;
+    }
+    slots[entry.slot] = id;
+}
+
+void LocalTimeTimingWheel::unlinkEntry(ScheduleId id) {
+    Entry &entry = entries[id];
+    if (entry.slot == NO_SLOT) {
+        return;
+    }
+    if (entry.prev != INVALID_ID) {
+        entries[entry.prev].next = entry.next;
+    }
+    else {
+        slots[entry.slot] = entry.next;
+    }
+    if (entry.next != INVALID_ID) {
+        entries[entry.next].prev = entry.prev;
+    }
+    entry.slot = NO_SLOT;
+}
+
+uint32_t LocalTimeTimingWheel::slotForTime(time_t time) const {
+    // Times that have already passed are due on the next advance()
+    if (time < nextTick) {
+        time = nextTick;
+    }
+
+    if (time / 60 == nextTick / 60) {
+        return (uint32_t)(time % SECOND_SLOTS);
+    }
+    if (time / 3600 == nextTick / 3600) {
+        return MINUTE_SLOT_OFFSET + (uint32_t)((time / 60) % MINUTE_SLOTS);
+    }
+    if (time / 86400 == nextTick / 86400) {
+        return HOUR_SLOT_OFFSET + (uint32_t)((time / 3600) % HOUR_SLOTS);
+    }
+    if (time / 86400 - nextTick / 86400 < DAY_SLOTS) {
+        return DAY_SLOT_OFFSET + (uint32_t)((time / 86400) % DAY_SLOTS);
+    }
+    return OVERFLOW_SLOT;
+}
+
+void LocalTimeTimingWheel::expireSlot(uint32_t slot) {
+    ScheduleId id = slots[slot];
+    slots[slot] = INVALID_ID;
+    while(id != INVALID_ID) {
+        Entry &entry = entries[id];
+        due.push_back(std::make_pair(entry.time, id));
+        entry.slot = NO_SLOT;
+        id = entry.next;
+    }
+}
+
+void LocalTimeTimingWheel::expireSlots(uint32_t first, uint32_t last) {
+    for(uint32_t slot = first; slot <= last; slot++) {
+        if (slots[slot] != INVALID_ID) {
+            expireSlot(slot);
+        }
+    }
+}
+
+void LocalTimeTimingWheel::cascadeSlot(uint32_t slot) {
+    ScheduleId id = slots[slot];
+    slots[slot] = INVALID_ID;
+    while(id != INVALID_ID) {
+        ScheduleId next = entries[id].next;
+        insertEntry(id);
+        id = next;
+    }
+}
+
+
+//
+// LocalTimeScheduleManager
+//
+
+time_t LocalTimeScheduleManager::getNextTimeByName(const char *name, const LocalTimeConvert &conv) {
+    for(auto it = schedules.begin(); it != schedules.end(); ++it) {
+        if (it->name.equals(name)) {
+            LocalTimeConvert tempConv(conv);
+            if (it->getNextScheduledTime(tempConv)) {
+
+            }
+        }
+    }
+    return 0;
+}
+
+time_t LocalTimeScheduleManager::getNextWake(const LocalTimeConvert &conv) const {
+    time_t nextTime = 0;
+
+    for(auto it = schedules.begin(); it != schedules.end(); ++it) {
+        if ((it->flags & LocalTimeSchedule::FLAG_ANY_WAKE) != 0) {
+            LocalTimeConvert tempConv(conv);
+            if (it->getNextScheduledTime(tempConv)) {
+                if (nextTime == 0 || tempConv.time < nextTime) {
+                    nextTime = tempConv.time;
+                }
+            }
+        }
+    }
+    return nextTime;
+}
+
+time_t LocalTimeScheduleManager::getNextFullWake(const LocalTimeConvert &conv) const {
+    time_t nextTime = 0;
+
+    for(auto it = schedules.begin(); it != schedules.end(); ++it) {
+        if ((it->flags & LocalTimeSchedule::FLAG_FULL_WAKE) != 0) {
+            LocalTimeConvert tempConv(conv);
+            if (it->getNextScheduledTime(tempConv)) {
+                if (nextTime == 0 || tempConv.time < nextTime) {
+                    nextTime = tempConv.time;
+                }
+            }
+        }
+    }
+    return nextTime;
+}
+
+time_t LocalTimeScheduleManager::getNextDataCapture(const LocalTimeConvert &conv) const {
+    time_t nextTime = 0;
+
+    for(auto it = schedules.begin(); it != schedules.end(); ++it) {
+        if (it->name.equals("data")) {
+            LocalTimeConvert tempConv(conv);
+            if (it->getNextScheduledTime(tempConv)) {
+                if (nextTime == 0 || tempConv.time < nextTime) {
+                    nextTime = tempConv.time;
+                }
+            }
+        }
+    }
+    return nextTime;
+}
+
+
+void LocalTimeScheduleManager::forEach(std::function<void(LocalTimeSchedule &schedule)> callback) {
+    for(auto it = schedules.begin(); it != schedules.end(); ++it) {
+        callback(*it);
+    }
+}
+
+LocalTimeSchedule &LocalTimeScheduleManager::getScheduleByName(const char *name) {
+
+    for(auto it = schedules.begin(); it != schedules.end(); ++it) {
+        if (it->name.equals(name)) {
+            return *it;
+        }
+    }
+
+    LocalTimeSchedule sch;
+    sch.name = name;
+    schedules.push_back(sch);
+
+    return getScheduleByName(name);
+}
+
+
+void LocalTimeScheduleManager::setFromJsonObject(const JSONValue &jsonObj) {
+    JSONObjectIterator iter(jsonObj);
+    while(iter.next()) {
+        String key = (const char *)iter.name();
+
+        for(auto it = schedules.begin(); it != schedules.end(); ++it) {
+            if (it->name.equals(key)) {
+                it->fromJson(iter.value());
+            }
+        }
+    }
+}
+
+
+//
+// LocalTimeRange
+// 
+
+time_t LocalTimeRange::getTimeSpan(const LocalTimeConvert &conv) const {
+    
+    LocalTimeConvert convStart(conv);
+    convStart.atLocalTime(hmsStart);
+
+    LocalTimeConvert convEnd(conv);
+    convEnd.atLocalTime(hmsEnd);
+
+    if (!rangeCrossesMidnight()) {
+        return convEnd.time - convStart.time;
+    }
+    else {        
+        convEnd.nextDay();
+        return convEnd.time - convStart.time;
+    }
+}
+
+
+void LocalTimeRange::fromJson(JSONValue jsonObj) {    
+    JSONObjectIterator iter(jsonObj);
+    while(iter.next()) {
+        String key = (const char *)iter.name();
+
+        if (key == "s" || key == "e") {
+            String hmsStr = iter.value().toString().data();
+
+            if (key == "s") {
+                hmsStart = LocalTimeHMS(hmsStr);
+            }
+            else
+            if (key == "e") {
+                hmsEnd = LocalTimeHMS(hmsStr);
+            }
+        }
+    }
+    LocalTimeRestrictedDate::fromJson(jsonObj);
+}
+
+
+
+//
+// LocalTimeConvert
+//
+void LocalTimeConvert::convert() {
+    if (time >= segmentStart && time < segmentEnd) {
+        // Same offset, position, and transitions as the last conversion, so only
+        // the local time needs to be updated
+        setLocalTime(time + segmentOffset);
+        return;
+    }
+
+    if (transitionTable) {
+        int index = transitionTable->find(time);
+        if (index >= 0) {
+            const LocalTimeTransitionTable::Type &type = transitionTable->getType(index);
+
+            position = (Position) type.position;
+            if (position != Position::NO_DST) {
+                time_t tableDstStart, tableStandardStart;
+                transitionTable->getTransitions(index, &tableDstStart, &tableStandardStart);
+
+                // These only change once a year, so skip the conversion when they're the same
+                if (tableDstStart != dstStart || tableStandardStart != standardStart) {
+                    dstStart = tableDstStart;
+                    standardStart = tableStandardStart;
+                    LocalTime::timeToTm(dstStart, &dstStartTimeInfo);
+                    LocalTime::timeToTm(standardStart, &standardStartTimeInfo);
+                }
+            }
+            segmentStart = transitionTable->times[index];
+            segmentEnd = ((size_t)index + 1 < transitionTable->size()) ? transitionTable->times[index + 1] : transitionTable->rangeEnd;
+            segmentOffset = type.offset;
+            setLocalTime(time + segmentOffset);
+            return;
+        }
+        // Outside of the table, use the rules in config
+    }
+
+    if (!config.isValid()) {
+        config = LocalTime::instance().getConfig();
+    }
+
+    if (!config.hasDST()) {
+        // Fixed offset zone: no transitions to evaluate, same as LocalTimeFixedOffsetConvert
+        position = Position::NO_DST;
+        if (config.isValid()) {
+            segmentStart = std::numeric_limits<time_t>::min();
+            segmentEnd = std::numeric_limits<time_t>::max();
+        }
+        else {
+            // The global config hasn't been set yet. Don't keep a segment, so the next
+            // conversion checks the global config again.
+            segmentStart = segmentEnd = 0;
+        }
+        segmentOffset = config.getOffset(false);
+        setLocalTime(time + segmentOffset);
+        return;
+    }
+
+    // We need to worry about daylight saving time. The config is this object's own 
+    // copy, so its transition cache can be used.
+    struct tm timeInfo;
+    LocalTime::timeToTm(time, &timeInfo);
+
+    config.getTransitions(timeInfo.tm_year, &dstStart, &standardStart);
+
+    LocalTimeConversion conversion;
+    conversion.withConfig(&config).withTime(time);
+    conversion.offsetFromTransitions(config, timeInfo.tm_year, dstStart, standardStart);
+
+    position = conversion.position;
+    segmentStart = conversion.segmentStart;
+    segmentEnd = conversion.segmentEnd;
+    segmentOffset = conversion.offset;
+
+    LocalTime::timeToTm(dstStart, &dstStartTimeInfo);
+    LocalTime::timeToTm(standardStart, &standardStartTimeInfo);
+
+    setLocalTime(time + segmentOffset);
+}
+
+void LocalTimeConvert::invalidateSegment() {
+    segmentStart = segmentEnd = 0;
+}
+
+LocalTimeConvert &LocalTimeConvert::withZone(LocalTimeZoneHandle zone, const LocalTimeZoneRegistry &registry) {
+    const LocalTimeTransitionTable *table = registry.getTransitionTable(zone);
+    if (table) {
+        return withTransitionTable(table);
+    }
+    else {
+        return withConfig(LocalTimePosixTimezone());
+    }
+}
+
+void LocalTimeConvert::setLocalTime(time_t localTime) {
+    if (localTime >= localDayStart && localTime < localDayStart + 86400 &&
+        localTimeValue.tm_mday == localDayMonthDay && localTimeValue.tm_mon == localDayMonth && localTimeValue.tm_year == localDayYear) {
+        // Same local day as the last conversion, only the time of day changes
+        int secondOfDay = (int)(localTime - localDayStart);
+        localTimeValue.tm_hour = secondOfDay / 3600;
+        localTimeValue.tm_min = (secondOfDay / 60) % 60;
+        localTimeValue.tm_sec = secondOfDay % 60;
+        return;
+    }
+
+    LocalTime::timeToTm(localTime, &localTimeValue);
+
+    localDayStart = localTime - (localTimeValue.tm_hour * 3600 + localTimeValue.tm_min * 60 + localTimeValue.tm_sec);
+    localDayYear = localTimeValue.tm_year;
+    localDayMonth = localTimeValue.tm_mon;
+    localDayMonthDay = localTimeValue.tm_mday;
+}
+
+void LocalTimeConvert::addSeconds(int seconds) {
+    time += seconds;
+    convert();
+}
+
+void LocalTimeConvert::nextMinuteMultiple(int increment, int startingModulo) {
+    time += increment * 60;
+
+    struct tm timeInfo;
+
+    LocalTime::timeToTm(time, &timeInfo);
+
+    timeInfo.tm_min -= ((timeInfo.tm_min - startingModulo) % increment);
+    timeInfo.tm_sec = 0;
+
+    time = LocalTime::tmToTime(&timeInfo);
+
+    convert();
+}
+
+
+void LocalTimeConvert::nextTimeList(std::initializer_list<LocalTimeHMS> _hmsList) {
+    std::vector<LocalTimeHMS> hmsList = _hmsList;
+
+    time_t origTime = time;
+
+    nextDay();
+    time_t resultTime = time;
+    time = origTime;
+    convert();
+
+    for(auto it = hmsList.begin(); it != hmsList.end(); ++it) {
+        LocalTimeHMS hms = *it;
+
+        nextTime(hms);
+        if (time > origTime && time < resultTime) {
+            resultTime = time;
+        }
+
+        // Restore original time
+        time = origTime;
+        convert();
+    }
+
+    time = resultTime;
+    convert();
+}
+
+// nextTime is used by nextDayMidnight with a HMS of 00:00:00
+
+void LocalTimeConvert::nextTime(LocalTimeHMS hms) {
+    time_t origTime = time;
+
+    localTimeValue.setHMS(hms);
+    time = localTimeValue.toUTC(config);
+    convert();
+
+    if (time <= origTime) {
+        // Day rolled backwards, so move back forward
+        localTimeValue.tm_mday++;
+        time = localTimeValue.toUTC(config);
+        convert();
+    }
+}
+
+void LocalTimeConvert::prevDay(LocalTimeHMS hms) {
+    time_t origTime = time;
+
+    localTimeValue.setHMS(hms);
+    localTimeValue.tm_mday--;
+
+    time = localTimeValue.toUTC(config);
+    convert();
+}
+
+
+void LocalTimeConvert::nextDay(LocalTimeHMS hms) {
+    time_t origTime = time;
+
+    localTimeValue.setHMS(hms);
+    localTimeValue.tm_mday++;
+
+    time = localTimeValue.toUTC(config);
+    convert();
+}
+
+void LocalTimeConvert::nextDayOrTimeChange(LocalTimeHMS hms) {
+    time_t timeOrig = time;
+    time_t dstStartOrig = dstStart;
+    time_t standardStartOrig = standardStart;
+
+    nextDay(hms);
+
+    if (dstStartOrig > timeOrig && dstStartOrig < time) {
+        time = dstStartOrig;
+        convert();
+    }
+    if (standardStartOrig > timeOrig && standardStartOrig < time) {
+        time = standardStartOrig;
+        convert();
+    }
+}   
+
+
+bool LocalTimeConvert::nextDayOfWeek(int dayOfWeek, LocalTimeHMS hms) {
+    if (dayOfWeek < 0 || dayOfWeek > 6) {
+        return false;
+    }
+
+    do {
+        nextDay(hms);
+    } while(localTimeValue.tm_wday != dayOfWeek);
+
+    return true;
+}
+
+void LocalTimeConvert::nextWeekday(LocalTimeHMS hms) {
+    do {
+        nextDay(hms);
+    } while(localTimeValue.tm_wday == 0 || localTimeValue.tm_wday == 6);
+}
+
+void LocalTimeConvert::nextWeekendDay(LocalTimeHMS hms) {
+    do {
+        nextDay(hms);
+    } while(localTimeValue.tm_wday != 0 && localTimeValue.tm_wday != 6);
+}
+
+bool LocalTimeConvert::nextDayOfMonth(int dayOfMonth, LocalTimeHMS hms) {
+    time_t origTime = time;
+
+    localTimeValue.tm_mday = (dayOfMonth > 0) ? dayOfMonth : (lastDayOfMonth() + dayOfMonth);
+    localTimeValue.setHMS(hms);
+    time = localTimeValue.toUTC(config);
+    convert();
+
+    if (time <= origTime) {
+        // The target dayOfMonth and time is before the original time, so move to next month
+        localTimeValue.tm_mon++;
+        time = localTimeValue.toUTC(config);
+        convert();
+    }
+    return true;
+}
+
+
+bool LocalTimeConvert::nextDayOfNextMonth(int dayOfMonth, LocalTimeHMS hms) {
+    localTimeValue.tm_mon++;
+    localTimeValue.tm_mday = (dayOfMonth > 0) ? dayOfMonth : (lastDayOfMonth() + dayOfMonth);
+    localTimeValue.setHMS(hms);
+    time = localTimeValue.toUTC(config);
+    convert();
+    return true;
+}
+
+bool LocalTimeConvert::nextDayOfWeekOrdinal(int dayOfWeek, int ordinal, LocalTimeHMS hms) {
+    for(int tries = 0; tries < 52; tries++) {
+        nextDayOfWeek(dayOfWeek, hms);
+        if (localTimeValue.ordinal() == ordinal) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void LocalTimeConvert::nextLocalTime(LocalTimeHMS hms) {
+    time_t origTime = time;
+    localTimeValue.setHMS(hms);
+    time = localTimeValue.toUTC(config);
+    convert();
+
+    if (time <= origTime) {
+        // Need to move to tomorrow
+        nextDay(hms);
+    }
+}
+
+bool LocalTimeConvert::nextSchedule(const LocalTimeSchedule &schedule) {
+
+    return schedule.getNextScheduledTime(*this);
+}
+
+
+void LocalTimeConvert::atLocalTime(LocalTimeHMS hms) {
+    if (!hms.ignore) {
+        localTimeValue.setHMS(hms);
+        time = localTimeValue.toUTC(config);
+        convert();
+    }
+}
+
+
+String LocalTimeConvert::timeStr() {
+    char buf[TIME_STR_SIZE];
+    timeStr(buf, sizeof(buf));
+    return String(buf);
+}
+
+size_t LocalTimeConvert::timeStr(char *buf, size_t bufSize) const {
+    char ascstr[26];
+    asctime_r(&localTimeValue, ascstr);
+    size_t len = strlen(ascstr) - 1; // remove final newline
+
+    return copyToBuffer(ascstr, len, buf, bufSize);
+}
+
+String LocalTimeConvert::format(const char* format_spec) {
+    char buf[64];
+
+    size_t len = format(format_spec, buf, sizeof(buf));
+    if (len < sizeof(buf)) {
+        return String(buf);
+    }
+    
+    // Did not fit in the stack buffer
+    char *largeBuf = new char[len + 1];
+    format(format_spec, largeBuf, len + 1);
+    String result(largeBuf);
+    delete[] largeBuf;
+    return result;
+}
+
+size_t LocalTimeConvert::format(const char *formatSpec, char *buf, size_t bufSize) const {
+    BufferContext context = { buf, bufSize, 0 };
+
+    size_t len = format(formatSpec, bufferCallback, &context);
+    if (bufSize > 0) {
+        buf[std::min(len, bufSize - 1)] = 0;
+    }
+    return len;
+}
+
+size_t LocalTimeConvert::format(const char *formatSpec, FormatCallback callback, void *context) const {
+    if (!formatSpec || !strcmp(formatSpec, TIME_FORMAT_DEFAULT)) {
+        char buf[TIME_STR_SIZE];
+        size_t len = timeStr(buf, sizeof(buf));
+        callback(context, buf, len);
+        return len;
+    }
+
+    size_t len = 0;
+    const char *cp = formatSpec;
+    while(*cp) {
+        // Literal text up to the next conversion
+        const char *literal = cp;
+        while(*cp && *cp != '%') {
+            cp++;
+        }
+        if (cp > literal) {
+            callback(context, literal, cp - literal);
+            len += cp - literal;
+        }
+        if (!*cp) {
+            break;
+        }
+
+        // A conversion is % followed by optional flags and width, an optional E or O modifier, and a letter
+        const char *conversion = cp++;
+        while(*cp && !isalpha((unsigned char)*cp) && *cp != '%') {
+            cp++;
+        }
+        if (*cp == 'E' || *cp == 'O') {
+            cp++;
+        }
+        if (*cp) {
+            cp++;
+        }
+
+        size_t conversionLen = cp - conversion;
+        char buf[64];
+        size_t bufLen;
+
+        if (conversionLen == 2 && conversion[1] == 'z') {
+            // The standard library does not know the timezone, so %z and %Z are done here
+            bufLen = zoneOffsetStr(buf, sizeof(buf));
+        }
+        else
+        if (conversionLen == 2 && conversion[1] == 'Z') {
+            bufLen = copyToBuffer(getZoneName(), strlen(getZoneName()), buf, sizeof(buf));
+        }
+        else
+        if (conversionLen < sizeof(buf)) {
+            char spec[sizeof(buf)];
+            memcpy(spec, conversion, conversionLen);
+            spec[conversionLen] = 0;
+            bufLen = strftime(buf, sizeof(buf), spec, &localTimeValue);
+        }
+        else {
+            bufLen = 0;
+        }
+
+        callback(context, buf, bufLen);
+        len += bufLen;
+    }
+    return len;
+}
+
+size_t LocalTimeConvert::zoneOffsetStr(char *buf, size_t bufSize) const {
+    if (config.isZ()) {
+        return copyToBuffer("Z", 1, buf, bufSize);
+    }
+    else {
+        int time_zone = isDST() ? config.dstHMS.toSeconds() : config.standardHMS.toSeconds();
+
+        return snprintf(buf, bufSize, "%+03d:%02u", -time_zone/3600, abs(time_zone/60)%60);
+    }
+}
+
+String LocalTimeConvert::zoneName() const { 
+    return getZoneName();
+};
+
+const char *LocalTimeConvert::getZoneName() const { 
+    if (config.isZ()) {
+        return "Z";
+    }
+    else
+    if (isDST()) {
+        return config.dstName.c_str();
+    }
+    else {
+        return config.standardName.c_str();
+    }
+};
+
+// [static]
+void LocalTimeConvert::bufferCallback(void *context, const char *str, size_t len) {
+    BufferContext *bufferContext = (BufferContext *)context;
+
+    if (bufferContext->len < bufferContext->bufSize) {
+        size_t room = bufferContext->bufSize - bufferContext->len;
+        memcpy(&bufferContext->buf[bufferContext->len], str, std::min(len, room));
+    }
+    bufferContext->len += len;
+}
+
+// [static]
+size_t LocalTimeConvert::copyToBuffer(const char *str, size_t len, char *buf, size_t bufSize) {
+    if (bufSize > 0) {
+        size_t copyLen = std::min(len, bufSize - 1);
+        memcpy(buf, str, copyLen);
+        buf[copyLen] = 0;
+    }
+    return len;
+}
+
+int LocalTimeConvert::lastDayOfMonth() const {
+    return LocalTime::lastDayOfMonth(localTimeValue.tm_year + 1900, (localTimeValue.tm_mon % 12) + 1);
+}
+
+
+//
+// LocalTimeConversion
+//
+
+void LocalTimeConversion::convert() {
+    convertOffset();
+
+    struct tm timeInfo;
+    LocalTime::timeToTm(time + offset, &timeInfo);
+
+    year = (int16_t)(timeInfo.tm_year + 1900);
+    dayOfYear = (int16_t)timeInfo.tm_yday;
+    month = (int8_t)(timeInfo.tm_mon + 1);
+    day = (int8_t)timeInfo.tm_mday;
+    hour = (int8_t)timeInfo.tm_hour;
+    minute = (int8_t)timeInfo.tm_min;
+    second = (int8_t)timeInfo.tm_sec;
+    dayOfWeek = (int8_t)timeInfo.tm_wday;
+}
+
+void LocalTimeConversion::convertOffset() {
+    if (config) {
+        if (time >= segmentStart && time < segmentEnd) {
+            // Same segment as the last conversion
+            return;
+        }
+        offsetFromConfig(*config);
+        return;
+    }
+
+    // Global configuration: the segment is only reused if the configuration hasn't been
+    // replaced since it was calculated. The snapshot itself is only used with a reader, 
+    // because a replaced snapshot can be deleted.
+    if (configVersion == LocalTime::instance().getConfigVersion() && time >= segmentStart && time < segmentEnd) {
+        return;
+    }
+
+    LocalTime::ConfigReader reader;
+    configVersion = reader.getVersion();
+    offsetFromConfig(reader.getConfig());
+}
+
+void LocalTimeConversion::offsetFromConfig(const LocalTimePosixTimezone &config) {
+    if (!config.hasDST()) {
+        position = LocalTimeConvert::Position::NO_DST;
+        segmentStart = std::numeric_limits<time_t>::min();
+        segmentEnd = std::numeric_limits<time_t>::max();
+        offset = config.getOffset(false);
+        return;
+    }
+
+    int utcYear, utcMonth, utcDay;
+    LocalTime::civilFromDays((int)((time >= 0) ? (time / 86400) : ((time - 86399) / 86400)), &utcYear, &utcMonth, &utcDay);
+    utcYear -= 1900;
+
+    time_t dstStart, standardStart;
+    config.calculateTransitions(utcYear, &dstStart, &standardStart);
+    offsetFromTransitions(config, utcYear, dstStart, standardStart);
+}
+
+void LocalTimeConversion::offsetFromTransitions(const LocalTimePosixTimezone &config, int utcYear, time_t dstStart, time_t standardStart) {
+    bool dst = LocalTimePosixTimezone::segmentFromTransitions(time, utcYear, dstStart, standardStart, &segmentStart, &segmentEnd);
+    position = positionFromTransitions(time, dstStart, standardStart);
+    offset = config.getOffset(dst);
+}
+
+void LocalTimeConversion::toTimeInfo(struct tm *pTimeInfo) const {
+    LocalTime::timeToTm(localTime(), pTimeInfo);
+    pTimeInfo->tm_isdst = isDST();
+}
+
+LocalTimeValue LocalTimeConversion::getLocalTimeValue() const {
+    LocalTimeValue value;
+    LocalTime::timeToTm(localTime(), &value);
+    return value;
+}
+
+// [static]
+LocalTimeConvert::Position LocalTimeConversion::positionFromTransitions(time_t time, time_t dstStart, time_t standardStart) {
+    if (dstStart < standardStart) {
+        // Northern Hemisphere, DST is in summer
+        if (time < dstStart) {
+            // Before the start of DST this year
+            return LocalTimeConvert::Position::BEFORE_DST;
+        }
+        else if (time < standardStart) {
+            // In DST, before the end of DST in this year
+            return LocalTimeConvert::Position::IN_DST;
+        }
+        else {
+            // After the end of DST in this year
+            return LocalTimeConvert::Position::AFTER_DST;
+        }
+    }
+    else {
+        // Southern Hemisphere: DST runs from October/November through the 
+        // turn of the year, into March/April. There's a different set of
+        // position variables for this.
+        if (time < standardStart) {
+            // Before the start of standard time this year
+            return LocalTimeConvert::Position::BEFORE_STANDARD;
+        }
+        else if (time < dstStart) {
+            return LocalTimeConvert::Position::IN_STANDARD;
+        }
+        else {
+            return LocalTimeConvert::Position::AFTER_STANDARD;
+        }
+    }
+}
+
+//
+// LocalTimeCursor
+//
+LocalTimeCursor &LocalTimeCursor::advance(time_t time) {
+    this->time = time;
+    convertOffset();
+
+    int64_t local = (int64_t)time + offset;
+    int32_t days = (int32_t)(local / 86400);
+    int secondOfDay = (int)(local - (int64_t)days * 86400);
+    if (secondOfDay < 0) {
+        secondOfDay += 86400;
+        days--;
+    }
+
+    // The date fields are public and LocalTimeConversion::convert() writes them too, so they're
+    // only reused if they're still the ones set for localDays
+    if (days != localDays || day != localDayDay || month != localDayMonth || year != localDayYear) {
+        // Local date changed
+        int y, m, d;
+        LocalTime::civilFromDays(days, &y, &m, &d);
+        year = localDayYear = (int16_t)y;
+        month = localDayMonth = (int8_t)m;
+        day = localDayDay = (int8_t)d;
+        dayOfYear = (int16_t)(days - LocalTime::daysFromCivil(y, 1, 1));
+        dayOfWeek = (int8_t)LocalTime::dayOfWeekFromDays(days);
+        localDays = days;
+    }
+
+    hour = (int8_t)(secondOfDay / 3600);
+    minute = (int8_t)((secondOfDay / 60) % 60);
+    second = (int8_t)(secondOfDay % 60);
+
+    return *this;
+}
+
+//
+// LocalTimeTransitionTable
+//
+
+bool LocalTimeTransitionTable::build(const LocalTimePosixTimezone &config, int startYear, int endYear) {
+    clear();
+
+    if (!config.isValid() || startYear > endYear || (endYear - startYear) >= 65535) {
+        return false;
+    }
+
+    this->config = config;
+    this->startYear = startYear;
+    this->endYear = endYear;
+
+    time_t rangeStart = (time_t)LocalTime::daysFromCivil(startYear, 1, 1) * 86400;
+    rangeEnd = (time_t)LocalTime::daysFromCivil(endYear + 1, 1, 1) * 86400;
+
+    // The config passed in may be shared, such as the global config, so only this table's
+    // own copy is used for anything that updates the transition cache
+    if (this->config.hasDST()) {
+        yearTransitions.reserve((endYear - startYear + 1) * 2);
+        for(int year = startYear; year <= endYear; year++) {
+            time_t dstStart, standardStart;
+            this->config.getTransitions(year - 1900, &dstStart, &standardStart);
+            yearTransitions.push_back(dstStart);
+            yearTransitions.push_back(standardStart);
+        }
+        times.reserve((endYear - startYear + 1) * 3);
+    }
+
+    // Walk the same segments that convert() uses so the results are identical, 
+    // and use convert() itself to get the position in each segment
+    LocalTimeConvert conv;
+    conv.withConfig(config);
+
+    time_t time = rangeStart;
+    while(time < rangeEnd) {
+        conv.withTime(time).convert();
+
+        Type type;
+        type.offset = config.getOffset(conv.isDST());
+        type.isDST = conv.isDST();
+        type.position = (uint8_t) conv.position;
+
+        size_t ii;
+        for(ii = 0; ii < types.size(); ii++) {
+            if (types[ii].offset == type.offset && types[ii].isDST == type.isDST && types[ii].position == type.position) {
+                break;
+            }
+        }
+        if (ii == types.size()) {
+            types.push_back(type);
+        }
+
+        struct tm timeInfo;
+        LocalTime::timeToTm(time, &timeInfo);
+
+        times.push_back(time);
+        typeIndex.push_back((uint8_t) ii);
+        yearIndex.push_back((uint16_t) (timeInfo.tm_year + 1900 - startYear));
+
+        time_t segmentEnd;
+        this->config.getSegment(time, NULL, &segmentEnd);
+        time = segmentEnd;
+    }
+
+    return true;
+}
+
+void LocalTimeTransitionTable::clear() {
+    config.clear();
+    startYear = endYear = 0;
+    rangeEnd = 0;
+    times.clear();
+    typeIndex.clear();
+    yearIndex.clear();
+    types.clear();
+    yearTransitions.clear();
+}
+
+int LocalTimeTransitionTable::find(time_t time) const {
+    if (!isInRange(time)) {
+        return -1;
+    }
+
+    size_t count = times.size();
+
+    // Interpolated guess
+    size_t guess = (size_t) (((int64_t)time - (int64_t)times[0]) * (int64_t)count / ((int64_t)rangeEnd - (int64_t)times[0]));
+    if (guess >= count) {
+        guess = count - 1;
+    }
+    if (times[guess] <= time && (guess + 1 == count || time < times[guess + 1])) {
+        return (int) guess;
+    }
+
+    // Binary search for the first entry after time; the entry before it applies
+    return (int) (std::upper_bound(times.begin(), times.end(), time) - times.begin()) - 1;
+}
+
+bool LocalTimeTransitionTable::lookup(time_t time, int32_t *pOffset, bool *pIsDST) const {
+    int index = find(time);
+    if (index < 0) {
+        return false;
+    }
+    const Type &type = getType(index);
+    if (pOffset) {
+        *pOffset = type.offset;
+    }
+    if (pIsDST) {
+        *pIsDST = type.isDST;
+    }
+    return true;
+}
+
+void LocalTimeTransitionTable::getTransitions(size_t index, time_t *pDstStart, time_t *pStandardStart) const {
+    size_t year = yearIndex[index];
+
+    if (pDstStart) {
+        *pDstStart = yearTransitions[year * 2];
+    }
+    if (pStandardStart) {
+        *pStandardStart = yearTransitions[year * 2 + 1];
+    }
+}
+
+//
+// LocalTimeZoneRegistry
+//
+LocalTimeZoneRegistry::LocalTimeZoneRegistry() : count(0) {
+    for(size_t ii = 0; ii < NUM_BUCKETS; ii++) {
+        buckets[ii].store(INVALID_HANDLE, std::memory_order_relaxed);
+    }
+}
+
+LocalTimeZoneRegistry::~LocalTimeZoneRegistry() {
+    for(size_t ii = 0; ii < MAX_CHUNKS; ii++) {
+        delete[] chunks[ii];
+    }
+}
+
+// [static]
+LocalTimeZoneRegistry &LocalTimeZoneRegistry::instance() {
+    LocalTimeZoneRegistry *result = _instance.load(std::memory_order_acquire);
+    if (!result) {
+        LocalTimeZoneRegistry *newInstance = new LocalTimeZoneRegistry();
+        if (_instance.compare_exchange_strong(result, newInstance, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            result = newInstance;
+        }
+        else {
+            delete newInstance;
+        }
+    }
+    return *result;
+}
+
+LocalTimeZoneHandle LocalTimeZoneRegistry::intern(const char *tzStr) {
+    if (!tzStr) {
+        return INVALID_HANDLE;
+    }
+    uint32_t hash = hashString(tzStr);
+
+    // Strings that have already been interned are found without locking
+    LocalTimeZoneHandle handle = findHash(tzStr, hash);
+    if (handle != INVALID_HANDLE) {
+        return handle;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Check again in case another thread added it before the mutex was acquired
+    handle = findHash(tzStr, hash);
+    if (handle != INVALID_HANDLE) {
+        return handle;
+    }
+
+    LocalTimePosixTimezone config;
+    if (!config.parse(tzStr)) {
+        return INVALID_HANDLE;
+    }
+
+    // count only changes with the mutex held, so a relaxed load is sufficient here
+    size_t index = count.load(std::memory_order_relaxed);
+    if (index >= CHUNK_SIZE * MAX_CHUNKS) {
+        return INVALID_HANDLE;
+    }
+    Entry *&chunk = chunks[index / CHUNK_SIZE];
+    if (!chunk) {
+        chunk = new Entry[CHUNK_SIZE];
+    }
+
+    std::atomic<LocalTimeZoneHandle> &bucket = buckets[hash & (NUM_BUCKETS - 1)];
+
+    Entry &entry = chunk[index % CHUNK_SIZE];
+    entry.hash = hash;
+    entry.next = bucket.load(std::memory_order_relaxed);
+    entry.tzStr = tzStr;
+    if (!entry.table.build(config, startYear, endYear)) {
+        // Empty span of years, the config is still used for conversions
+        entry.table.config = config;
+    }
+
+    // Publish the entry to readers, first by handle and then in the hash bucket, so a handle
+    // from find() is always valid
+    count.store((uint16_t)(index + 1), std::memory_order_release);
+    bucket.store((LocalTimeZoneHandle)index, std::memory_order_release);
+
+    return (LocalTimeZoneHandle)index;
+}
+
+LocalTimeZoneHandle LocalTimeZoneRegistry::find(const char *tzStr) const {
+    if (!tzStr) {
+        return INVALID_HANDLE;
+    }
+    return findHash(tzStr, hashString(tzStr));
+}
+
+const LocalTimePosixTimezone *LocalTimeZoneRegistry::getConfig(LocalTimeZoneHandle handle) const {
+    if (!isValid(handle)) {
+        return NULL;
+    }
+    return &getEntry(handle).table.config;
+}
+
+const LocalTimeTransitionTable *LocalTimeZoneRegistry::getTransitionTable(LocalTimeZoneHandle handle) const {
+    if (!isValid(handle)) {
+        return NULL;
+    }
+    return &getEntry(handle).table;
+}
+
+const char *LocalTimeZoneRegistry::getString(LocalTimeZoneHandle handle) const {
+    if (!isValid(handle)) {
+        return NULL;
+    }
+    return getEntry(handle).tzStr.c_str();
+}
+
+LocalTimeZoneHandle LocalTimeZoneRegistry::findHash(const char *tzStr, uint32_t hash) const {
+    // Entries are complete before they're added to a bucket and never change after that,
+    // so the next links can be followed without any further synchronization
+    LocalTimeZoneHandle handle = buckets[hash & (NUM_BUCKETS - 1)].load(std::memory_order_acquire);
+
+    while(handle != INVALID_HANDLE) {
+        const Entry &entry = getEntry(handle);
+        if (entry.hash == hash && strcmp(entry.tzStr.c_str(), tzStr) == 0) {
+            return handle;
+        }
+        handle = entry.next;
+    }
+    return INVALID_HANDLE;
+}
+
+// [static]
+uint32_t LocalTimeZoneRegistry::hashString(const char *tzStr) {
+    uint32_t hash = 2166136261UL;
+    for(const char *cp = tzStr; *cp; cp++) {
+        hash ^= (uint8_t)*cp;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+//
+// LocalTimeBatchConvert
+//
+void LocalTimeBatchConvert::convert(const time_t *times, size_t count) {
+    if (!config.isValid()) {
+        config = LocalTime::instance().getConfig();
+    }
+    if (count == 0) {
+        return;
+    }
+
+    if (!config.hasDST()) {
+        // Fixed offset, everything is one run
+        convertRun(times, 0, count, config.getOffset(false), false);
+        return;
+    }
+
+    // Common case: all times are in the same DST segment, which is checked using
+    // the minimum and maximum times
+    time_t minTime = times[0], maxTime = times[0];
+    for(size_t ii = 1; ii < count; ii++) {
+        minTime = std::min(minTime, times[ii]);
+        maxTime = std::max(maxTime, times[ii]);
+    }
+
+    time_t segmentStart, segmentEnd;
+    bool isDST = config.getSegment(minTime, &segmentStart, &segmentEnd);
+    if (maxTime < segmentEnd) {
+        convertRun(times, 0, count, config.getOffset(isDST), isDST);
+        return;
+    }
+
+    // Times span more than one segment, so convert runs of times in the same segment
+    size_t runStart = 0;
+    while(runStart < count) {
+        isDST = config.getSegment(times[runStart], &segmentStart, &segmentEnd);
+
+        size_t runEnd = runStart + 1;
+        while(runEnd < count && times[runEnd] >= segmentStart && times[runEnd] < segmentEnd) {
+            runEnd++;
+        }
+        convertRun(times, runStart, runEnd - runStart, config.getOffset(isDST), isDST);
+
+        runStart = runEnd;
+    }
+}
+
+void LocalTimeBatchConvert::convertRun(const time_t *times, size_t start, size_t count, int32_t runOffset, bool runDST) {
+    const time_t *src = &times[start];
+
+    // Each of these loops is branch-free so the compiler can vectorize them
+    if (localTime) {
+        time_t *dest = &localTime[start];
+        for(size_t ii = 0; ii < count; ii++) {
+            dest[ii] = src[ii] + runOffset;
+        }
+    }
+    if (offset) {
+        int32_t *dest = &offset[start];
+        for(size_t ii = 0; ii < count; ii++) {
+            dest[ii] = runOffset;
+        }
+    }
+    if (dst) {
+        uint8_t *dest = &dst[start];
+        for(size_t ii = 0; ii < count; ii++) {
+            dest[ii] = runDST;
+        }
+    }
+
+    if (year || month || day || hour || minute || second) {
+        for(size_t ii = 0; ii < count; ii++) {
+            int64_t local = (int64_t)src[ii] + runOffset;
+            int days = (int)(local / 86400);
+            int secondOfDay = (int)(local - (int64_t)days * 86400);
+            if (secondOfDay < 0) {
+                secondOfDay += 86400;
+                days--;
+            }
+
+            int y, m, d;
+            LocalTime::civilFromDays(days, &y, &m, &d);
+
+            size_t index = start + ii;
+            if (year) {
+                year[index] = (int16_t) y;
+            }
+            if (month) {
+                month[index] = (int8_t) m;
+            }
+            if (day) {
+                day[index] = (int8_t) d;
+            }
+            if (hour) {
+                hour[index] = (int8_t) (secondOfDay / 3600);
+            }
+            if (minute) {
+                minute[index] = (int8_t) ((secondOfDay / 60) % 60);
+            }
+            if (second) {
+                second[index] = (int8_t) (secondOfDay % 60);
+            }
+        }
+    }
+}
+
+
+//
+// LocalTimeMultiZoneConvert
+//
+void LocalTimeMultiZoneConvert::convert(time_t time) {
+    // UTC calendar decomposition, shared by all of the timezones
+    utcDays = (int64_t)time / 86400;
+    utcSecondOfDay = (int)((int64_t)time - utcDays * 86400);
+    if (utcSecondOfDay < 0) {
+        utcSecondOfDay += 86400;
+        utcDays--;
+    }
+
+    // Local dates are almost always within one day of the UTC date
+    for(int ii = 0; ii < 3; ii++) {
+        LocalTime::civilFromDays((int)utcDays + ii - 1, &nearYear[ii], &nearMonth[ii], &nearDay[ii]);
+    }
+    utcYear = nearYear[1] - 1900;
+
+    // Keeps the global snapshot from being deleted during the loop, if any zone uses it
+    LocalTime::ConfigReader reader;
+
+    for(size_t index = 0; index < count; index++) {
+        int32_t zoneOffset;
+        bool zoneDST;
+        const LocalTimePosixTimezone *config = nullptr;
+
+        if (zones) {
+            const LocalTimeTransitionTable *table = registry->getTransitionTable(zones[index]);
+            if (table) {
+                if (table->lookup(time, &zoneOffset, &zoneDST)) {
+                    store(index, time, zoneOffset, zoneDST);
+                    continue;
+                }
+                // Outside of the years in the table
+                config = &table->config;
+            }
+        }
+        else if (configs[index].isValid()) {
+            config = &configs[index];
+        }
+
+        if (!config) {
+            config = &reader.getConfig();
+        }
+        zoneOffset = configOffset(index, *config, time, &zoneDST);
+        store(index, time, zoneOffset, zoneDST);
+    }
+}
+
+int32_t LocalTimeMultiZoneConvert::configOffset(size_t index, const LocalTimePosixTimezone &config, time_t time, bool *pIsDST) {
+    if (!config.hasDST()) {
+        *pIsDST = false;
+        return config.getOffset(false);
+    }
+
+    // The config may be shared between threads (the global config, a registry table, or the
+    // caller's array), so its own cache must not be written. Use this object's entry instead.
+    if (transitionCache.size() < count) {
+        transitionCache.resize(count);
+    }
+
+    time_t dstStart, standardStart;
+    config.getTransitions(utcYear, &dstStart, &standardStart, transitionCache[index]);
+    *pIsDST = LocalTimePosixTimezone::segmentFromTransitions(time, utcYear, dstStart, standardStart, NULL, NULL);
+    return config.getOffset(*pIsDST);
+}
+
+void LocalTimeMultiZoneConvert::store(size_t index, time_t time, int32_t zoneOffset, bool zoneDST) {
+    if (localTime) {
+        localTime[index] = time + zoneOffset;
+    }
+    if (offset) {
+        offset[index] = zoneOffset;
+    }
+    if (dst) {
+        dst[index] = zoneDST;
+    }
+
+    if (year || month || day || hour || minute || second) {
+        int secondOfDay = utcSecondOfDay + zoneOffset;
+        int dayDelta = secondOfDay / 86400;
+        secondOfDay -= dayDelta * 86400;
+        if (secondOfDay < 0) {
+            secondOfDay += 86400;
+            dayDelta--;
+        }
+
+        int y, m, d;
+        if (dayDelta >= -1 && dayDelta <= 1) {
+            y = nearYear[dayDelta + 1];
+            m = nearMonth[dayDelta + 1];
+            d = nearDay[dayDelta + 1];
+        }
+        else {
+            LocalTime::civilFromDays((int)utcDays + dayDelta, &y, &m, &d);
+        }
+
+        if (year) {
+            year[index] = (int16_t) y;
+        }
+        if (month) {
+            month[index] = (int8_t) m;
+        }
+        if (day) {
+            day[index] = (int8_t) d;
+        }
+        if (hour) {
+            hour[index] = (int8_t) (secondOfDay / 3600);
+        }
+        if (minute) {
+            minute[index] = (int8_t) ((secondOfDay / 60) % 60);
+        }
+        if (second) {
+            second[index] = (int8_t) (secondOfDay % 60);
+        }
+    }
+}
+
+
+//
+// LocalTimeFormatter
+//
+
+// "00" to "99", so two digits can be written with one copy
+static const char formatterDigitPairs[] = 
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const char * const formatterWeekdayNames[7] = {
+    "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"
+};
+
+static const char * const formatterMonthNames[12] = {
+    "January", "February", "March", "April", "May", "June", 
+    "July", "August", "September", "October", "November", "December"
+};
+
+// Output buffer that keeps counting after it's full, like snprintf
+class LocalTimeFormatterWriter {
+public:
+    LocalTimeFormatterWriter(char *buf, size_t bufSize) : buf(buf), bufSize(bufSize) {
+    }
+
+    void append(const char *str, size_t strLen) {
+        if (len + strLen < bufSize) {
+            memcpy(&buf[len], str, strLen);
+        }
+        else
+        if (len < bufSize) {
+            memcpy(&buf[len], str, bufSize - len);
+        }
+        len += strLen;
+    }
+
+    void appendTwoDigits(int value) {
+        append(&formatterDigitPairs[value * 2], 2);
+    }
+
+    void appendFourDigits(int value) {
+        appendTwoDigits(value / 100);
+        appendTwoDigits(value % 100);
+    }
+
+    size_t finish() {
+        if (bufSize > 0) {
+            buf[std::min(len, bufSize - 1)] = 0;
+        }
+        return len;
+    }
+
+    char *buf;
+    size_t bufSize;
+    size_t len = 0;
+};
+
+// Fallback for conversions and values the direct operations do not handle
+static void formatterStrftime(LocalTimeFormatterWriter &writer, const char *spec, const struct tm *pTimeInfo) {
+    char buf[64];
+    size_t bufLen = strftime(buf, sizeof(buf), spec, pTimeInfo);
+    writer.append(buf, bufLen);
+}
+
+void LocalTimeFormatter::compile(const char *formatSpec) {
+    ops.clear();
+    literals.clear();
+
+    if (!formatSpec || !strcmp(formatSpec, TIME_FORMAT_DEFAULT)) {
+        // asctime format, without the trailing newline
+        formatSpec = "%a %b %e %H:%M:%S %Y";
+    }
+
+    const char *cp = formatSpec;
+    while(*cp) {
+        const char *literal = cp;
+        while(*cp && *cp != '%') {
+            cp++;
+        }
+        if (cp > literal) {
+            addLiteral(literal, cp - literal);
+        }
+        if (!*cp) {
+            break;
+        }
+
+        // Same parsing as LocalTimeConvert::format()
+        const char *conversion = cp++;
+        while(*cp && !isalpha((unsigned char)*cp) && *cp != '%') {
+            cp++;
+        }
+        if (*cp == 'E' || *cp == 'O') {
+            cp++;
+        }
+        if (*cp) {
+            cp++;
+        }
+
+        size_t conversionLen = cp - conversion;
+        if (conversionLen == 2 && compileConversion(conversion[1])) {
+            continue;
+        }
+
+        // Let strftime() handle it
+        Op op;
+        op.type = OpType::STRFTIME;
+        op.len = (uint8_t)std::min(conversionLen, (size_t)63);
+        op.offset = (uint16_t)literals.size();
+        literals.insert(literals.end(), conversion, conversion + op.len);
+        ops.push_back(op);
+    }
+}
+
+bool LocalTimeFormatter::compileConversion(char conversion) {
+    switch(conversion) {
+        case '%': addLiteral("%", 1); break;
+        case 'n': addLiteral("\n", 1); break;
+        case 't': addLiteral("\t", 1); break;
+        case 'Y': addOp(OpType::YEAR); break;
+        case 'y': addOp(OpType::YEAR_2); break;
+        case 'C': addOp(OpType::CENTURY); break;
+        case 'm': addOp(OpType::MONTH); break;
+        case 'd': addOp(OpType::DAY); break;
+        case 'e': addOp(OpType::DAY_SPACE); break;
+        case 'j': addOp(OpType::DAY_OF_YEAR); break;
+        case 'H': addOp(OpType::HOUR); break;
+        case 'I': addOp(OpType::HOUR_12); break;
+        case 'M': addOp(OpType::MINUTE); break;
+        case 'S': addOp(OpType::SECOND); break;
+        case 'p': addOp(OpType::AM_PM); break;
+        case 'a': addOp(OpType::WEEKDAY_NAME); break;
+        case 'A': addOp(OpType::WEEKDAY_FULL_NAME); break;
+        case 'b': 
+        case 'h': addOp(OpType::MONTH_NAME); break;
+        case 'B': addOp(OpType::MONTH_FULL_NAME); break;
+        case 'w': addOp(OpType::WEEKDAY); break;
+        case 'u': addOp(OpType::WEEKDAY_MONDAY); break;
+        case 'z': addOp(OpType::ZONE_OFFSET); break;
+        case 'Z': addOp(OpType::ZONE_NAME); break;
+
+        // Combinations
+        case 'D': 
+            compileConversion('m'); addLiteral("/", 1); compileConversion('d'); addLiteral("/", 1); compileConversion('y');
+            break;
+        case 'F':
+            compileConversion('Y'); addLiteral("-", 1); compileConversion('m'); addLiteral("-", 1); compileConversion('d');
+            break;
+        case 'T':
+            compileConversion('H'); addLiteral(":", 1); compileConversion('M'); addLiteral(":", 1); compileConversion('S');
+            break;
+        case 'R':
+            compileConversion('H'); addLiteral(":", 1); compileConversion('M');
+            break;
+        case 'r':
+            compileConversion('I'); addLiteral(":", 1); compileConversion('M'); addLiteral(":", 1); compileConversion('S'); 
+            addLiteral(" ", 1); compileConversion('p');
+            break;
+
+        default:
+            return false;
+    }
+    return true;
+}
 
-        nextTime(hms);
-        if (time > origTime && time < resultTime) {
-            resultTime = time;
+void LocalTimeFormatter::addLiteral(const char *str, size_t len) {
+    while(len > 0) {
+        if (!ops.empty() && ops.back().type == OpType::LITERAL && ops.back().len < 255 && 
+            (size_t)ops.back().offset + ops.back().len == literals.size()) {
+            // Append to the previous literal
+            Op &op = ops.back();
+            size_t count = std::min(len, (size_t)(255 - op.len));
+            literals.insert(literals.end(), str, str + count);
+            op.len += count;
+            str += count;
+            len -= count;
+        }
+        else {
+            Op op;
+            op.type = OpType::LITERAL;
+            op.len = 0;
+            op.offset = (uint16_t)literals.size();
+            ops.push_back(op);
         }
-
-        // Restore original time
-        time = origTime;
-        convert();
     }
+}
 
-    time = resultTime;
-    convert();
+void LocalTimeFormatter::addOp(OpType type) {
+    Op op;
+    op.type = type;
+    op.len = 0;
+    op.offset = 0;
+    ops.push_back(op);
 }
 
-// nextTime is used by nextDayMidnight with a HMS of 00:00:00
+size_t LocalTimeFormatter::format(const LocalTimeConvert &conv, char *buf, size_t bufSize) const {
+    Fields fields;
+    const struct tm &timeInfo = conv.localTimeValue;
+
+    fields.year = timeInfo.tm_year + 1900;
+    fields.month = timeInfo.tm_mon + 1;
+    fields.day = timeInfo.tm_mday;
+    fields.hour = timeInfo.tm_hour;
+    fields.minute = timeInfo.tm_min;
+    fields.second = timeInfo.tm_sec;
+    fields.dayOfWeek = timeInfo.tm_wday;
+    fields.dayOfYear = timeInfo.tm_yday;
+    fields.isDST = conv.isDST();
+    fields.config = &conv.config;
+
+    return format(fields, buf, bufSize);
+}
 
-void LocalTimeConvert::nextTime(LocalTimeHMS hms) {
-    time_t origTime = time;
+String LocalTimeFormatter::format(const LocalTimeConvert &conv) const {
+    char buf[64];
 
-    localTimeValue.setHMS(hms);
-    time = localTimeValue.toUTC(config);
-    convert();
+    size_t len = format(conv, buf, sizeof(buf));
+    if (len < sizeof(buf)) {
+        return String(buf);
+    }
 
-    if (time <= origTime) {
-        // Day rolled backwards, so move back forward
-        localTimeValue.tm_mday++;
-        time = localTimeValue.toUTC(config);
-        convert();
+    char *largeBuf = new char[len + 1];
+    format(conv, largeBuf, len + 1);
+    String result(largeBuf);
+    delete[] largeBuf;
+    return result;
+}
+
+size_t LocalTimeFormatter::format(const LocalTimeConversion &conversion, char *buf, size_t bufSize) const {
+    Fields fields;
+
+    fields.year = conversion.year;
+    fields.month = conversion.month;
+    fields.day = conversion.day;
+    fields.hour = conversion.hour;
+    fields.minute = conversion.minute;
+    fields.second = conversion.second;
+    fields.dayOfWeek = conversion.dayOfWeek;
+    fields.dayOfYear = conversion.dayOfYear;
+    fields.isDST = conversion.isDST();
+
+    if (!conversion.config) {
+        // The global snapshot is only valid while the reader exists
+        LocalTime::ConfigReader reader;
+        fields.config = &reader.getConfig();
+        return format(fields, buf, bufSize);
     }
+    fields.config = conversion.config;
+
+    return format(fields, buf, bufSize);
 }
 
-void LocalTimeConvert::prevDay(LocalTimeHMS hms) {
-    time_t origTime = time;
+size_t LocalTimeFormatter::format(const LocalTimeBatchConvert &batch, size_t index, char *buf, size_t bufSize) const {
+    Fields fields;
 
-    localTimeValue.setHMS(hms);
-    localTimeValue.tm_mday--;
+    fieldsFromLocalTime(batch.localTime[index], fields);
+    fields.isDST = batch.dst ? (batch.dst[index] != 0) : false;
+    fields.config = &batch.config;
 
-    time = localTimeValue.toUTC(config);
-    convert();
+    return format(fields, buf, bufSize);
 }
 
+size_t LocalTimeFormatter::format(const Fields &fields, char *buf, size_t bufSize) const {
+    LocalTimeFormatterWriter writer(buf, bufSize);
 
-void LocalTimeConvert::nextDay(LocalTimeHMS hms) {
-    time_t origTime = time;
+    // Years outside of this range are left to strftime(), which may not pad them to 4 digits
+    bool fourDigitYear = (fields.year >= 1000 && fields.year <= 9999);
 
-    localTimeValue.setHMS(hms);
-    localTimeValue.tm_mday++;
+    for(const Op &op : ops) {
+        const char *strftimeSpec = NULL;
+        char spec[64];
 
-    time = localTimeValue.toUTC(config);
-    convert();
-}
+        switch(op.type) {
+            case OpType::LITERAL:
+                writer.append(&literals[op.offset], op.len);
+                break;
 
-void LocalTimeConvert::nextDayOrTimeChange(LocalTimeHMS hms) {
-    time_t timeOrig = time;
-    time_t dstStartOrig = dstStart;
-    time_t standardStartOrig = standardStart;
+            case OpType::STRFTIME:
+                memcpy(spec, &literals[op.offset], op.len);
+                spec[op.len] = 0;
+                strftimeSpec = spec;
+                break;
 
-    nextDay(hms);
+            case OpType::YEAR:
+                if (fourDigitYear) {
+                    writer.appendFourDigits(fields.year);
+                }
+                else {
+                    strftimeSpec = "%Y";
+                }
+                break;
 
-    if (dstStartOrig > timeOrig && dstStartOrig < time) {
-        time = dstStartOrig;
-        convert();
-    }
-    if (standardStartOrig > timeOrig && standardStartOrig < time) {
-        time = standardStartOrig;
-        convert();
-    }
-}   
+            case OpType::YEAR_2:
+                if (fourDigitYear) {
+                    writer.appendTwoDigits(fields.year % 100);
+                }
+                else {
+                    strftimeSpec = "%y";
+                }
+                break;
 
+            case OpType::CENTURY:
+                if (fourDigitYear) {
+                    writer.appendTwoDigits(fields.year / 100);
+                }
+                else {
+                    strftimeSpec = "%C";
+                }
+                break;
 
-bool LocalTimeConvert::nextDayOfWeek(int dayOfWeek, LocalTimeHMS hms) {
-    if (dayOfWeek < 0 || dayOfWeek > 6) {
-        return false;
-    }
+            case OpType::MONTH:
+                writer.appendTwoDigits(fields.month);
+                break;
 
-    do {
-        nextDay(hms);
-    } while(localTimeValue.tm_wday != dayOfWeek);
+            case OpType::DAY:
+                writer.appendTwoDigits(fields.day);
+                break;
 
-    return true;
-}
+            case OpType::DAY_SPACE:
+                if (fields.day < 10) {
+                    char temp[2] = { ' ', (char)('0' + fields.day) };
+                    writer.append(temp, 2);
+                }
+                else {
+                    writer.appendTwoDigits(fields.day);
+                }
+                break;
 
-void LocalTimeConvert::nextWeekday(LocalTimeHMS hms) {
-    do {
-        nextDay(hms);
-    } while(localTimeValue.tm_wday == 0 || localTimeValue.tm_wday == 6);
-}
+            case OpType::DAY_OF_YEAR: {
+                int value = fields.dayOfYear + 1;
+                char temp = (char)('0' + value / 100);
+                writer.append(&temp, 1);
+                writer.appendTwoDigits(value % 100);
+                break;
+            }
 
-void LocalTimeConvert::nextWeekendDay(LocalTimeHMS hms) {
-    do {
-        nextDay(hms);
-    } while(localTimeValue.tm_wday != 0 && localTimeValue.tm_wday != 6);
-}
+            case OpType::HOUR:
+                writer.appendTwoDigits(fields.hour);
+                break;
 
-bool LocalTimeConvert::nextDayOfMonth(int dayOfMonth, LocalTimeHMS hms) {
-    time_t origTime = time;
+            case OpType::HOUR_12:
+                writer.appendTwoDigits((fields.hour % 12) ? (fields.hour % 12) : 12);
+                break;
 
-    localTimeValue.tm_mday = (dayOfMonth > 0) ? dayOfMonth : (lastDayOfMonth() + dayOfMonth);
-    localTimeValue.setHMS(hms);
-    time = localTimeValue.toUTC(config);
-    convert();
+            case OpType::MINUTE:
+                writer.appendTwoDigits(fields.minute);
+                break;
 
-    if (time <= origTime) {
-        // The target dayOfMonth and time is before the original time, so move to next month
-        localTimeValue.tm_mon++;
-        time = localTimeValue.toUTC(config);
-        convert();
-    }
-    return true;
-}
+            case OpType::SECOND:
+                writer.appendTwoDigits(fields.second);
+                break;
 
+            case OpType::AM_PM:
+                writer.append((fields.hour < 12) ? "AM" : "PM", 2);
+                break;
 
-bool LocalTimeConvert::nextDayOfNextMonth(int dayOfMonth, LocalTimeHMS hms) {
-    localTimeValue.tm_mon++;
-    localTimeValue.tm_mday = (dayOfMonth > 0) ? dayOfMonth : (lastDayOfMonth() + dayOfMonth);
-    localTimeValue.setHMS(hms);
-    time = localTimeValue.toUTC(config);
-    convert();
-    return true;
-}
+            case OpType::WEEKDAY_NAME:
+                writer.append(formatterWeekdayNames[fields.dayOfWeek], 3);
+                break;
 
-bool LocalTimeConvert::nextDayOfWeekOrdinal(int dayOfWeek, int ordinal, LocalTimeHMS hms) {
-    for(int tries = 0; tries < 52; tries++) {
-        nextDayOfWeek(dayOfWeek, hms);
-        if (localTimeValue.ordinal() == ordinal) {
-            return true;
-        }
-    }
-    return false;
-}
+            case OpType::WEEKDAY_FULL_NAME:
+                writer.append(formatterWeekdayNames[fields.dayOfWeek], strlen(formatterWeekdayNames[fields.dayOfWeek]));
+                break;
 
+            case OpType::MONTH_NAME:
+                writer.append(formatterMonthNames[fields.month - 1], 3);
+                break;
 
-void LocalTimeConvert::nextLocalTime(LocalTimeHMS hms) {
-    time_t origTime = time;
-    localTimeValue.setHMS(hms);
-    time = localTimeValue.toUTC(config);
-    convert();
+            case OpType::MONTH_FULL_NAME:
+                writer.append(formatterMonthNames[fields.month - 1], strlen(formatterMonthNames[fields.month - 1]));
+                break;
 
-    if (time <= origTime) {
-        // Need to move to tomorrow
-        nextDay(hms);
+            case OpType::WEEKDAY: {
+                char temp = (char)('0' + fields.dayOfWeek);
+                writer.append(&temp, 1);
+                break;
+            }
+
+            case OpType::WEEKDAY_MONDAY: {
+                char temp = (char)('0' + (fields.dayOfWeek ? fields.dayOfWeek : 7));
+                writer.append(&temp, 1);
+                break;
+            }
+
+            case OpType::ZONE_OFFSET:
+                if (fields.config->isZ()) {
+                    writer.append("Z", 1);
+                }
+                else {
+                    // Same result as LocalTimeConvert::format(), "%+03d:%02u"
+                    int timeZone = fields.isDST ? fields.config->dstHMS.toSeconds() : fields.config->standardHMS.toSeconds();
+                    int hours = -timeZone / 3600;
+                    writer.append((hours < 0) ? "-" : "+", 1);
+                    writer.appendTwoDigits(abs(hours));
+                    writer.append(":", 1);
+                    writer.appendTwoDigits(abs(timeZone / 60) % 60);
+                }
+                break;
+
+            case OpType::ZONE_NAME: {
+                const char *name;
+                if (fields.config->isZ()) {
+                    name = "Z";
+                }
+                else {
+                    name = fields.isDST ? fields.config->dstName.c_str() : fields.config->standardName.c_str();
+                }
+                writer.append(name, strlen(name));
+                break;
+            }
+        }
+
+        if (strftimeSpec) {
+            struct tm timeInfo;
+            fieldsToTimeInfo(fields, &timeInfo);
+            formatterStrftime(writer, strftimeSpec, &timeInfo);
+        }
     }
+
+    return writer.finish();
 }
 
-bool LocalTimeConvert::nextSchedule(const LocalTimeSchedule &schedule) {
+// [static]
+void LocalTimeFormatter::fieldsToTimeInfo(const Fields &fields, struct tm *pTimeInfo) {
+    *pTimeInfo = {};
+    pTimeInfo->tm_year = fields.year - 1900;
+    pTimeInfo->tm_mon = fields.month - 1;
+    pTimeInfo->tm_mday = fields.day;
+    pTimeInfo->tm_hour = fields.hour;
+    pTimeInfo->tm_min = fields.minute;
+    pTimeInfo->tm_sec = fields.second;
+    pTimeInfo->tm_wday = fields.dayOfWeek;
+    pTimeInfo->tm_yday = fields.dayOfYear;
+    pTimeInfo->tm_isdst = fields.isDST;
+}
 
-    return schedule.getNextScheduledTime(*this);
+// [static]
+void LocalTimeFormatter::fieldsFromLocalTime(time_t localTime, Fields &fields) {
+    int64_t days = (int64_t)localTime / 86400;
+    int secondOfDay = (int)((int64_t)localTime - days * 86400);
+    if (secondOfDay < 0) {
+        secondOfDay += 86400;
+        days--;
+    }
+
+    LocalTime::civilFromDays((int)days, &fields.year, &fields.month, &fields.day);
+    fields.hour = secondOfDay / 3600;
+    fields.minute = (secondOfDay / 60) % 60;
+    fields.second = secondOfDay % 60;
+    fields.dayOfWeek = LocalTime::dayOfWeekFromDays((int)days);
+    fields.dayOfYear = (int)days - LocalTime::daysFromCivil(fields.year, 1, 1);
 }
 
 
-void LocalTimeConvert::atLocalTime(LocalTimeHMS hms) {
-    if (!hms.ignore) {
-        localTimeValue.setHMS(hms);
-        time = localTimeValue.toUTC(config);
-        convert();
+//
+// LocalTime
+//
+LocalTime &LocalTime::instance() {
+    LocalTime *result = _instance.load(std::memory_order_acquire);
+    if (!result) {
+        // If two threads get here at the same time, only one object is published
+        // and the other thread deletes the one it allocated
+        LocalTime *newInstance = new LocalTime();
+        if (_instance.compare_exchange_strong(result, newInstance, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            result = newInstance;
+        }
+        else {
+            delete newInstance;
+        }
     }
+    return *result;
 }
 
+LocalTime &LocalTime::withConfig(const LocalTimePosixTimezone &config) {
+    ConfigSnapshot *snapshot = new ConfigSnapshot();
+    if (!snapshot) {
+        return *this;
+    }
+    snapshot->config = config;
 
-String LocalTimeConvert::timeStr() {
-    char ascstr[26];
-    asctime_r(&localTimeValue, ascstr);
-    int len = strlen(ascstr);
-    ascstr[len-1] = 0; // remove final newline
-    return String(ascstr);
-}
+    // Readers only use calculateTransitions() or a copy, so the published cache is not written.
+    // Clearing it means it also doesn't carry entries from the caller's object.
+    snapshot->config.clearCache();
 
-String LocalTimeConvert::format(const char* format_spec) {
+    std::lock_guard<std::mutex> lock(configMutex);
+
+    ConfigSnapshot *oldSnapshot = configSnapshot.load(std::memory_order_relaxed);
+    snapshot->version = oldSnapshot->version + 1;
 
-    if (!format_spec || !strcmp(format_spec, TIME_FORMAT_DEFAULT)) {
-        return timeStr();
+    configSnapshot.store(snapshot, std::memory_order_seq_cst);
+    configVersion.store(snapshot->version, std::memory_order_release);
+
+    // A reader may still be using the old snapshot, so it's only deleted once there are no readers
+    if (oldSnapshot != &initialSnapshot) {
+        oldSnapshot->nextRetired = retiredSnapshots;
+        retiredSnapshots = oldSnapshot;
     }
+    deleteRetiredSnapshots();
+
+    return *this;
+}
 
-    // This implementation is from spark_wiring_time.cpp
+LocalTimePosixTimezone LocalTime::getConfig() const {
+    ConfigReader reader;
+    return reader.getConfig();
+}
 
-    char format_str[64];
-    // only copy up to n-1 to dest if no null terminator found
-    strncpy(format_str, format_spec, sizeof(format_str) - 1); // Flawfinder: ignore (ch42318)
-    format_str[sizeof(format_str) - 1] = '\0'; // ensure null termination
-    size_t len = strlen(format_str); // Flawfinder: ignore (ch42318)
+const LocalTime::ConfigSnapshot *LocalTime::acquireSnapshot() {
+    // The reader is counted before the snapshot is loaded. If withConfig() sees no readers
+    // after publishing a new snapshot, any reader that starts later loads the new one.
+    configReaders.fetch_add(1, std::memory_order_seq_cst);
+    return configSnapshot.load(std::memory_order_seq_cst);
+}
 
-    // while we are not using stdlib for managing the timezone, we have to do this manually
-    String zoneNameStr = zoneName();
+void LocalTime::releaseSnapshot() {
+    configReaders.fetch_sub(1, std::memory_order_seq_cst);
+}
 
-    char time_zone_str[16];
-    if (config.isZ()) {
-        strcpy(time_zone_str, "Z");
+void LocalTime::deleteRetiredSnapshots() {
+    if (configReaders.load(std::memory_order_seq_cst) != 0) {
+        // Try again on the next call to withConfig()
+        return;
     }
-    else {
-        int time_zone = isDST() ? config.dstHMS.toSeconds() : config.standardHMS.toSeconds();
 
-        snprintf(time_zone_str, sizeof(time_zone_str), "%+03d:%02u", -time_zone/3600, abs(time_zone/60)%60);
+    while(retiredSnapshots) {
+        ConfigSnapshot *next = retiredSnapshots->nextRetired;
+        delete retiredSnapshots;
+        retiredSnapshots = next;
     }
+}
 
-    // replace %z with the timezone
-    for (size_t i=0; i<len-1; i++)
-    {
-        if (format_str[i]=='%' && format_str[i+1]=='z')
-        {
-            size_t tzlen = strlen(time_zone_str);
-            memcpy(format_str+i+tzlen, format_str+i+2, len-i-1);    // +1 include the 0 char
-            memcpy(format_str+i, time_zone_str, tzlen);
-            len = strlen(format_str);
-        }
-        else
-        if (format_str[i]=='%' && format_str[i+1]=='Z')
-        {
-            size_t tzlen = zoneNameStr.length();
-            memcpy(format_str+i+tzlen, format_str+i+2, len-i-1);    // +1 include the 0 char
-            memcpy(format_str+i, zoneNameStr.c_str(), tzlen);
-            len = strlen(format_str);
-        }
+// [static]
+void LocalTime::timeToTm(time_t time, struct tm *pTimeInfo) {
+    // Floor division so times before 1970 work correctly
+    int64_t days = (int64_t)time / 86400;
+    int secondOfDay = (int)((int64_t)time - days * 86400);
+    if (secondOfDay < 0) {
+        secondOfDay += 86400;
+        days--;
     }
 
-    char buf[50] = {};
-    strftime(buf, sizeof(buf), format_str, &localTimeValue);
-    return String(buf);    
+    int year, month, day;
+    civilFromDays((int)days, &year, &month, &day);
+
+    pTimeInfo->tm_year = year - 1900;
+    pTimeInfo->tm_mon = month - 1;
+    pTimeInfo->tm_mday = day;
+    pTimeInfo->tm_hour = secondOfDay / 3600;
+    pTimeInfo->tm_min = (secondOfDay / 60) % 60;
+    pTimeInfo->tm_sec = secondOfDay % 60;
+    pTimeInfo->tm_wday = dayOfWeekFromDays((int)days);
+    pTimeInfo->tm_yday = (int)days - daysFromCivil(year, 1, 1);
+    pTimeInfo->tm_isdst = 0;
 }
 
-String LocalTimeConvert::zoneName() const { 
-    if (config.isZ()) {
-        return "Z";
-    }
-    else
-    if (isDST()) {
-        return config.dstName;
-    }
-    else {
-        return config.standardName;
+// [static]
+time_t LocalTime::tmToTime(struct tm *pTimeInfo) {
+    // Carry out-of-range months into the year, like mktime does
+    int year = pTimeInfo->tm_year + 1900;
+    int month = pTimeInfo->tm_mon;
+    year += month / 12;
+    month %= 12;
+    if (month < 0) {
+        month += 12;
+        year--;
     }
-};
 
-int LocalTimeConvert::lastDayOfMonth() const {
-    return LocalTime::lastDayOfMonth(localTimeValue.tm_year + 1900, (localTimeValue.tm_mon % 12) + 1);
-}
+    // Day of month, hour, minute, and second can be out of range because they're 
+    // just added to the number of days or seconds
+    int64_t days = (int64_t)daysFromCivil(year, month + 1, 1) + pTimeInfo->tm_mday - 1;
 
+    time_t result = (time_t)(days * 86400 + (int64_t)pTimeInfo->tm_hour * 3600 + (int64_t)pTimeInfo->tm_min * 60 + pTimeInfo->tm_sec);
 
-//
-// LocalTime
-//
-LocalTime &LocalTime::instance() {
-    if (!_instance) {
-        _instance = new LocalTime();
-    }
-    return *_instance;
+    // Update all fields with the normalized values, including tm_wday and tm_yday
+    timeToTm(result, pTimeInfo);
+
+    return result;
 }
 
 // [static]
-void LocalTime::timeToTm(time_t time, struct tm *pTimeInfo) {
-#ifndef UNITTEST
-    // Particle C standard library does not implement gmtime_r, however the C
-    // library is always set to UTC, so this works
-    localtime_r(&time, pTimeInfo);
-#else
-    gmtime_r(&time, pTimeInfo);     
-#endif
+int LocalTime::daysFromCivil(int year, int month, int day) {
+    // Algorithm from Howard Hinnant, "chrono-Compatible Low-Level Date Algorithms"
+    // https://howardhinnant.github.io/date_algorithms.html
+    // The year is shifted to start in March so the leap day is the last day of the year.
+    if (month <= 2) {
+        year--;
+    }
+    int era = ((year >= 0) ? year : (year - 399)) / 400;
+    int yearOfEra = year - era * 400;                                                       // [0, 399]
+    int dayOfYear = (153 * ((month > 2) ? (month - 3) : (month + 9)) + 2) / 5 + day - 1;    // [0, 365]
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;           // [0, 146096]
+
+    return era * 146097 + dayOfEra - 719468;
 }
 
 // [static]
-time_t LocalTime::tmToTime(struct tm *pTimeInfo) {
-#ifndef UNITTEST
-    // Particle C standard library does not implement timegm, however the C
-    // library is always set to UTC, so this works
-    return mktime(pTimeInfo);
-#else
-    return timegm(pTimeInfo);        
-#endif
+void LocalTime::civilFromDays(int days, int *pYear, int *pMonth, int *pDay) {
+    days += 719468;
+    int era = ((days >= 0) ? days : (days - 146096)) / 146097;
+    int dayOfEra = days - era * 146097;                                                                 // [0, 146096]
+    int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;          // [0, 399]
+    int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);                     // [0, 365]
+    int monthPrime = (5 * dayOfYear + 2) / 153;                                                         // [0, 11], March = 0
+    int month = (monthPrime < 10) ? (monthPrime + 3) : (monthPrime - 9);
+
+    *pDay = dayOfYear - (153 * monthPrime + 2) / 5 + 1;
+    *pMonth = month;
+    *pYear = yearOfEra + era * 400 + ((month <= 2) ? 1 : 0);
 }
 
 // [static]
@@ -1488,19 +4094,15 @@ String LocalTime::getTmString(struct tm *pTimeInfo) {
 
 // [static]
 time_t LocalTime::stringToTime(const char *str, struct tm *pTimeInfo) {
-    struct tm timeInfo;
-    int parts[6];
-    if (sscanf(str, "%d-%d-%d%*c%d:%d:%d", &parts[0], &parts[1], &parts[2], &parts[3], &parts[4], &parts[5]) == 6) {
-        timeInfo.tm_year = parts[0] - 1900;
-        timeInfo.tm_mon = parts[1] - 1;
-        timeInfo.tm_mday = parts[2];
-        timeInfo.tm_hour = parts[3];
-        timeInfo.tm_min = parts[4];
-        timeInfo.tm_sec = parts[5];
+    LocalTimeISO8601 iso;
+
+    // Seconds are required, and any offset is ignored
+    if (iso.parse(str) && iso.timeParts == 3) {
         if (pTimeInfo) {
-            *pTimeInfo = timeInfo;
+            iso.toTimeInfo(pTimeInfo);
         }
-        return tmToTime(&timeInfo);
+        iso.offset = 0;
+        return iso.toTime();
     }
     else {
         return 0;
@@ -1510,14 +4112,19 @@ time_t LocalTime::stringToTime(const char *str, struct tm *pTimeInfo) {
 
 // [static]
 String LocalTime::timeToString(time_t time, char separator) {
-    struct tm timeInfo;
+    char buf[32];
 
-    timeToTm(time, &timeInfo);
+    timeToString(time, buf, sizeof(buf), separator);
+    return String(buf);
+}
+
+// [static]
+size_t LocalTime::timeToString(time_t time, char *buf, size_t bufSize, char separator) {
+    LocalTimeISO8601 iso;
 
-    return String::format("%04d-%02d-%02d%c%02d:%02d:%02d", 
-        timeInfo.tm_year + 1900, timeInfo.tm_mon + 1, timeInfo.tm_mday,
-        separator,
-        timeInfo.tm_hour, timeInfo.tm_min, timeInfo.tm_sec);
+    iso.fromTime(time);
+    iso.separator = separator;
+    return iso.format(buf, bufSize);
 }
 
 
@@ -1535,7 +4142,8 @@ int LocalTime::lastDayOfMonth(int year, int month) {
 
         case 2:
             if ((year % 4) == 0) {
-                if ((year % 100) == 0) {
+                if ((year % 100) == 0 && (year % 400) != 0) {
+                    // Century years are not leap years, unless divisible by 400 (2000 is a leap year)
                     return 28;
                 }
                 else {
@@ -1557,60 +4165,27 @@ int LocalTime::lastDayOfMonth(int year, int month) {
 
 // [static]
 int LocalTime::dayOfWeekOfMonth(int year, int month, int dayOfWeek, int ordinal) {
-    struct tm timeInfo = {0};
-
-    if (dayOfWeek < 0 || dayOfWeek >= 7) {
-        // Invalid values of dayOfWeek can cause infinite loop below
+    if (dayOfWeek < 0 || dayOfWeek >= 7 || month < 1 || month > 12) {
         return 0;
     }
 
     int lastDay = lastDayOfMonth(year, month);
 
-    if (ordinal > 0) {
-        timeInfo.tm_year = year - 1900;
-        timeInfo.tm_mon = month - 1;
-        timeInfo.tm_mday = 1;
-        tmToTime(&timeInfo);
-
-        while(timeInfo.tm_wday != dayOfWeek) {
-            timeInfo.tm_mday++;
-            tmToTime(&timeInfo);
-        }
+    // Day of week of the 1st of the month
+    int firstDayOfWeek = dayOfWeekFromDays(daysFromCivil(year, month, 1));
 
-        for(int loops = 1; loops <= 5; loops++) {
-            if (loops >= ordinal) {
-                return timeInfo.tm_mday;
-            }
-            timeInfo.tm_mday += 7;
-            if (timeInfo.tm_mday > lastDay) {
-                // This ordinal does not exist
-                return 0;
-            }
-        }
+    if (ordinal > 0) {
+        // First dayOfWeek in the month, then add weeks
+        int day = 1 + (dayOfWeek - firstDayOfWeek + 7) % 7 + (ordinal - 1) * 7;
+        return (day <= lastDay) ? day : 0;
     }
     else
     if (ordinal < 0) {
-        timeInfo.tm_year = year - 1900;
-        timeInfo.tm_mon = month - 1;
-        timeInfo.tm_mday = lastDay;
-        tmToTime(&timeInfo);
-
-        while(timeInfo.tm_wday != dayOfWeek) {
-            timeInfo.tm_mday--;
-            tmToTime(&timeInfo);
-        }
-        for(int loops = 1; loops <= 5; loops++) {
-            if (loops >= -ordinal) {
-                return timeInfo.tm_mday;
-            }
-            timeInfo.tm_mday -= 7;
-            if (timeInfo.tm_mday < 1) {
-                // This ordinal does not exist
-                return 0;
-            }
-        }
+        // Last dayOfWeek in the month, then subtract weeks
+        int lastDayOfWeek = (firstDayOfWeek + lastDay - 1) % 7;
+        int day = lastDay - (lastDayOfWeek - dayOfWeek + 7) % 7 + (ordinal + 1) * 7;
+        return (day >= 1) ? day : 0;
     }
-
     
     return 0;
 }
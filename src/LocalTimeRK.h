@@ -3,12 +3,157 @@
 
 #include "Particle.h"
 
+#include <string.h>
 #include <time.h>
+#include <algorithm>
+#include <atomic>
 #include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <type_traits>
 #include <vector>
 
 class LocalTimeValue;
 
+/**
+ * @brief Scanner and printer for ISO 8601 dates and times
+ * 
+ * Parses strings like "2021-04-01T12:00:00", "2021-04-01 12:00:00.250Z", and 
+ * "2021-04-01T12:00:00-04:00". The input is length-bounded, so it does not need to be null 
+ * terminated, and parsing stops at the first character that is not part of the date and time,
+ * so it can be used on a timestamp inside a larger buffer such as a JSON payload.
+ * 
+ * This is used by LocalTime::stringToTime(), LocalTime::timeToString(), LocalTimeYMD::parse(),
+ * LocalTimeHMS::parse(), and LocalTimeValue::fromString(). To be compatible with the previous 
+ * sscanf-based implementation, numbers may be preceded by spaces and a sign, and the separator 
+ * between the date and time can be any single character.
+ */
+class LocalTimeISO8601 {
+public:
+    /**
+     * @brief Parse a date and time
+     * 
+     * @param str String to parse. Does not need to be null terminated.
+     * @param len Number of characters available in str
+     * @return size_t Number of characters used, or 0 if the string does not start with a date and time
+     * 
+     * The date must have year, month, and day. The time must have hour and minute, and optionally
+     * seconds, fractional seconds (after a . or ,), and a UTC offset (Z, +hh:mm, +hhmm, or +hh).
+     */
+    size_t parse(const char *str, size_t len);
+
+    /**
+     * @brief Parse a date and time from a null-terminated string
+     * 
+     * @param str String to parse
+     * @return size_t Number of characters used, or 0 if the string does not start with a date and time
+     */
+    size_t parse(const char *str) { return str ? parse(str, strlen(str)) : 0; };
+
+    /**
+     * @brief Parse a date only (YYYY-MM-DD)
+     * 
+     * @param str String to parse. Does not need to be null terminated.
+     * @param len Number of characters available in str
+     * @return size_t Number of characters used, or 0 if the string does not start with a date
+     */
+    size_t parseDate(const char *str, size_t len);
+
+    /**
+     * @brief Parse a time only (H, H:MM, or H:MM:SS)
+     * 
+     * @param str String to parse. Does not need to be null terminated.
+     * @param len Number of characters available in str
+     * @return size_t Number of characters used, or 0 if the string does not start with a number
+     * 
+     * The parts that are present are stored in timeParts. Fractional seconds and offsets are
+     * not parsed.
+     */
+    size_t parseTime(const char *str, size_t len);
+
+    /**
+     * @brief Returns the time as a time_t
+     * 
+     * If the string had a UTC offset, it's applied, so the result is UTC. Otherwise the date and
+     * time are treated as UTC. Fractional seconds are not included.
+     */
+    time_t toTime() const;
+
+    /**
+     * @brief Fill in a struct tm with the date and time as parsed, ignoring any offset
+     * 
+     * @param pTimeInfo The struct tm to fill in. tm_wday, tm_yday, and tm_isdst are set as well.
+     * 
+     * Out of range values are normalized, so "2021-02-29" becomes March 1.
+     */
+    void toTimeInfo(struct tm *pTimeInfo) const;
+
+    /**
+     * @brief Format the date and time
+     * 
+     * @param buf Buffer to store the string in. Always null terminated if bufSize > 0.
+     * @param bufSize Size of buf in bytes
+     * @return size_t Length of the string, not including the null terminator. If this is >= bufSize
+     * the string was truncated.
+     * 
+     * The format is "YYYY-MM-DDTHH:MM:SS" using separator instead of the T. Fractional seconds are
+     * included if fractionDigits is non-zero, and the offset if hasOffset is true (Z if the offset
+     * is 0).
+     */
+    size_t format(char *buf, size_t bufSize) const;
+
+    /**
+     * @brief Sets the date and time from a time_t with an optional offset
+     * 
+     * @param time Unix time, UTC
+     * @param offset If non-zero, seconds to add to time, and hasOffset is set
+     * 
+     * This is used to format a time_t.
+     */
+    void fromTime(time_t time, int32_t offset = 0);
+
+    /**
+     * @brief Write a number like printf "%0*d"
+     * 
+     * @param value The value to write
+     * @param minWidth The minimum number of characters, including the minus sign if negative
+     * @param buf Buffer to write to. Not null terminated.
+     * @param bufSize Size of buf in bytes. At least 12 bytes is always enough.
+     * @return size_t Number of characters written
+     */
+    static size_t formatNumber(int value, int minWidth, char *buf, size_t bufSize);
+
+    int year = 0;               //!< Year (4-digit, 2021 = 2021)
+    int month = 0;              //!< Month, 1 - 12
+    int day = 0;                //!< Day of month, 1 - 31
+    int hour = 0;               //!< Hour, 0 - 23
+    int minute = 0;             //!< Minute, 0 - 59
+    int second = 0;             //!< Second, 0 - 59
+    uint32_t nanosecond = 0;    //!< Fractional seconds in nanoseconds
+    uint8_t fractionDigits = 0; //!< Number of fractional second digits in the string (0 if none)
+    uint8_t timeParts = 0;      //!< Number of time parts present, 1 = hour, 2 = hour and minute, 3 = hour, minute, and second
+    bool hasOffset = false;     //!< true if the string included a UTC offset or Z
+    int32_t offset = 0;         //!< Seconds to add to UTC to get the time in the string, for example -14400 for -04:00
+    char separator = 'T';       //!< Separator between the date and time
+
+protected:
+    /**
+     * @brief Scan an integer like sscanf %d
+     * 
+     * @param cp Current position, updated on success
+     * @param end End of the input
+     * @param pValue Filled in with the value
+     * @return true if a number was found
+     */
+    static bool scanNumber(const char *&cp, const char *end, int *pValue);
+
+    /**
+     * @brief Scan exactly count digits
+     */
+    static bool scanDigits(const char *&cp, const char *end, int count, int *pValue);
+};
+
 /**
  * @brief Class for holding a year month day efficiently (4 bytes of storage)
  * 
@@ -162,13 +307,51 @@ public:
      */
     int getDayOfWeek() const;
 
+    /**
+     * @brief Get the date as the number of days since January 1, 1970
+     * 
+     * @return int Day number. Dates before 1970 are negative.
+     * 
+     * This is a serial day number, so adding days or finding the number of days between dates is 
+     * integer arithmetic. A day that is past the end of the month is the same as the corresponding 
+     * day in the next month.
+     */
+    int toDays() const;
+
+    /**
+     * @brief Sets the date from the number of days since January 1, 1970
+     * 
+     * @param days Day number, as from toDays()
+     */
+    void fromDays(int days);
+
+    /**
+     * @brief Returns the number of days from other to this date
+     * 
+     * @param other The date to compare to
+     * @return int Number of days, positive if this is after other
+     */
+    int diffDays(const LocalTimeYMD other) const {
+        return toDays() - other.toDays();
+    }
+
     /**
      * @brief Compare to another LocalTimeYMD object
      * 
      * @param other 
      * @return int -1 if this is < other, 0 if this == other, or 1 if this > other.
      */
-    int compareTo(const LocalTimeYMD other) const;
+    int compareTo(const LocalTimeYMD other) const {
+        uint32_t key = sortKey(), otherKey = other.sortKey();
+        return (key > otherKey) - (key < otherKey);
+    }
+
+    /**
+     * @brief Returns a value that sorts in date order (year, then month, then day)
+     */
+    uint32_t sortKey() const {
+        return ((uint32_t)ymd.year << 9) | ((uint32_t)ymd.month << 5) | (uint32_t)ymd.day;
+    }
 
     /**
      * @brief Tests if this LocalTimeYMD is equal to other
@@ -247,14 +430,21 @@ public:
      */
     bool parse(const char *s);
 
+    /**
+     * @brief Parse a YMD string in the format "YYYY-MD-DD" that is not necessarily null terminated
+     * 
+     * @param s String to parse
+     * @param len Number of characters available in s
+     * @return size_t Number of characters used, or 0 if s does not start with a date
+     */
+    size_t parse(const char *s, size_t len);
+
     /**
      * @brief Converts the value to YYYY-MM-DD format as a String with leading zeros.
      * 
      * @return String 
      */
-    String toString() const {
-        return String::format("%04d-%02d-%02d", ymd.year + 1900, ymd.month, ymd.day);
-    }
+    String toString() const;
 
     YMD ymd;    //!< Packed value for year, month, and day of month (4 bytes)
 };
@@ -426,11 +616,6 @@ public:
      */
     LocalTimeHMS();
 
-    /**
-     * @brief Destructor
-     */
-    virtual ~LocalTimeHMS();
-
     /**
      * @brief Constructs the object from a time string
      * 
@@ -447,6 +632,18 @@ public:
      */
     LocalTimeHMS(const char *str);
 
+    /**
+     * @brief Constructs the object from hour, minute, and second values
+     * 
+     * @param hour 0-23 hour (could also be negative or larger for timezone offsets)
+     * @param minute 0-59 minute
+     * @param second 0-59 second
+     * 
+     * Unlike the string constructor, this does not need to parse anything, so it's
+     * preferable for constants.
+     */
+    LocalTimeHMS(int hour, int minute, int second) : hour((int8_t)hour), minute((int8_t)minute), second((int8_t)second) {};
+
     /**
      * @brief Construct this HMS from a LocalTimeValue (which contains YMD and HMS)
      * 
@@ -657,8 +854,8 @@ public:
     int8_t second = 0;      //!< 0-59 second
     int8_t ignore = 0;      //!< Special case
 
-    static const LocalTimeHMS startOfDay; // LocalTimeHMS("00:00:00")
-    static const LocalTimeHMS endOfDay; // LocalTimeHMS("23:59:59")
+    static const LocalTimeHMS startOfDay; // LocalTimeHMS(0, 0, 0)
+    static const LocalTimeHMS endOfDay; // LocalTimeHMS(23, 59, 59)
 
 };
 
@@ -936,20 +1133,27 @@ public:
  * @brief Handles the time change part of the Posix timezone string like "M3.2.0/2:00:00"
  * 
  * Other formats with shortened time of day are also allowed like "M3.2.0/2" or even 
- * "M3.2.0" (midnight) are also allowed. Since the hour is local time, it can also be
+ * "M3.2.0" (2:00:00, the POSIX default) are also allowed. Since the hour is local time, it can also be
  * negative "M3.2.0/-1".
+ * 
+ * The POSIX day of year rules "J60" (1-365, never counting February 29) and "59" 
+ * (0-365, counting February 29 in leap years) are also supported.
  */
 class LocalTimeChange {
 public:
     /**
-     * @brief Default contructor
+     * @brief Which form of rule this is, which determines which fields are used
      */
-    LocalTimeChange();
+    enum class Rule : uint8_t {
+        MONTH_WEEK_DAY,     //!< Mm.w.d, uses month, week, and dayOfWeek
+        JULIAN,             //!< Jn, uses dayOfYear 1-365. February 29 is never counted, so J60 is always March 1.
+        DAY_OF_YEAR,        //!< n, uses dayOfYear 0-365. February 29 is counted in leap years.
+    };
 
     /**
-     * @brief Destructor
+     * @brief Default contructor
      */
-    virtual ~LocalTimeChange();
+    LocalTimeChange();
 
     /**
      * @brief Constructs a time change object with a string format (calls parse())
@@ -981,11 +1185,21 @@ public:
      * 
      * Setting the week to 5 essentially means the last week of the month. If the month does
      * not have a fifth week for that day of the week, then the fourth is used instead.
+     * 
+     * The string must contain exactly one rule. If it's not valid, valid is cleared.
      */
     void parse(const char *str);
 
     /**
-     * @brief Turns the parsed data into a normalized string like "M3.2.0/2:00:00"
+     * @brief Parses a time change string that is not necessarily null-terminated
+     * 
+     * @param str the time change string to parse
+     * @param len the number of characters in str to parse. Parsing also stops at a null character.
+     */
+    void parse(const char *str, size_t len);
+
+    /**
+     * @brief Turns the parsed data into a normalized string like "M3.2.0/2:00:00", "J60/2:00:00", or "59/2:00:00"
      */
     String toString() const;
 
@@ -999,1341 +1213,4004 @@ public:
      */
     time_t calculate(struct tm *pTimeInfo, LocalTimeHMS tzAdjust) const;
 
+    /**
+     * @brief Returns true if this rule is the same as other. Compares all of the rule fields.
+     */
+    bool operator==(const LocalTimeChange &other) const {
+        return month == other.month && week == other.week && dayOfWeek == other.dayOfWeek && valid == other.valid &&
+            hms == other.hms && rule == other.rule && dayOfYear == other.dayOfYear;
+    }
+
+    /**
+     * @brief Returns true if this rule is not the same as other
+     */
+    bool operator!=(const LocalTimeChange &other) const { return !(*this == other); };
+
     int8_t month = 0;       //!< 1-12, 1=January
     int8_t week = 0;        //!< 1-5, 1=first
     int8_t dayOfWeek = 0;   //!< 0-6, 0=Sunday, 1=Monday, ...
     int8_t valid = 0;       //!< true = valid
     LocalTimeHMS hms;       //!< Local time when timezone change occurs
+    Rule rule = Rule::MONTH_WEEK_DAY; //!< Which form of rule this is
+    int16_t dayOfYear = 0;  //!< Day for JULIAN (1-365) and DAY_OF_YEAR (0-365) rules
 };
 
 /**
- * @brief Parses a Posix timezone string into its component parts
- * 
- * For the Eastern US timezone, the string is: "EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00"
- * 
- * - EST is the standard timezone name
- * - 5 is the offset in hours (the sign is backwards from the normal offset from UTC)
- * - EDT is the daylight saving timezone name
- * - M3 indicates that DST starts on the 3rd month (March)
- * - 2 is the week number (second week)
- * - 0 is the day of week (0 = Sunday)
- * - 2:00:00 at 2 AM local time, the transition occurs
- * - M11 indicates that standard time begins in the 11th month (November)
- * - 1 is the week number (first week)
- * - 0 is the day of week (0 = Sunday)
- * - 2:00:00 at 2 AM local time, the transition occurs
- * 
- * There are many other acceptable formats, including formats for locations that don't have DST.
+ * @brief Timezone abbreviation, such as "EST", stored in a fixed-size buffer
  * 
- * For more information, see:
- * https://developer.ibm.com/technologies/systems/articles/au-aix-posix/
+ * This is used instead of String so LocalTimePosixTimezone does not allocate memory
+ * and can be copied with memcpy. Names longer than SIZE - 1 characters are truncated.
  */
-class LocalTimePosixTimezone {
+class LocalTimeZoneName {
 public:
     /**
-     * @brief Default constructor (no timezone set)
+     * @brief Default constructor (empty string)
      */
-    LocalTimePosixTimezone();
+    LocalTimeZoneName() {};
 
     /**
-     * @brief Destructor
+     * @brief Construct from a c-string
+     * 
+     * @param str The string to copy. Can be NULL, which is the same as an empty string.
      */
-    virtual ~LocalTimePosixTimezone();
+    LocalTimeZoneName(const char *str) { assign(str); };
 
     /**
-     * @brief Constructs the object with a specified timezone configuration
+     * @brief Set the value from a c-string
      * 
-     * Calls parse() internally.
+     * @param str The string to copy. Can be NULL, which is the same as an empty string.
      */
-    LocalTimePosixTimezone(const char *str);
+    LocalTimeZoneName &operator=(const char *str) { assign(str); return *this; };
 
     /**
-     * @brief Clears the timezone setting in this object
+     * @brief Set the value from a c-string, truncating if necessary
+     * 
+     * @param str The string to copy. Can be NULL, which is the same as an empty string.
      */
-    void clear();
+    void assign(const char *str) {
+        size_t ii = 0;
+        if (str) {
+            for(; ii < SIZE - 1 && str[ii]; ii++) {
+                name[ii] = str[ii];
+            }
+        }
+        name[ii] = 0;
+    }
 
     /**
-     * @brief Parses the timezone configuration string
-     * 
-     * @param str The string, for example: "EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00"
-     * 
-     * If the string is not valid this function returns false and the valid flag will
-     * be clear. You can call isValid() to check the validity at any time (such as
-     * if you are using the constructor with a string that does not return a boolean).
+     * @brief Returns the name as a c-string
      */
-    bool parse(const char *str);
+    const char *c_str() const { return name; };
 
     /**
-     * @brief Returns true if this timezone configuration has daylight saving
+     * @brief Returns the name as a c-string
      */
-    bool hasDST() const { return dstStart.valid; };
+    operator const char *() const { return name; };
 
     /**
-     * @brief Returns true if this timezone configuration has been set and appears valid
+     * @brief Returns the length of the name in characters
      */
-    bool isValid() const { return valid; };
+    size_t length() const { return strlen(name); };
 
     /**
-     * @brief Returns true if this timezone configuration is UTC
+     * @brief Compares the name to a c-string
      */
-    bool isZ() const { return !valid || (!hasDST() && standardHMS.toSeconds() == 0); };
+    bool operator==(const char *str) const { return strcmp(name, str ? str : "") == 0; };
 
-    String dstName; //!< Daylight saving timezone name (empty string if no DST)
-    LocalTimeHMS dstHMS; //!< Daylight saving time shift (relative to UTC)
-    String standardName; //!< Standard time timezone name
-    LocalTimeHMS standardHMS; //!< Standard time shift (relative to UTC). Note that this is positive in the United States, which is kind of backwards.
-    LocalTimeChange dstStart; //!< Rule for when DST starts
-    LocalTimeChange standardStart; //!< Rule for when standard time starts. 
-    bool valid = false; //!< true if the configuration looks valid
+    /**
+     * @brief Compares the name to a c-string
+     */
+    bool operator!=(const char *str) const { return !(*this == str); };
+
+    /**
+     * @brief Size of the buffer including the null terminator
+     */
+    static const size_t SIZE = 8;
+
+    char name[SIZE] = {}; //!< Null-terminated name
 };
 
 /**
- * @brief Container for a local time value with accessors similar to the Wiring Time class
+ * @brief A POSIX timezone string parsed at compile time
  * 
- * Really just a C++ wrapper around struct tm with adjustments for weekday and month being 
- * 0-based in struct tm and 1-based in Wiring. Also tm_year being weird in struct tm.
+ * LocalTimePosixTimezone::parse() uses this parser at runtime. If the timezone is a string 
+ * literal you can instead parse it at compile time, so the result is stored in flash and 
+ * there is no parsing at startup:
  * 
- * If you want to format a time string, use the methods in LocalTimeConvert. The reason is
- * that the LocalTimeValue is only the value container and doesn't know the current timezone
- * offset for the local time.
+ * ```
+ * constexpr LocalTimePosixTimezoneLiteral tzNewYork = LocalTimePosixTimezoneLiteral::parse("EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00");
+ * 
+ * LocalTime::instance().withConfig(tzNewYork);
+ * ```
+ * 
+ * The result must be declared constexpr for the string to be checked at compile time. A malformed
+ * string is then a compile error at the call to invalidPosixTimezoneString(). If parse() is evaluated 
+ * at runtime instead, a malformed string returns an object with valid false, and errorPosition
+ * and errorReason describe the problem.
+ * 
+ * The parser makes a single pass over the string and does not allocate memory. The syntax is:
+ * 
+ * - Names are 3 to NAME_SIZE - 1 letters, or 3 to NAME_SIZE - 1 letters, digits, + or - enclosed 
+ * in angle brackets like "<+0330>". The brackets are not included in the stored name.
+ * - Offsets are [+-]hh[:mm[:ss]], with hours 0-24 and minutes and seconds 0-59
+ * - The standard time name must be followed by its offset, so "UTC0" is valid but "UTC" is not.
+ * The DST offset is optional and defaults to one hour ahead of standard time.
+ * - Rules are Mm.w.d (month 1-12, week 1-5, day of week 0-6), Jn (day 1-365, February 29 is never 
+ * counted), or n (zero-based day 0-365, February 29 is counted in leap years), optionally followed
+ * by /time with a time hour from -127 to 127. Without a time, the change is at 2:00:00 local time.
+ * - There must be either no rules, or both a DST start and standard time start rule, and rules require a DST name
+ * - Anything else, including trailing characters, is an error
  */
-class LocalTimeValue : public ::tm {
+class LocalTimePosixTimezoneLiteral {
 public:
     /**
-     * @brief Returns the hour (0 - 23)
+     * @brief Hour, minute, and second, as in LocalTimeHMS
      */
-    int hour() const { return tm_hour; };
+    struct HMS {
+        int8_t hour = 0;        //!< Hour (could be negative)
+        int8_t minute = 0;      //!< 0-59 minute
+        int8_t second = 0;      //!< 0-59 second
+    };
 
     /**
-     * @brief Returns the hour (1 - 12) used in AM/PM mode
+     * @brief Time change rule, as in LocalTimeChange
      */
-    int hourFormat12() const;
+    struct Change {
+        int8_t month = 0;       //!< 1-12, 1=January
+        int8_t week = 0;        //!< 1-5, 1=first
+        int8_t dayOfWeek = 0;   //!< 0-6, 0=Sunday, 1=Monday, ...
+        int8_t valid = 0;       //!< true = valid
+        HMS hms;                //!< Local time when timezone change occurs
+        LocalTimeChange::Rule rule = LocalTimeChange::Rule::MONTH_WEEK_DAY; //!< Which fields are used
+        int16_t dayOfYear = 0;  //!< Day for JULIAN (1-365) and DAY_OF_YEAR (0-365) rules
+    };
 
     /**
-     * @brief Returns true if the time is in the AM (before noon)
+     * @brief Size of the name buffers, including the null terminator
      */
-    uint8_t isAM() const { return tm_hour < 12; };
+    static const size_t NAME_SIZE = LocalTimeZoneName::SIZE;
 
     /**
-     * @brief Returns true if the time is in the PM (>= 12:00:00 in 24-hour clock).
+     * @brief Parses a POSIX timezone string
+     * 
+     * @param str The string, for example: "EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00"
+     * @return LocalTimePosixTimezoneLiteral The parsed timezone. Check valid if evaluated at runtime.
      */
-    uint8_t isPM() const { return !isAM(); };
+    static constexpr LocalTimePosixTimezoneLiteral parse(const char *str) {
+        return parse(str, UNTERMINATED);
+    }
 
     /**
-     * @brief Returns the minute 0 - 59
-     */
-    int minute() const { return tm_min; };
+     * @brief Parses a POSIX timezone string that is not necessarily null-terminated
+     * 
+     * @param str The string, for example: "EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00"
+     * @param len The number of characters in str to parse. Parsing also stops at a null character.
+     * @return LocalTimePosixTimezoneLiteral The parsed timezone. Check valid if evaluated at runtime.
+     * 
+     * This is useful for validating timezone strings in a larger buffer, such as a configuration 
+     * file, without copying them.
+     */
+    static constexpr LocalTimePosixTimezoneLiteral parse(const char *str, size_t len) {
+        LocalTimePosixTimezoneLiteral result;
+        result.parseTimezone(Input{str, len});
+        if (!result.valid) {
+            // Not constexpr, so this fails to compile when evaluated at compile time
+            invalidPosixTimezoneString(result.errorReason);
+        }
+        return result;
+    }
 
     /**
-     * @brief Returns the second 0 - 59
+     * @brief Parses a single time change rule like "M3.2.0/2:00:00", "J60", or "59/2"
+     * 
+     * @param str The string to parse
+     * @param len The number of characters in str to parse. Parsing also stops at a null character.
+     * @return Change The rule. valid is 0 if the string is not exactly one valid rule.
      */
-    int second() const { return tm_sec; };
+    static constexpr Change parseRule(const char *str, size_t len = UNTERMINATED) {
+        LocalTimePosixTimezoneLiteral result;
+        Change change;
+        Input input{str, len};
+        size_t pos = 0;
+        if (!str || !result.parseChange(input, pos, change) || input[pos]) {
+            change = Change();
+        }
+        return change;
+    }
 
     /**
-     * @brief Returns the day of the month 1 - 31 (or less in some months)
+     * @brief Returns true if the timezone has daylight saving time
      */
-    int day() const { return tm_mday; };
+    constexpr bool hasDST() const { return dstStart.valid != 0; };
 
     /**
-     * @brief Returns the day of week 1 - 7 (Sunday = 1, Monday = 2, ..., Saturday = 7)
+     * @brief Called when parsing fails
      * 
-     * Note: the underlying struct tm tm_wday is 0 - 6 (Sunday = 0, Monday = 1, ..., Saturday = 6)
-     * but Wiring uses 1 - 7 instead of 0 - 6.
+     * @param reason Description of the error
+     * 
+     * This function intentionally is not constexpr so parsing a malformed string at compile time fails
+     * to compile. At runtime it does nothing.
      */
-    int weekday() const { return tm_wday + 1; };
+    static void invalidPosixTimezoneString(const char *reason) { (void)reason; };
 
+    char standardName[NAME_SIZE] = {}; //!< Standard time timezone name
+    HMS standardHMS;                    //!< Standard time shift (relative to UTC, positive in the United States)
+    char dstName[NAME_SIZE] = {};       //!< Daylight saving timezone name (empty string if no DST)
+    HMS dstHMS;                         //!< Daylight saving time shift (relative to UTC)
+    Change dstStart;                    //!< Rule for when DST starts
+    Change standardStart;               //!< Rule for when standard time starts
+    bool valid = false;                 //!< true if the string was parsed successfully
+    size_t errorPosition = 0;           //!< Offset in the string where parsing failed
+    const char *errorReason = nullptr;  //!< Reason parsing failed, or nullptr if valid
+
+protected:
     /**
-     * @brief Returns the month of the year 1 - 12 (1 = January, 2 = February, ...)
-     * 
-     * Note: the underlying struct tm tm_mon is 0 - 11, but this returns the more common 1 - 12.
+     * @brief Length used for null-terminated strings
      */
-    int month() const { return tm_mon + 1; };
+    static const size_t UNTERMINATED = (size_t)-1;
 
     /**
-     * @brief Returns the 4-digit year
+     * @brief A length-bounded view of the string being parsed
+     * 
+     * Reading past the end returns a null character, so the parsing code only has to check
+     * for null to handle both null-terminated and length-bounded strings.
      */
-    int year() const { return tm_year + 1900; };
+    struct Input {
+        const char *str;    //!< Characters to parse
+        size_t len;         //!< Number of characters, or UNTERMINATED
+
+        /**
+         * @brief Returns the character at pos, or 0 if pos is at or past the end
+         */
+        constexpr char operator[](size_t pos) const { return (pos < len) ? str[pos] : 0; };
+    };
 
     /**
-     * @brief Gets the local time as a LocalTimeHMS object
+     * @brief Records a parsing error
+     * 
+     * @param pos Offset into the string
+     * @param reason Description of the error
+     * @return false, to make it easy to return from the caller
      */
-    LocalTimeHMS hms() const;
+    constexpr bool fail(size_t pos, const char *reason) {
+        valid = false;
+        errorPosition = pos;
+        errorReason = reason;
+        return false;
+    }
 
     /**
-     * @brief Sets the local time from a LocalTimeHMS object
+     * @brief Returns true if c is an ASCII digit
      */
-    void setHMS(LocalTimeHMS hms);
+    static constexpr bool isDigit(char c) { return c >= '0' && c <= '9'; };
 
     /**
-     * @brief Get the date portion of this object as a LocalTimeYMD
-     * 
-     * @return LocalTimeYMD 
+     * @brief Returns true if c is an ASCII letter
      */
-    LocalTimeYMD ymd() const;
+    static constexpr bool isAlpha(char c) { return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'); };
 
     /**
-     * @brief Converts the specified local time into a UTC time
-     * 
-     * There are some caveats to this that occur on when the time change
-     * occurs. On spring forward, there is an hour that doesn't technically
-     * map to a UTC time. For example, in the United States, 2:00 AM to 3:00 AM
-     * local time doesn't exist because at 2:00 AM local time, the local time
-     * springs forward to 3:00 AM. 
-     * 
-     * When falling back, the hour from 1:00 AM to 2:00 AM is not unique, 
-     * because it happens twice, once in DST before falling back, and a second
-     * time after falling back. The toUTC() function returns the second one
-     * that occurs in standard time. 
+     * @brief Returns true if c can start a timezone name (a letter or <)
      */
-    time_t toUTC(LocalTimePosixTimezone config) const;
+    static constexpr bool isNameStart(char c) { return isAlpha(c) || c == '<'; };
 
     /**
-     * @brief Converts time from ISO-8601 format, ignoring the timezone 
-     * 
-     * @param str The string to convert
-     * 
-     * The string should be of the form:
-     * 
-     * YYYY-MM-DDTHH:MM:SS
-     * 
-     * The T can be any single character, such as a space. For example: 
-     * 
-     * 2021-04-01 10:00:00
-     * 
-     * Any characters after the seconds are ignored.
+     * @brief Parses a number of 1 to maxDigits digits that must be <= maxValue
      */
-    void fromString(const char *str);
+    constexpr bool parseNumber(const Input &str, size_t &pos, int maxDigits, int maxValue, int &value) {
+        size_t start = pos;
+        value = 0;
+        while(isDigit(str[pos]) && (int)(pos - start) < maxDigits) {
+            value = value * 10 + (str[pos++] - '0');
+        }
+        if (pos == start || isDigit(str[pos])) {
+            return fail(start, "expected number");
+        }
+        if (value > maxValue) {
+            return fail(start, "number out of range");
+        }
+        return true;
+    }
 
     /**
-     * @brief Returns which week of this day it is
-     * 
-     * For example, if this day is a Friday and it's the first Friday of the month, then
-     * 1 is returned. If it's the second Friday, then 2 is returned.
-     * 
-     * (This is different than the week number of the month, which depends on which day
-     * you begin the week on.)
+     * @brief Parses a timezone name of letters, or a quoted name like <+0330>
      */
-    int ordinal() const;
+    constexpr bool parseName(const Input &str, size_t &pos, char *name) {
+        size_t start = pos;
+        bool quoted = (str[pos] == '<');
+        if (quoted) {
+            pos++;
+        }
+        size_t nameStart = pos;
+        while(isAlpha(str[pos]) || (quoted && (isDigit(str[pos]) || str[pos] == '+' || str[pos] == '-'))) {
+            if (pos - nameStart >= NAME_SIZE - 1) {
+                return fail(start, "name too long");
+            }
+            name[pos - nameStart] = str[pos];
+            pos++;
+        }
+        if (pos == nameStart) {
+            return fail(start, "expected name");
+        }
+        if (pos - nameStart < 3) {
+            return fail(start, "name too short");
+        }
+        if (quoted) {
+            if (str[pos] != '>') {
+                return fail(pos, "expected >");
+            }
+            pos++;
+        }
+        return true;
+    }
 
-};
+    /**
+     * @brief Parses [+-]hh[:mm[:ss]]
+     */
+    constexpr bool parseHMS(const Input &str, size_t &pos, int maxHour, HMS &hms) {
+        bool negative = false;
+        if (str[pos] == '+' || str[pos] == '-') {
+            negative = (str[pos++] == '-');
+        }
+        int hour = 0, minute = 0, second = 0;
+        if (!parseNumber(str, pos, 3, maxHour, hour)) {
+            return false;
+        }
+        if (str[pos] == ':') {
+            pos++;
+            if (!parseNumber(str, pos, 2, 59, minute)) {
+                return false;
+            }
+            if (str[pos] == ':') {
+                pos++;
+                if (!parseNumber(str, pos, 2, 59, second)) {
+                    return false;
+                }
+            }
+        }
+        // Same representation as LocalTimeHMS::parse(): only the hour is negative
+        hms.hour = (int8_t)(negative ? -hour : hour);
+        hms.minute = (int8_t)minute;
+        hms.second = (int8_t)second;
+        return true;
+    }
 
+    /**
+     * @brief Parses a Mm.w.d, Jn, or n rule, followed by an optional /time
+     */
+    constexpr bool parseChange(const Input &str, size_t &pos, Change &change) {
+        int month = 0, week = 0, dayOfWeek = 0, dayOfYear = 0;
+        LocalTimeChange::Rule rule = LocalTimeChange::Rule::MONTH_WEEK_DAY;
+        if (str[pos] == 'M') {
+            pos++;
+            if (!parseNumber(str, pos, 2, 12, month)) {
+                return false;
+            }
+            if (month < 1) {
+                return fail(pos - 1, "number out of range");
+            }
+            if (str[pos] != '.') {
+                return fail(pos, "expected .");
+            }
+            pos++;
+            if (!parseNumber(str, pos, 1, 5, week)) {
+                return false;
+            }
+            if (week < 1) {
+                return fail(pos - 1, "number out of range");
+            }
+            if (str[pos] != '.') {
+                return fail(pos, "expected .");
+            }
+            pos++;
+            if (!parseNumber(str, pos, 1, 6, dayOfWeek)) {
+                return false;
+            }
+        }
+        else if (str[pos] == 'J') {
+            pos++;
+            rule = LocalTimeChange::Rule::JULIAN;
+            size_t start = pos;
+            if (!parseNumber(str, pos, 3, 365, dayOfYear)) {
+                return false;
+            }
+            if (dayOfYear < 1) {
+                return fail(start, "number out of range");
+            }
+        }
+        else if (isDigit(str[pos])) {
+            rule = LocalTimeChange::Rule::DAY_OF_YEAR;
+            if (!parseNumber(str, pos, 3, 365, dayOfYear)) {
+                return false;
+            }
+        }
+        else {
+            return fail(pos, "expected rule");
+        }
+        if (str[pos] == '/') {
+            pos++;
+            if (!parseHMS(str, pos, 127, change.hms)) {
+                return false;
+            }
+        }
+        else {
+            // POSIX default time of day for a change
+            change.hms.hour = 2;
+            change.hms.minute = 0;
+            change.hms.second = 0;
+        }
+        change.month = (int8_t)month;
+        change.week = (int8_t)week;
+        change.dayOfWeek = (int8_t)dayOfWeek;
+        change.rule = rule;
+        change.dayOfYear = (int16_t)dayOfYear;
+        change.valid = true;
+        return true;
+    }
 
-class LocalTimeConvert; // Forward declaration
+    /**
+     * @brief Parses the whole string, setting valid on success
+     */
+    constexpr bool parseTimezone(const Input &str) {
+        size_t pos = 0;
+        if (!str.str) {
+            return fail(0, "null string");
+        }
+        if (!parseName(str, pos, standardName)) {
+            return false;
+        }
+        if (!str[pos] || str[pos] == ',' || isNameStart(str[pos])) {
+            return fail(pos, "expected offset");
+        }
+        if (!parseHMS(str, pos, 24, standardHMS)) {
+            return false;
+        }
+        if (isNameStart(str[pos])) {
+            if (!parseName(str, pos, dstName)) {
+                return false;
+            }
+            if (str[pos] && str[pos] != ',') {
+                if (!parseHMS(str, pos, 24, dstHMS)) {
+                    return false;
+                }
+            }
+            else {
+                // Default dst is 1 hour later
+                dstHMS = standardHMS;
+                dstHMS.hour--;
+            }
+        }
+        if (str[pos] == ',') {
+            if (!dstName[0]) {
+                return fail(pos, "rules require a DST name");
+            }
+            pos++;
+            if (!parseChange(str, pos, dstStart)) {
+                return false;
+            }
+            if (str[pos] != ',') {
+                return fail(pos, "expected standard time rule");
+            }
+            pos++;
+            if (!parseChange(str, pos, standardStart)) {
+                return false;
+            }
+        }
+        if (str[pos]) {
+            return fail(pos, "unexpected character");
+        }
+        valid = true;
+        return true;
+    }
+};
 
 /**
- * @brief Class to hold a time range in local time in HH:MM:SS format
+ * @brief Parses a Posix timezone string into its component parts
  * 
- * Added in 0.1.0 (2023-11-25): The ability for hmsStart to be > hmsEnd. In this case, the time range is assumed
- * to cross midnight and to essentially be two separate ranges. 
+ * For the Eastern US timezone, the string is: "EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00"
+ * 
+ * - EST is the standard timezone name
+ * - 5 is the offset in hours (the sign is backwards from the normal offset from UTC)
+ * - EDT is the daylight saving timezone name
+ * - M3 indicates that DST starts on the 3rd month (March)
+ * - 2 is the week number (second week)
+ * - 0 is the day of week (0 = Sunday)
+ * - 2:00:00 at 2 AM local time, the transition occurs
+ * - M11 indicates that standard time begins in the 11th month (November)
+ * - 1 is the week number (first week)
+ * - 0 is the day of week (0 = Sunday)
+ * - 2:00:00 at 2 AM local time, the transition occurs
+ * 
+ * There are many other acceptable formats, including formats for locations that don't have DST.
+ * 
+ * For more information, see:
+ * https://developer.ibm.com/technologies/systems/articles/au-aix-posix/
+ * 
+ * Thread safety: getTransitions(), getSegment(), and localToUTC() are const but update a small 
+ * cache of transition times in this object, so a single object must not be used from more than
+ * one thread at a time, even if it's const. Code that reads a config shared between threads, 
+ * such as the global one in LocalTime::ConfigReader or a registry transition table, uses 
+ * calculateTransitions() or a cache entry of its own instead.
  */
-class LocalTimeRange : public LocalTimeRestrictedDate {
-public: 
+class LocalTimePosixTimezone {
+public:
     /**
-     * @brief Construct a new Time Range object with the range of the entire day (inclusive) 
-     * 
-     * This is start = 00:00:00, end = 23:59:59. The system clock does not have a concept of leap seconds.
+     * @brief Default constructor (no timezone set)
      */
-    LocalTimeRange() : LocalTimeRestrictedDate(LocalTimeDayOfWeek::MASK_ALL), hmsStart(LocalTimeHMS::startOfDay), hmsEnd(LocalTimeHMS::endOfDay) {
-    }
+    LocalTimePosixTimezone();
 
     /**
-     * @brief Construct a new Time Range object with the specifies start and end times.
-     * 
-     * @param hmsStart Start time in local time 00:00:00 <= hmsStart <= 23:59:59
-     * @param hmsEnd  End time in local time 00:00:00 <= hmsStart <= 23:59:59 (optional)
-     * 
-     * Note that 24:00:00 is not a valid time. You should generally use inclusive times such that
-     * 23:59:59 is the end of the day.
+     * @brief Constructs the object with a specified timezone configuration
      * 
+     * Calls parse() internally.
      */
-    LocalTimeRange(LocalTimeHMS hmsStart, LocalTimeHMS hmsEnd = LocalTimeHMS::endOfDay) : LocalTimeRestrictedDate(LocalTimeDayOfWeek::MASK_ALL), hmsStart(hmsStart), hmsEnd(hmsEnd) {
-    }
+    LocalTimePosixTimezone(const char *str);
 
     /**
-     * @brief Construct a new object that specifies start time, end time, and date restrictions
+     * @brief Constructs the object from a timezone parsed at compile time
      * 
-     * @param hmsStart Start time in local time 00:00:00 <= hmsStart <= 23:59:59
-     * @param hmsEnd  End time in local time 00:00:00 <= hmsStart <= 23:59:59
-     * @param dateRestriction Only use this time range on certain dates
+     * Calls fromLiteral() internally.
      */
-    LocalTimeRange(LocalTimeHMS hmsStart, LocalTimeHMS hmsEnd, LocalTimeRestrictedDate dateRestriction) : LocalTimeRestrictedDate(dateRestriction), hmsStart(hmsStart), hmsEnd(hmsEnd) {
-    }
+    LocalTimePosixTimezone(const LocalTimePosixTimezoneLiteral &literal);
 
     /**
-     * @brief Construct a new object that specifies start time and date restrictions, used for at time and date schedules
-     * 
-     * @param hmsStart Start time in local time 00:00:00 <= hmsStart <= 23:59:59
-     * @param hmsEnd  End time in local time 00:00:00 <= hmsStart <= 23:59:59
-     * @param dateRestriction Only use this time range on certain dates
+     * @brief Clears the timezone setting in this object
      */
-    LocalTimeRange(LocalTimeHMS hmsStart, LocalTimeRestrictedDate dateRestriction) : LocalTimeRestrictedDate(dateRestriction), hmsStart(hmsStart) {
-        hmsEnd = LocalTimeHMS::endOfDay;
-    }
+    void clear();
 
     /**
-     * @brief Clear time range to all day, every day
+     * @brief Parses the timezone configuration string
+     * 
+     * @param str The string, for example: "EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00"
+     * 
+     * If the string is not valid this function returns false and the valid flag will
+     * be clear. You can call isValid() to check the validity at any time (such as
+     * if you are using the constructor with a string that does not return a boolean).
+     * 
+     * The string is parsed in a single pass without allocating memory, using the same
+     * parser as LocalTimePosixTimezoneLiteral, which describes the syntax. Strings with 
+     * anything unexpected, including trailing characters, are not valid.
      */
-    void clear() {
-        hmsStart = LocalTimeHMS::startOfDay;
-        hmsEnd = LocalTimeHMS::endOfDay;
-
-        // Default to all days
-        LocalTimeRestrictedDate::clear();
-        LocalTimeRestrictedDate::withOnAllDays();
-    }
+    bool parse(const char *str);
 
     /**
-     * @brief Returns true if the time range is the whole day (00:00:00 to 23:59:59 inclusive)
+     * @brief Parses a timezone configuration string that is not necessarily null-terminated
      * 
-     * @return true 
-     * @return false 
+     * @param str The string, for example: "EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00"
+     * @param len The number of characters in str to parse. Parsing also stops at a null character.
+     * @param pErrorPosition Filled in with the offset in str where parsing failed. Can be NULL.
+     * @param pErrorReason Filled in with a description of the error, or nullptr if valid. Can be NULL.
+     * @return true if the string is valid
      */
-    bool isWholeDay() const {
-        return (hmsStart == LocalTimeHMS::startOfDay) && (hmsEnd == LocalTimeHMS::endOfDay);
-    }
+    bool parse(const char *str, size_t len, size_t *pErrorPosition = NULL, const char **pErrorReason = NULL);
 
     /**
-     * @brief Get the number of seconds between start and end based on a LocalTimeConvert object
-     * 
-     * The reason for the conv object is that it contains the time to calculate at, as well as 
-     * the daylight saving time settings. This methods takes into account the actual number of
-     * seconds including when a time change is crossed.
-     * 
-     * @param conv The time and timezone settings to calculate the time span at
-     * @return time_t Time difference in seconds
+     * @brief Sets this object from a timezone parsed at compile time
      * 
-     * In the weird case that start > end, it can return a negative value, as time_t is a signed
-     * long (or long long) value.
+     * @param literal The parsed timezone from LocalTimePosixTimezoneLiteral::parse()
      * 
-     * This does not take into account date restrictions!
+     * This does not parse any strings, it only copies the already parsed values. Returns
+     * false if literal is not valid.
      */
-    time_t getTimeSpan(const LocalTimeConvert &conv) const;
+    bool fromLiteral(const LocalTimePosixTimezoneLiteral &literal);
 
     /**
-     * @brief Compares a time (LocalTimeHHS, local time) to this time range
-     * 
-     * @param hms 
-     * @return int -1 if hms is before hmsStart, 0 if in range, +1 if hms is after hmsEnd
+     * @brief Returns true if this timezone configuration has daylight saving
      */
-    int compareTo(LocalTimeHMS hms) const {
-        if (hms < hmsStart) {
-            return -1;
-        }
-        else
-        if (hms > hmsEnd) {
-            return +1;
-        }
-        else {
-            return 0;
-        }
-    }
+    bool hasDST() const { return dstStart.valid; };
 
     /**
-     * @brief Returns true if the date restrictions allow this day 
-     * 
-     * @param ymd 
-     * @return true 
-     * @return false 
+     * @brief Returns true if this timezone configuration has been set and appears valid
      */
-    bool isValidDate(LocalTimeYMD ymd) const {
-        return LocalTimeRestrictedDate::isValid(ymd);
-    }
+    bool isValid() const { return valid; };
 
     /**
-     * @brief Returns true if the date restrictions allow this date and the time is in this range (inclusive)
-     * 
-     * @param localTimeValue 
-     * @return true 
-     * @return false 
+     * @brief Returns true if this timezone configuration is UTC
      */
-    bool inRange(LocalTimeValue localTimeValue) const {
-        if (isValidDate(localTimeValue)) {
-            LocalTimeHMS hms = localTimeValue.hms();
-            return isInRangeHMS(hms);
-        }
-        else {
-            return false;
-        }
-    }
+    bool isZ() const { return !valid || (!hasDST() && standardHMS.toSeconds() == 0); };
 
     /**
-     * @brief Returns true if start >= end (range crosses midnight)
-     * 
-     * @return true 
-     * @return false 
+     * @brief Cached transition times for one year, used by getTransitions()
      */
-    bool rangeCrossesMidnight() const {
-        return hmsStart > hmsEnd;
-    }
+    struct TransitionCacheEntry {
+        int year;               //!< Year in struct tm format (121 = 2021)
+        bool valid = false;     //!< true if this entry has been filled in
+        time_t dstStart;        //!< Time DST starts in year (UTC)
+        time_t standardStart;   //!< Time standard time starts in year (UTC)
+        LocalTimeChange dstRule;        //!< dstStart rule the times were calculated from
+        LocalTimeChange standardRule;   //!< standardStart rule the times were calculated from
+        LocalTimeHMS dstHMS;            //!< dstHMS the times were calculated from
+        LocalTimeHMS standardHMS;       //!< standardHMS the times were calculated from
+    };
 
     /**
-     * @brief Returns true if the specified time is in the time range (ignoring date restrictions)
+     * @brief Get the UTC time of the start of DST and the start of standard time in a year
+     *
+     * @param year The year, in struct tm format (121 = 2021)
+     * @param pDstStart Filled in with the time DST starts (Unix time, UTC). Can be NULL.
+     * @param pStandardStart Filled in with the time standard time starts (Unix time, UTC). Can be NULL.
+     *
+     * Only meaningful if hasDST() is true. The results are cached by year in this object, so
+     * converting many times in the same year only evaluates the dstStart and standardStart
+     * rules once. The cache is a small fixed-size array, so it never allocates memory.
      * 
-     * @return true 
-     * @return false 
+     * This writes the cache, so it's not safe to call on an object shared between threads.
      */
-    bool isInRangeHMS(LocalTimeHMS hms) const {
-        if (!rangeCrossesMidnight()) {
-            return (hmsStart <= hms) && (hms <= hmsEnd);
-        }
-        else {
-            // Range crosses midnight (hmsEnd < hmsStart)
-            // Is not in range if hmsEnd < hms < hmsStart
-            return !((hmsEnd < hms) && (hms < hmsStart));
-        }
-    }
-    
+    void getTransitions(int year, time_t *pDstStart, time_t *pStandardStart) const;
 
     /**
-     * @brief For restricted time ranges, get the last date (YMD) that this time range could be valid
+     * @brief Get the transitions in a year using a cache entry owned by the caller
+     *
+     * @param year The year, in struct tm format (121 = 2021)
+     * @param pDstStart Filled in with the time DST starts (Unix time, UTC). Can be NULL.
+     * @param pStandardStart Filled in with the time standard time starts (Unix time, UTC). Can be NULL.
+     * @param entry The cache entry to use. It's recalculated if it's for a different year or different rules.
+     *
+     * This does not modify this object, so it can be used on a config shared between threads as
+     * long as each thread has its own entry.
+     */
+    void getTransitions(int year, time_t *pDstStart, time_t *pStandardStart, TransitionCacheEntry &entry) const;
+
+    /**
+     * @brief Calculate the UTC time of the start of DST and the start of standard time in a year, without caching
+     *
+     * @param year The year, in struct tm format (121 = 2021)
+     * @param pDstStart Filled in with the time DST starts (Unix time, UTC). Can be NULL.
+     * @param pStandardStart Filled in with the time standard time starts (Unix time, UTC). Can be NULL.
+     *
+     * This is the same as getTransitions() but does not read or modify the cache, so it's safe to 
+     * call on a config that is shared between threads.
+     */
+    void calculateTransitions(int year, time_t *pDstStart, time_t *pStandardStart) const;
+
+    /**
+     * @brief Determine the DST state and segment of a time from the transitions in its year
      * 
-     * @return LocalTimeYMD 
+     * @param time The time to check (Unix time, UTC)
+     * @param year The UTC year of time, in struct tm format (121 = 2021)
+     * @param dstStart The time DST starts in year, from getTransitions() or calculateTransitions()
+     * @param standardStart The time standard time starts in year
+     * @param pSegmentStart Filled in with the start of the span (inclusive, UTC). Can be NULL.
+     * @param pSegmentEnd Filled in with the end of the span (exclusive, UTC). Can be NULL.
+     * @return true if time is in daylight saving time
      * 
-     * This will return the empty date for most cases. A valid value is returned if the LocalTimeRestrictedDate
-     * is used, and an only on date is set. In this case, there's as point in time where this range will 
-     * never be true. This is used to optimize scheduling.
+     * This is the calculation used by getSegment().
      */
-    LocalTimeYMD getExpirationDate() const {
-        return LocalTimeRestrictedDate::getExpirationDate();
-    }
+    static bool segmentFromTransitions(time_t time, int year, time_t dstStart, time_t standardStart, time_t *pSegmentStart, time_t *pSegmentEnd);
 
     /**
-     * @brief Set the date restrictions from a LocalTimeHMSRestricted object
-     * 
-     * @param hms LocalTimeHMSRestricted, really only uses the date restrictions, not the HMS part
+     * @brief Clears the cache of per-year transition times
+     *
+     * This is done automatically by parse() and clear(). Each entry also remembers the rules it
+     * was calculated from and is recalculated if dstStart, standardStart, dstHMS, or standardHMS 
+     * change, so this is not required after modifying them directly.
      */
-    void fromTime(LocalTimeHMSRestricted hms) {
-        *(LocalTimeRestrictedDate *)this = hms;
-        hmsStart = hms;
-    }
+    void clearCache() const;
 
     /**
-     * @brief Fills in the time range from a JSON object
+     * @brief Determines if a time is in daylight saving time, and the span of time with the same offset
+     *
+     * @param time The time to check (Unix time, UTC)
+     * @param pSegmentStart Filled in with the start of the span (inclusive, UTC). Can be NULL.
+     * @param pSegmentEnd Filled in with the end of the span (exclusive, UTC). Can be NULL.
+     * @return true if time is in daylight saving time
+     *
+     * Every time in [segmentStart, segmentEnd) has the same UTC offset as time. The span never extends
+     * past the UTC calendar year of time because transitions are calculated by year. If there is no
+     * DST, the span covers all possible time_t values.
+     */
+    bool getSegment(time_t time, time_t *pSegmentStart = NULL, time_t *pSegmentEnd = NULL) const;
+
+    /**
+     * @brief Returns the number of seconds to add to UTC to get local time
+     *
+     * @param isDST true to get the offset during daylight saving time, false for standard time
+     *
+     * This is the opposite sign of standardHMS and dstHMS, so it's negative in the United States.
+     */
+    int getOffset(bool isDST) const { return isDST ? -dstHMS.toSeconds() : -standardHMS.toSeconds(); };
+
+    /**
+     * @brief How a local time maps to UTC, returned by localToUTC()
+     */
+    enum class LocalTimeKind {
+        UNIQUE,     //!< The local time occurs exactly once
+        SKIPPED,    //!< The local time does not exist because it's in the gap when springing forward
+        REPEATED,   //!< The local time occurs twice because it's in the overlap when falling back
+    };
+
+    /**
+     * @brief Converts a local time to UTC
      * 
-     * @param jsonObj 
+     * @param pLocalTime The local time. Values can be out of range, like mktime.
+     * @param pKind Filled in with whether the local time is unique, skipped, or repeated. Can be NULL.
+     * @return time_t The time (Unix time, UTC)
      * 
-     * Keys:
-     * - s (string) The start time (HH:MM:SS format, can omit MM or SS)
-     * - e (string) The end time (HH:MM:SS format, can omit MM or SS)
+     * This uses the cached transition times for the year directly, so it's much less work 
+     * than doing a forward conversion with LocalTimeConvert. Like getTransitions(), it updates
+     * the cache, so it's not safe to call on an object shared between threads.
+     * 
+     * For a repeated time, the second occurrence (in standard time) is returned. For a skipped 
+     * time, the local time is interpreted using the daylight saving time offset, so 2:30 AM
+     * on the day DST starts in the United States is the same as 1:30 AM standard time. This is
+     * the same behavior as LocalTimeValue::toUTC().
      */
-    void fromJson(JSONValue jsonObj);
+    time_t localToUTC(const struct tm *pLocalTime, LocalTimeKind *pKind = NULL) const;
 
-    LocalTimeHMS hmsStart; //!< Starting time, inclusive
-    LocalTimeHMS hmsEnd; //!< Ending time, inclusive
-};
+    LocalTimeZoneName dstName; //!< Daylight saving timezone name (empty string if no DST)
+    LocalTimeHMS dstHMS; //!< Daylight saving time shift (relative to UTC)
+    LocalTimeZoneName standardName; //!< Standard time timezone name
+    LocalTimeHMS standardHMS; //!< Standard time shift (relative to UTC). Note that this is positive in the United States, which is kind of backwards.
+    LocalTimeChange dstStart; //!< Rule for when DST starts
+    LocalTimeChange standardStart; //!< Rule for when standard time starts.
+    bool valid = false; //!< true if the configuration looks valid
+
+    /**
+     * @brief Number of years to keep in the transition cache
+     *
+     * Two is enough to cover stepping across the end of a year without having to recalculate.
+     */
+    static const size_t TRANSITION_CACHE_SIZE = 2;
 
+    /**
+     * @brief Per-year cache of transition times, indexed by year modulo TRANSITION_CACHE_SIZE
+     */
+    mutable TransitionCacheEntry transitionCache[TRANSITION_CACHE_SIZE];
+};
 
+// These are copied often, so they must not allocate memory or require a copy constructor
+static_assert(std::is_trivially_copyable<LocalTimeHMS>::value, "LocalTimeHMS must be trivially copyable");
+static_assert(std::is_trivially_copyable<LocalTimeChange>::value, "LocalTimeChange must be trivially copyable");
+static_assert(std::is_trivially_copyable<LocalTimePosixTimezone>::value, "LocalTimePosixTimezone must be trivially copyable");
 
 /**
- * @brief A single item in a schedule, such as minute of hour, hour of day, or a specific time.
+ * @brief Container for a local time value with accessors similar to the Wiring Time class
+ * 
+ * Really just a C++ wrapper around struct tm with adjustments for weekday and month being 
+ * 0-based in struct tm and 1-based in Wiring. Also tm_year being weird in struct tm.
+ * 
+ * If you want to format a time string, use the methods in LocalTimeConvert. The reason is
+ * that the LocalTimeValue is only the value container and doesn't know the current timezone
+ * offset for the local time.
  */
-class LocalTimeScheduleItem {
-public: 
+class LocalTimeValue : public ::tm {
+public:
     /**
-     * @brief Type of schedule item this is
+     * @brief Returns the hour (0 - 23)
      */
-    enum class ScheduleItemType : int {
-        NONE = 0,               //!< No schedule defined
-        MINUTE_OF_HOUR,         //!< Minute of the hour (1)
-        HOUR_OF_DAY,            //!< Hour of day (2)
-        DAY_OF_WEEK_OF_MONTH,   //!< The nth day of week of the month (3)
-        DAY_OF_MONTH,           //!< Day of the month (4)
-        TIME                    //!< Specific time (5)    
-    };
+    int hour() const { return tm_hour; };
 
     /**
-     * @brief Default constructor. Set increment and optionally timeRange to use.
+     * @brief Returns the hour (1 - 12) used in AM/PM mode
      */
-    LocalTimeScheduleItem() {
-    }
+    int hourFormat12() const;
 
     /**
-     * @brief Returns true ScheduleItemType is not NONE
-     * 
-     * @return true 
-     * @return false 
+     * @brief Returns true if the time is in the AM (before noon)
+     */
+    uint8_t isAM() const { return tm_hour < 12; };
+
+    /**
+     * @brief Returns true if the time is in the PM (>= 12:00:00 in 24-hour clock).
+     */
+    uint8_t isPM() const { return !isAM(); };
+
+    /**
+     * @brief Returns the minute 0 - 59
+     */
+    int minute() const { return tm_min; };
+
+    /**
+     * @brief Returns the second 0 - 59
+     */
+    int second() const { return tm_sec; };
+
+    /**
+     * @brief Returns the day of the month 1 - 31 (or less in some months)
+     */
+    int day() const { return tm_mday; };
+
+    /**
+     * @brief Returns the day of week 1 - 7 (Sunday = 1, Monday = 2, ..., Saturday = 7)
      * 
-     * This is used to check if an object was constructed by the default constructor and never set.
+     * Note: the underlying struct tm tm_wday is 0 - 6 (Sunday = 0, Monday = 1, ..., Saturday = 6)
+     * but Wiring uses 1 - 7 instead of 0 - 6.
      */
-    bool isValid() const { return (scheduleItemType != ScheduleItemType::NONE); };
+    int weekday() const { return tm_wday + 1; };
 
     /**
-     * @brief Get number of seconds in the time range at a given time
+     * @brief Returns the month of the year 1 - 12 (1 = January, 2 = February, ...)
      * 
-     * @param conv The timezone and date information for time span calculation
-     * @return time_t 
+     * Note: the underlying struct tm tm_mon is 0 - 11, but this returns the more common 1 - 12.
+     */
+    int month() const { return tm_mon + 1; };
+
+    /**
+     * @brief Returns the 4-digit year
+     */
+    int year() const { return tm_year + 1900; };
+
+    /**
+     * @brief Gets the local time as a LocalTimeHMS object
+     */
+    LocalTimeHMS hms() const;
+
+    /**
+     * @brief Sets the local time from a LocalTimeHMS object
+     */
+    void setHMS(LocalTimeHMS hms);
+
+    /**
+     * @brief Get the date portion of this object as a LocalTimeYMD
      * 
-     * The conv object is necessary because getTimeSpan takes into account daylight saving transitions.
-     * When springing forward to daylight saving, from 01:15:00 to 03:15:00 is only one hour because of the 
-     * DST transition.
+     * @return LocalTimeYMD 
      */
-    time_t getTimeSpan(const LocalTimeConvert &conv) const {
-        return timeRange.getTimeSpan(conv);
-    }
+    LocalTimeYMD ymd() const;
 
     /**
-     * @brief Update the conv object to point at the next schedule item
+     * @brief Converts the specified local time into a UTC time
      * 
-     * @param conv LocalTimeConvert object, may be modified
-     * @return true if there is an item available or false if not. if false, conv will be unchanged.
+     * There are some caveats to this that occur on when the time change
+     * occurs. On spring forward, there is an hour that doesn't technically
+     * map to a UTC time. For example, in the United States, 2:00 AM to 3:00 AM
+     * local time doesn't exist because at 2:00 AM local time, the local time
+     * springs forward to 3:00 AM. 
      * 
-     * This method finds the next scheduled time of this item, if it's in the near future.
-     * The LocalTime::instance().getScheduleLookaheadDays() setting determines how far in the future
-     * to check; the default is 100 days. The way schedules work each day needs to be checked to make
-     * sure all of the constraints are met, so long look-aheads are computationally intensive. This
-     * is not normally an issue, because the idea is that you'll wake from sleep or check the
-     * schedule at least every few days, at which point the new schedule may be available.
+     * When falling back, the hour from 1:00 AM to 2:00 AM is not unique, 
+     * because it happens twice, once in DST before falling back, and a second
+     * time after falling back. The toUTC() function returns the second one
+     * that occurs in standard time. 
+     * 
+     * Pass pKind to find out if the time was in one of these cases. See
+     * LocalTimePosixTimezone::localToUTC(), which does the conversion.
      */
-    bool getNextScheduledTime(LocalTimeConvert &conv) const;
+    time_t toUTC(const LocalTimePosixTimezone &config, LocalTimePosixTimezone::LocalTimeKind *pKind = NULL) const;
 
     /**
-     * @brief For restricted time ranges, get the last date (YMD) that this time range could be valid
+     * @brief Converts time from ISO-8601 format, ignoring the timezone 
      * 
-     * @return LocalTimeYMD 
+     * @param str The string to convert
      * 
-     * This will return the empty date for most cases. A valid value is returned if the LocalTimeRestrictedDate
-     * is used, and an only on date is set. In this case, there's as point in time where this range will 
-     * never be true. This is used to optimize scheduling.
+     * The string should be of the form:
+     * 
+     * YYYY-MM-DDTHH:MM:SS
+     * 
+     * The T can be any single character, such as a space. For example: 
+     * 
+     * 2021-04-01 10:00:00
+     * 
+     * Any characters after the seconds are ignored.
      */
-    LocalTimeYMD getExpirationDate() const {
-        return timeRange.getExpirationDate();
-    }
+    void fromString(const char *str);
 
     /**
-     * @brief Creates an object from JSON
+     * @brief Returns which week of this day it is
      * 
-     * @param jsonObj The schedule. This should be the object containing the values, not the array.
+     * For example, if this day is a Friday and it's the first Friday of the month, then
+     * 1 is returned. If it's the second Friday, then 2 is returned.
      * 
-     * Keys:
-     * - m (integer) ScheduleItemType (1 = minute of hour, 2 = hour of day, 3 = day of week, 4 = day of month)
-     * - i (integer) increment or ordinal value
-     * - d (integer) dayOfWeek value (optional, only used for DAY_OF_WEEK_OF_MONTH)
-     * - f (integer) flag bits (optional)
-     * - n (string) a user-defined name for this item (optional)
-     * - s (string) The start time (HH:MM:SS format, can omit MM or SS) [from LocalTimeRange via LocalTimeRange]
-     * - e (string) The end time (HH:MM:SS format, can omit MM or SS) [from LocalTimeRange via LocalTimeRange]
-     * - y (integer) mask value for onlyOnDays [from LocalTimeRestrictedDate via LocalTimeRange]
-     * - a (array) Array of YYYY-MM-DD value strings to allow [from LocalTimeRestrictedDate via LocalTimeRange]
-     * - x (array) Array of YYYY-MM-DD values to exclude [from LocalTimeRestrictedDate via LocalTimeRange]
+     * (This is different than the week number of the month, which depends on which day
+     * you begin the week on.)
      */
-    void fromJson(JSONValue jsonObj);
-
+    int ordinal() const;
 
-    LocalTimeRange timeRange; //!< Range of local time, inclusive
-    int increment = 0; //!< Increment value, or sometimes ordinal value
-    int dayOfWeek = 0; //!< Used for DAY_OF_WEEK_OF_MONTH only
-    int flags = 0; //!< Optional scheduling flags
-    String name; //!< Optional name
-    ScheduleItemType scheduleItemType = ScheduleItemType::NONE; //!< The type of schedule item
 };
 
+
 /**
- * @brief A complete time schedule
- * 
- * A time schedule consists of minute multiples ("every 15 minutes"), optionally within a time range (all day, 
- * or from 09:00:00 to 17:00:00 local time, for example.
- * 
- * It can also have hour multiples, optionally in a time range, at a defined minute ("every 4 hours at :15 
- * past the hour").
+ * @brief Precomputed table of timezone transitions over a span of years
  * 
- * Schedules can be at a specifc day week, with an ordinal (first Monday, last Friday) at a specific time, 
- * optionally with exceptions.
+ * Evaluating the LocalTimeChange rules requires calendar calculations. If you convert many 
+ * times in the same timezone, you can instead build a table of every transition once, and
+ * conversion becomes a search in a sorted array plus an add. It's similar to the tzfile
+ * format: a sorted array of times, each with an index into a small array of types
+ * (offset and DST flag).
  * 
- * Schedules can be a specific day of the month (the 1st, the 5th of the month, the last day of the month, the 
- * second to last day of month).
+ * The table does not refer to anything else once built, so one table can be shared by
+ * any number of LocalTimeConvert objects using withTransitionTable(). Times outside of the 
+ * span of years are converted using the rules in the config as usual.
  * 
- * It can also have any number of specific times in the day ("at 08:17:30 local time, 18:15:20 local time")
- * every day, specific days of the week, on specific dates, or with date exceptions.
+ * For a timezone with DST, the table has at most three entries per year, so 2000 to 2100
+ * is about 300 entries.
  */
-class LocalTimeSchedule {
+class LocalTimeTransitionTable {
 public:
     /**
-     * @brief Construct a new, empty schedule
+     * @brief Offset information that applies at and after a transition
      */
-    LocalTimeSchedule() {
-    }
-
+    struct Type {
+        int32_t offset;     //!< Seconds to add to UTC to get local time
+        uint8_t isDST;      //!< 1 if daylight saving time
+        uint8_t position;   //!< LocalTimeConvert::Position as an integer
+    };
 
     /**
-     * @brief Adds a minute multiple schedule in a time range
+     * @brief Build the table from a timezone configuration
      * 
-     * @param increment Number of minutes (must be 1 <= minutes <= 59). A value that is is divisible by is recommended.
-     * @param timeRange When to apply this minute multiple and/or minute offset (optional)
+     * @param config The timezone configuration
+     * @param startYear First year in the table (inclusive, for example 2000)
+     * @param endYear Last year in the table (inclusive, for example 2100)
+     * @return true if the table was built, false if the config is not valid or the years are out of order
      * 
-     * This schedule publishes every n minutes within the hour. This really is every hour, not rolling, so you
-     * should use a value that 60 is divisible by (2, 3, 4, 5, 6, 10, 12, 15, 20, 30) otherwise there will be
-     * an inconsistent period at the top of the hour.
+     * The span is in UTC years, from January 1 of startYear to the end of December 31 of endYear.
+     */
+    bool build(const LocalTimePosixTimezone &config, int startYear = 2000, int endYear = 2100);
+
+    /**
+     * @brief Clears the table and releases its memory
+     */
+    void clear();
+
+    /**
+     * @brief Returns true if the table has been built
+     */
+    bool isValid() const { return !times.empty(); };
+
+    /**
+     * @brief Returns true if time is covered by this table
      * 
-     * If you specify a time range that does not start at 00:00:00 you can customize which minute the schedule
-     * starts at. For example: `15, LocalTimeRange(LocalTimeHMS("00:05:00"), LocalTimeHMS("23:59:59")` 
-     * will schedule every 15 minutes, but starting at 5 minutes past the hour, so 05:00, 20:00, 35:00, 50:00.
+     * @param time time_t UTC
+     */
+    bool isInRange(time_t time) const { return isValid() && time >= times[0] && time < rangeEnd; };
+
+    /**
+     * @brief Find the index of the entry that applies to a time
      * 
-     * The largest value for hmsEnd of the time range is 23:59:59.
+     * @param time time_t UTC
+     * @return int Index into times and typeIndex, or -1 if not in range
      * 
-     * @return LocalTimeSchedule& 
-     */        
-    LocalTimeSchedule &withMinuteOfHour(int increment, LocalTimeRange timeRange = LocalTimeRange());
+     * Transitions are spaced fairly evenly through the years, so this first tries an 
+     * interpolated guess and only does a binary search if the guess is wrong.
+     */
+    int find(time_t time) const;
+
+    /**
+     * @brief Looks up the UTC offset for a time
+     * 
+     * @param time time_t UTC
+     * @param pOffset Filled in with the seconds to add to UTC to get local time. Can be NULL.
+     * @param pIsDST Filled in with true if in daylight saving time. Can be NULL.
+     * @return true if the time is in range. If false, the outputs are not modified.
+     */
+    bool lookup(time_t time, int32_t *pOffset, bool *pIsDST = NULL) const;
 
+    /**
+     * @brief Returns the number of entries in the table
+     */
+    size_t size() const { return times.size(); };
 
     /**
-     * @brief Adds multiple times periodically in a time range with an hour increment
+     * @brief Get the Type for an entry
+     * 
+     * @param index Index from find(), must be valid
+     */
+    const Type &getType(size_t index) const { return types[typeIndex[index]]; };
+
+    /**
+     * @brief Get the DST start and standard time start for the year of an entry
+     * 
+     * @param index Index from find(), must be valid
+     * @param pDstStart Filled in with the time DST starts (UTC). Can be NULL.
+     * @param pStandardStart Filled in with the time standard time starts (UTC). Can be NULL.
+     * 
+     * These are the same values as LocalTimeConvert::dstStart and standardStart. They're
+     * only meaningful if the timezone has DST.
+     */
+    void getTransitions(size_t index, time_t *pDstStart, time_t *pStandardStart) const;
+
+    LocalTimePosixTimezone config; //!< Timezone configuration the table was built from
+    int startYear = 0;              //!< First year in the table
+    int endYear = 0;                //!< Last year in the table
+    time_t rangeEnd = 0;            //!< End of the table (exclusive), January 1 of the year after endYear (UTC)
+
+    std::vector<time_t> times;      //!< Sorted start time of each entry (UTC). The first is January 1 of startYear.
+    std::vector<uint8_t> typeIndex; //!< Index into types for each entry
+    std::vector<uint16_t> yearIndex; //!< Year of each entry, relative to startYear
+    std::vector<Type> types;        //!< Distinct offsets used in the table
+    std::vector<time_t> yearTransitions; //!< DST start and standard time start for each year (2 values per year)
+};
+
+/**
+ * @brief Small integer handle for a timezone in a LocalTimeZoneRegistry
+ */
+typedef uint16_t LocalTimeZoneHandle;
+
+/**
+ * @brief Registry of timezones, each parsed once and referred to by a small integer handle
+ * 
+ * This is intended for servers that convert times for many devices that share a small number 
+ * of distinct POSIX timezone strings. Instead of keeping a LocalTimePosixTimezone in each 
+ * device record, intern the string once and keep the 2-byte handle. The registry owns the 
+ * parsed configuration and a LocalTimeTransitionTable for each distinct string, so memory is 
+ * proportional to the number of zones, not devices.
+ * 
+ * Handles are assigned sequentially starting from 0 and remain valid for the life of the
+ * registry. Interning a new string is serialized with a mutex, but finding a string that has
+ * already been interned (a hash table lookup) and looking up a handle do not lock and are 
+ * safe from any thread. Entries are never moved once added, so the pointers returned
+ * by getConfig() and getTransitionTable() remain valid as well.
+ * 
+ * On a device you will typically not need this class; set the timezone using 
+ * LocalTime::withConfig() instead.
+ */
+class LocalTimeZoneRegistry {
+public:
+    /**
+     * @brief Construct a new, empty registry
+     * 
+     * Most code uses the singleton instance(), but you can create separate registries.
+     */
+    LocalTimeZoneRegistry();
+
+    /**
+     * @brief Destructor. All handles and pointers from this registry become invalid.
+     */
+    ~LocalTimeZoneRegistry();
+
+    /**
+     * @brief This class is not copyable
+     */
+    LocalTimeZoneRegistry(const LocalTimeZoneRegistry&) = delete;
+
+    /**
+     * @brief This class is not copyable
+     */
+    LocalTimeZoneRegistry &operator=(const LocalTimeZoneRegistry&) = delete;
+
+    /**
+     * @brief Get the singleton instance of this class
+     */
+    static LocalTimeZoneRegistry &instance();
+
+    /**
+     * @brief Sets the years to build transition tables for
+     * 
+     * @param startYear First year (inclusive), default is 2000
+     * @param endYear Last year (inclusive), default is 2100
+     * 
+     * This only affects zones interned after this call. Times outside of the span are still 
+     * converted correctly, just using the timezone rules instead of the table.
+     */
+    LocalTimeZoneRegistry &withTransitionYears(int startYear, int endYear) {
+        this->startYear = startYear;
+        this->endYear = endYear;
+        return *this;
+    }
+
+    /**
+     * @brief Get the handle for a POSIX timezone string, adding it to the registry if necessary
+     * 
+     * @param tzStr Timezone string, for example "EST5EDT,M3.2.0/2:00:00,M11.1.0/2:00:00"
+     * @return LocalTimeZoneHandle The handle, or INVALID_HANDLE if the string cannot be parsed
+     * or the registry is full
+     * 
+     * The string is only parsed the first time it's seen. Strings are compared exactly, so 
+     * equivalent strings that differ in spelling get different handles.
+     */
+    LocalTimeZoneHandle intern(const char *tzStr);
+
+    /**
+     * @brief Get the handle for a POSIX timezone string without adding it
+     * 
+     * @param tzStr Timezone string
+     * @return LocalTimeZoneHandle The handle, or INVALID_HANDLE if the string has not been interned
+     */
+    LocalTimeZoneHandle find(const char *tzStr) const;
+
+    /**
+     * @brief Returns true if handle refers to a timezone in this registry
+     */
+    bool isValid(LocalTimeZoneHandle handle) const { return handle < count.load(std::memory_order_acquire); };
+
+    /**
+     * @brief Get the parsed timezone configuration for a handle
+     * 
+     * @param handle Handle from intern()
+     * @return const LocalTimePosixTimezone* The configuration, or NULL if the handle is not valid
+     * 
+     * The configuration is shared by all threads, so use calculateTransitions() on it, or make a
+     * copy, instead of the methods that update its transition cache.
+     */
+    const LocalTimePosixTimezone *getConfig(LocalTimeZoneHandle handle) const;
+
+    /**
+     * @brief Get the transition table for a handle
+     * 
+     * @param handle Handle from intern()
+     * @return const LocalTimeTransitionTable* The table, or NULL if the handle is not valid
+     * 
+     * The config member of the table is the same configuration returned by getConfig(). Pass
+     * this to LocalTimeConvert::withTransitionTable(), or use LocalTimeConvert::withZone().
+     */
+    const LocalTimeTransitionTable *getTransitionTable(LocalTimeZoneHandle handle) const;
+
+    /**
+     * @brief Get the timezone string that was interned for a handle
+     * 
+     * @param handle Handle from intern()
+     * @return const char* The string, or NULL if the handle is not valid
+     */
+    const char *getString(LocalTimeZoneHandle handle) const;
+
+    /**
+     * @brief Returns the number of distinct timezones in the registry
+     */
+    size_t size() const { return count.load(std::memory_order_acquire); };
+
+    static const LocalTimeZoneHandle INVALID_HANDLE = 0xffff; //!< Returned when a timezone is not valid
+    static const size_t CHUNK_SIZE = 32; //!< Number of entries allocated at a time
+    static const size_t MAX_CHUNKS = 128; //!< Maximum number of chunks (4096 timezones)
+    static const size_t NUM_BUCKETS = 512; //!< Number of hash buckets for intern() and find(), must be a power of 2
+
+protected:
+    /**
+     * @brief Data for one interned timezone, allocated in chunks of CHUNK_SIZE
+     */
+    struct Entry {
+        uint32_t hash;                  //!< Hash of the string, to speed up intern() and find()
+        LocalTimeZoneHandle next = INVALID_HANDLE; //!< Next (older) entry in the same hash bucket
+        String tzStr;                   //!< The original timezone string
+        LocalTimeTransitionTable table; //!< Transition table, including the parsed config
+    };
+
+    /**
+     * @brief Get the entry for a handle. The handle must be valid.
+     */
+    const Entry &getEntry(LocalTimeZoneHandle handle) const { return chunks[handle / CHUNK_SIZE][handle % CHUNK_SIZE]; };
+
+    /**
+     * @brief Finds an existing entry by walking its hash bucket. Does not lock.
+     * 
+     * A reader that races with intern() of the same string may not find it yet, but never 
+     * sees an incomplete entry. With the mutex held, all entries are found.
+     */
+    LocalTimeZoneHandle findHash(const char *tzStr, uint32_t hash) const;
+
+    /**
+     * @brief Hash function for timezone strings (FNV-1a)
+     */
+    static uint32_t hashString(const char *tzStr);
+
+    Entry *chunks[MAX_CHUNKS] = {}; //!< Entries, allocated CHUNK_SIZE at a time so they never move
+    std::atomic<uint16_t> count;    //!< Number of valid entries, published after the entry is complete
+    std::atomic<LocalTimeZoneHandle> buckets[NUM_BUCKETS]; //!< Newest entry for each hash bucket, or INVALID_HANDLE
+    std::mutex mutex;               //!< Serializes intern()
+    int startYear = 2000;           //!< First year for transition tables
+    int endYear = 2100;             //!< Last year for transition tables
+
+    static std::atomic<LocalTimeZoneRegistry *> _instance; //!< Singleton instance of this class
+};
+
+class LocalTimeConvert; // Forward declaration
+class LocalTimeScheduleOccurrences; // Forward declaration
+
+/**
+ * @brief Class to hold a time range in local time in HH:MM:SS format
+ * 
+ * Added in 0.1.0 (2023-11-25): The ability for hmsStart to be > hmsEnd. In this case, the time range is assumed
+ * to cross midnight and to essentially be two separate ranges. 
+ */
+class LocalTimeRange : public LocalTimeRestrictedDate {
+public: 
+    /**
+     * @brief Construct a new Time Range object with the range of the entire day (inclusive) 
+     * 
+     * This is start = 00:00:00, end = 23:59:59. The system clock does not have a concept of leap seconds.
+     */
+    LocalTimeRange() : LocalTimeRestrictedDate(LocalTimeDayOfWeek::MASK_ALL), hmsStart(LocalTimeHMS::startOfDay), hmsEnd(LocalTimeHMS::endOfDay) {
+    }
+
+    /**
+     * @brief Construct a new Time Range object with the specifies start and end times.
+     * 
+     * @param hmsStart Start time in local time 00:00:00 <= hmsStart <= 23:59:59
+     * @param hmsEnd  End time in local time 00:00:00 <= hmsStart <= 23:59:59 (optional)
+     * 
+     * Note that 24:00:00 is not a valid time. You should generally use inclusive times such that
+     * 23:59:59 is the end of the day.
+     * 
+     */
+    LocalTimeRange(LocalTimeHMS hmsStart, LocalTimeHMS hmsEnd = LocalTimeHMS::endOfDay) : LocalTimeRestrictedDate(LocalTimeDayOfWeek::MASK_ALL), hmsStart(hmsStart), hmsEnd(hmsEnd) {
+    }
+
+    /**
+     * @brief Construct a new object that specifies start time, end time, and date restrictions
+     * 
+     * @param hmsStart Start time in local time 00:00:00 <= hmsStart <= 23:59:59
+     * @param hmsEnd  End time in local time 00:00:00 <= hmsStart <= 23:59:59
+     * @param dateRestriction Only use this time range on certain dates
+     */
+    LocalTimeRange(LocalTimeHMS hmsStart, LocalTimeHMS hmsEnd, LocalTimeRestrictedDate dateRestriction) : LocalTimeRestrictedDate(dateRestriction), hmsStart(hmsStart), hmsEnd(hmsEnd) {
+    }
+
+    /**
+     * @brief Construct a new object that specifies start time and date restrictions, used for at time and date schedules
+     * 
+     * @param hmsStart Start time in local time 00:00:00 <= hmsStart <= 23:59:59
+     * @param hmsEnd  End time in local time 00:00:00 <= hmsStart <= 23:59:59
+     * @param dateRestriction Only use this time range on certain dates
+     */
+    LocalTimeRange(LocalTimeHMS hmsStart, LocalTimeRestrictedDate dateRestriction) : LocalTimeRestrictedDate(dateRestriction), hmsStart(hmsStart) {
+        hmsEnd = LocalTimeHMS::endOfDay;
+    }
+
+    /**
+     * @brief Clear time range to all day, every day
+     */
+    void clear() {
+        hmsStart = LocalTimeHMS::startOfDay;
+        hmsEnd = LocalTimeHMS::endOfDay;
+
+        // Default to all days
+        LocalTimeRestrictedDate::clear();
+        LocalTimeRestrictedDate::withOnAllDays();
+    }
+
+    /**
+     * @brief Returns true if the time range is the whole day (00:00:00 to 23:59:59 inclusive)
+     * 
+     * @return true 
+     * @return false 
+     */
+    bool isWholeDay() const {
+        return (hmsStart == LocalTimeHMS::startOfDay) && (hmsEnd == LocalTimeHMS::endOfDay);
+    }
+
+    /**
+     * @brief Get the number of seconds between start and end based on a LocalTimeConvert object
+     * 
+     * The reason for the conv object is that it contains the time to calculate at, as well as 
+     * the daylight saving time settings. This methods takes into account the actual number of
+     * seconds including when a time change is crossed.
+     * 
+     * @param conv The time and timezone settings to calculate the time span at
+     * @return time_t Time difference in seconds
+     * 
+     * In the weird case that start > end, it can return a negative value, as time_t is a signed
+     * long (or long long) value.
+     * 
+     * This does not take into account date restrictions!
+     */
+    time_t getTimeSpan(const LocalTimeConvert &conv) const;
+
+    /**
+     * @brief Compares a time (LocalTimeHHS, local time) to this time range
+     * 
+     * @param hms 
+     * @return int -1 if hms is before hmsStart, 0 if in range, +1 if hms is after hmsEnd
+     */
+    int compareTo(LocalTimeHMS hms) const {
+        if (hms < hmsStart) {
+            return -1;
+        }
+        else
+        if (hms > hmsEnd) {
+            return +1;
+        }
+        else {
+            return 0;
+        }
+    }
+
+    /**
+     * @brief Returns true if the date restrictions allow this day 
+     * 
+     * @param ymd 
+     * @return true 
+     * @return false 
+     */
+    bool isValidDate(LocalTimeYMD ymd) const {
+        return LocalTimeRestrictedDate::isValid(ymd);
+    }
+
+    /**
+     * @brief Returns true if the date restrictions allow this date and the time is in this range (inclusive)
+     * 
+     * @param localTimeValue 
+     * @return true 
+     * @return false 
+     */
+    bool inRange(LocalTimeValue localTimeValue) const {
+        if (isValidDate(localTimeValue)) {
+            LocalTimeHMS hms = localTimeValue.hms();
+            return isInRangeHMS(hms);
+        }
+        else {
+            return false;
+        }
+    }
+
+    /**
+     * @brief Returns true if start >= end (range crosses midnight)
+     * 
+     * @return true 
+     * @return false 
+     */
+    bool rangeCrossesMidnight() const {
+        return hmsStart > hmsEnd;
+    }
+
+    /**
+     * @brief Returns true if the specified time is in the time range (ignoring date restrictions)
+     * 
+     * @return true 
+     * @return false 
+     */
+    bool isInRangeHMS(LocalTimeHMS hms) const {
+        if (!rangeCrossesMidnight()) {
+            return (hmsStart <= hms) && (hms <= hmsEnd);
+        }
+        else {
+            // Range crosses midnight (hmsEnd < hmsStart)
+            // Is not in range if hmsEnd < hms < hmsStart
+            return !((hmsEnd < hms) && (hms < hmsStart));
+        }
+    }
+    
+
+    /**
+     * @brief For restricted time ranges, get the last date (YMD) that this time range could be valid
+     * 
+     * @return LocalTimeYMD 
+     * 
+     * This will return the empty date for most cases. A valid value is returned if the LocalTimeRestrictedDate
+     * is used, and an only on date is set. In this case, there's as point in time where this range will 
+     * never be true. This is used to optimize scheduling.
+     */
+    LocalTimeYMD getExpirationDate() const {
+        return LocalTimeRestrictedDate::getExpirationDate();
+    }
+
+    /**
+     * @brief Set the date restrictions from a LocalTimeHMSRestricted object
+     * 
+     * @param hms LocalTimeHMSRestricted, really only uses the date restrictions, not the HMS part
+     */
+    void fromTime(LocalTimeHMSRestricted hms) {
+        *(LocalTimeRestrictedDate *)this = hms;
+        hmsStart = hms;
+    }
+
+    /**
+     * @brief Fills in the time range from a JSON object
+     * 
+     * @param jsonObj 
+     * 
+     * Keys:
+     * - s (string) The start time (HH:MM:SS format, can omit MM or SS)
+     * - e (string) The end time (HH:MM:SS format, can omit MM or SS)
+     */
+    void fromJson(JSONValue jsonObj);
+
+    LocalTimeHMS hmsStart; //!< Starting time, inclusive
+    LocalTimeHMS hmsEnd; //!< Ending time, inclusive
+};
+
+
+
+/**
+ * @brief A single item in a schedule, such as minute of hour, hour of day, or a specific time.
+ */
+class LocalTimeScheduleItem {
+public: 
+    /**
+     * @brief Type of schedule item this is
+     */
+    enum class ScheduleItemType : int {
+        NONE = 0,               //!< No schedule defined
+        MINUTE_OF_HOUR,         //!< Minute of the hour (1)
+        HOUR_OF_DAY,            //!< Hour of day (2)
+        DAY_OF_WEEK_OF_MONTH,   //!< The nth day of week of the month (3)
+        DAY_OF_MONTH,           //!< Day of the month (4)
+        TIME                    //!< Specific time (5)    
+    };
+
+    /**
+     * @brief Default constructor. Set increment and optionally timeRange to use.
+     */
+    LocalTimeScheduleItem() {
+    }
+
+    /**
+     * @brief Returns true ScheduleItemType is not NONE
+     * 
+     * @return true 
+     * @return false 
+     * 
+     * This is used to check if an object was constructed by the default constructor and never set.
+     */
+    bool isValid() const { return (scheduleItemType != ScheduleItemType::NONE); };
+
+    /**
+     * @brief Get number of seconds in the time range at a given time
+     * 
+     * @param conv The timezone and date information for time span calculation
+     * @return time_t 
+     * 
+     * The conv object is necessary because getTimeSpan takes into account daylight saving transitions.
+     * When springing forward to daylight saving, from 01:15:00 to 03:15:00 is only one hour because of the 
+     * DST transition.
+     */
+    time_t getTimeSpan(const LocalTimeConvert &conv) const {
+        return timeRange.getTimeSpan(conv);
+    }
+
+    /**
+     * @brief Update the conv object to point at the next schedule item
+     * 
+     * @param conv LocalTimeConvert object, may be modified
+     * @return true if there is an item available or false if not. if false, conv will be unchanged.
+     * 
+     * This method finds the next scheduled time of this item, if it's in the near future.
+     * The LocalTime::instance().getScheduleLookaheadDays() setting determines how far in the future
+     * to check; the default is 100 days. The way schedules work each day needs to be checked to make
+     * sure all of the constraints are met, so long look-aheads are computationally intensive. This
+     * is not normally an issue, because the idea is that you'll wake from sleep or check the
+     * schedule at least every few days, at which point the new schedule may be available.
+     */
+    bool getNextScheduledTime(LocalTimeConvert &conv) const;
+
+    /**
+     * @brief Get the first local time of day this item is scheduled after a given local time of day
+     * 
+     * @param seconds Local time of day in seconds. Can be negative to get the first time of the day.
+     * @return int Local time of day in seconds, or -1 if there are no more times that day
+     * 
+     * All types are scheduled at the start of the time range. MINUTE_OF_HOUR is also scheduled every
+     * hour at the minutes that are the same as the start minute modulo increment, at the start second, 
+     * before (not at) the end of the time range. HOUR_OF_DAY is also scheduled every increment hours
+     * after the start, up to and including the end.
+     * 
+     * This does not check the date restrictions of the time range.
+     */
+    int nextTimeOfDay(int seconds) const;
+
+    /**
+     * @brief For restricted time ranges, get the last date (YMD) that this time range could be valid
+     * 
+     * @return LocalTimeYMD 
+     * 
+     * This will return the empty date for most cases. A valid value is returned if the LocalTimeRestrictedDate
+     * is used, and an only on date is set. In this case, there's as point in time where this range will 
+     * never be true. This is used to optimize scheduling.
+     */
+    LocalTimeYMD getExpirationDate() const {
+        return timeRange.getExpirationDate();
+    }
+
+    /**
+     * @brief Creates an object from JSON
+     * 
+     * @param jsonObj The schedule. This should be the object containing the values, not the array.
+     * 
+     * Keys:
+     * - m (integer) ScheduleItemType (1 = minute of hour, 2 = hour of day, 3 = day of week, 4 = day of month)
+     * - i (integer) increment or ordinal value
+     * - d (integer) dayOfWeek value (optional, only used for DAY_OF_WEEK_OF_MONTH)
+     * - f (integer) flag bits (optional)
+     * - n (string) a user-defined name for this item (optional)
+     * - s (string) The start time (HH:MM:SS format, can omit MM or SS) [from LocalTimeRange via LocalTimeRange]
+     * - e (string) The end time (HH:MM:SS format, can omit MM or SS) [from LocalTimeRange via LocalTimeRange]
+     * - y (integer) mask value for onlyOnDays [from LocalTimeRestrictedDate via LocalTimeRange]
+     * - a (array) Array of YYYY-MM-DD value strings to allow [from LocalTimeRestrictedDate via LocalTimeRange]
+     * - x (array) Array of YYYY-MM-DD values to exclude [from LocalTimeRestrictedDate via LocalTimeRange]
+     */
+    void fromJson(JSONValue jsonObj);
+
+
+    LocalTimeRange timeRange; //!< Range of local time, inclusive
+    int increment = 0; //!< Increment value, or sometimes ordinal value
+    int dayOfWeek = 0; //!< Used for DAY_OF_WEEK_OF_MONTH only
+    int flags = 0; //!< Optional scheduling flags
+    String name; //!< Optional name
+    ScheduleItemType scheduleItemType = ScheduleItemType::NONE; //!< The type of schedule item
+
+protected:
+    /**
+     * @brief Used by getNextScheduledTime() for MINUTE_OF_HOUR and HOUR_OF_DAY on days the UTC offset changes
+     * 
+     * @param dayConv The local day to check
+     * @param fromSeconds Only check local times of day > fromSeconds
+     * @param time Results must be > time (UTC)
+     * @return time_t The time (UTC) or 0 if there is none on that day
+     */
+    time_t nextTimeAfterTimeChange(const LocalTimeConvert &dayConv, int fromSeconds, time_t time) const;
+};
+
+/**
+ * @brief A complete time schedule
+ * 
+ * A time schedule consists of minute multiples ("every 15 minutes"), optionally within a time range (all day, 
+ * or from 09:00:00 to 17:00:00 local time, for example.
+ * 
+ * It can also have hour multiples, optionally in a time range, at a defined minute ("every 4 hours at :15 
+ * past the hour").
+ * 
+ * Schedules can be at a specifc day week, with an ordinal (first Monday, last Friday) at a specific time, 
+ * optionally with exceptions.
+ * 
+ * Schedules can be a specific day of the month (the 1st, the 5th of the month, the last day of the month, the 
+ * second to last day of month).
+ * 
+ * It can also have any number of specific times in the day ("at 08:17:30 local time, 18:15:20 local time")
+ * every day, specific days of the week, on specific dates, or with date exceptions.
+ */
+class LocalTimeSchedule {
+public:
+    /**
+     * @brief Construct a new, empty schedule
+     */
+    LocalTimeSchedule() {
+    }
+
+
+    /**
+     * @brief Adds a minute multiple schedule in a time range
+     * 
+     * @param increment Number of minutes (must be 1 <= minutes <= 59). A value that is is divisible by is recommended.
+     * @param timeRange When to apply this minute multiple and/or minute offset (optional)
+     * 
+     * This schedule publishes every n minutes within the hour. This really is every hour, not rolling, so you
+     * should use a value that 60 is divisible by (2, 3, 4, 5, 6, 10, 12, 15, 20, 30) otherwise there will be
+     * an inconsistent period at the top of the hour.
+     * 
+     * If you specify a time range that does not start at 00:00:00 you can customize which minute the schedule
+     * starts at. For example: `15, LocalTimeRange(LocalTimeHMS("00:05:00"), LocalTimeHMS("23:59:59")` 
+     * will schedule every 15 minutes, but starting at 5 minutes past the hour, so 05:00, 20:00, 35:00, 50:00.
+     * 
+     * The largest value for hmsEnd of the time range is 23:59:59.
+     * 
+     * @return LocalTimeSchedule& 
+     */        
+    LocalTimeSchedule &withMinuteOfHour(int increment, LocalTimeRange timeRange = LocalTimeRange());
+
+
+    /**
+     * @brief Adds multiple times periodically in a time range with an hour increment
      * 
      * @param hourMultiple Hours between items must be >= 1. For example: 2 = every other hour.
      * @param timeRange Time range to add items to. This is optional; if not specified then the entire day. 
      * Also is used to specify a minute offset.
      * 
-     * @return LocalTimeSchedule& 
+     * @return LocalTimeSchedule& 
+     * 
+     * Hours are per day, local time. For whole-day schedules, you will typically use a value that
+     * 24 is evenly divisible by (2, 3, 4, 6, 8, 12), because otherwise the time periods will brief
+     * unequal at midnight.
+     * 
+     * Also note that times are local, and take into account daylight saving. Thus during a time switch,
+     * the interval may end up being a different number of hours than specified. For example, if the
+     * times would have been 00:00 and 04:00, a hourMultiple of 4, and you do this over a spring forward, 
+     * the actual number hours between 00:00 and 04:00 is 5 (at least in the US where DST starts at 2:00).
+     */
+    LocalTimeSchedule &withHourOfDay(int hourMultiple, LocalTimeRange timeRange = LocalTimeRange());
+
+    /**
+     * @brief Schedule an item on a specific instance of a day of week of the month
+     * 
+     * @param dayOfWeek Day of week 0 = Sunday, 1 = Monday, ..., 6 = Saturday
+     * @param instance 1 = first week, 2 = second week, ..., -1 = last week, -2 = 2nd to last week
+     * @param timeRange Optional to restrict dates or to set a time for the item
+     * @return LocalTimeSchedule& 
+     */
+    LocalTimeSchedule &withDayOfWeekOfMonth(int dayOfWeek, int instance, LocalTimeRange timeRange = LocalTimeRange());
+
+    /**
+     * @brief Schedule an item on a specific day of the month
+     * 
+     * @param dayOfMonth 1 = 1st, 2 = 2nd of the month, ..., -1 = last day of the month, -2 = second to last day of the month, ...
+     * @param timeRange Optional to restrict dates or to set a time for the item
+     * @return LocalTimeSchedule& 
+     */
+    LocalTimeSchedule &withDayOfMonth(int dayOfMonth, LocalTimeRange timeRange = LocalTimeRange());
+
+    /**
+     * @brief Add a scheduled item at a time in local time during the day. 
+     * 
+     * @param hms The time in local time 00:00:00 to 23:59:59, optionally with date restrictions
+     * @return LocalTimeSchedule& 
+     * 
+     * You can call this multiple times, and also combine it with minute multiple schedules.
+     */
+    LocalTimeSchedule &withTime(LocalTimeHMSRestricted hms);
+
+    /**
+     * @brief Add multiple scheduled items at a time in local time during the day. 
+     * 
+     * @param timesParam an auto-initialized list of LocalTimeHMS objects
+     * @return LocalTimeSchedule& 
+     * 
+     * You can call this multiple times, and also combine it with minute multiple schedules.
+     * 
+     * schedule.withTimes({LocalTimeHMS("06:00"), LocalTimeHMS("18:30")});
+     */
+    LocalTimeSchedule &withTimes(std::initializer_list<LocalTimeHMSRestricted> timesParam);
+
+    /**
+     * @brief Sets the name of this schedule (optional)
+     * 
+     * @param name 
+     * @return LocalTimeSchedule& 
+     */
+    LocalTimeSchedule &withName(const char *name) {
+        this->name = name;
+        return *this;
+    }
+
+    /**
+     * @brief Sets the flags for this schedule (optional)
+     * 
+     * @param flags 
+     * @return LocalTimeSchedule& 
+     */
+    LocalTimeSchedule &withFlags(uint32_t flags) {
+        this->flags = flags;
+        return *this;
+    }
+
+    /**
+     * @brief Sets the timezone used by isScheduledTime() (optional)
+     * 
+     * @param zone Handle from LocalTimeZoneRegistry::intern() in the singleton registry
+     * @return LocalTimeSchedule& 
+     * 
+     * If not set, isScheduledTime() uses the global default timezone set in the LocalTime class.
+     */
+    LocalTimeSchedule &withZone(LocalTimeZoneHandle zone) {
+        this->zone = zone;
+        return *this;
+    }
+
+
+    /**
+     * @brief Returns true if the schedule does not have any items in it
+     * 
+     * @return true 
+     * @return false 
+     */
+    bool isEmpty() const { 
+        return scheduleItems.empty();
+    }
+
+    /**
+     * @brief Clear the existing settings
+     */
+    void clear() {
+        scheduleItems.clear();   
+    }
+
+    /**
+     * @brief Set the schedule from a JSON string containing an array of objects.
+     * 
+     * @param jsonStr 
+     * 
+     * See the overload that takes a JSONValue if the JSON string has already been parsed.
+     */
+    void fromJson(const char *jsonStr);
+
+    /**
+     * @brief Set the schedule of this object from a JSONValue, typically the outer object
+     * 
+     * @param jsonArray A JSONValue containing an array of objects
+     * 
+     * Array of LocalTimeScheduleItem objects:
+     *  - mh (integer): Minute of hour (takes place of setting m and i separately)
+     *  - hd (integer): Hour of day (takes place of setting m and i separately)
+     *  - dw (integer): Day of week (takes place of setting m and i separately)
+     *  - dm (integer): Day of month (takes place of setting m and i separately)
+     *  - tm (string) Time string in HH:MM:SS format (can omit MM and SS parts, see LocalTimeHMS) for TIME items
+     *  - m (integer) type of multiple (optional if mm, )
+     *  - i (integer) increment
+     *  - f (integer) flag bits (optional)
+     *  - s (string) The start time (HH:MM:SS format, can omit MM or SS) [from LocalTimeRange via LocalTimeRange]
+     *  - e (string) The end time (HH:MM:SS format, can omit MM or SS) [from LocalTimeRange via LocalTimeRange]
+     *  - y (integer) mask value for onlyOnDays [from LocalTimeRestrictedDate via LocalTimeRange]
+     *  - a (array) Array of YYYY-MM-DD value strings to allow [from LocalTimeRestrictedDate via LocalTimeRange]
+     *  - x (array) Array of YYYY-MM-DD values to exclude [from LocalTimeRestrictedDate via LocalTimeRange]
+     */
+    void fromJson(JSONValue jsonArray);
+
+    /**
+     * @brief Update the conv object to point at the next schedule item
+     * 
+     * @param conv LocalTimeConvert object, may be modified
+     * @return true if there is an item available or false if not. if false, conv will be unchanged.
+     * 
+     * This method finds closest scheduled time for this object, if it's in the relatively near future.
+     * The LocalTime::instance().getScheduleLookaheadDays() setting determines how far in the future
+     * to check; the default is 100 days. The way schedules work each day needs to be checked to make
+     * sure all of the constraints are met, so long look-aheads are computationally intensive. 
+     */
+    bool getNextScheduledTime(LocalTimeConvert &conv) const;
+
+    /**
+     * @brief Update the conv object to point at the next schedule item
+     * 
+     * @param conv LocalTimeConvert object, may be modified
+     * @param filter A function to determine, for each schedule item, if it should be tested
+     * @return true if there is an item available or false if not. if false, conv will be unchanged.
+     * 
+     * This method finds closest scheduled time for this object, if it's in the relatively near future.
+     * The LocalTime::instance().getScheduleLookaheadDays() setting determines how far in the future
+     * to check; the default is 100 days. The way schedules work each day needs to be checked to make
+     * sure all of the constraints are met, so long look-aheads are computationally intensive. 
+     * 
+     * The filter function or lambda has this prototype:
+     * 
+     * bool filterCallback(LocalTimeScheduleItem &item)
+     * 
+     * If should return true to check this item, or false to skip this item for schedule checking.
+     */
+    bool getNextScheduledTime(LocalTimeConvert &conv, std::function<bool(LocalTimeScheduleItem &item)> filter) const;
+
+    /**
+     * @brief Get the next scheduled time after a given time in a timezone from a LocalTimeZoneRegistry
+     * 
+     * @param zone Handle from LocalTimeZoneRegistry::intern()
+     * @param time The time to start searching from (UTC)
+     * @param registry The registry the handle came from. Default is the singleton instance.
+     * @return time_t The next scheduled time (UTC), or 0 if there is none
+     * 
+     * This allows one schedule object to be evaluated for many devices that are in different
+     * timezones, keeping only a handle per device instead of a LocalTimePosixTimezone or 
+     * LocalTimeConvert.
+     */
+    time_t getNextScheduledTime(LocalTimeZoneHandle zone, time_t time, const LocalTimeZoneRegistry &registry = LocalTimeZoneRegistry::instance()) const;
+
+    /**
+     * @brief Get the scheduled times after conv and before until, calculated as they are iterated
+     * 
+     * @param conv The time and timezone to start from. The first occurrence is after conv.time.
+     * @param until Only occurrences before this time (UTC) are returned
+     * @return LocalTimeScheduleOccurrences Range of LocalTimeConvert objects, for use in a range-based for loop
+     * 
+     * This is the same as calling getNextScheduledTime() in a loop, but much more efficient. This schedule 
+     * must not be modified or destroyed while the returned object is in use.
+     */
+    LocalTimeScheduleOccurrences occurrences(const LocalTimeConvert &conv, time_t until) const;
+
+    /**
+     * @brief Determine if it's time to run the scheduled task based on the current time and internal nextTime member variable
+     * 
+     * @return true 
+     * @return false 
+     */
+    bool isScheduledTime();
+
+    /**
+     * @brief Low-level function used for unit testing
+     * 
+     * @param conv 
+     * @param timeNow 
+     * @return true 
+     * @return false 
+     */
+    bool isScheduledTime(LocalTimeConvert &conv, time_t timeNow);
+
+    static const uint32_t FLAG_QUICK_WAKE       = 0x00000001; //!< Schedule is for quick wake
+    static const uint32_t FLAG_FULL_WAKE        = 0x00000002; //!< Schedule is for full wake with publish
+    // Other wake constants go here, up to 0x00000080
+    static const uint32_t FLAG_ANY_WAKE         = 0x000000ff; //!< Mask for any schedule that wakes
+
+    String name; //!< Name of this schedule (optional, typically used with LocalTimeScheduleManager)
+    uint32_t flags = 0; //!< Flags (optional, typically used with LocalTimeScheduleManager)
+    time_t nextTime = 0; //!< Optional, used with isScheduleTime()
+    LocalTimeZoneHandle zone = LocalTimeZoneRegistry::INVALID_HANDLE; //!< Optional, timezone used with isScheduledTime()
+    std::vector<LocalTimeScheduleItem> scheduleItems; //!< LocalTimeSchedule items
+};
+
+/**
+ * @brief A LocalTimeSchedule compiled into sorted tables for fast next scheduled time lookups
+ * 
+ * LocalTimeSchedule::getNextScheduledTime() checks each item one local day at a time, doing a full
+ * conversion for each day. This object is built once from a schedule and stores:
+ * 
+ * - For each day of the week, a sorted list of the local times of day of all items that are 
+ * only restricted by day of week
+ * - For items with other date restrictions (only on dates, except dates, day of month, nth day of 
+ * week of month), a date class with sorted only on and except date arrays and a sorted list of 
+ * local times of day
+ * 
+ * Finding the next scheduled time is then a binary search in the times of day, and finding the next
+ * valid date is a search in the date arrays or month-by-month calculation, instead of checking every day.
+ * Only the result is converted from local time to UTC.
+ * 
+ * ```
+ * LocalTimeScheduleIndex index(schedule);
+ * 
+ * LocalTimeConvert conv;
+ * conv.withCurrentTime().convert();
+ * if (index.getNextScheduledTime(conv)) {
+ *     // conv.time is the next scheduled time
+ * }
+ * ```
+ * 
+ * The results are the same as LocalTimeSchedule::getNextScheduledTime(), including the use of 
+ * LocalTime::instance().getScheduleLookaheadDays(). If you modify the schedule you must call
+ * compile() again.
+ */
+class LocalTimeScheduleIndex {
+public:
+    /**
+     * @brief Default constructor, an empty index that never has a scheduled time
+     */
+    LocalTimeScheduleIndex() {};
+
+    /**
+     * @brief Construct an index from a schedule (calls compile())
+     * 
+     * @param schedule The schedule to compile
+     */
+    LocalTimeScheduleIndex(const LocalTimeSchedule &schedule) { compile(schedule); };
+
+    /**
+     * @brief Build the index from a schedule, replacing any previous contents
+     * 
+     * @param schedule The schedule to compile. It is not referenced after this call returns.
+     * @return LocalTimeScheduleIndex& 
+     */
+    LocalTimeScheduleIndex &compile(const LocalTimeSchedule &schedule);
+
+    /**
+     * @brief Clears the index
+     */
+    void clear();
+
+    /**
+     * @brief Returns true if the index does not have any times in it
+     */
+    bool isEmpty() const;
+
+    /**
+     * @brief Update the conv object to point at the next scheduled time
+     * 
+     * @param conv LocalTimeConvert object, may be modified
+     * @return true if there is an item available or false if not. if false, conv will be unchanged.
+     * 
+     * This is the same as LocalTimeSchedule::getNextScheduledTime() for the schedule this index was compiled from.
+     */
+    bool getNextScheduledTime(LocalTimeConvert &conv) const;
+
+    /**
+     * @brief Get the next scheduled time after a given time in a timezone
+     * 
+     * @param config The timezone configuration
+     * @param time The time to start searching from (UTC)
+     * @return time_t The next scheduled time (UTC), or 0 if there is none
+     */
+    time_t getNextScheduledTime(const LocalTimePosixTimezone &config, time_t time) const;
+
+    /**
+     * @brief Number of seconds in a day, the range of times of day is 0 to SECONDS_PER_DAY - 1
+     */
+    static const int SECONDS_PER_DAY = 86400;
+
+protected:
+    /**
+     * @brief The kind of date restriction of a DateClass
+     */
+    enum class DateType : uint8_t {
+        DAYS,                   //!< Day of week mask and only on dates
+        DAY_OF_MONTH,           //!< Day of month (ordinal, negative from the end of the month), also restricted like DAYS
+        DAY_OF_WEEK_OF_MONTH,   //!< nth day of week of the month (dayOfWeek, ordinal), also restricted like DAYS
+    };
+
+    /**
+     * @brief Schedule items that share the same date restrictions
+     */
+    struct DateClass {
+        DateType dateType = DateType::DAYS;     //!< Kind of date restriction
+        uint8_t dayOfWeekMask = 0;              //!< Mask of days of the week, as in LocalTimeDayOfWeek
+        int dayOfWeek = 0;                      //!< Day of week for DAY_OF_WEEK_OF_MONTH
+        int ordinal = 0;                        //!< Day for DAY_OF_MONTH or ordinal for DAY_OF_WEEK_OF_MONTH
+        int expirationDays = 0;                 //!< Last valid day (LocalTimeYMD::toDays()), only if hasExpiration
+        bool hasExpiration = false;             //!< true if there are only on dates, which stop the search at the last one
+        std::vector<int> onlyOnDays;            //!< Sorted only on dates (LocalTimeYMD::toDays())
+        std::vector<int> exceptDays;            //!< Sorted except dates (LocalTimeYMD::toDays())
+        std::vector<int32_t> times;             //!< Sorted, unique local times of day (seconds * 2, plus 1 if it occurs in both repeated hours)
+
+        /**
+         * @brief Returns true if the date restrictions other than times are the same
+         */
+        bool isSameDates(const DateClass &other) const;
+
+        /**
+         * @brief Returns true if the date restrictions allow this day, like LocalTimeRestrictedDate::isValid()
+         */
+        bool isValidDay(int days) const;
+
+        /**
+         * @brief Returns the first valid day >= days and <= endDays, or INVALID_DAYS
+         */
+        int nextValidDay(int days, int endDays) const;
+    };
+
+    /**
+     * @brief Returned by DateClass::nextValidDay() if there is no valid day
+     */
+    static const int INVALID_DAYS = std::numeric_limits<int>::max();
+
+    /**
+     * @brief Adds the times of day of an item to times
+     */
+    static void addItemTimes(const LocalTimeScheduleItem &item, std::vector<int32_t> &times);
+
+    /**
+     * @brief Sorts values and removes duplicates
+     */
+    static void sortUnique(std::vector<int32_t> &values);
+
+    /**
+     * @brief Finds the first time in times on day days that is after time
+     * 
+     * @param times Sorted times of day, encoded like DateClass::times
+     * @param config Timezone configuration to convert from local time to UTC
+     * @param days The local day to check
+     * @param fromSeconds Only check times of day >= fromSeconds
+     * @param time Results must be > time (UTC)
+     * @return time_t The time (UTC) or 0 if there is none on that day
+     */
+    static time_t firstTimeAfter(const std::vector<int32_t> &times, const LocalTimePosixTimezone &config, int days, int fromSeconds, time_t time);
+
+    /**
+     * @brief Used by firstTimeAfter() on days where local time is not continuous because of a time change
+     * 
+     * @param shift Number of seconds between standard and daylight saving time
+     */
+    static time_t firstTimeAfterTimeChange(const std::vector<int32_t> &times, const LocalTimePosixTimezone &config, int days, int fromSeconds, time_t time, int shift);
+
+    /**
+     * @brief Finds the next scheduled time
+     * 
+     * @param config Timezone configuration to convert from local time to UTC
+     * @param time Results must be > time (UTC)
+     * @param days The local day of time (LocalTimeYMD::toDays())
+     * @param seconds The local time of day of time in seconds
+     * @return time_t The time (UTC) or 0 if there is none
+     */
+    time_t getNextScheduledTime(const LocalTimePosixTimezone &config, time_t time, int days, int seconds) const;
+
+    /**
+     * @brief Converts a local day and time of day to UTC, like LocalTimeConvert::atLocalTime()
+     */
+    static time_t localToUTC(const LocalTimePosixTimezone &config, int days, int seconds, LocalTimePosixTimezone::LocalTimeKind *pKind = NULL);
+
+    std::vector<int32_t> weekdayTimes[7];   //!< Times of day for items only restricted by day of week, indexed by day of week (0 = Sunday), encoded like DateClass::times
+    std::vector<DateClass> dateClasses;     //!< Items with other date restrictions
+};
+
+/**
+ * @brief Keeps the next scheduled time of many schedules in a priority queue
+ * 
+ * LocalTimeScheduleManager calculates the next time of every schedule each time you ask for the next wake.
+ * That's fine for a few schedules, but not for a server with hundreds of thousands of them. This class
+ * compiles each schedule into a LocalTimeScheduleIndex and keeps its next scheduled time in a binary
+ * min-heap keyed by UTC time. Only the schedule that fired, or a schedule that was added, updated, or
+ * removed, is recalculated.
+ * 
+ * ```
+ * LocalTimeScheduler scheduler;
+ * LocalTimeScheduler::ScheduleId id = scheduler.add(schedule, Time.now());
+ * 
+ * // Later
+ * scheduler.popDue(Time.now(), [](LocalTimeScheduler::ScheduleId id, time_t time) {
+ *     // Schedule id was scheduled at time
+ * });
+ * ```
+ * 
+ * A schedule uses the timezone from LocalTimeSchedule::withZone() if set, otherwise the timezone set 
+ * using withConfig(), which defaults to the LocalTime global timezone when the scheduler is constructed.
+ * The schedule is not referenced after add() or update() returns.
+ * 
+ * This class is not thread safe.
+ */
+class LocalTimeScheduler {
+public:
+    /**
+     * @brief Identifies a schedule in the scheduler, returned by add()
+     * 
+     * The id of a removed schedule can be reused by a later add().
+     */
+    typedef uint32_t ScheduleId;
+
+    /**
+     * @brief Returned by add() if the schedule could not be added
+     */
+    static const ScheduleId INVALID_ID = 0xffffffff;
+
+    /**
+     * @brief Construct an empty scheduler using the LocalTime global timezone
+     */
+    LocalTimeScheduler();
+
+    /**
+     * @brief Sets the timezone for schedules that do not have a zone set
+     * 
+     * @param config The timezone configuration (copied)
+     * @return LocalTimeScheduler& 
+     * 
+     * Schedules that are already added are not recalculated until they fire or you call reschedule().
+     */
+    LocalTimeScheduler &withConfig(const LocalTimePosixTimezone &config) { 
+        this->config = config;
+        return *this;
+    };
+
+    /**
+     * @brief Adds a schedule
+     * 
+     * @param schedule The schedule to add. It is compiled and not referenced after this call returns.
+     * @param timeNow The current time (UTC). The first scheduled time is after this time.
+     * @return ScheduleId The id of this schedule, used with update(), remove(), and returned by popDue()
+     */
+    ScheduleId add(const LocalTimeSchedule &schedule, time_t timeNow);
+
+    /**
+     * @brief Replaces the definition of a schedule and recalculates its next time
+     * 
+     * @param id The id returned by add()
+     * @param schedule The new schedule
+     * @param timeNow The current time (UTC). The next scheduled time is after this time.
+     * @return true if the schedule was updated or false if id is not valid
+     */
+    bool update(ScheduleId id, const LocalTimeSchedule &schedule, time_t timeNow);
+
+    /**
+     * @brief Removes a schedule
+     * 
+     * @param id The id returned by add()
+     * @return true if the schedule was removed or false if id is not valid
+     */
+    bool remove(ScheduleId id);
+
+    /**
+     * @brief Removes all schedules
+     */
+    void clear();
+
+    /**
+     * @brief Recalculates the next time of every schedule
+     * 
+     * @param timeNow The current time (UTC). The next scheduled times are after this time.
+     * 
+     * Use this after the clock is set, or after changing the timezone or 
+     * LocalTime::instance().withScheduleLookaheadDays(). This is O(n).
+     */
+    void reschedule(time_t timeNow);
+
+    /**
+     * @brief Returns true if id is a schedule that is in the scheduler
+     */
+    bool isValid(ScheduleId id) const {
+        return id < entries.size() && entries[id].inUse;
+    }
+
+    /**
+     * @brief Returns the number of schedules in the scheduler
+     */
+    size_t size() const { 
+        return entries.size() - freeIds.size(); 
+    };
+
+    /**
+     * @brief Gets the earliest time in the queue without removing it
+     * 
+     * @param pId If not NULL, filled in with the id of the schedule
+     * @return time_t The time (UTC), or 0 if no schedule has a next time
+     * 
+     * If a schedule has no time within LocalTime::instance().getScheduleLookaheadDays(), it's checked
+     * again at the end of the lookahead period and that time can be returned here. popDue() 
+     * recalculates the schedule at that time without returning it. It's always safe to sleep until 
+     * the returned time.
+     */
+    time_t peekNext(ScheduleId *pId = NULL) const;
+
+    /**
+     * @brief Removes one due schedule from the queue and calculates its next time
+     * 
+     * @param timeNow The current time (UTC). Schedules with a time <= timeNow are due.
+     * @param id Filled in with the id of the schedule
+     * @param time Filled in with the scheduled time (UTC), which is <= timeNow
+     * @return true if a schedule was due or false if not
+     * 
+     * The next time of the schedule is calculated after timeNow, not after time, so if the schedule 
+     * was due more than once since the last call, it's only returned once. This is the same as
+     * LocalTimeSchedule::isScheduledTime().
+     */
+    bool popDue(time_t timeNow, ScheduleId &id, time_t &time);
+
+    /**
+     * @brief Removes all due schedules from the queue, calling a function or lambda for each
+     * 
+     * @param timeNow The current time (UTC). Schedules with a time <= timeNow are due.
+     * @param callback Function or lambda to call, in order of scheduled time
+     * @return size_t Number of times callback was called
+     * 
+     * The callback has this prototype:
+     * 
+     * void callback(LocalTimeScheduler::ScheduleId id, time_t time)
+     * 
+     * The callback must not add, update, or remove schedules.
+     */
+    size_t popDue(time_t timeNow, std::function<void(ScheduleId id, time_t time)> callback);
+
+protected:
+    /**
+     * @brief A schedule in the scheduler
+     */
+    struct Entry {
+        LocalTimeScheduleIndex index;                       //!< The compiled schedule
+        LocalTimePosixTimezone zoneConfig;                  //!< Copy of the timezone from the registry, or not valid to use config
+        size_t heapIndex = NOT_IN_HEAP;                     //!< Index into heap, or NOT_IN_HEAP
+        bool isCheck = false;                               //!< The time in heap is a check, not a scheduled time
+        bool inUse = false;                                 //!< false if in freeIds
+    };
+
+    /**
+     * @brief An entry in the heap
+     */
+    struct HeapItem {
+        time_t time;    //!< Scheduled time (UTC)
+        ScheduleId id;  //!< Schedule
+
+        /**
+         * @brief Order by time, then id so equal times are returned in a consistent order
+         */
+        bool operator<(const HeapItem &other) const {
+            return time < other.time || (time == other.time && id < other.id);
+        }
+    };
+
+    /**
+     * @brief Value of Entry::heapIndex for schedules that are not in the heap
+     */
+    static const size_t NOT_IN_HEAP = (size_t)-1;
+
+    /**
+     * @brief Calculates the next time of a schedule after timeNow and updates the heap
+     */
+    void scheduleEntry(ScheduleId id, time_t timeNow);
+
+    /**
+     * @brief Removes a schedule from the heap, if it is in the heap
+     */
+    void removeFromHeap(ScheduleId id);
+
+    /**
+     * @brief Moves heap[index] toward the root until the heap is valid
+     */
+    void siftUp(size_t index);
+
+    /**
+     * @brief Moves heap[index] toward the leaves until the heap is valid
+     */
+    void siftDown(size_t index);
+
+    /**
+     * @brief Stores item in heap[index] and updates its entry's heapIndex
+     */
+    void setHeapItem(size_t index, const HeapItem &item) {
+        heap[index] = item;
+        entries[item.id].heapIndex = index;
+    }
+
+    LocalTimePosixTimezone config;      //!< Timezone for schedules without a zone
+    std::vector<Entry> entries;         //!< Schedules, indexed by ScheduleId
+    std::vector<ScheduleId> freeIds;    //!< Ids of removed schedules that can be reused
+    std::vector<HeapItem> heap;         //!< Binary min-heap of next scheduled times
+};
+
+/**
+ * @brief Hierarchical timing wheel of the next scheduled times of a very large number of schedules
+ * 
+ * This is an alternative to LocalTimeScheduler for servers or simulations with millions of schedules.
+ * Instead of a heap, each schedule is in a slot of a second, minute, hour, or day wheel based on its
+ * next scheduled time (UTC), so adding, removing, and expiring a schedule is O(1). When the wheel 
+ * reaches the start of a minute, hour, or day, the schedules in that slot move down to the finer wheel.
+ * Times more than DAY_SLOTS days in the future are kept in an overflow list that is checked every 
+ * DAY_SLOTS days.
+ * 
+ * ```
+ * LocalTimeTimingWheel wheel;
+ * LocalTimeTimingWheel::ScheduleId id = wheel.add(schedule, Time.now());
+ * 
+ * // Later
+ * wheel.advance(Time.now(), [](LocalTimeTimingWheel::ScheduleId id, time_t time) {
+ *     // Schedule id was scheduled at time
+ * });
+ * ```
+ * 
+ * The next time of each schedule is calculated using LocalTimeSchedule::getNextScheduledTime(). 
+ * To save memory, the wheel only stores a pointer to the schedule, so the schedule must not be 
+ * moved or destroyed until it is removed from the wheel. Call update() after modifying it. Many 
+ * entries can share the same schedule.
+ * 
+ * A schedule uses the timezone from LocalTimeSchedule::withZone() if set, otherwise the timezone set 
+ * using withConfig(), which defaults to the LocalTime global timezone when the wheel is constructed.
+ * 
+ * This class is not thread safe.
+ */
+class LocalTimeTimingWheel {
+public:
+    /**
+     * @brief Identifies a schedule in the wheel, returned by add()
+     * 
+     * The id of a removed schedule can be reused by a later add().
+     */
+    typedef uint32_t ScheduleId;
+
+    /**
+     * @brief Returned by add() if the schedule could not be added
+     */
+    static const ScheduleId INVALID_ID = 0xffffffff;
+
+    /**
+     * @brief Construct an empty wheel using the LocalTime global timezone
+     */
+    LocalTimeTimingWheel();
+
+    /**
+     * @brief Sets the timezone for schedules that do not have a zone set
+     * 
+     * @param config The timezone configuration (copied)
+     * @return LocalTimeTimingWheel& 
+     * 
+     * Schedules that are already added are not recalculated until they fire or you call update().
+     */
+    LocalTimeTimingWheel &withConfig(const LocalTimePosixTimezone &config) { 
+        this->config = config;
+        return *this;
+    };
+
+    /**
+     * @brief Adds a schedule
+     * 
+     * @param schedule The schedule to add. It must remain valid until removed.
+     * @param timeNow The current time (UTC). The first scheduled time is after this time.
+     * @return ScheduleId The id of this schedule, used with update(), remove(), and passed to the advance() callback
+     * 
+     * The first call to add() or advance() sets the time of the wheel.
+     */
+    ScheduleId add(const LocalTimeSchedule &schedule, time_t timeNow);
+
+    /**
+     * @brief Recalculates the next time of a schedule after it has been modified
+     * 
+     * @param id The id returned by add()
+     * @param timeNow The current time (UTC). The next scheduled time is after this time.
+     * @return true if the schedule was updated or false if id is not valid
+     */
+    bool update(ScheduleId id, time_t timeNow);
+
+    /**
+     * @brief Replaces the schedule of an id and recalculates its next time
+     * 
+     * @param id The id returned by add()
+     * @param schedule The new schedule. It must remain valid until removed.
+     * @param timeNow The current time (UTC). The next scheduled time is after this time.
+     * @return true if the schedule was updated or false if id is not valid
+     */
+    bool update(ScheduleId id, const LocalTimeSchedule &schedule, time_t timeNow);
+
+    /**
+     * @brief Removes a schedule
+     * 
+     * @param id The id returned by add()
+     * @return true if the schedule was removed or false if id is not valid
+     */
+    bool remove(ScheduleId id);
+
+    /**
+     * @brief Removes all schedules. The next add() or advance() sets the time of the wheel.
+     */
+    void clear();
+
+    /**
+     * @brief Returns true if id is a schedule that is in the wheel
+     */
+    bool isValid(ScheduleId id) const {
+        return id < entries.size() && entries[id].schedule != NULL;
+    }
+
+    /**
+     * @brief Returns the number of schedules in the wheel
+     */
+    size_t size() const { 
+        return entries.size() - freeIds.size(); 
+    };
+
+    /**
+     * @brief Returns the time the wheel has been advanced to, or 0 if it has not been started
+     */
+    time_t getTime() const {
+        return (nextTick != 0) ? nextTick - 1 : 0;
+    }
+
+    /**
+     * @brief Advance the wheel to timeNow, calling a function or lambda for each schedule that is due
+     * 
+     * @param timeNow The current time (UTC). Schedules with a time <= timeNow are due.
+     * @param callback Function or lambda to call, in order of scheduled time
+     * @return size_t Number of times callback was called
+     * 
+     * The callback has this prototype:
+     * 
+     * void callback(LocalTimeTimingWheel::ScheduleId id, time_t time)
+     * 
+     * Calling this every second is O(1) plus the schedules that are due. If the clock jumps forward,
+     * whole minutes, hours, and days are expired at once instead of one second at a time. If timeNow is 
+     * not after getTime(), nothing happens.
+     * 
+     * The next time of each due schedule is calculated after timeNow, so if a schedule was due more than
+     * once since the last call, it's only returned once. This is the same as 
+     * LocalTimeSchedule::isScheduledTime(). The callback must not add, update, or remove schedules.
+     */
+    size_t advance(time_t timeNow, std::function<void(ScheduleId id, time_t time)> callback);
+
+    static const int SECOND_SLOTS = 60;     //!< Number of slots in the second wheel
+    static const int MINUTE_SLOTS = 60;     //!< Number of slots in the minute wheel
+    static const int HOUR_SLOTS = 24;       //!< Number of slots in the hour wheel
+    static const int DAY_SLOTS = 128;       //!< Number of slots in the day wheel, more than the default schedule lookahead
+
+protected:
+    /**
+     * @brief A schedule in the wheel
+     */
+    struct Entry {
+        const LocalTimeSchedule *schedule = NULL;   //!< The schedule, or NULL if this entry is in freeIds
+        time_t time = 0;                            //!< Next scheduled time (UTC)
+        uint32_t slot = NO_SLOT;                    //!< Index into slots, or NO_SLOT
+        ScheduleId prev = INVALID_ID;               //!< Previous entry in the slot list
+        ScheduleId next = INVALID_ID;               //!< Next entry in the slot list
+        bool isCheck = false;                       //!< time is a check at the end of the lookahead period, not a scheduled time
+    };
+
+    static const uint32_t MINUTE_SLOT_OFFSET = SECOND_SLOTS;                    //!< Index in slots of the minute wheel
+    static const uint32_t HOUR_SLOT_OFFSET = MINUTE_SLOT_OFFSET + MINUTE_SLOTS; //!< Index in slots of the hour wheel
+    static const uint32_t DAY_SLOT_OFFSET = HOUR_SLOT_OFFSET + HOUR_SLOTS;      //!< Index in slots of the day wheel
+    static const uint32_t OVERFLOW_SLOT = DAY_SLOT_OFFSET + DAY_SLOTS;          //!< Index in slots of the overflow list
+    static const uint32_t NUM_SLOTS = OVERFLOW_SLOT + 1;                        //!< Number of entries in slots
+    static const uint32_t NO_SLOT = 0xffffffff;                                 //!< Value of Entry::slot when not in a slot
+
+    /**
+     * @brief Calculates the next time of a schedule after timeNow and puts it in a slot
+     */
+    void scheduleEntry(ScheduleId id, time_t timeNow);
+
+    /**
+     * @brief Puts an entry in the slot for its time, relative to nextTick
+     */
+    void insertEntry(ScheduleId id);
+
+    /**
+     * @brief Removes an entry from its slot, if it is in one
+     */
+    void unlinkEntry(ScheduleId id);
+
+    /**
+     * @brief Returns the slot index for a time, relative to nextTick
+     */
+    uint32_t slotForTime(time_t time) const;
+
+    /**
+     * @brief Removes all entries in a slot and adds them to due
+     */
+    void expireSlot(uint32_t slot);
+
+    /**
+     * @brief Expires all slots from first to last, inclusive
+     */
+    void expireSlots(uint32_t first, uint32_t last);
+
+    /**
+     * @brief Removes all entries in a slot and puts them in the slot for their time, relative to nextTick
+     */
+    void cascadeSlot(uint32_t slot);
+
+    LocalTimePosixTimezone config;                          //!< Timezone for schedules without a zone
+    time_t nextTick = 0;                                    //!< First time that has not been expired, 0 if not started
+    std::vector<Entry> entries;                             //!< Schedules, indexed by ScheduleId
+    std::vector<ScheduleId> freeIds;                        //!< Ids of removed schedules that can be reused
+    std::vector<ScheduleId> slots;                          //!< First entry in each slot, or INVALID_ID
+    std::vector<std::pair<time_t, ScheduleId>> due;         //!< Entries expired by advance(), kept to avoid allocations
+};
+
+/**
+ * @brief Class for managing multiple named schedules
+ * 
+ * This is used for the quick and full wake schedules, but can be extended for other uses.
+ * 
+ * Each query calculates the next time of every schedule. For a large number of schedules, use
+ * LocalTimeScheduler instead.
+ */
+class LocalTimeScheduleManager {
+public:
+    /**
+     * @brief Get the next scheduled time of the schedule with name "name"
+     * 
+     * @param name The name to look for (c string)
+     * @param conv The LocalTimeConvert that contains the timezone information to use
+     * @return time_t Time of 0 if there is no schedule with that name
+     */
+    time_t getNextTimeByName(const char *name, const LocalTimeConvert &conv);
+
+    /**
+     * @brief Get the wake of any type (quick or full)
+     * 
+     * @param conv The LocalTimeConvert that contains the timezone information to use
+     * @return time_t Time of 0 if there is no schedule
+     */
+    time_t getNextWake(const LocalTimeConvert &conv) const;
+
+    /**
+     * @brief Get the full wake, typically with a publish
+     * 
+     * @param conv The LocalTimeConvert that contains the timezone information to use
+     * @return time_t Time of 0 if there is no schedule
+     */
+    time_t getNextFullWake(const LocalTimeConvert &conv) const;
+
+    /**
+     * @brief Get the next scheduled data capture. Data capture schedules are a 
+     * special class of quick wake that also runs while powered on.
+     * 
+     * @param conv 
+     * @return time_t 
+     */
+    time_t getNextDataCapture(const LocalTimeConvert &conv) const;
+
+    /**
+     * @brief Call a function or lambda for each schedule.
+     * 
+     * @param callback Function or lambda to call.
+     * 
+     * The callback has this prototype:
+     * 
+     * void callback(LocalTimeSchedule &schedule)
+     */
+    void forEach(std::function<void(LocalTimeSchedule &schedule)> callback);
+
+    /**
+     * @brief Get a LocalTimeSchedule reference by name and creates it if it does not exist
+     * 
+     * @param name Name to get or create
+     * @return LocalTimeSchedule& Reference to the schedule
+     */
+    LocalTimeSchedule &getScheduleByName(const char *name);
+
+    /**
+     * @brief Set the schedules from a JSON object
+     * 
+     * @param obj 
+     * 
+     * Only the keys in obj that already exist as named schedules are processed! This allows
+     * a single object to contain both schedules and other settings. Plus, in order for a 
+     * named schedule to be useful you probably need to have code to handle it, and this
+     * eliminates the need to pass the schedule flags in the JSON, since they should be
+     * constant depending on how the schedule is being used in the code, not by the
+     * schedule settings.
+     */
+    void setFromJsonObject(const JSONValue &obj);
+
+    std::vector<LocalTimeSchedule> schedules; //!< Vector of all of the schedules. Names and flags are in the schedule object
+};
+
+/**
+ * @brief Perform time conversions. This is the main class you will need.
+ */
+class LocalTimeConvert {
+public:
+    /**
+     * @brief Whether the specified time is DST or not. See also isDST().
+     */
+    enum class Position : uint8_t {
+        BEFORE_DST,      //!< This time is before the start of DST (northern hemisphere)
+        IN_DST,          //!< This time is in daylight saving time (northern hemisphere)
+        AFTER_DST,       //!< This time is after the end of DST (northern hemisphere)
+        BEFORE_STANDARD, //!< This time is before the start of standard time (southern hemisphere)
+        IN_STANDARD,     //!< This time is in standard saving time (southern hemisphere)
+        AFTER_STANDARD,  //!< This time is after the end of standard time (southern hemisphere)
+        NO_DST,          //!< This config does not use daylight saving
+    };
+
+
+    /**
+     * @brief Sets the timezone configuration to use for time conversion
+     * 
+     * If you do not use withConfig() the global default set in the LocalTime class is used.
+     * If neither are set, the local time is UTC (with no DST).
+     */
+    LocalTimeConvert &withConfig(LocalTimePosixTimezone config) { this->config = config; transitionTable = nullptr; invalidateSegment(); return *this; };
+
+    /**
+     * @brief Use a precomputed transition table for time conversion
+     * 
+     * @param transitionTable The table to use, or nullptr to calculate using the config rules.
+     * 
+     * This also sets the config to the one the table was built from. The table is not copied, 
+     * so it must remain valid for as long as this object uses it. Times outside of the years in
+     * the table are calculated using the config rules. The results are identical either way.
+     * 
+     * Calling withConfig() stops using the table.
+     */
+    LocalTimeConvert &withTransitionTable(const LocalTimeTransitionTable *transitionTable) { 
+        this->transitionTable = transitionTable; 
+        if (transitionTable) {
+            config = transitionTable->config;
+        }
+        invalidateSegment();
+        return *this; 
+    };
+
+    /**
+     * @brief Use a timezone from a LocalTimeZoneRegistry for time conversion
+     * 
+     * @param zone Handle from LocalTimeZoneRegistry::intern()
+     * @param registry The registry the handle came from. Default is the singleton instance.
+     * 
+     * This uses the registry's transition table for the zone, see withTransitionTable(). If the 
+     * handle is not valid, the global default set in the LocalTime class is used, as if
+     * withConfig() had been called with an empty config.
+     */
+    LocalTimeConvert &withZone(LocalTimeZoneHandle zone, const LocalTimeZoneRegistry &registry = LocalTimeZoneRegistry::instance());
+
+    /**
+     * @brief Sets the UTC time to begin conversion from 
+     * 
+     * @param time The time (UTC) to set. This is the Unix timestamp (seconds since January 1, 1970) UTC
+     * such as returned by Time.now().
+     * 
+     * This does not start the conversion; you must also call the convert() method after setting
+     * all of the settings you want to use.
+     * 
+     * For the current time, you can instead use withCurrentTime();
+     */
+    LocalTimeConvert &withTime(time_t time) { this->time = time; return *this; };
+
+    /**
+     * @brief Use the current time as the time to start with
+     * 
+     * This does not start the conversion; you must also call the convert() method after setting
+     * all of the settings you want to use.
+     */
+    LocalTimeConvert &withCurrentTime() { this->time = Time.now(); return *this; };
+
+    /**
+     * @brief Do the time conversion
+     * 
+     * You must call this after changing the configuration or the time using withTime() or withCurrentTime()
+     * 
+     * If time is still within segmentStart and segmentEnd from the last conversion, the timezone
+     * rules are not evaluated again and only the local time is updated. This makes stepping
+     * forward a little at a time, such as with addSeconds() or nextMinute(), inexpensive.
+     */
+    void convert();
+
+    /**
+     * @brief Forget the segment from the last conversion so the next convert() evaluates the rules
+     * 
+     * This is done automatically by withConfig() and withTransitionTable(). You only need to call it
+     * if you modify config directly.
+     */
+    void invalidateSegment();
+
+    /**
+     * @brief Returns true if the current time is in daylight saving time
+     */
+    bool isDST() const { return position == Position::IN_DST || position == Position::BEFORE_STANDARD || position == Position::AFTER_STANDARD; };
+
+    /**
+     * @brief Returns true of the current time in in standard time
+     */
+    bool isStandardTime() const { return !isDST(); };
+
+    /**
+     * @brief Adds a number of seconds to the current object
+     * 
+     * @param seconds 
+     */
+    void addSeconds(int seconds);
+
+    /**
+     * @brief Moves the current time the next specified multiple of minutes
+     * 
+     * @param increment Typically something like 5, 15, 20, 30 that 60 is evenly divisible by
+     * 
+     * @param startingModulo (optional). If present, must be 0 < startingModulo < increment
+     * 
+     * Moves the time forward to the next multiple of that number of minutes. For example, if the 
+     * clock is at :10 past the hour and the multiple is 15, then time will be updated to :15. If
+     * the time is equal to an even multple, the next multiple is selected.
+     * 
+     * Upon completion, all fields are updated appropriately. For example:
+     * - time specifies the time_t of the new time at UTC
+     * - localTimeValue contains the broken-out values for the local time
+     * - isDST() return true if the new time is in daylight saving time
+     */
+    void nextMinuteMultiple(int increment, int startingModulo = 0);
+
+    /**
+     * @brief Moves the current time the next specified local time. This could be today or tomorrow.
+     * 
+     * @param hms Moves to the next occurrence of that time of day (local time)
+     * 
+     * Upon completion, all fields are updated appropriately. For example:
+     * - time specifies the time_t of the new time at UTC
+     * - localTimeValue contains the broken-out values for the local time
+     * - isDST() return true if the new time is in daylight saving time
+     */
+    void nextTime(LocalTimeHMS hms);
+
+   /**
+     * @brief Moves the current time to the next minute
+     * 
+     * Upon completion, all fields are updated appropriately. For example:
+     * - time specifies the time_t of the new time at UTC
+     * - localTimeValue contains the broken-out values for the local time
+     * - isDST() return true if the new time is in daylight saving time
+     */
+    void nextMinute() { nextMinuteMultiple(1); };
+
+    /**
+     * @brief Moves the current time to the next hour
+     * 
+     * Upon completion, all fields are updated appropriately. For example:
+     * - time specifies the time_t of the new time at UTC
+     * - localTimeValue contains the broken-out values for the local time
+     * - isDST() return true if the new time is in daylight saving time
+     */
+    void nextHour() { nextMinuteMultiple(60); };
+
+    /**
+     * @brief Moves the current time to the next day at midnight
+     * 
+     * Upon completion, all fields are updated appropriately. For example:
+     * - time specifies the time_t of the new time at UTC
+     * - localTimeValue contains the broken-out values for the local time
+     * - isDST() return true if the new time is in daylight saving time
+     */
+    void nextDayMidnight() { nextTime(LocalTimeHMS("00:00:00")); };
+
+    /**
+     * @brief Moves the current time the closest local time om hmsList. This could be today or tomorrow.
+     * 
+     * @param hmsList An initialize list of LocalTimeHMS surrounded by {}
+     * 
+     * For example, this sets the time to the nearest noon or midnight local time greater than the time
+     * set in this object:
+     * 
+     * conv.nextTimeList({LocalTimeHMS("00:00"), LocalTimeHMS("12:00")});
+     */
+    void nextTimeList(std::initializer_list<LocalTimeHMS> hmsList);
+
+
+
+    /**
+     * @brief Moves the current time to the previous day
+     * 
+     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
      * 
-     * Hours are per day, local time. For whole-day schedules, you will typically use a value that
-     * 24 is evenly divisible by (2, 3, 4, 6, 8, 12), because otherwise the time periods will brief
-     * unequal at midnight.
+     * Upon completion, all fields are updated appropriately. For example:
+     * - time specifies the time_t of the new time at UTC
+     * - localTimeValue contains the broken-out values for the local time
+     * - isDST() return true if the new time is in daylight saving time
+     */
+    void prevDay(LocalTimeHMS hms = LocalTimeIgnoreHMS());
+
+    /**
+     * @brief Moves the current time to the next day
      * 
-     * Also note that times are local, and take into account daylight saving. Thus during a time switch,
-     * the interval may end up being a different number of hours than specified. For example, if the
-     * times would have been 00:00 and 04:00, a hourMultiple of 4, and you do this over a spring forward, 
-     * the actual number hours between 00:00 and 04:00 is 5 (at least in the US where DST starts at 2:00).
+     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
+     * 
+     * Upon completion, all fields are updated appropriately. For example:
+     * - time specifies the time_t of the new time at UTC
+     * - localTimeValue contains the broken-out values for the local time
+     * - isDST() return true if the new time is in daylight saving time
      */
-    LocalTimeSchedule &withHourOfDay(int hourMultiple, LocalTimeRange timeRange = LocalTimeRange());
+    void nextDay(LocalTimeHMS hms = LocalTimeIgnoreHMS());
 
     /**
-     * @brief Schedule an item on a specific instance of a day of week of the month
+     * @brief Moves the current to the next day, or right after the next time change, whichever comes first 
      * 
-     * @param dayOfWeek Day of week 0 = Sunday, 1 = Monday, ..., 6 = Saturday
-     * @param instance 1 = first week, 2 = second week, ..., -1 = last week, -2 = 2nd to last week
-     * @param timeRange Optional to restrict dates or to set a time for the item
-     * @return LocalTimeSchedule& 
+     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
+     * 
+     * Upon completion, all fields are updated appropriately. For example:
+     * - time specifies the time_t of the new time at UTC
+     * - localTimeValue contains the broken-out values for the local time
+     * - isDST() return true if the new time is in daylight saving time
+     * 
+     * This method is used when you want to synchronize an external device clock daily to keep it synchronized,
+     * or right after a time change.
+     * 
+     * Do not pick the local time of the time change as the hms time! For example, in the United State do *not* select
+     * 02:00:00. The reason is that on spring forward, that time doesn't actually exist, because as soon as the clock
+     * hits 02:00:00 it jumps forward to 03:00:00 local time. Picking 03:00:00 or really any other time that's not between 
+     * 02:00:00 and 02:59:59 is fine. During fall back, even though you've picked the time sync time to be 03:00 local
+     * time it will sync at the time of the actual time change correctly, which is why this function is different than
+     * nextDay().
+     */
+    void nextDayOrTimeChange(LocalTimeHMS hms = LocalTimeIgnoreHMS());
+
+    /**
+     * @brief Moves the current time to the next of the specified day of week
+     * 
+     * @param dayOfWeek The day of week (0 - 6, 0 = Sunday, 1 = Monday, ..., 6 = Saturday)
+     * 
+     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
+     * 
+     * Upon completion, all fields are updated appropriately. For example:
+     * - time specifies the time_t of the new time at UTC
+     * - localTimeValue contains the broken-out values for the local time
+     * - isDST() return true if the new time is in daylight saving time
+     */
+    bool nextDayOfWeek(int dayOfWeek, LocalTimeHMS hms = LocalTimeIgnoreHMS());
+
+    /**
+     * @brief Returns the next day that is a weekday (Monday - Friday)
+     * 
+     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
+     * 
+     * Upon completion, all fields are updated appropriately. For example:
+     * - time specifies the time_t of the new time at UTC
+     * - localTimeValue contains the broken-out values for the local time
+     * - isDST() return true if the new time is in daylight saving time
+     */
+    void nextWeekday(LocalTimeHMS hms = LocalTimeIgnoreHMS());
+
+    /**
+     * @brief Returns the next day that is a weekend day (Saturday or Sunday)
+     * 
+     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
+     * 
+     * Upon completion, all fields are updated appropriately. For example:
+     * - time specifies the time_t of the new time at UTC
+     * - localTimeValue contains the broken-out values for the local time
+     * - isDST() return true if the new time is in daylight saving time
+     */
+    void nextWeekendDay(LocalTimeHMS hms = LocalTimeIgnoreHMS());
+
+    /**
+     * @brief Moves the date and time (local time) forward to the specified day of month and local time
+     * 
+     * @param dayOfMonth The day of the month (1 = first day of the month). See also special cases below.
+     * 
+     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
+     * 
+     * This version will move to the closest forward time. It could be as close as 1 second later, but 
+     * it will always advance at least once second. It could be as much as 1 month minus 1 second later.
+     * 
+     * Upon completion, all fields are updated appropriately. For example:
+     * - time specifies the time_t of the new time at UTC
+     * - localTimeValue contains the broken-out values for the local time
+     * - isDST() return true if the new time is in daylight saving time
+     * 
+     * dayOfMonth is normally a a day number (1 = first day of the month). There are also special cases:
+     * 0 = the last day of the month, -1 the second to last day of month, ... The number of days in the month are
+     * based on the date in local time.
+     */
+    bool nextDayOfMonth(int dayOfMonth, LocalTimeHMS hms = LocalTimeIgnoreHMS());
+
+    /**
+     * @brief Moves the date and time (local time) forward to the specified day of month and local time
+     * 
+     * @param dayOfMonth The day of the month (1 = first day of the month). See also special cases below.
+     * 
+     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
+     * 
+     * This version always picks the next month, even if the target day of month hasn't been reached
+     * in this month yet. This will always more forward at least a month, and may be as much as 
+     * two months minus one day.
+     * 
+     * Upon completion, all fields are updated appropriately. For example:
+     * - time specifies the time_t of the new time at UTC
+     * - localTimeValue contains the broken-out values for the local time
+     * - isDST() return true if the new time is in daylight saving time
+     * 
+     * dayOfMonth is normally a a day number (1 = first day of the month). There are also special cases:
+     * 0 = the last day of the month, -1 the second to last day of month, ... The number of days in the month are
+     * based on the date in local time.
+     */
+    bool nextDayOfNextMonth(int dayOfMonth, LocalTimeHMS hms = LocalTimeIgnoreHMS());
+
+
+    /**
+     * @brief Moves the date and time (local time) forward to the specified day of month and local time
+     * 
+     * @param dayOfWeek The day of week (0 - 6, 0 = Sunday, 1 = Monday, ..., 6 = Saturday)
+     * 
+     * @param ordinal 1 = first of that day of week in month, 2 = second, ...
+     * 
+     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
+     * 
+     * If you specify an ordinal that does not exist (for example, there may not be a 5th ordinal for certain days
+     * in certain months), returns false and leaves the date unchanged.
+     * 
+     * Upon successful completion, all fields are updated appropriately. For example:
+     * - time specifies the time_t of the new time at UTC
+     * - localTimeValue contains the broken-out values for the local time
+     * - isDST() return true if the new time is in daylight saving time
+     */
+    bool nextDayOfWeekOrdinal(int dayOfWeek, int ordinal, LocalTimeHMS hms = LocalTimeIgnoreHMS());
+
+    /**
+     * @brief Sets the time to the nearest hms in local time in the future.
+     * 
+     * @param hms The time of day to set in local time
+     * 
+     * Moves the time forward to the next instance of hms in local time. If hms has not
+     * occurred yet, it will select the one today, but it will always move the time forward.
+     * 
+     * There is a weird special case on the beginning of daylight saving (spring forward in
+     * the northern hemisphere). If you select a hms between 2:00 AM and 2:59:59 AM local time,
+     * this time does not exist on spring forward day because it's the hour that is skipped.
+     * In order to preserve the requirement that the time will always be advanced by this
+     * call, it will jump forward to the next day when the 2:00 hour occurs next. (The hour
+     * may be different in other locations, for example it's 1:00 AM in the UK.)
+     * 
+     * In the case of fall back, if you specify a hms in the repeated hour (1:00:00 to 1:59:59)
+     * the time returned will be the second time this time occurs, in standard time in the US.
+     * 
+     * Upon completion, all fields are updated appropriately. For example:
+     * - time specifies the time_t of the new time at UTC
+     * - localTimeValue contains the broken-out values for the local time
+     * - isDST() return true if the new time is in daylight saving time
+     */    
+    void nextLocalTime(LocalTimeHMS hms);
+
+    /**
+     * @brief Sets the time to the nearest scheduled time in the future base on the schedule
+     * 
+     * @param schedule 
+     */
+    bool nextSchedule(const LocalTimeSchedule &schedule);
+
+    /**
+     * @brief Changes the time of day to the specified hms in local time on the same local day
+     * 
+     * @param hms A LocalTimeHMS object with hour, minute, and second
+     * 
+     * You can use the string constructor like this to set the time to 2:00 PM local time.
+     * 
+     * ```
+     * converter.atLocalTime(LocalTimeHms("14:00:00"));
+     * ```
+     * 
+     * It's possible that this will set the time to a time earlier than the object's current
+     * time. To only set a time in the future, use nextLocalTime() instead.
+     * 
+     * Upon completion, all fields are updated appropriately. For example:
+     * - time specifies the time_t of the new time at UTC
+     * - localTimeValue contains the broken-out values for the local time
+     * - isDST() return true if the new time is in daylight saving time
+     */
+    void atLocalTime(LocalTimeHMS hms);
+
+    /**
+     * @brief Get the value of this object as a LocalTimeHMS (hour minute second)
+     * 
+     * @return LocalTimeHMS 
+     */
+    LocalTimeHMS getLocalTimeHMS() const { return LocalTimeHMS(localTimeValue); };
+
+    /**
+     * @brief Get the value of this object as a LocalTimeYMD (year month day0)
+     * 
+     * @return LocalTimeYMD 
+     */
+    LocalTimeYMD getLocalTimeYMD() const { return LocalTimeYMD(localTimeValue); };
+
+    /**
+     * @brief Works like Time.timeStr() to generate a readable string of the local time
+     * 
+     * Uses asctime formatting, which looks like "Fri Jan  1 18:45:56 2021". The strings
+     * are not localized; they're always in English.
+     */
+    String timeStr();
+
+    /**
+     * @brief Works like Time.timeStr() but stores the string in a buffer instead of allocating a String
+     * 
+     * @param buf Buffer to store the string in. Always null terminated if bufSize > 0.
+     * @param bufSize Size of buf in bytes. TIME_STR_SIZE is always large enough.
+     * @return size_t Length of the string, not including the null terminator. If this is >= bufSize the 
+     * string was truncated.
+     */
+    size_t timeStr(char *buf, size_t bufSize) const;
+
+    /**
+     * @brief Works like Time.format()
+     * 
+     * @param formatSpec the format specifies, which can be 
+     * 
+     * - TIME_FORMAT_DEFAULT (example: "Thu Apr  1 12:00:00 2021")
+     * - TIME_FORMAT_ISO8601_FULL (example: "2021-04-01T12:00:00-04:00")
+     * - custom format based on strftime()
+     * 
+     * There are many options to strftime described here: 
+     * https://www.cplusplus.com/reference/ctime/strftime/?kw=strftime
+     * 
+     * Unlike Time.format(), you can use %Z to output the timezone abbreviation,
+     * for example "EDT" for the Eastern United States, daylight saving instead 
+     * of -04:00.
+     * 
+     * The %z formatting matches that of Time.format(), which is wrong. The
+     * correct output should be "-400" but the output will be "-04:00" 
+     * for compatibility.
+     */
+    String format(const char* formatSpec);
+
+    /**
+     * @brief Works like format() but stores the string in a buffer instead of allocating a String
+     * 
+     * @param formatSpec The format specifier, see format()
+     * @param buf Buffer to store the string in. Always null terminated if bufSize > 0.
+     * @param bufSize Size of buf in bytes
+     * @return size_t Length of the formatted string, not including the null terminator. Like snprintf,
+     * this is the full length even if it did not fit, so if the result is >= bufSize the string was
+     * truncated.
+     * 
+     * This never allocates memory, and there is no limit on the length of formatSpec.
      */
-    LocalTimeSchedule &withDayOfWeekOfMonth(int dayOfWeek, int instance, LocalTimeRange timeRange = LocalTimeRange());
+    size_t format(const char *formatSpec, char *buf, size_t bufSize) const;
 
     /**
-     * @brief Schedule an item on a specific day of the month
+     * @brief Function called with each piece of formatted output
      * 
-     * @param dayOfMonth 1 = 1st, 2 = 2nd of the month, ..., -1 = last day of the month, -2 = second to last day of the month, ...
-     * @param timeRange Optional to restrict dates or to set a time for the item
-     * @return LocalTimeSchedule& 
+     * @param context The context pointer passed to format()
+     * @param str The characters to output (not null terminated)
+     * @param len Number of characters in str
      */
-    LocalTimeSchedule &withDayOfMonth(int dayOfMonth, LocalTimeRange timeRange = LocalTimeRange());
+    typedef void (*FormatCallback)(void *context, const char *str, size_t len);
 
     /**
-     * @brief Add a scheduled item at a time in local time during the day. 
+     * @brief Works like format() but passes the output to a callback function in pieces
      * 
-     * @param hms The time in local time 00:00:00 to 23:59:59, optionally with date restrictions
-     * @return LocalTimeSchedule& 
+     * @param formatSpec The format specifier, see format()
+     * @param callback Function to call with each piece of output
+     * @param context Passed to the callback
+     * @return size_t Total length of the output
      * 
-     * You can call this multiple times, and also combine it with minute multiple schedules.
+     * This is used to implement the other format methods. It never allocates memory.
      */
-    LocalTimeSchedule &withTime(LocalTimeHMSRestricted hms);
+    size_t format(const char *formatSpec, FormatCallback callback, void *context) const;
 
     /**
-     * @brief Add multiple scheduled items at a time in local time during the day. 
+     * @brief Works like format() but writes to an output iterator
      * 
-     * @param timesParam an auto-initialized list of LocalTimeHMS objects
-     * @return LocalTimeSchedule& 
+     * @param out Output iterator for char, such as a pointer or std::back_inserter
+     * @param formatSpec The format specifier, see format()
+     * @return OutputIt The iterator after the last character written. No null terminator is written.
+     */
+    template<class OutputIt>
+    OutputIt formatTo(OutputIt out, const char *formatSpec) const {
+        format(formatSpec, [](void *context, const char *str, size_t len) {
+            OutputIt &it = *(OutputIt *)context;
+            it = std::copy(str, str + len, it);
+        }, &out);
+        return out;
+    }
+
+    /**
+     * @brief Returns the abbreviated time zone name for the current time
      * 
-     * You can call this multiple times, and also combine it with minute multiple schedules.
+     * For example, for the United States east coast, EST or EDT depending on
+     * whether the current time is DST or not. See also isDST().
      * 
-     * schedule.withTimes({LocalTimeHMS("06:00"), LocalTimeHMS("18:30")});
+     * This string comes from the LocalTimePosixTimezone object.
      */
-    LocalTimeSchedule &withTimes(std::initializer_list<LocalTimeHMSRestricted> timesParam);
+    String zoneName() const;
 
     /**
-     * @brief Sets the name of this schedule (optional)
+     * @brief Returns the abbreviated time zone name for the current time, without allocating a String
      * 
-     * @param name 
-     * @return LocalTimeSchedule& 
+     * The pointer is to a string in config (or a constant), so it's only valid until this object 
+     * is modified.
      */
-    LocalTimeSchedule &withName(const char *name) {
-        this->name = name;
-        return *this;
-    }
+    const char *getZoneName() const;
 
     /**
-     * @brief Sets the flags for this schedule (optional)
-     * 
-     * @param flags 
-     * @return LocalTimeSchedule& 
+     * @brief Returns the last day of the month, local time (based on localTimeValue)
      */
-    LocalTimeSchedule &withFlags(uint32_t flags) {
-        this->flags = flags;
-        return *this;
-    }
+    int lastDayOfMonth() const;
 
+    /**
+     * @brief Where time is relative to DST
+     */
+    Position position = Position::NO_DST;
 
     /**
-     * @brief Returns true if the schedule does not have any items in it
+     * @brief Timezone configuration for this time conversion
      * 
-     * @return true 
-     * @return false 
+     * If you don't specify this using withConfig then the global setting is retrieved
+     * from the LocalTime singleton instance.
      */
-    bool isEmpty() const { 
-        return scheduleItems.empty();
-    }
+    LocalTimePosixTimezone config;
 
     /**
-     * @brief Clear the existing settings
+     * @brief Optional precomputed transition table, set using withTransitionTable()
      */
-    void clear() {
-        scheduleItems.clear();   
-    }
+    const LocalTimeTransitionTable *transitionTable = nullptr;
 
     /**
-     * @brief Set the schedule from a JSON string containing an array of objects.
-     * 
-     * @param jsonStr 
+     * @brief The time that is being converted. This is always Unix time at UTC
      * 
-     * See the overload that takes a JSONValue if the JSON string has already been parsed.
+     * Seconds after January 1, 1970, UTC. Using methods like nextDay() increment
+     * this value.
      */
-    void fromJson(const char *jsonStr);
+    time_t time;
 
     /**
-     * @brief Set the schedule of this object from a JSONValue, typically the outer object
-     * 
-     * @param jsonArray A JSONValue containing an array of objects
+     * @brief The local time that corresponds to time
      * 
-     * Array of LocalTimeScheduleItem objects:
-     *  - mh (integer): Minute of hour (takes place of setting m and i separately)
-     *  - hd (integer): Hour of day (takes place of setting m and i separately)
-     *  - dw (integer): Day of week (takes place of setting m and i separately)
-     *  - dm (integer): Day of month (takes place of setting m and i separately)
-     *  - tm (string) Time string in HH:MM:SS format (can omit MM and SS parts, see LocalTimeHMS) for TIME items
-     *  - m (integer) type of multiple (optional if mm, )
-     *  - i (integer) increment
-     *  - f (integer) flag bits (optional)
-     *  - s (string) The start time (HH:MM:SS format, can omit MM or SS) [from LocalTimeRange via LocalTimeRange]
-     *  - e (string) The end time (HH:MM:SS format, can omit MM or SS) [from LocalTimeRange via LocalTimeRange]
-     *  - y (integer) mask value for onlyOnDays [from LocalTimeRestrictedDate via LocalTimeRange]
-     *  - a (array) Array of YYYY-MM-DD value strings to allow [from LocalTimeRestrictedDate via LocalTimeRange]
-     *  - x (array) Array of YYYY-MM-DD values to exclude [from LocalTimeRestrictedDate via LocalTimeRange]
+     * The convert() method sets this, as do methods like nextDay(). The local time
+     * will depend on the timezone set in config, as well as the date which will
+     * determine whether it's daylight saving or not.
      */
-    void fromJson(JSONValue jsonArray);
+    LocalTimeValue localTimeValue;
 
     /**
-     * @brief Update the conv object to point at the next schedule item
+     * @brief The time that daylight saving starts, Unix time, UTC
      * 
-     * @param conv LocalTimeConvert object, may be modified
-     * @return true if there is an item available or false if not. if false, conv will be unchanged.
+     * The config specifies the rule (2nd Sunday in March, for example), and the
+     * local time that the change occurs. This is the UTC value that corresponds
+     * to that rule in the year specified by time.
      * 
-     * This method finds closest scheduled time for this object, if it's in the relatively near future.
-     * The LocalTime::instance().getScheduleLookaheadDays() setting determines how far in the future
-     * to check; the default is 100 days. The way schedules work each day needs to be checked to make
-     * sure all of the constraints are met, so long look-aheads are computationally intensive. 
+     * Note in the southern hemisphere, dstStart is after standardStart.
      */
-    bool getNextScheduledTime(LocalTimeConvert &conv) const;
+    time_t dstStart = 0;
 
     /**
-     * @brief Update the conv object to point at the next schedule item
-     * 
-     * @param conv LocalTimeConvert object, may be modified
-     * @param filter A function to determine, for each schedule item, if it should be tested
-     * @return true if there is an item available or false if not. if false, conv will be unchanged.
-     * 
-     * This method finds closest scheduled time for this object, if it's in the relatively near future.
-     * The LocalTime::instance().getScheduleLookaheadDays() setting determines how far in the future
-     * to check; the default is 100 days. The way schedules work each day needs to be checked to make
-     * sure all of the constraints are met, so long look-aheads are computationally intensive. 
-     * 
-     * The filter function or lambda has this prototype:
+     * @brief The struct tm that corresponds to dstStart (UTC)
+     */
+    struct tm dstStartTimeInfo = {};
+
+    /**
+     * @brief The time that standard time starts, Unix time, UTC
      * 
-     * bool filterCallback(LocalTimeScheduleItem &item)
+     * The config specifies the rule (1st Sunday in November, for example), and the
+     * local time that the change occurs. This is the UTC value that corresponds
+     * to that rule in the year specified by time.
      * 
-     * If should return true to check this item, or false to skip this item for schedule checking.
+     * Note in the southern hemisphere, dstStart is after standardStart.
      */
-    bool getNextScheduledTime(LocalTimeConvert &conv, std::function<bool(LocalTimeScheduleItem &item)> filter) const;
+    time_t standardStart = 0;
 
     /**
-     * @brief Determine if it's time to run the scheduled task based on the current time and internal nextTime member variable
-     * 
-     * @return true 
-     * @return false 
+     * @brief The struct tm that corresponds to standardStart (UTC)
      */
-    bool isScheduledTime();
+    struct tm standardStartTimeInfo = {};
 
     /**
-     * @brief Low-level function used for unit testing
+     * @brief Start of the span of time with the same offset and position as time (inclusive, UTC)
      * 
-     * @param conv 
-     * @param timeNow 
-     * @return true 
-     * @return false 
+     * Set by convert(). This never extends past the UTC year of time.
      */
-    bool isScheduledTime(LocalTimeConvert &conv, time_t timeNow);
+    time_t segmentStart = 0;
 
-    static const uint32_t FLAG_QUICK_WAKE       = 0x00000001; //!< Schedule is for quick wake
-    static const uint32_t FLAG_FULL_WAKE        = 0x00000002; //!< Schedule is for full wake with publish
-    // Other wake constants go here, up to 0x00000080
-    static const uint32_t FLAG_ANY_WAKE         = 0x000000ff; //!< Mask for any schedule that wakes
+    /**
+     * @brief End of the span of time with the same offset and position as time (exclusive, UTC)
+     */
+    time_t segmentEnd = 0;
 
-    String name; //!< Name of this schedule (optional, typically used with LocalTimeScheduleManager)
-    uint32_t flags = 0; //!< Flags (optional, typically used with LocalTimeScheduleManager)
-    time_t nextTime = 0; //!< Optional, used with isScheduleTime()
-    std::vector<LocalTimeScheduleItem> scheduleItems; //!< LocalTimeSchedule items
-};
+    static const size_t TIME_STR_SIZE = 26; //!< Buffer size for timeStr() (asctime format)
 
-/**
- * @brief Class for managing multiple named schedules
- * 
- * This is used for the quick and full wake schedules, but can be extended for other uses.
- */
-class LocalTimeScheduleManager {
-public:
+protected:
     /**
-     * @brief Get the next scheduled time of the schedule with name "name"
-     * 
-     * @param name The name to look for (c string)
-     * @param conv The LocalTimeConvert that contains the timezone information to use
-     * @return time_t Time of 0 if there is no schedule with that name
+     * @brief Output buffer used by the char buffer version of format()
      */
-    time_t getNextTimeByName(const char *name, const LocalTimeConvert &conv);
+    struct BufferContext {
+        char *buf;      //!< Buffer to write to
+        size_t bufSize; //!< Size of buf in bytes
+        size_t len;     //!< Total length of the output so far (may be larger than bufSize)
+    };
 
     /**
-     * @brief Get the wake of any type (quick or full)
-     * 
-     * @param conv The LocalTimeConvert that contains the timezone information to use
-     * @return time_t Time of 0 if there is no schedule
+     * @brief FormatCallback that writes to a BufferContext, truncating if necessary
      */
-    time_t getNextWake(const LocalTimeConvert &conv) const;
+    static void bufferCallback(void *context, const char *str, size_t len);
 
     /**
-     * @brief Get the full wake, typically with a publish
+     * @brief Copy a string into a buffer, truncating if necessary
      * 
-     * @param conv The LocalTimeConvert that contains the timezone information to use
-     * @return time_t Time of 0 if there is no schedule
+     * @return size_t len, which is >= bufSize if the string was truncated
      */
-    time_t getNextFullWake(const LocalTimeConvert &conv) const;
+    static size_t copyToBuffer(const char *str, size_t len, char *buf, size_t bufSize);
 
     /**
-     * @brief Get the next scheduled data capture. Data capture schedules are a 
-     * special class of quick wake that also runs while powered on.
-     * 
-     * @param conv 
-     * @return time_t 
+     * @brief Formats the UTC offset for %z, for example "-04:00", or "Z" for UTC
      */
-    time_t getNextDataCapture(const LocalTimeConvert &conv) const;
+    size_t zoneOffsetStr(char *buf, size_t bufSize) const;
 
     /**
-     * @brief Call a function or lambda for each schedule.
-     * 
-     * @param callback Function or lambda to call.
+     * @brief Sets localTimeValue from a local time
      * 
-     * The callback has this prototype:
+     * @param localTime Local time as a time_t
      * 
-     * void callback(LocalTimeSchedule &schedule)
+     * If localTime is on the same local day as the last call, only the hour, minute, and second 
+     * are updated.
      */
-    void forEach(std::function<void(LocalTimeSchedule &schedule)> callback);
+    void setLocalTime(time_t localTime);
 
     /**
-     * @brief Get a LocalTimeSchedule reference by name and creates it if it does not exist
-     * 
-     * @param name Name to get or create
-     * @return LocalTimeSchedule& Reference to the schedule
+     * @brief Seconds to add to UTC to get local time in the segment
      */
-    LocalTimeSchedule &getScheduleByName(const char *name);
+    int32_t segmentOffset = 0;
 
     /**
-     * @brief Set the schedules from a JSON object
-     * 
-     * @param obj 
-     * 
-     * Only the keys in obj that already exist as named schedules are processed! This allows
-     * a single object to contain both schedules and other settings. Plus, in order for a 
-     * named schedule to be useful you probably need to have code to handle it, and this
-     * eliminates the need to pass the schedule flags in the JSON, since they should be
-     * constant depending on how the schedule is being used in the code, not by the
-     * schedule settings.
+     * @brief Local time of midnight of the day in localTimeValue, used by setLocalTime()
      */
-    void setFromJsonObject(const JSONValue &obj);
+    time_t localDayStart = 0;
 
-    std::vector<LocalTimeSchedule> schedules; //!< Vector of all of the schedules. Names and flags are in the schedule object
+    int localDayYear = -1;      //!< tm_year of localDayStart, to detect if localTimeValue was modified
+    int localDayMonth = -1;     //!< tm_mon of localDayStart
+    int localDayMonthDay = -1;  //!< tm_mday of localDayStart
 };
 
+
 /**
- * @brief Perform time conversions. This is the main class you will need.
+ * @brief The scheduled times of a LocalTimeSchedule in a range of time, calculated as they are used
+ * 
+ * Use LocalTimeSchedule::occurrences() to create one of these. It keeps a LocalTimeConvert for each
+ * schedule item at that item's next scheduled time and returns the earliest one, so each step only 
+ * advances the items that were just returned instead of checking every item again.
+ * 
+ * ```
+ * LocalTimeConvert conv;
+ * conv.withCurrentTime().convert();
+ * for(const LocalTimeConvert &occurrence : schedule.occurrences(conv, conv.time + 7 * 86400)) {
+ *     Log.info("%s", occurrence.format(TIME_FORMAT_ISO8601_FULL).c_str());
+ * }
+ * ```
+ * 
+ * The times are the same as calling LocalTimeSchedule::getNextScheduledTime() in a loop, including the 
+ * use of LocalTime::instance().getScheduleLookaheadDays(). The schedule must not be modified or 
+ * destroyed while this object is in use. The iterators are single pass (input iterators); copies of
+ * an iterator share the position of this object.
  */
-class LocalTimeConvert {
+class LocalTimeScheduleOccurrences {
 public:
     /**
-     * @brief Whether the specified time is DST or not. See also isDST().
-     */
-    enum class Position {
-        BEFORE_DST,      //!< This time is before the start of DST (northern hemisphere)
-        IN_DST,          //!< This time is in daylight saving time (northern hemisphere)
-        AFTER_DST,       //!< This time is after the end of DST (northern hemisphere)
-        BEFORE_STANDARD, //!< This time is before the start of standard time (southern hemisphere)
-        IN_STANDARD,     //!< This time is in standard saving time (southern hemisphere)
-        AFTER_STANDARD,  //!< This time is after the end of standard time (southern hemisphere)
-        NO_DST,          //!< This config does not use daylight saving
+     * @brief Construct the occurrences of a schedule, normally done using LocalTimeSchedule::occurrences()
+     * 
+     * @param schedule The schedule. It is referenced, not copied.
+     * @param conv The time and timezone to start from. The first occurrence is after conv.time.
+     * @param until Only occurrences before this time (UTC) are returned
+     */
+    LocalTimeScheduleOccurrences(const LocalTimeSchedule &schedule, const LocalTimeConvert &conv, time_t until);
+
+    /**
+     * @brief Iterator over the occurrences
+     */
+    class iterator {
+    public:
+        typedef std::input_iterator_tag iterator_category;  //!< Single pass iterator
+        typedef LocalTimeConvert value_type;                //!< Occurrences are LocalTimeConvert objects
+        typedef std::ptrdiff_t difference_type;             //!< Not used
+        typedef const LocalTimeConvert *pointer;            //!< Pointer to an occurrence
+        typedef const LocalTimeConvert &reference;          //!< Reference to an occurrence
+
+        /**
+         * @brief Construct an iterator, normally done using begin() and end()
+         * 
+         * @param occurrences The object to iterate, or NULL for the end iterator
+         */
+        iterator(LocalTimeScheduleOccurrences *occurrences = NULL) : occurrences(occurrences) {};
+
+        /**
+         * @brief Gets the current occurrence, converted to local time
+         */
+        reference operator*() const { return occurrences->getCurrent(); };
+
+        /**
+         * @brief Gets the current occurrence, converted to local time
+         */
+        pointer operator->() const { return &occurrences->getCurrent(); };
+
+        /**
+         * @brief Advance to the next occurrence
+         */
+        iterator &operator++() {
+            occurrences->next();
+            return *this;
+        };
+
+        /**
+         * @brief Returns true if both iterators are at the end, or both are not
+         */
+        bool operator==(const iterator &other) const { return isEnd() == other.isEnd(); };
+
+        /**
+         * @brief Returns true if one iterator is at the end and the other is not
+         */
+        bool operator!=(const iterator &other) const { return isEnd() != other.isEnd(); };
+
+    protected:
+        /**
+         * @brief Returns true if this is the end iterator or there are no more occurrences
+         */
+        bool isEnd() const { return !occurrences || !occurrences->isValid(); };
+
+        LocalTimeScheduleOccurrences *occurrences; //!< The object being iterated, or NULL for the end iterator
     };
 
+    /**
+     * @brief Returns an iterator at the current occurrence
+     */
+    iterator begin() { return iterator(this); };
+
+    /**
+     * @brief Returns the end iterator
+     */
+    iterator end() { return iterator(); };
 
     /**
-     * @brief Sets the timezone configuration to use for time conversion
-     * 
-     * If you do not use withConfig() the global default set in the LocalTime class is used.
-     * If neither are set, the local time is UTC (with no DST).
+     * @brief Returns true if there is a current occurrence
      */
-    LocalTimeConvert &withConfig(LocalTimePosixTimezone config) { this->config = config; return *this; };
+    bool isValid() const { return currentIndex != NO_CURSOR; };
 
     /**
-     * @brief Sets the UTC time to begin conversion from 
+     * @brief Gets the current occurrence. Only valid if isValid() is true.
      * 
-     * @param time The time (UTC) to set. This is the Unix timestamp (seconds since January 1, 1970) UTC
-     * such as returned by Time.now().
-     * 
-     * This does not start the conversion; you must also call the convert() method after setting
-     * all of the settings you want to use.
+     * @return const LocalTimeConvert& The occurrence, converted to local time. The reference is only
+     * valid until next() is called.
+     */
+    const LocalTimeConvert &getCurrent() const { return cursors[currentIndex].conv; };
+
+    /**
+     * @brief Advance to the next occurrence
      * 
-     * For the current time, you can instead use withCurrentTime();
+     * @return true if there is an occurrence or false if there are no more before until
      */
-    LocalTimeConvert &withTime(time_t time) { this->time = time; return *this; };
+    bool next();
+
+protected:
+    /**
+     * @brief The next scheduled time of one schedule item
+     */
+    struct Cursor {
+        LocalTimeConvert conv;      //!< The next scheduled time of this item, if isValid
+        bool isValid = false;       //!< true if conv is a scheduled time
+        bool canRetry = false;      //!< true if the item had no time within the lookahead period, but a later search could find one before until
+        int searchDays = 0;         //!< Local day the last search started from (LocalTimeYMD::toDays())
+    };
+
+    /**
+     * @brief Value of currentIndex when there is no current occurrence
+     */
+    static const size_t NO_CURSOR = (size_t)-1;
+
+    /**
+     * @brief Finds the next scheduled time of the item after conv and stores it in cursors[index]
+     */
+    void advanceCursor(size_t index, const LocalTimeConvert &conv);
+
+    /**
+     * @brief Sets currentIndex to the cursor with the earliest time before until, or NO_CURSOR
+     */
+    void selectCurrent();
 
+    const LocalTimeSchedule &schedule;  //!< The schedule, not copied
+    time_t until;                       //!< Only return occurrences before this time
+    int untilDays;                      //!< Local day of until (LocalTimeYMD::toDays())
+    std::vector<Cursor> cursors;        //!< One for each item in the schedule
+    size_t currentIndex = NO_CURSOR;    //!< Index into cursors of the current occurrence
+};
+
+
+/**
+ * @brief Compact result of converting a UTC time to local time
+ * 
+ * This holds the same information as LocalTimeConvert in 64 bytes: the UTC time, offset,
+ * position relative to DST, and the local date and time packed into small fields. The timezone
+ * is referenced by pointer instead of being copied, and the struct tm values LocalTimeConvert
+ * keeps are not stored. This makes it inexpensive to copy and store in large numbers.
+ * 
+ * ```
+ * LocalTimeConversion conv;
+ * conv.withConfig(&tzConfig).withTime(Time.now()).convert();
+ * Log.info("hour=%d", conv.hour);
+ * ```
+ * 
+ * The transition times are calculated without using the config's cache, so the same config
+ * can be used by conversions in multiple threads. Like LocalTimeConvert, converting a time in
+ * the same segment as the previous conversion only updates the local time fields.
+ * 
+ * LocalTimeConvert uses this class to do its conversions.
+ */
+class LocalTimeConversion {
+public:
     /**
-     * @brief Use the current time as the time to start with
+     * @brief Sets the timezone configuration to use
      * 
-     * This does not start the conversion; you must also call the convert() method after setting
-     * all of the settings you want to use.
+     * @param config Pointer to the configuration. It is not copied, so it must remain valid. If
+     * nullptr, the global configuration from LocalTime is used, and the next conversion after
+     * the global configuration is changed uses the new one. The pointer to the global 
+     * configuration is not kept; its version is.
      */
-    LocalTimeConvert &withCurrentTime() { this->time = Time.now(); return *this; };
+    LocalTimeConversion &withConfig(const LocalTimePosixTimezone *config) { this->config = config; segmentStart = segmentEnd = 0; return *this; };
 
     /**
-     * @brief Do the time conversion
+     * @brief Sets the UTC time to convert
      * 
-     * You must call this after changing the configuration or the time using withTime() or withCurrentTime()
+     * @param time time_t UTC
      */
-    void convert();
+    LocalTimeConversion &withTime(time_t time) { this->time = time; return *this; };
 
     /**
-     * @brief Returns true if the current time is in daylight saving time
+     * @brief Converts time, updating all fields
      */
-    bool isDST() const { return position == Position::IN_DST || position == Position::BEFORE_STANDARD || position == Position::AFTER_STANDARD; };
+    void convert();
 
     /**
-     * @brief Returns true of the current time in in standard time
+     * @brief Updates offset, position, segment, and transitions for time, but not the local time fields
      */
-    bool isStandardTime() const { return !isDST(); };
+    void convertOffset();
 
     /**
-     * @brief Adds a number of seconds to the current object
+     * @brief Updates offset, position, and segment from the transitions in the UTC year of time
      * 
-     * @param seconds 
-     */
-    void addSeconds(int seconds);
-
-    /**
-     * @brief Moves the current time the next specified multiple of minutes
+     * @param config The configuration the transitions were calculated from. It must have DST.
      * 
-     * @param increment Typically something like 5, 15, 20, 30 that 60 is evenly divisible by
+     * @param utcYear The UTC year of time, in struct tm format (121 = 2021)
      * 
-     * @param startingModulo (optional). If present, must be 0 < startingModulo < increment
+     * @param dstStart The time DST starts in utcYear
      * 
-     * Moves the time forward to the next multiple of that number of minutes. For example, if the 
-     * clock is at :10 past the hour and the multiple is 15, then time will be updated to :15. If
-     * the time is equal to an even multple, the next multiple is selected.
+     * @param standardStart The time standard time starts in utcYear
      * 
-     * Upon completion, all fields are updated appropriately. For example:
-     * - time specifies the time_t of the new time at UTC
-     * - localTimeValue contains the broken-out values for the local time
-     * - isDST() return true if the new time is in daylight saving time
+     * This is used when the caller already has the transitions for the year, such as from the
+     * config's cache.
      */
-    void nextMinuteMultiple(int increment, int startingModulo = 0);
+    void offsetFromTransitions(const LocalTimePosixTimezone &config, int utcYear, time_t dstStart, time_t standardStart);
 
     /**
-     * @brief Moves the current time the next specified local time. This could be today or tomorrow.
-     * 
-     * @param hms Moves to the next occurrence of that time of day (local time)
-     * 
-     * Upon completion, all fields are updated appropriately. For example:
-     * - time specifies the time_t of the new time at UTC
-     * - localTimeValue contains the broken-out values for the local time
-     * - isDST() return true if the new time is in daylight saving time
+     * @brief Returns true if the time is in daylight saving time
      */
-    void nextTime(LocalTimeHMS hms);
+    bool isDST() const { 
+        return position == LocalTimeConvert::Position::IN_DST || position == LocalTimeConvert::Position::BEFORE_STANDARD || position == LocalTimeConvert::Position::AFTER_STANDARD; 
+    };
 
-   /**
-     * @brief Moves the current time to the next minute
-     * 
-     * Upon completion, all fields are updated appropriately. For example:
-     * - time specifies the time_t of the new time at UTC
-     * - localTimeValue contains the broken-out values for the local time
-     * - isDST() return true if the new time is in daylight saving time
+    /**
+     * @brief Returns the local time as a time_t (as if local time were UTC)
      */
-    void nextMinute() { nextMinuteMultiple(1); };
+    time_t localTime() const { return time + offset; };
 
     /**
-     * @brief Moves the current time to the next hour
+     * @brief Fill in a struct tm with the local time
      * 
-     * Upon completion, all fields are updated appropriately. For example:
-     * - time specifies the time_t of the new time at UTC
-     * - localTimeValue contains the broken-out values for the local time
-     * - isDST() return true if the new time is in daylight saving time
+     * @param pTimeInfo The struct tm to fill in. tm_isdst is set from isDST().
      */
-    void nextHour() { nextMinuteMultiple(60); };
+    void toTimeInfo(struct tm *pTimeInfo) const;
 
     /**
-     * @brief Moves the current time to the next day at midnight
-     * 
-     * Upon completion, all fields are updated appropriately. For example:
-     * - time specifies the time_t of the new time at UTC
-     * - localTimeValue contains the broken-out values for the local time
-     * - isDST() return true if the new time is in daylight saving time
+     * @brief Returns the local time as a LocalTimeValue
      */
-    void nextDayMidnight() { nextTime(LocalTimeHMS("00:00:00")); };
+    LocalTimeValue getLocalTimeValue() const;
 
     /**
-     * @brief Moves the current time the closest local time om hmsList. This could be today or tomorrow.
-     * 
-     * @param hmsList An initialize list of LocalTimeHMS surrounded by {}
-     * 
-     * For example, this sets the time to the nearest noon or midnight local time greater than the time
-     * set in this object:
+     * @brief Gets the position of time relative to the DST transitions in its year
      * 
-     * conv.nextTimeList({LocalTimeHMS("00:00"), LocalTimeHMS("12:00")});
+     * @param time The time (Unix time, UTC)
+     * @param dstStart The time DST starts that year
+     * @param standardStart The time standard time starts that year
      */
-    void nextTimeList(std::initializer_list<LocalTimeHMS> hmsList);
+    static LocalTimeConvert::Position positionFromTransitions(time_t time, time_t dstStart, time_t standardStart);
 
+protected:
+    /**
+     * @brief Updates offset, position, and segment for time using config
+     */
+    void offsetFromConfig(const LocalTimePosixTimezone &config);
+
+public:
+    const LocalTimePosixTimezone *config = nullptr; //!< Timezone configuration (not copied), nullptr for the global configuration
+    time_t time = 0;            //!< The time being converted (UTC)
+    time_t segmentStart = 0;    //!< Start of the span with the same offset and position (inclusive, UTC)
+    time_t segmentEnd = 0;      //!< End of the span with the same offset and position (exclusive, UTC)
+    int32_t offset = 0;         //!< Seconds to add to UTC to get local time
+    uint32_t configVersion = 0; //!< Version of the global configuration the segment is for (only if config is nullptr)
+    int16_t year = 0;           //!< Local year (2021 = 2021)
+    int16_t dayOfYear = 0;      //!< Local day of year, 0 = January 1
+    int8_t month = 0;           //!< Local month, 1 - 12
+    int8_t day = 0;             //!< Local day of month, 1 - 31
+    int8_t hour = 0;            //!< Local hour, 0 - 23
+    int8_t minute = 0;          //!< Local minute, 0 - 59
+    int8_t second = 0;          //!< Local second, 0 - 59
+    int8_t dayOfWeek = 0;       //!< Local day of week, 0 = Sunday
+    LocalTimeConvert::Position position = LocalTimeConvert::Position::NO_DST; //!< Where time is relative to DST
+};
 
+static_assert(sizeof(LocalTimeConversion) <= 64, "LocalTimeConversion should fit in a cache line");
 
+/**
+ * @brief Convert a stream of mostly increasing UTC times, such as log or sensor records
+ * 
+ * The cursor remembers the daylight saving segment and the local day of the last time it 
+ * was advanced to. Advancing to a time in the same segment and the same local day is a 
+ * couple of compares and a division to get the hour, minute, and second. The transitions are 
+ * only recalculated when the time leaves the segment, and the date only when it changes 
+ * local day.
+ * 
+ * ```
+ * LocalTimeCursor cursor;
+ * cursor.withConfig(&tzConfig);
+ * for(size_t ii = 0; ii < count; ii++) {
+ *     cursor.advance(records[ii].time);
+ *     Log.info("%02d:%02d:%02d", cursor.hour, cursor.minute, cursor.second);
+ * }
+ * ```
+ * 
+ * Times do not need to be in order. A time before the current segment or day is converted 
+ * correctly, it just takes the slower path, and the cursor then continues from there.
+ */
+class LocalTimeCursor : public LocalTimeConversion {
+public:
     /**
-     * @brief Moves the current time to the previous day
-     * 
-     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
+     * @brief Sets the timezone configuration to use
      * 
-     * Upon completion, all fields are updated appropriately. For example:
-     * - time specifies the time_t of the new time at UTC
-     * - localTimeValue contains the broken-out values for the local time
-     * - isDST() return true if the new time is in daylight saving time
+     * @param config Pointer to the configuration. It is not copied, so it must remain valid. If
+     * nullptr, the global configuration from LocalTime is used.
      */
-    void prevDay(LocalTimeHMS hms = LocalTimeIgnoreHMS());
+    LocalTimeCursor &withConfig(const LocalTimePosixTimezone *config) { 
+        LocalTimeConversion::withConfig(config); 
+        localDays = INVALID_DAYS; 
+        return *this; 
+    };
 
     /**
-     * @brief Moves the current time to the next day
+     * @brief Sets the UTC time to convert
      * 
-     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
+     * @param time time_t UTC
      * 
-     * Upon completion, all fields are updated appropriately. For example:
-     * - time specifies the time_t of the new time at UTC
-     * - localTimeValue contains the broken-out values for the local time
-     * - isDST() return true if the new time is in daylight saving time
+     * This returns the cursor so withTime(time).convert() calls the convert() in this class.
      */
-    void nextDay(LocalTimeHMS hms = LocalTimeIgnoreHMS());
+    LocalTimeCursor &withTime(time_t time) { this->time = time; return *this; };
 
     /**
-     * @brief Moves the current to the next day, or right after the next time change, whichever comes first 
-     * 
-     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
-     * 
-     * Upon completion, all fields are updated appropriately. For example:
-     * - time specifies the time_t of the new time at UTC
-     * - localTimeValue contains the broken-out values for the local time
-     * - isDST() return true if the new time is in daylight saving time
+     * @brief Convert a time, updating all fields
      * 
-     * This method is used when you want to synchronize an external device clock daily to keep it synchronized,
-     * or right after a time change.
-     * 
-     * Do not pick the local time of the time change as the hms time! For example, in the United State do *not* select
-     * 02:00:00. The reason is that on spring forward, that time doesn't actually exist, because as soon as the clock
-     * hits 02:00:00 it jumps forward to 03:00:00 local time. Picking 03:00:00 or really any other time that's not between 
-     * 02:00:00 and 02:59:59 is fine. During fall back, even though you've picked the time sync time to be 03:00 local
-     * time it will sync at the time of the actual time change correctly, which is why this function is different than
-     * nextDay().
+     * @param time time_t UTC
      */
-    void nextDayOrTimeChange(LocalTimeHMS hms = LocalTimeIgnoreHMS());
+    LocalTimeCursor &advance(time_t time);
 
     /**
-     * @brief Moves the current time to the next of the specified day of week
-     * 
-     * @param dayOfWeek The day of week (0 - 6, 0 = Sunday, 1 = Monday, ..., 6 = Saturday)
-     * 
-     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
-     * 
-     * Upon completion, all fields are updated appropriately. For example:
-     * - time specifies the time_t of the new time at UTC
-     * - localTimeValue contains the broken-out values for the local time
-     * - isDST() return true if the new time is in daylight saving time
+     * @brief Converts the time set using withTime(), the same as advance(time)
      */
-    bool nextDayOfWeek(int dayOfWeek, LocalTimeHMS hms = LocalTimeIgnoreHMS());
+    void convert() { advance(time); };
+
+    static const int32_t INVALID_DAYS = std::numeric_limits<int32_t>::min(); //!< localDays before the first conversion
+
+    int32_t localDays = INVALID_DAYS; //!< Local day of the fields, as days since January 1, 1970
+    int16_t localDayYear = 0;   //!< year when localDays was set, to detect the fields being changed by LocalTimeConversion::convert()
+    int8_t localDayMonth = 0;   //!< month when localDays was set
+    int8_t localDayDay = 0;     //!< day when localDays was set
+};
 
+/**
+ * @brief Convert an array of UTC times to local time in one call
+ *
+ * This is intended for converting large amounts of data, such as sensor logs, where creating a 
+ * LocalTimeConvert object for each value is too slow. The results are stored in separate arrays
+ * (structure-of-arrays) that you provide. Only the arrays you set with the with methods are 
+ * filled in, and each must have room for the number of times passed to convert().
+ * 
+ * ```
+ * LocalTimeBatchConvert batch;
+ * batch.withConfig(tzConfig).withLocalTime(localTimes).withDST(dstFlags).convert(utcTimes, count);
+ * ```
+ * 
+ * Runs of times that have the same UTC offset are converted together in a tight loop with no 
+ * branches, which the compiler can vectorize. This is very fast when all of the times are in 
+ * the same daylight saving segment.
+ */
+class LocalTimeBatchConvert {
+public:
     /**
-     * @brief Returns the next day that is a weekday (Monday - Friday)
-     * 
-     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
+     * @brief Sets the timezone configuration to use for time conversion
      * 
-     * Upon completion, all fields are updated appropriately. For example:
-     * - time specifies the time_t of the new time at UTC
-     * - localTimeValue contains the broken-out values for the local time
-     * - isDST() return true if the new time is in daylight saving time
+     * If you do not use withConfig() the global default set in the LocalTime class is used.
      */
-    void nextWeekday(LocalTimeHMS hms = LocalTimeIgnoreHMS());
+    LocalTimeBatchConvert &withConfig(const LocalTimePosixTimezone &config) { this->config = config; return *this; };
 
     /**
-     * @brief Returns the next day that is a weekend day (Saturday or Sunday)
-     * 
-     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
-     * 
-     * Upon completion, all fields are updated appropriately. For example:
-     * - time specifies the time_t of the new time at UTC
-     * - localTimeValue contains the broken-out values for the local time
-     * - isDST() return true if the new time is in daylight saving time
+     * @brief Array to store the local time in, as if local time was Unix time (seconds since January 1, 1970)
      */
-    void nextWeekendDay(LocalTimeHMS hms = LocalTimeIgnoreHMS());
+    LocalTimeBatchConvert &withLocalTime(time_t *localTime) { this->localTime = localTime; return *this; };
 
     /**
-     * @brief Moves the date and time (local time) forward to the specified day of month and local time
-     * 
-     * @param dayOfMonth The day of the month (1 = first day of the month). See also special cases below.
-     * 
-     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
-     * 
-     * This version will move to the closest forward time. It could be as close as 1 second later, but 
-     * it will always advance at least once second. It could be as much as 1 month minus 1 second later.
-     * 
-     * Upon completion, all fields are updated appropriately. For example:
-     * - time specifies the time_t of the new time at UTC
-     * - localTimeValue contains the broken-out values for the local time
-     * - isDST() return true if the new time is in daylight saving time
+     * @brief Array to store the offset in. This is the number of seconds added to UTC to get local time.
      * 
-     * dayOfMonth is normally a a day number (1 = first day of the month). There are also special cases:
-     * 0 = the last day of the month, -1 the second to last day of month, ... The number of days in the month are
-     * based on the date in local time.
+     * This is the opposite sign of the POSIX timezone string, so it's negative in the United States.
      */
-    bool nextDayOfMonth(int dayOfMonth, LocalTimeHMS hms = LocalTimeIgnoreHMS());
+    LocalTimeBatchConvert &withOffset(int32_t *offset) { this->offset = offset; return *this; };
 
     /**
-     * @brief Moves the date and time (local time) forward to the specified day of month and local time
-     * 
-     * @param dayOfMonth The day of the month (1 = first day of the month). See also special cases below.
-     * 
-     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
-     * 
-     * This version always picks the next month, even if the target day of month hasn't been reached
-     * in this month yet. This will always more forward at least a month, and may be as much as 
-     * two months minus one day.
-     * 
-     * Upon completion, all fields are updated appropriately. For example:
-     * - time specifies the time_t of the new time at UTC
-     * - localTimeValue contains the broken-out values for the local time
-     * - isDST() return true if the new time is in daylight saving time
-     * 
-     * dayOfMonth is normally a a day number (1 = first day of the month). There are also special cases:
-     * 0 = the last day of the month, -1 the second to last day of month, ... The number of days in the month are
-     * based on the date in local time.
+     * @brief Array to store the daylight saving flag in, 1 if in DST or 0 if not
      */
-    bool nextDayOfNextMonth(int dayOfMonth, LocalTimeHMS hms = LocalTimeIgnoreHMS());
-
+    LocalTimeBatchConvert &withDST(uint8_t *dst) { this->dst = dst; return *this; };
 
     /**
-     * @brief Moves the date and time (local time) forward to the specified day of month and local time
-     * 
-     * @param dayOfWeek The day of week (0 - 6, 0 = Sunday, 1 = Monday, ..., 6 = Saturday)
-     * 
-     * @param ordinal 1 = first of that day of week in month, 2 = second, ...
-     * 
-     * @param hms If specified, moves to that time of day (local time). If omitted, leaves the current time and only changes the date.
+     * @brief Arrays to store the local date and time components in
      * 
-     * If you specify an ordinal that does not exist (for example, there may not be a 5th ordinal for certain days
-     * in certain months), returns false and leaves the date unchanged.
+     * @param year 4-digit year (2021, for example)
+     * @param month Month 1 - 12 (not like struct tm which is 0 - 11)
+     * @param day Day of month 1 - 31
+     * @param hour Hour 0 - 23
+     * @param minute Minute 0 - 59
+     * @param second Second 0 - 59
      * 
-     * Upon successful completion, all fields are updated appropriately. For example:
-     * - time specifies the time_t of the new time at UTC
-     * - localTimeValue contains the broken-out values for the local time
-     * - isDST() return true if the new time is in daylight saving time
+     * Any parameter can be NULL if you don't need that component.
      */
-    bool nextDayOfWeekOrdinal(int dayOfWeek, int ordinal, LocalTimeHMS hms = LocalTimeIgnoreHMS());
+    LocalTimeBatchConvert &withDateTime(int16_t *year, int8_t *month, int8_t *day, int8_t *hour, int8_t *minute, int8_t *second) {
+        this->year = year; 
+        this->month = month; 
+        this->day = day; 
+        this->hour = hour; 
+        this->minute = minute; 
+        this->second = second;
+        return *this;
+    }
 
     /**
-     * @brief Sets the time to the nearest hms in local time in the future.
-     * 
-     * @param hms The time of day to set in local time
-     * 
-     * Moves the time forward to the next instance of hms in local time. If hms has not
-     * occurred yet, it will select the one today, but it will always move the time forward.
+     * @brief Convert an array of times
      * 
-     * There is a weird special case on the beginning of daylight saving (spring forward in
-     * the northern hemisphere). If you select a hms between 2:00 AM and 2:59:59 AM local time,
-     * this time does not exist on spring forward day because it's the hour that is skipped.
-     * In order to preserve the requirement that the time will always be advanced by this
-     * call, it will jump forward to the next day when the 2:00 hour occurs next. (The hour
-     * may be different in other locations, for example it's 1:00 AM in the UK.)
+     * @param times Array of Unix times (seconds since January 1, 1970) at UTC
+     * @param count Number of elements in times (and in each of the result arrays)
      * 
-     * In the case of fall back, if you specify a hms in the repeated hour (1:00:00 to 1:59:59)
-     * the time returned will be the second time this time occurs, in standard time in the US.
+     * The times do not need to be sorted, but conversion is faster when nearby elements
+     * have the same UTC offset.
+     */
+    void convert(const time_t *times, size_t count);
+
+    /**
+     * @brief Timezone configuration for this time conversion
+     */
+    LocalTimePosixTimezone config;
+
+    time_t *localTime = nullptr;    //!< Local time results (optional)
+    int32_t *offset = nullptr;      //!< Offset from UTC in seconds results (optional)
+    uint8_t *dst = nullptr;         //!< DST flag results (optional)
+    int16_t *year = nullptr;        //!< Local year results (optional)
+    int8_t *month = nullptr;        //!< Local month results (optional)
+    int8_t *day = nullptr;          //!< Local day of month results (optional)
+    int8_t *hour = nullptr;         //!< Local hour results (optional)
+    int8_t *minute = nullptr;       //!< Local minute results (optional)
+    int8_t *second = nullptr;       //!< Local second results (optional)
+
+protected:
+    /**
+     * @brief Convert a run of times that all have the same offset
      * 
-     * Upon completion, all fields are updated appropriately. For example:
-     * - time specifies the time_t of the new time at UTC
-     * - localTimeValue contains the broken-out values for the local time
-     * - isDST() return true if the new time is in daylight saving time
-     */    
-    void nextLocalTime(LocalTimeHMS hms);
+     * @param start Index into times and the result arrays to start at
+     * @param count Number of elements to convert
+     */
+    void convertRun(const time_t *times, size_t start, size_t count, int32_t runOffset, bool runDST);
+};
 
+/**
+ * @brief Convert one UTC time to local time in many timezones in one call
+ *
+ * This is the opposite of LocalTimeBatchConvert: one time and many timezones, such as when 
+ * displaying the same event for users in different locations. The timezones are either an
+ * array of LocalTimePosixTimezone objects or an array of handles from a LocalTimeZoneRegistry.
+ * The results are stored in separate arrays that you provide, one element per timezone. Only 
+ * the arrays you set with the with methods are filled in.
+ * 
+ * ```
+ * LocalTimeMultiZoneConvert multi;
+ * multi.withZones(zones, numZones).withDateTime(year, month, day, hour, minute, second).convert(Time.now());
+ * ```
+ * 
+ * The UTC calendar date and year are calculated once and shared by all timezones, so each 
+ * timezone only costs a transition lookup and an add. With handles, the lookup is in the
+ * registry's transition table. With configs, it uses a cache of transitions by year owned by
+ * this object, one entry per timezone, because the configs may be shared with other threads.
+ */
+class LocalTimeMultiZoneConvert {
+public:
     /**
-     * @brief Sets the time to the nearest scheduled time in the future base on the schedule
+     * @brief Sets an array of timezone configurations to convert to
      * 
-     * @param schedule 
+     * @param configs Array of configurations. It is not copied, so it must remain valid until convert().
+     * @param count Number of elements in configs (and in each of the result arrays)
+     * 
+     * An element that is not valid uses the global default set in the LocalTime class.
      */
-    bool nextSchedule(const LocalTimeSchedule &schedule);
+    LocalTimeMultiZoneConvert &withConfigs(const LocalTimePosixTimezone *configs, size_t count) { 
+        this->configs = configs; 
+        this->zones = nullptr;
+        this->count = count; 
+        return *this; 
+    };
 
     /**
-     * @brief Changes the time of day to the specified hms in local time on the same local day
+     * @brief Sets an array of timezone handles to convert to
      * 
-     * @param hms A LocalTimeHMS object with hour, minute, and second
+     * @param zones Array of handles from LocalTimeZoneRegistry::intern(). It is not copied, so it must remain valid until convert().
+     * @param count Number of elements in zones (and in each of the result arrays)
+     * @param registry The registry the handles came from. Default is the singleton instance.
      * 
-     * You can use the string constructor like this to set the time to 2:00 PM local time.
+     * An element that is not a valid handle uses the global default set in the LocalTime class.
+     */
+    LocalTimeMultiZoneConvert &withZones(const LocalTimeZoneHandle *zones, size_t count, const LocalTimeZoneRegistry &registry = LocalTimeZoneRegistry::instance()) { 
+        this->configs = nullptr;
+        this->zones = zones; 
+        this->count = count; 
+        this->registry = &registry;
+        return *this; 
+    };
+
+    /**
+     * @brief Array to store the local time in, as if local time was Unix time (seconds since January 1, 1970)
+     */
+    LocalTimeMultiZoneConvert &withLocalTime(time_t *localTime) { this->localTime = localTime; return *this; };
+
+    /**
+     * @brief Array to store the offset in. This is the number of seconds added to UTC to get local time.
      * 
-     * ```
-     * converter.atLocalTime(LocalTimeHms("14:00:00"));
-     * ```
+     * This is the opposite sign of the POSIX timezone string, so it's negative in the United States.
+     */
+    LocalTimeMultiZoneConvert &withOffset(int32_t *offset) { this->offset = offset; return *this; };
+
+    /**
+     * @brief Array to store the daylight saving flag in, 1 if in DST or 0 if not
+     */
+    LocalTimeMultiZoneConvert &withDST(uint8_t *dst) { this->dst = dst; return *this; };
+
+    /**
+     * @brief Arrays to store the local date and time components in
      * 
-     * It's possible that this will set the time to a time earlier than the object's current
-     * time. To only set a time in the future, use nextLocalTime() instead.
+     * @param year 4-digit year (2021, for example)
+     * @param month Month 1 - 12 (not like struct tm which is 0 - 11)
+     * @param day Day of month 1 - 31
+     * @param hour Hour 0 - 23
+     * @param minute Minute 0 - 59
+     * @param second Second 0 - 59
      * 
-     * Upon completion, all fields are updated appropriately. For example:
-     * - time specifies the time_t of the new time at UTC
-     * - localTimeValue contains the broken-out values for the local time
-     * - isDST() return true if the new time is in daylight saving time
+     * Any parameter can be NULL if you don't need that component.
      */
-    void atLocalTime(LocalTimeHMS hms);
+    LocalTimeMultiZoneConvert &withDateTime(int16_t *year, int8_t *month, int8_t *day, int8_t *hour, int8_t *minute, int8_t *second) {
+        this->year = year; 
+        this->month = month; 
+        this->day = day; 
+        this->hour = hour; 
+        this->minute = minute; 
+        this->second = second;
+        return *this;
+    }
 
     /**
-     * @brief Get the value of this object as a LocalTimeHMS (hour minute second)
+     * @brief Convert a time to each of the timezones
      * 
-     * @return LocalTimeHMS 
+     * @param time Unix time (seconds since January 1, 1970) at UTC
      */
-    LocalTimeHMS getLocalTimeHMS() const { return LocalTimeHMS(localTimeValue); };
+    void convert(time_t time);
 
+    const LocalTimePosixTimezone *configs = nullptr; //!< Timezone configurations (not copied), or nullptr if using zones
+    const LocalTimeZoneHandle *zones = nullptr;     //!< Timezone handles (not copied), or nullptr if using configs
+    const LocalTimeZoneRegistry *registry = nullptr; //!< Registry for zones
+    size_t count = 0;                               //!< Number of timezones
+
+    time_t *localTime = nullptr;    //!< Local time results (optional)
+    int32_t *offset = nullptr;      //!< Offset from UTC in seconds results (optional)
+    uint8_t *dst = nullptr;         //!< DST flag results (optional)
+    int16_t *year = nullptr;        //!< Local year results (optional)
+    int8_t *month = nullptr;        //!< Local month results (optional)
+    int8_t *day = nullptr;          //!< Local day of month results (optional)
+    int8_t *hour = nullptr;         //!< Local hour results (optional)
+    int8_t *minute = nullptr;       //!< Local minute results (optional)
+    int8_t *second = nullptr;       //!< Local second results (optional)
+
+protected:
     /**
-     * @brief Get the value of this object as a LocalTimeYMD (year month day0)
+     * @brief Get the offset for a config at time, using the shared UTC year
      * 
-     * @return LocalTimeYMD 
+     * @param index Index of the timezone, which selects the entry in transitionCache
      */
-    LocalTimeYMD getLocalTimeYMD() const { return LocalTimeYMD(localTimeValue); };
+    int32_t configOffset(size_t index, const LocalTimePosixTimezone &config, time_t time, bool *pIsDST);
 
     /**
-     * @brief Works like Time.timeStr() to generate a readable string of the local time
-     * 
-     * Uses asctime formatting, which looks like "Fri Jan  1 18:45:56 2021". The strings
-     * are not localized; they're always in English.
+     * @brief Store the results for one timezone
      */
-    String timeStr();
+    void store(size_t index, time_t time, int32_t zoneOffset, bool zoneDST);
+
+    int64_t utcDays = 0;        //!< Days since January 1, 1970 of the time being converted (UTC)
+    int utcSecondOfDay = 0;     //!< Second of the day of the time being converted (UTC)
+    int utcYear = 0;            //!< UTC year, in struct tm format (121 = 2021)
+    int nearYear[3] = {};       //!< Year of the day before, the day of, and the day after the UTC date
+    int nearMonth[3] = {};      //!< Month (1 - 12) of the day before, the day of, and the day after the UTC date
+    int nearDay[3] = {};        //!< Day of month of the day before, the day of, and the day after the UTC date
+    std::vector<LocalTimePosixTimezone::TransitionCacheEntry> transitionCache; //!< Transitions by timezone index, so shared configs are not written
+};
+
+/**
+ * @brief A format specifier that has been compiled for fast formatting of many times
+ * 
+ * LocalTimeConvert::format() scans the format specifier and calls strftime() every time. If you
+ * format many times with the same specifier, compile it once using this class instead. Common 
+ * conversions are turned into operations that write the digits directly, and the output is
+ * identical to LocalTimeConvert::format().
+ * 
+ * ```
+ * LocalTimeFormatter formatter(TIME_FORMAT_ISO8601_FULL);
+ * char buf[32];
+ * formatter.format(conv, buf, sizeof(buf));
+ * ```
+ * 
+ * These conversions are done directly: %a %A %b %B %C %d %D %e %F %h %H %I %j %m %M %n %p %r %R 
+ * %S %t %T %u %w %y %Y %z %Z %%. Any others, including ones with flags or E and O modifiers, 
+ * are passed to strftime() so the results are still the same, just not as fast.
+ * 
+ * Compiling allocates memory for the operations, but formatting does not.
+ */
+class LocalTimeFormatter {
+public:
+    /**
+     * @brief Construct an empty formatter. Use compile() to set the format specifier.
+     */
+    LocalTimeFormatter() {
+    }
 
     /**
-     * @brief Works like Time.format()
+     * @brief Construct a formatter and compile a format specifier
      * 
-     * @param formatSpec the format specifies, which can be 
+     * @param formatSpec The format specifier, see LocalTimeConvert::format()
+     */
+    LocalTimeFormatter(const char *formatSpec) {
+        compile(formatSpec);
+    }
+
+    /**
+     * @brief Compile a format specifier
      * 
-     * - TIME_FORMAT_DEFAULT (example: "Thu Apr  1 12:00:00 2021")
-     * - TIME_FORMAT_ISO8601_FULL (example: "2021-04-01T12:00:00-04:00")
-     * - custom format based on strftime()
+     * @param formatSpec The format specifier, see LocalTimeConvert::format(). NULL or 
+     * TIME_FORMAT_DEFAULT is the asctime format, like LocalTimeConvert::timeStr().
+     */
+    void compile(const char *formatSpec);
+
+    /**
+     * @brief Format the local time of a LocalTimeConvert object
      * 
-     * There are many options to strftime described here: 
-     * https://www.cplusplus.com/reference/ctime/strftime/?kw=strftime
+     * @param conv The object to format the local time of
+     * @param buf Buffer to store the string in. Always null terminated if bufSize > 0.
+     * @param bufSize Size of buf in bytes
+     * @return size_t Length of the formatted string, not including the null terminator. If this is 
+     * >= bufSize the string was truncated.
+     */
+    size_t format(const LocalTimeConvert &conv, char *buf, size_t bufSize) const;
+
+    /**
+     * @brief Format the local time of a LocalTimeConvert object as a String
      * 
-     * Unlike Time.format(), you can use %Z to output the timezone abbreviation,
-     * for example "EDT" for the Eastern United States, daylight saving instead 
-     * of -04:00.
+     * @param conv The object to format the local time of
+     */
+    String format(const LocalTimeConvert &conv) const;
+
+    /**
+     * @brief Format the local time of a LocalTimeConversion or LocalTimeCursor object
      * 
-     * The %z formatting matches that of Time.format(), which is wrong. The
-     * correct output should be "-400" but the output will be "-04:00" 
-     * for compatibility.
+     * @param conversion The object to format the local time of
+     * @param buf Buffer to store the string in. Always null terminated if bufSize > 0.
+     * @param bufSize Size of buf in bytes
+     * @return size_t Length of the formatted string, not including the null terminator. If this is 
+     * >= bufSize the string was truncated.
      */
-    String format(const char* formatSpec);
+    size_t format(const LocalTimeConversion &conversion, char *buf, size_t bufSize) const;
 
     /**
-     * @brief Returns the abbreviated time zone name for the current time
+     * @brief Format one result of a LocalTimeBatchConvert
      * 
-     * For example, for the United States east coast, EST or EDT depending on
-     * whether the current time is DST or not. See also isDST().
+     * @param batch The batch object, after calling convert(). The localTime array must have been set.
+     * @param index The index of the result to format
+     * @param buf Buffer to store the string in. Always null terminated if bufSize > 0.
+     * @param bufSize Size of buf in bytes
+     * @return size_t Length of the formatted string, not including the null terminator. If this is 
+     * >= bufSize the string was truncated.
      * 
-     * This string comes from the LocalTimePosixTimezone object.
+     * The DST flag is taken from the dst array. If it was not set, times are formatted as standard time.
      */
-    String zoneName() const;
+    size_t format(const LocalTimeBatchConvert &batch, size_t index, char *buf, size_t bufSize) const;
 
     /**
-     * @brief Returns the last day of the month, local time (based on localTimeValue)
+     * @brief Operations in a compiled format specifier
      */
-    int lastDayOfMonth() const;
+    enum class OpType : uint8_t {
+        LITERAL,            //!< Copy text from literals
+        STRFTIME,           //!< Call strftime() with the conversion in literals
+        YEAR,               //!< %Y
+        YEAR_2,             //!< %y
+        CENTURY,            //!< %C
+        MONTH,              //!< %m
+        DAY,                //!< %d
+        DAY_SPACE,          //!< %e
+        DAY_OF_YEAR,        //!< %j
+        HOUR,               //!< %H
+        HOUR_12,            //!< %I
+        MINUTE,             //!< %M
+        SECOND,             //!< %S
+        AM_PM,              //!< %p
+        WEEKDAY_NAME,       //!< %a
+        WEEKDAY_FULL_NAME,  //!< %A
+        MONTH_NAME,         //!< %b %h
+        MONTH_FULL_NAME,    //!< %B
+        WEEKDAY,            //!< %w
+        WEEKDAY_MONDAY,     //!< %u
+        ZONE_OFFSET,        //!< %z
+        ZONE_NAME,          //!< %Z
+    };
 
     /**
-     * @brief Where time is relative to DST
+     * @brief One operation in a compiled format specifier
      */
-    Position position = Position::NO_DST;
+    struct Op {
+        OpType type;        //!< What to output
+        uint8_t len;        //!< Length in literals for LITERAL and STRFTIME
+        uint16_t offset;    //!< Offset in literals for LITERAL and STRFTIME
+    };
 
+    std::vector<Op> ops;        //!< Compiled operations
+    std::vector<char> literals; //!< Literal text and strftime conversions, referenced by ops
+
+protected:
     /**
-     * @brief Timezone configuration for this time conversion
-     * 
-     * If you don't specify this using withConfig then the global setting is retrieved
-     * from the LocalTime singleton instance.
-     */
-    LocalTimePosixTimezone config;
+     * @brief Local time values to format
+     */
+    struct Fields {
+        int year;           //!< 4-digit year
+        int month;          //!< 1 - 12
+        int day;            //!< 1 - 31
+        int hour;           //!< 0 - 23
+        int minute;         //!< 0 - 59
+        int second;         //!< 0 - 59
+        int dayOfWeek;      //!< 0 = Sunday
+        int dayOfYear;      //!< 0 = January 1
+        bool isDST;         //!< true if in daylight saving time, for %z and %Z
+        const LocalTimePosixTimezone *config; //!< Timezone configuration, for %z and %Z
+    };
 
     /**
-     * @brief The time that is being converted. This is always Unix time at UTC
-     * 
-     * Seconds after January 1, 1970, UTC. Using methods like nextDay() increment
-     * this value.
+     * @brief Add a literal, merging with the previous op if it's also a literal
      */
-    time_t time;
+    void addLiteral(const char *str, size_t len);
 
     /**
-     * @brief The local time that corresponds to time
-     * 
-     * The convert() method sets this, as do methods like nextDay(). The local time
-     * will depend on the timezone set in config, as well as the date which will
-     * determine whether it's daylight saving or not.
+     * @brief Add an op that has no literal data
      */
-    LocalTimeValue localTimeValue;
+    void addOp(OpType type);
 
     /**
-     * @brief The time that daylight saving starts, Unix time, UTC
-     * 
-     * The config specifies the rule (2nd Sunday in March, for example), and the
-     * local time that the change occurs. This is the UTC value that corresponds
-     * to that rule in the year specified by time.
+     * @brief Compile one conversion (the character after the %)
      * 
-     * Note in the southern hemisphere, dstStart is after standardStart.
+     * @return true if it was handled, false if it should be passed to strftime()
      */
-    time_t dstStart;
+    bool compileConversion(char conversion);
 
     /**
-     * @brief The struct tm that corresponds to dstStart (UTC)
+     * @brief Run the ops with the given fields
      */
-    struct tm dstStartTimeInfo;
+    size_t format(const Fields &fields, char *buf, size_t bufSize) const;
 
     /**
-     * @brief The time that standard time starts, Unix time, UTC
-     * 
-     * The config specifies the rule (1st Sunday in November, for example), and the
-     * local time that the change occurs. This is the UTC value that corresponds
-     * to that rule in the year specified by time.
-     * 
-     * Note in the southern hemisphere, dstStart is after standardStart.
+     * @brief Fill in fields from a local time (as if local time was UTC)
      */
-    time_t standardStart;
+    static void fieldsFromLocalTime(time_t localTime, Fields &fields);
 
     /**
-     * @brief The struct tm that corresponds to standardStart (UTC)
+     * @brief Fill in a struct tm from fields, for strftime()
      */
-    struct tm standardStartTimeInfo;
+    static void fieldsToTimeInfo(const Fields &fields, struct tm *pTimeInfo);
 };
 
-
 /**
  * @brief Global time settings
  */
 class LocalTime {
 public:
+    /**
+     * @brief Immutable copy of the global timezone configuration
+     * 
+     * Each call to withConfig() allocates and publishes a new snapshot, so a reader that has a 
+     * snapshot always sees a complete configuration, even if another thread is changing it.
+     * A snapshot is never modified after it's published. Replaced snapshots are deleted once 
+     * no ConfigReader is active, so use a ConfigReader to access one.
+     */
+    struct ConfigSnapshot {
+        LocalTimePosixTimezone config;              //!< The timezone configuration
+        uint32_t version = 0;                       //!< Incremented each time withConfig() is called
+        ConfigSnapshot *nextRetired = nullptr;      //!< Next replaced snapshot waiting to be deleted
+    };
+
+    /**
+     * @brief Read access to the current global timezone configuration
+     * 
+     * The snapshot that is current when this object is constructed remains valid until it's 
+     * destructed, even if withConfig() is called from another thread in the meantime. This does 
+     * not lock or allocate memory; it increments and decrements an atomic reader count.
+     * 
+     * ```
+     * {
+     *     LocalTime::ConfigReader reader;
+     *     Log.info("timezone %s", reader.getConfig().standardName.c_str());
+     * }
+     * ```
+     * 
+     * Keep the object on the stack and only for as long as the configuration is used. Replaced
+     * snapshots are not deleted while any reader exists.
+     */
+    class ConfigReader {
+    public:
+        /**
+         * @brief Get the current snapshot and prevent it from being deleted
+         */
+        ConfigReader() : localTime(LocalTime::instance()), snapshot(localTime.acquireSnapshot()) {};
+
+        /**
+         * @brief Allow replaced snapshots to be deleted again
+         */
+        ~ConfigReader() { localTime.releaseSnapshot(); };
+
+        /**
+         * @brief This class is not copyable
+         */
+        ConfigReader(const ConfigReader&) = delete;
+
+        /**
+         * @brief This class is not copyable
+         */
+        ConfigReader& operator=(const ConfigReader&) = delete;
+
+        /**
+         * @brief Gets the timezone configuration in the snapshot
+         * 
+         * The returned object must not be modified. Because multiple threads can read it 
+         * concurrently, only use calculateTransitions() on it or make a copy of it, as 
+         * LocalTimeConvert does. Its transition cache is never written after it's published.
+         */
+        const LocalTimePosixTimezone &getConfig() const { return snapshot->config; };
+
+        /**
+         * @brief Gets the version number of the snapshot
+         */
+        uint32_t getVersion() const { return snapshot->version; };
+
+    protected:
+        LocalTime &localTime;                       //!< The instance the snapshot belongs to
+        const ConfigSnapshot *snapshot;             //!< The snapshot, valid until this object is destructed
+    };
+
     /**
      * @brief Get the global singleton instance of this class
+     * 
+     * This is safe to call from multiple threads.
      */
     static LocalTime &instance();
 
     /**
      * @brief Sets the default global timezone configuration
+     * 
+     * This is safe to call from any thread. The configuration is copied into a newly allocated
+     * snapshot which is then published atomically. The snapshot it replaces is not modified 
+     * because other threads may still be using it; it's deleted by a later call once no 
+     * ConfigReader is active. Normally the timezone is only set a few times, such as at boot 
+     * and when it's changed by the user.
+     */
+    LocalTime &withConfig(const LocalTimePosixTimezone &config);
+
+    /**
+     * @brief Gets a copy of the default global timezone configuration
+     * 
+     * This does not lock or allocate memory. A copy is returned because the snapshot it's 
+     * copied from can be deleted after withConfig() is called again. To use the configuration 
+     * without copying it, use a ConfigReader.
      */
-    LocalTime &withConfig(LocalTimePosixTimezone config) { this->config = config; return *this; };
+    LocalTimePosixTimezone getConfig() const;
 
     /**
-     * @brief Gets the default global timezone configuration
+     * @brief Gets the version number of the global timezone configuration
+     * 
+     * This is 0 until withConfig() is called and is incremented each time withConfig()
+     * is called. Compare it to a previous value to find out if the configuration changed.
      */
-    const LocalTimePosixTimezone &getConfig() const { return config; };
+    uint32_t getConfigVersion() const { return configVersion.load(std::memory_order_acquire); };
 
     /**
      * @brief Sets the maximum number of days to look ahead in the schedule for a match (default: 3)
@@ -2368,25 +5245,73 @@ public:
      * - tm_year year since 1900. Note: 2021 is 121, not 2021 or 21! Beware!
      * - tm_wday Day of week (Sunday = 0, Monday = 1, Tuesday = 2, ..., Saturday = 6)
      * - tm_yday Day of year (0 - 365). Note: zero-based, January 1 = 0
-     * - tm_isdst Daylight saving flag, always 0 on Particle devices
-     * 
-     * This basically a wrapper around localtime_r or gmtime_r.
+     * - tm_isdst Daylight saving flag, always 0
+     *
+     * This works like gmtime_r but is calculated directly using civilFromDays(), so it
+     * does not depend on the C library timezone setting or locale.
      */
     static void timeToTm(time_t time, struct tm *pTimeInfo);
 
     /**
      * @brief Converts a struct tm to a Unix time (seconds past Jan 1 1970) UTC
-     * 
+     *
      * @param pTimeInfo Pointer to a struct tm
-     * 
+     *
      * Note: tm_wday, tm_yday, and tm_isdst are ignored for calculating the result,
      * however tm_wday and tm_yday are filled in with the correct values based on
      * the date, which is why pTimeInfo is not const.
-     * 
-     * This basically a wrapper around mktime or timegm.
+     *
+     * Like mktime and timegm, out-of-range values are allowed and are normalized. For
+     * example, tm_mday = 32 in January is February 1, and tm_hour = -1 is 23:00 on the
+     * previous day. All fields of pTimeInfo are updated with the normalized values.
+     *
+     * This works like timegm but is calculated directly using daysFromCivil(), so it
+     * does not depend on the C library timezone setting or locale.
      */
     static time_t tmToTime(struct tm *pTimeInfo);
 
+    /**
+     * @brief Returns the number of days since January 1, 1970 for a date
+     *
+     * @param year The 4-digit year (2021, for example)
+     *
+     * @param month The month (1 - 12)
+     *
+     * @param day The day of the month (1 - 31)
+     *
+     * The result is negative for dates before 1970. Uses the proleptic Gregorian calendar
+     * and a closed-form calculation, there are no loops or library calls. The month must
+     * be in range, but day can be out of range (day 0 is the last day of the previous month).
+     */
+    static int daysFromCivil(int year, int month, int day);
+
+    /**
+     * @brief Converts a number of days since January 1, 1970 into a year, month, and day
+     *
+     * @param days Number of days since January 1, 1970 (can be negative)
+     *
+     * @param pYear Filled in with the 4-digit year
+     *
+     * @param pMonth Filled in with the month (1 - 12)
+     *
+     * @param pDay Filled in with the day of the month (1 - 31)
+     *
+     * This is the inverse of daysFromCivil().
+     */
+    static void civilFromDays(int days, int *pYear, int *pMonth, int *pDay);
+
+    /**
+     * @brief Returns the day of the week for a number of days since January 1, 1970
+     *
+     * @param days Number of days since January 1, 1970 (can be negative)
+     *
+     * @return int 0 = Sunday, 1 = Monday, 2 = Tuesday, ..., 6 = Saturday (same as tm_wday)
+     */
+    static int dayOfWeekFromDays(int days) {
+        // January 1, 1970 was a Thursday (4)
+        return (days >= -4) ? ((days + 4) % 7) : (((days + 5) % 7) + 6);
+    }
+
     /**
      * @brief Returns a human-readable string version of a struct tm
      * 
@@ -2408,6 +5333,10 @@ public:
      * Same for milliseconds. The T between the day and hour can be any single 
      * non-numeric character, such as a space, instead of a T.
      * 
+     * The struct tm is normalized, with tm_wday and tm_yday set and tm_isdst set to 0. 
+     * Use LocalTimeISO8601 if you need the offset or fractional seconds, or if the
+     * string is not null terminated.
+     * 
      * See also timeToString to convert in the other direction.
      */
     static time_t stringToTime(const char *str, struct tm *pTimeInfo = NULL);
@@ -2429,6 +5358,20 @@ public:
      */
     static String timeToString(time_t time, char separator = ' ');
 
+    /**
+     * @brief Converts a time to a string in a modified ISO-8601 format, storing it in a buffer
+     * 
+     * @param time Unix time (seconds past Jan 1 1970) UTC
+     * @param buf Buffer to store the string in. Always null terminated if bufSize > 0.
+     * @param bufSize Size of buf in bytes. 20 bytes is enough for years 0 - 9999.
+     * @param separator the separator between the day of month and hour, typically T or a space.
+     * @return size_t Length of the string, not including the null terminator. If this is >= bufSize 
+     * the string was truncated.
+     * 
+     * This is the same as the other overload, but does not allocate memory.
+     */
+    static size_t timeToString(time_t time, char *buf, size_t bufSize, char separator = ' ');
+
     /**
      * @brief Returns the last day of the month in a given month and year
      * 
@@ -2448,7 +5391,11 @@ public:
      * @param month Month 1 - 12 inclusive, 1 = January, 12 = December
      * @param dayOfWeek 0 = Sunday, 1 = Monday, 2 = Tuesday, ..., 6 = Saturday
      * @param ordinal 1 = first instance of that day of week in the month, 2 = second, ...
+     * -1 = last instance of that day of week in the month, -2 = second to last, ...
      * @return int The day of the month, or 0 if that ordinal does not exist in the month
+     * 
+     * This is calculated directly from the day of week of the 1st and the length of the month.
+     * It's also used by LocalTimeChange::calculate() to find the date of a time change.
      */
     static int dayOfWeekOfMonth(int year, int month, int dayOfWeek, int ordinal);
 
@@ -2456,7 +5403,7 @@ protected:
     /**
      * @brief This class is a singleton and should not be manually allocated
      */
-    LocalTime() {};
+    LocalTime() : configSnapshot(&initialSnapshot) {};
 
     /**
      * @brief This class is a singleton and should not be manually destructed
@@ -2473,14 +5420,55 @@ protected:
      */
     LocalTime& operator=(const LocalTime&) = delete;
 
+    /**
+     * @brief Used by ConfigReader to register a reader and get the current snapshot
+     */
+    const ConfigSnapshot *acquireSnapshot();
+
+    /**
+     * @brief Used by ConfigReader to unregister a reader
+     */
+    void releaseSnapshot();
+
+    /**
+     * @brief Deletes the replaced snapshots if there are no readers. Call with configMutex locked.
+     */
+    void deleteRetiredSnapshots();
+
+    /**
+     * @brief The empty configuration used until withConfig() is called. It's never deleted.
+     */
+    ConfigSnapshot initialSnapshot;
 
     /**
      * @brief Global default timezone
      * 
      * The LocalTimeConverter class will use this if a config is not set for that specific 
-     * converter.
+     * converter. Snapshots are not modified after they are published.
      */
-    LocalTimePosixTimezone config;
+    std::atomic<ConfigSnapshot *> configSnapshot;
+
+    /**
+     * @brief Version of configSnapshot, so it can be checked without a ConfigReader
+     */
+    std::atomic<uint32_t> configVersion{0};
+
+    /**
+     * @brief Number of ConfigReader objects that currently exist
+     */
+    std::atomic<uint32_t> configReaders{0};
+
+    /**
+     * @brief Snapshots replaced by withConfig() that may still be in use by a reader
+     * 
+     * Only accessed with configMutex locked.
+     */
+    ConfigSnapshot *retiredSnapshots = nullptr;
+
+    /**
+     * @brief Serializes withConfig() so only one thread publishes and deletes snapshots at a time
+     */
+    std::mutex configMutex;
 
     /**
      * @brief Number of days to look forward to see if there are scheduled events. Default: 100
@@ -2490,9 +5478,139 @@ protected:
     /**
      * @brief Singleton instance of this class
      */
-    static LocalTime *_instance;
+    static std::atomic<LocalTime *> _instance;
+};
+
+
+/**
+ * @brief Converter for a timezone with a fixed offset and no daylight saving time
+ * 
+ * The offset is a template parameter, so there is no timezone configuration stored in the 
+ * object and conversion is one addition plus the calendar decomposition, which is skipped when 
+ * the time is on the same local day as the last conversion. This is useful for
+ * zones known at compile time like UTC or India Standard Time:
+ * 
+ * ```
+ * LocalTimeFixedOffsetConvert<19800> conv; // IST-5:30
+ * conv.withCurrentTime().convert();
+ * ```
+ * 
+ * The sign of OFFSET is the conventional one (seconds east of UTC), which is the opposite
+ * of the POSIX timezone string. For a timezone string parsed at runtime, LocalTimeConvert
+ * and LocalTimeBatchConvert automatically use the same fixed offset code path when the 
+ * config has no DST rule.
+ * 
+ * @tparam OFFSET Seconds to add to UTC to get local time, for example -18000 for EST5
+ */
+template<int OFFSET>
+class LocalTimeFixedOffsetConvert {
+public:
+    static_assert(OFFSET > -24 * 3600 && OFFSET < 24 * 3600, "offset must be less than 24 hours");
+
+    /**
+     * @brief Sets the UTC time to convert
+     * 
+     * @param time time_t UTC
+     * @return LocalTimeFixedOffsetConvert& This object, for chaining options, fluent-style
+     */
+    LocalTimeFixedOffsetConvert &withTime(time_t time) { this->time = time; return *this; };
+
+    /**
+     * @brief Sets the time to convert to the current time from Time.now()
+     * 
+     * @return LocalTimeFixedOffsetConvert& This object, for chaining options, fluent-style
+     */
+    LocalTimeFixedOffsetConvert &withCurrentTime() { return withTime(Time.now()); };
+
+    /**
+     * @brief Converts time into localTimeValue
+     * 
+     * Like LocalTimeConvert, converting a time on the same local day as the last conversion 
+     * only updates the hour, minute, and second.
+     */
+    void convert() {
+        time_t localTime = toLocal(time);
+        if (localTime >= localDayStart && localTime < localDayStart + 86400 &&
+            localTimeValue.tm_mday == localDayMonthDay && localTimeValue.tm_mon == localDayMonth && localTimeValue.tm_year == localDayYear) {
+            // Same local day as the last conversion, only the time of day changes
+            int secondOfDay = (int)(localTime - localDayStart);
+            localTimeValue.tm_hour = secondOfDay / 3600;
+            localTimeValue.tm_min = (secondOfDay / 60) % 60;
+            localTimeValue.tm_sec = secondOfDay % 60;
+            return;
+        }
+
+        LocalTime::timeToTm(localTime, &localTimeValue);
+
+        localDayStart = localTime - (localTimeValue.tm_hour * 3600 + localTimeValue.tm_min * 60 + localTimeValue.tm_sec);
+        localDayYear = localTimeValue.tm_year;
+        localDayMonth = localTimeValue.tm_mon;
+        localDayMonthDay = localTimeValue.tm_mday;
+    };
+
+    /**
+     * @brief Always returns false, there is no daylight saving time in a fixed offset zone
+     */
+    bool isDST() const { return false; };
+
+    /**
+     * @brief Converts UTC time_t to local time_t
+     * 
+     * @param time time_t UTC
+     * @return time_t Local time as if it were UTC
+     */
+    static constexpr time_t toLocal(time_t time) { return time + OFFSET; };
+
+    /**
+     * @brief Converts local time to UTC time_t
+     * 
+     * @param localTime Local time as a struct tm (may be unnormalized, like mktime)
+     * @return time_t UTC
+     */
+    static time_t toUTC(struct tm localTime) { return LocalTime::tmToTime(&localTime) - OFFSET; };
+
+    /**
+     * @brief Returns the offset in seconds to add to UTC to get local time
+     */
+    static constexpr int getOffset() { return OFFSET; };
+
+    /**
+     * @brief Returns true if a runtime timezone config is equivalent to this converter
+     * 
+     * @param config Timezone configuration to compare
+     * 
+     * The config must be valid, have no DST rule, and have the same standard time offset.
+     */
+    static bool isEquivalent(const LocalTimePosixTimezone &config) {
+        return config.isValid() && !config.hasDST() && config.getOffset(false) == OFFSET;
+    };
+
+    /**
+     * @brief The time to convert (UTC)
+     */
+    time_t time = 0;
+
+    /**
+     * @brief The local time after calling convert()
+     */
+    LocalTimeValue localTimeValue;
+
+protected:
+    /**
+     * @brief Local time of midnight of the day in localTimeValue, used by convert()
+     */
+    time_t localDayStart = 0;
+
+    int localDayYear = -1;      //!< tm_year of localDayStart, to detect if localTimeValue was modified
+    int localDayMonth = -1;     //!< tm_mon of localDayStart
+    int localDayMonthDay = -1;  //!< tm_mday of localDayStart
 };
 
+/**
+ * @brief Converter for UTC, no offset and no DST
+ */
+typedef LocalTimeFixedOffsetConvert<0> LocalTimeUTCConvert;
+
 
 /**
  * @brief Container for a date and time range. Specifies a date and time start and a date and time end